@@ -95,6 +95,20 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(height_txids[0], txidb0)
         assert_equal(height_txids[1], txidb1)
 
+        # Check that paging with a cursor works
+        print "Testing paged txids and deltas..."
+        page_txids = self.nodes[1].getaddresstxids({"addresses": ["2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br"], "limit": 2})
+        assert_equal(page_txids["txids"], [txidb0, txidb1])
+        page_txids = self.nodes[1].getaddresstxids({"addresses": ["2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br"], "limit": 2, "cursor": page_txids["next"]})
+        assert_equal(page_txids["txids"], [txidb2])
+        assert("next" not in page_txids)
+
+        page_deltas = self.nodes[1].getaddressdeltas({"addresses": ["2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br"], "start": 105, "end": 110, "limit": 1})
+        assert_equal(len(page_deltas["deltas"]), 1)
+        assert_equal(page_deltas["deltas"][0]["txid"], txidb0)
+        page_deltas = self.nodes[1].getaddressdeltas({"addresses": ["2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br"], "start": 105, "end": 110, "limit": 1, "cursor": page_deltas["next"]})
+        assert_equal(page_deltas["deltas"][0]["txid"], txidb1)
+
         # Check that multiple addresses works
         multitxids = self.nodes[1].getaddresstxids({"addresses": ["2N2JD6wb56AfK4tfmM6PwdVmoYk2dCKf4Br", "mo9ncXisMeAoXwqcV5EWuyncbmCcQN4rVs"]})
         assert_equal(len(multitxids), 6)
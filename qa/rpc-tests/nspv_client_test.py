@@ -110,6 +110,34 @@ class TestNspvClient(unittest.TestCase):
         self.assertEqual(result["result"], "success")
         self.assertEqual(result["address"], chain_params.get(chain).get("tx_list_address"))
 
+    def test_nspv_listunspentpage(self):
+        print("testing nspv_listunspentpage")
+        address = chain_params.get(chain).get("tx_list_address")
+        result = rpc_proxy.nspv_listunspentpage(address, "0", "", "1")
+        self.assertEqual(result["result"], "success")
+        self.assertEqual(result["address"], address)
+        self.assertLessEqual(result["numutxos"], 1)
+        time.sleep(1)
+        if result["cursor"]:
+            page = rpc_proxy.nspv_listunspentpage(address, "0", result["cursor"], "1")
+            self.assertEqual(page["result"], "success")
+            self.assertNotEqual(page["utxos"], result["utxos"])
+            time.sleep(1)
+
+    def test_nspv_listtransactionspage(self):
+        print("testing nspv_listtransactionspage")
+        address = chain_params.get(chain).get("tx_list_address")
+        result = rpc_proxy.nspv_listtransactionspage(address, "0", "", "2")
+        self.assertEqual(result["result"], "success")
+        self.assertEqual(result["numtxids"], 2)
+        self.assertNotEqual(result["cursor"], "")
+        time.sleep(1)
+        page = rpc_proxy.nspv_listtransactionspage(address, "0", result["cursor"], "2")
+        self.assertEqual(page["result"], "success")
+        self.assertGreaterEqual(page["txids"][0]["height"], result["txids"][1]["height"])
+        self.assertNotEqual(page["txids"][0], result["txids"][1])
+        time.sleep(1)
+
     def test_nspv_spend(self):
         print("testing nspv_spend")
         result = rpc_proxy.nspv_login(wif)
@@ -0,0 +1,76 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016-2023 The Komodo Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test compact block relay (BIP152): a node that has the transactions
+# of a new block in its mempool rebuilds the block without downloading
+# them, a node that doesn't asks for the missing ones.
+#
+
+import time
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, initialize_chain_clean, \
+    start_node, connect_nodes, sync_blocks
+
+
+class CompactBlocksTest(BitcoinTestFramework):
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 3)
+
+    def setup_network(self):
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-debug"]))
+        self.nodes.append(start_node(1, self.options.tmpdir, ["-debug"]))
+        # Node 2 doesn't accept the transactions into its mempool
+        self.nodes.append(start_node(2, self.options.tmpdir, ["-debug", "-minrelaytxfee=1"]))
+        # Outbound connections ask node 0 to announce new blocks as compact blocks
+        connect_nodes(self.nodes[1], 0)
+        connect_nodes(self.nodes[2], 0)
+
+        self.is_network_split = False
+        sync_blocks(self.nodes)
+
+    def peer_of(self, node):
+        peers = node.getpeerinfo()
+        assert_equal(len(peers), 1)
+        return peers[0]
+
+    def run_test(self):
+        print "Mining blocks..."
+        self.nodes[0].generate(101)
+        sync_blocks(self.nodes)
+
+        for node in self.nodes[1:]:
+            assert_equal(self.peer_of(node)["cmpctblock"], True)
+        for peer in self.nodes[0].getpeerinfo():
+            assert_equal(peer["cmpctblock"], True)
+
+        reconstructed = self.peer_of(self.nodes[1])["cmpctblocks_reconstructed"]
+        requested = self.peer_of(self.nodes[2])["cmpctblocks_txn_requested"]
+
+        txid = self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        for i in range(60):
+            if txid in self.nodes[1].getrawmempool():
+                break
+            time.sleep(1)
+        assert(txid in self.nodes[1].getrawmempool())
+        assert(txid not in self.nodes[2].getrawmempool())
+
+        print "Relaying a block as compact block..."
+        blockhash = self.nodes[0].generate(1)[0]
+        sync_blocks(self.nodes)
+        for node in self.nodes:
+            assert_equal(node.getbestblockhash(), blockhash)
+            assert(txid in node.getblock(blockhash)["tx"])
+
+        # Node 1 had the transaction, node 2 had to ask for it
+        assert(self.peer_of(self.nodes[1])["cmpctblocks_reconstructed"] > reconstructed)
+        assert(self.peer_of(self.nodes[2])["cmpctblocks_txn_requested"] > requested)
+        assert(self.peer_of(self.nodes[2])["cmpctblocks_reconstructed"] > 0)
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
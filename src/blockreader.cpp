@@ -0,0 +1,244 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreader.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/consensus.h"
+#include "main.h"
+#include "streams.h"
+#include "util.h"
+
+#include <algorithm>
+
+CBlockFileReader::CBlockFileReader(FILE *fileInIn, size_t nMaxAheadIn) :
+    fileIn(fileInIn), nMaxAhead(nMaxAheadIn), fDone(false), fStop(false)
+{
+    thread = boost::thread(&CBlockFileReader::Thread, this);
+}
+
+CBlockFileReader::~CBlockFileReader()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condConsumed.notify_all();
+    thread.join();
+}
+
+bool CBlockFileReader::Push(const std::shared_ptr<CBlock> &pblock, uint64_t nBlockPos)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (queue.size() >= nMaxAhead && !fStop)
+        condConsumed.wait(lock);
+    if (fStop)
+        return false;
+    Entry entry;
+    entry.pblock = pblock;
+    entry.nBlockPos = nBlockPos;
+    queue.push_back(entry);
+    condProduced.notify_one();
+    return true;
+}
+
+void CBlockFileReader::Thread()
+{
+    RenameThread("komodo-blkread");
+    const CChainParams& chainparams = Params();
+    try {
+        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE(10000000), MAX_BLOCK_SIZE(10000000)+8, SER_DISK, CLIENT_VERSION);
+        uint64_t nRewind = blkdat.GetPos();
+        while (!blkdat.eof()) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (fStop)
+                    break;
+            }
+
+            blkdat.SetPos(nRewind);
+            nRewind++; // start one byte further next time, in case of failure
+            blkdat.SetLimit(); // remove former limit
+            unsigned int nSize = 0;
+            try {
+                // locate a header
+                unsigned char buf[MESSAGE_START_SIZE];
+                blkdat.FindByte(chainparams.MessageStart()[0]);
+                nRewind = blkdat.GetPos()+1;
+                blkdat >> FLATDATA(buf);
+                if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
+                    continue;
+                // read size
+                blkdat >> nSize;
+                if (nSize < 80 || nSize > MAX_BLOCK_SIZE(10000000))
+                    continue;
+            } catch (const std::exception&) {
+                // no valid block header found; don't complain
+                break;
+            }
+            try {
+                // read block
+                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                uint64_t nBlockPos = blkdat.GetPos();
+                blkdat.SetLimit(nBlockPos + nSize);
+                blkdat.SetPos(nBlockPos);
+                blkdat >> *pblock;
+                nRewind = blkdat.GetPos();
+
+                pblock->BuildMerkleTree();
+                if (!Push(pblock, nBlockPos))
+                    break;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        strError = e.what();
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fDone = true;
+    }
+    condProduced.notify_all();
+}
+
+bool CBlockFileReader::Next(std::shared_ptr<CBlock> &pblock, uint64_t &nBlockPos)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (queue.empty() && !fDone)
+        condProduced.wait(lock);
+    if (!queue.empty()) {
+        pblock = queue.front().pblock;
+        nBlockPos = queue.front().nBlockPos;
+        queue.pop_front();
+        condConsumed.notify_one();
+        return true;
+    }
+    if (!strError.empty())
+        throw std::runtime_error(strError);
+    return false;
+}
+
+void CBlockReadAhead::Read(Entry &entry)
+{
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(entry.nHeight, *pblock, entry.pos, true) || pblock->GetHash() != entry.hash)
+        return;
+    pblock->BuildMerkleTree();
+    entry.pblock = pblock;
+}
+
+void CBlockReadAhead::Thread()
+{
+    RenameThread("komodo-blkahead");
+    while (true) {
+        std::shared_ptr<Entry> pentry;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty())
+                condWork.wait(lock);
+            pentry = queue.front();
+            queue.pop_front();
+            pentry->fStarted = true;
+        }
+        Read(*pentry);
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            pentry->fDone = true;
+        }
+        condDone.notify_all();
+    }
+}
+
+bool CBlockReadAhead::Request(const uint256 &hash, int nHeight, const CDiskBlockPos &pos)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (mapEntries.count(hash))
+        return true;
+    if (mapEntries.size() >= nMaxEntries)
+        return false;
+    std::shared_ptr<Entry> pentry = std::make_shared<Entry>();
+    pentry->hash = hash;
+    pentry->nHeight = nHeight;
+    pentry->pos = pos;
+    pentry->fStarted = false;
+    pentry->fDone = false;
+    mapEntries[hash] = pentry;
+    queue.push_back(pentry);
+    condWork.notify_one();
+    return true;
+}
+
+std::shared_ptr<CBlock> CBlockReadAhead::Take(const uint256 &hash)
+{
+    std::shared_ptr<Entry> pentry;
+    {
+        // Workers always finish the block they started, don't leave the caller half way
+        boost::this_thread::disable_interruption di;
+        boost::unique_lock<boost::mutex> lock(mutex);
+        std::map<uint256, std::shared_ptr<Entry> >::iterator it = mapEntries.find(hash);
+        if (it == mapEntries.end())
+            return nullptr;
+        pentry = it->second;
+        mapEntries.erase(it);
+        if (pentry->fStarted) {
+            while (!pentry->fDone)
+                condDone.wait(lock);
+            return pentry->pblock;
+        }
+        queue.erase(std::find(queue.begin(), queue.end(), pentry));
+        pentry->fStarted = true;
+    }
+    Read(*pentry);
+    return pentry->pblock;
+}
+
+void CBlockReadAhead::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    queue.clear();
+    mapEntries.clear();
+}
+
+CRawBlockRef CRawBlockCache::Get(const uint256 &hash)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<uint256, EntryList::iterator>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return nullptr;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+void CRawBlockCache::Insert(const uint256 &hash, const CRawBlockRef &raw)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (!raw || raw->size() > nMaxBytes || mapEntries.count(hash))
+        return;
+    entries.push_front(std::make_pair(hash, raw));
+    mapEntries[hash] = entries.begin();
+    nBytes += raw->size();
+    while (nBytes > nMaxBytes) {
+        nBytes -= entries.back().second->size();
+        mapEntries.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+size_t CRawBlockCache::Bytes()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nBytes;
+}
+
+void CRawBlockCache::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    entries.clear();
+    mapEntries.clear();
+    nBytes = 0;
+}
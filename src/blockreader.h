@@ -0,0 +1,172 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_BLOCKREADER_H
+#define KOMODO_BLOCKREADER_H
+
+#include "chain.h"
+#include "primitives/block.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+/**
+ * Scans a block file (blk?????.dat or bootstrap.dat) on a background thread,
+ * keeping up to nMaxAhead blocks ahead of the consumer. The blocks are
+ * deserialized (which computes the txids) and have their merkle tree built,
+ * so the validation thread only receives prepared blocks.
+ */
+class CBlockFileReader
+{
+private:
+    struct Entry
+    {
+        std::shared_ptr<CBlock> pblock;
+        uint64_t nBlockPos;
+    };
+
+    FILE *fileIn;
+    size_t nMaxAhead;
+    boost::mutex mutex;
+    boost::condition_variable condProduced;
+    boost::condition_variable condConsumed;
+    std::deque<Entry> queue;
+    bool fDone;
+    bool fStop;
+    std::string strError;
+    boost::thread thread;
+
+    void Thread();
+    bool Push(const std::shared_ptr<CBlock> &pblock, uint64_t nBlockPos);
+
+    // Disallow copies
+    CBlockFileReader(const CBlockFileReader&);
+    CBlockFileReader& operator=(const CBlockFileReader&);
+
+public:
+    /****
+     * Start scanning
+     * @param fileIn the file, closed by the reader
+     * @param nMaxAhead the number of blocks to keep ready
+     */
+    CBlockFileReader(FILE *fileIn, size_t nMaxAhead);
+    ~CBlockFileReader();
+
+    /****
+     * Take the next block of the file, waiting for it if needed
+     * @param[out] pblock the block
+     * @param[out] nBlockPos its position in the file
+     * @returns false at the end of the file
+     * @throws std::runtime_error on a file system error
+     */
+    bool Next(std::shared_ptr<CBlock> &pblock, uint64_t &nBlockPos);
+};
+
+/**
+ * Reads stored blocks ahead of validation on the threads that run Thread().
+ * Requested blocks are read from disk, deserialized, checked against their
+ * hash and have their merkle tree built.
+ */
+class CBlockReadAhead
+{
+private:
+    struct Entry
+    {
+        uint256 hash;
+        int nHeight;
+        CDiskBlockPos pos;
+        std::shared_ptr<CBlock> pblock; // NULL if the read failed
+        bool fStarted;
+        bool fDone;
+    };
+
+    size_t nMaxEntries;
+    boost::mutex mutex;
+    boost::condition_variable condWork;
+    boost::condition_variable condDone;
+    std::deque<std::shared_ptr<Entry> > queue;
+    std::map<uint256, std::shared_ptr<Entry> > mapEntries;
+
+    static void Read(Entry &entry);
+
+public:
+    CBlockReadAhead(size_t nMaxEntriesIn) : nMaxEntries(nMaxEntriesIn) {}
+
+    //! Worker thread
+    void Thread();
+
+    /****
+     * Queue a block to be read
+     * @param hash the block hash
+     * @param nHeight the block height
+     * @param pos the block position on disk
+     * @returns false if too many blocks are pending
+     */
+    bool Request(const uint256 &hash, int nHeight, const CDiskBlockPos &pos);
+
+    /****
+     * Take a requested block, reading it in the calling thread if no worker started it yet
+     * @param hash the block hash
+     * @returns the block, or NULL if it was not requested or could not be read
+     */
+    std::shared_ptr<CBlock> Take(const uint256 &hash);
+
+    //! Drop all pending blocks
+    void Clear();
+};
+
+/** A block in its disk serialization, which is also its network serialization */
+typedef std::shared_ptr<const std::vector<unsigned char> > CRawBlockRef;
+
+/**
+ * Keeps the most recently served raw blocks, up to a total size in bytes,
+ * so that blocks requested by many peers are read from disk only once.
+ */
+class CRawBlockCache
+{
+private:
+    typedef std::list<std::pair<uint256, CRawBlockRef> > EntryList;
+
+    size_t nMaxBytes;
+    size_t nBytes;
+    boost::mutex mutex;
+    EntryList entries; // most recently used first
+    std::map<uint256, EntryList::iterator> mapEntries;
+
+public:
+    CRawBlockCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn), nBytes(0) {}
+
+    /****
+     * Look up a block and mark it as recently used
+     * @param hash the block hash
+     * @returns the block, or NULL if it is not cached
+     */
+    CRawBlockRef Get(const uint256 &hash);
+
+    /****
+     * Add a block, evicting the least recently used ones to stay within the size
+     * @param hash the block hash
+     * @param raw the serialized block
+     */
+    void Insert(const uint256 &hash, const CRawBlockRef &raw);
+
+    //! Total size of the cached blocks
+    size_t Bytes();
+
+    //! Drop all blocks
+    void Clear();
+};
+
+#endif // KOMODO_BLOCKREADER_H
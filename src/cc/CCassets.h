@@ -24,6 +24,7 @@
 #define CC_ASSETS_H
 
 #include "CCinclude.h"
+#include "CCassetsorderbook.h"
 
 // CCcustom
 bool AssetsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &tx, uint32_t nIn);
@@ -42,12 +43,15 @@ bool SetSwapFillamounts(int64_t &paid,int64_t &remaining_price,int64_t orig_nVal
 int64_t AssetValidateBuyvin(struct CCcontract_info *cp,Eval* eval,int64_t &tmpprice,std::vector<uint8_t> &tmporigpubkey,char *CCaddr,char *origaddr,const CTransaction &tx,uint256 refassetid);
 int64_t AssetValidateSellvin(struct CCcontract_info *cp,Eval* eval,int64_t &tmpprice,std::vector<uint8_t> &tmporigpubkey,char *CCaddr,char *origaddr,const CTransaction &tx,uint256 assetid);
 bool AssetCalcAmounts(struct CCcontract_info *cpAssets, int64_t &inputs, int64_t &outputs, Eval* eval, const CTransaction &tx, uint256 assetid);
+bool DecodeAssetOrders(const CTransaction &tx, std::vector<CAssetOrder> &orders);
+
+extern CAssetsOrderBook assetsOrderBook;
 
 // CCassetstx
 //int64_t GetAssetBalance(CPubKey pk,uint256 tokenid); // --> GetTokenBalance()
 int64_t AddAssetInputs(struct CCcontract_info *cp, CMutableTransaction &mtx, CPubKey pk, uint256 assetid, int64_t total, int32_t maxinputs);
 
-UniValue AssetOrders(uint256 tokenid, CPubKey pubkey, uint8_t additionalEvalCode);
+UniValue AssetOrders(uint256 tokenid, CPubKey pubkey, uint8_t additionalEvalCode, int32_t offset = 0, int32_t limit = 0);
 //UniValue AssetInfo(uint256 tokenid);
 //UniValue AssetList();
 //std::string CreateAsset(int64_t txfee,int64_t assetsupply,std::string name,std::string description);
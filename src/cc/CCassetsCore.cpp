@@ -648,3 +648,69 @@ bool AssetCalcAmounts(struct CCcontract_info *cpAssets, int64_t &inputs, int64_t
 		it's now done in Tokens  */
 	return(true);
 }
+
+// the orders created by an assets transaction: its outputs on the assets global addresses
+bool DecodeAssetOrders(const CTransaction &tx, std::vector<CAssetOrder> &orders)
+{
+    vscript_t vopret, vopretAssets, vopretNonfungible;
+    std::vector<CPubKey> voutPubkeys;
+    std::vector<std::pair<uint8_t, vscript_t>> oprets;
+    struct CCcontract_info *cpAssets, assetsC;
+    char coinsaddr[64], tokensaddr[64], nftaddr[64], destaddr[64];
+    uint8_t evalCode, funcid;
+    uint256 tokenid, assetid2;
+    int64_t price;
+    std::vector<uint8_t> origpubkey;
+
+    orders.clear();
+    // checked before DecodeAssetTokenOpRet which logs any other transaction
+    if (tx.vout.size() < 2 || !GetOpReturnData(tx.vout.back().scriptPubKey, vopret) || vopret.empty() || vopret[0] != EVAL_TOKENS)
+        return false;
+    if (DecodeTokenOpRet(tx.vout.back().scriptPubKey, evalCode, tokenid, voutPubkeys, oprets) == 0 || !GetOpretBlob(oprets, OPRETID_ASSETSDATA, vopretAssets) || vopretAssets.empty() || vopretAssets[0] != EVAL_ASSETS)
+        return false;
+    if ((funcid = DecodeAssetTokenOpRet(tx.vout.back().scriptPubKey, evalCode, tokenid, assetid2, price, origpubkey)) == 0)
+        return false;
+
+    cpAssets = CCinit(&assetsC, EVAL_ASSETS);
+    GetCCaddress(cpAssets, coinsaddr, GetUnspendable(cpAssets, NULL));
+    GetTokensCCaddress(cpAssets, tokensaddr, GetUnspendable(cpAssets, NULL));
+    bool fNonfungibleRead = false;
+    for (int32_t v = 0; v < (int32_t)tx.vout.size() - 1; v++)
+    {
+        uint8_t evalcode2 = 0;
+        if (!tx.vout[v].scriptPubKey.IsPayToCryptoCondition() || !Getscriptaddress(destaddr, tx.vout[v].scriptPubKey))
+            continue;
+        if (strcmp(destaddr, coinsaddr) != 0 && strcmp(destaddr, tokensaddr) != 0)
+        {
+            // an ask of non-fungible tokens is on the address with their evalcode
+            if (!fNonfungibleRead)
+            {
+                fNonfungibleRead = true;
+                GetNonfungibleData(tokenid, vopretNonfungible);
+                if (!vopretNonfungible.empty())
+                {
+                    cpAssets->additionalTokensEvalcode2 = vopretNonfungible[0];
+                    GetTokensCCaddress(cpAssets, nftaddr, GetUnspendable(cpAssets, NULL));
+                }
+            }
+            if (vopretNonfungible.empty() || strcmp(destaddr, nftaddr) != 0)
+                continue;
+            evalcode2 = vopretNonfungible[0];
+        }
+
+        CAssetOrder order;
+        order.funcid = funcid;
+        order.outpoint = COutPoint(tx.GetHash(), v);
+        order.amount = tx.vout[v].nValue;
+        order.amount0 = tx.vout[0].nValue;
+        order.assetid = tokenid;
+        order.assetid2 = assetid2;
+        order.price = price;
+        order.origpubkey = origpubkey;
+        order.evalcode2 = evalcode2;
+        orders.push_back(order);
+    }
+    return true;
+}
+
+CAssetsOrderBook assetsOrderBook(DecodeAssetOrders, [](const uint256 &txid) { return mempool.exists(txid); }, 100);
@@ -0,0 +1,235 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCassetsorderbook.h"
+#include "chain.h"
+
+#include <algorithm>
+
+double CAssetOrder::UnitPrice() const
+{
+    if (price <= 0 || amount0 <= 0)
+        return 0;
+    // same as the price shown by tokenorders
+    if (funcid == 's' || funcid == 'S' || funcid == 'e')
+        return (double)price / (COIN * amount0);
+    return (double)amount0 / (price * COIN);
+}
+
+static bool BidOrder(const CAssetOrder &a, const CAssetOrder &b)
+{
+    const double pa = a.UnitPrice(), pb = b.UnitPrice();
+    return pa != pb ? pa > pb : a.outpoint < b.outpoint;
+}
+
+static bool AskOrder(const CAssetOrder &a, const CAssetOrder &b)
+{
+    const double pa = a.UnitPrice(), pb = b.UnitPrice();
+    return pa != pb ? pa < pb : a.outpoint < b.outpoint;
+}
+
+void CAssetsOrderBook::AddOrder(const CAssetOrder &order)
+{
+    mapOrders[order.outpoint] = order;
+    mapTokenOrders[order.assetid].insert(order.outpoint);
+}
+
+bool CAssetsOrderBook::EraseOrder(const COutPoint &outpoint, CAssetOrder *pOrder)
+{
+    std::map<COutPoint, CAssetOrder>::iterator it = mapOrders.find(outpoint);
+    if (it == mapOrders.end())
+        return false;
+    std::map<uint256, std::set<COutPoint> >::iterator itToken = mapTokenOrders.find(it->second.assetid);
+    if (itToken != mapTokenOrders.end()) {
+        itToken->second.erase(outpoint);
+        if (itToken->second.empty())
+            mapTokenOrders.erase(itToken);
+    }
+    if (pOrder != NULL)
+        *pOrder = it->second;
+    mapOrders.erase(it);
+    return true;
+}
+
+void CAssetsOrderBook::Reset()
+{
+    fLoaded = false;
+    hashTip.SetNull();
+    setLoaded.clear();
+    mapOrders.clear();
+    mapTokenOrders.clear();
+    dequeUndo.clear();
+}
+
+bool CAssetsOrderBook::IsLoaded(const uint256 &hashTipIn, uint8_t evalcode2)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fLoaded && hashTip == hashTipIn && setLoaded.count(evalcode2) != 0;
+}
+
+void CAssetsOrderBook::Load(const uint256 &hashTipIn, uint8_t evalcode2, const std::vector<CAssetOrder> &orders)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (!fLoaded || hashTip != hashTipIn || evalcode2 == 0) {
+        Reset();
+        fLoaded = true;
+        hashTip = hashTipIn;
+    }
+    for (std::vector<CAssetOrder>::const_iterator it = orders.begin(); it != orders.end(); it++)
+        AddOrder(*it);
+    setLoaded.insert(evalcode2);
+}
+
+void CAssetsOrderBook::ConnectBlock(const CBlock &block, const uint256 &hashPrev, const uint256 &hashBlock)
+{
+    // decoded before taking the lock, the decoder may need cs_main
+    std::vector<std::vector<CAssetOrder> > vCreated(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        decoder(block.vtx[i], vCreated[i]);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        mapMempool.erase(block.vtx[i].GetHash());
+    if (!fLoaded)
+        return;
+    if (hashPrev != hashTip) {
+        Reset();
+        return;
+    }
+
+    BlockUndo undo;
+    undo.hashBlock = hashBlock;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
+        CAssetOrder order;
+        if (!tx.IsCoinBase()) {
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                if (EraseOrder(tx.vin[j].prevout, &order))
+                    undo.vSpent.push_back(order);
+            }
+        }
+        for (std::vector<CAssetOrder>::const_iterator it = vCreated[i].begin(); it != vCreated[i].end(); it++)
+            AddOrder(*it);
+    }
+    dequeUndo.push_back(undo);
+    while (dequeUndo.size() > nMaxUndo)
+        dequeUndo.pop_front();
+    hashTip = hashBlock;
+}
+
+void CAssetsOrderBook::DisconnectBlock(const CBlock &block, const uint256 &hashBlock, const uint256 &hashPrev)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (!fLoaded)
+        return;
+    if (hashBlock != hashTip || dequeUndo.empty() || dequeUndo.back().hashBlock != hashBlock) {
+        Reset();
+        return;
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
+        for (uint32_t k = 0; k < tx.vout.size(); k++)
+            EraseOrder(COutPoint(tx.GetHash(), k), NULL);
+    }
+    const BlockUndo &undo = dequeUndo.back();
+    for (std::vector<CAssetOrder>::const_iterator it = undo.vSpent.begin(); it != undo.vSpent.end(); it++)
+        AddOrder(*it);
+    dequeUndo.pop_back();
+    hashTip = hashPrev;
+}
+
+void CAssetsOrderBook::AddMempoolTx(const CTransaction &tx)
+{
+    MempoolTx entry;
+    if (tx.IsCoinBase() || !decoder(tx, entry.vCreated))
+        return;
+    // only an assets transaction can spend an order
+    for (size_t j = 0; j < tx.vin.size(); j++)
+        entry.vSpent.push_back(tx.vin[j].prevout);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    mapMempool[tx.GetHash()] = entry;
+}
+
+void CAssetsOrderBook::GetOrders(const uint256 &assetid, std::vector<CAssetOrder> &bids, std::vector<CAssetOrder> &asks)
+{
+    std::vector<CAssetOrder> orders;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        std::set<COutPoint> setSpent;
+        for (std::map<uint256, MempoolTx>::iterator it = mapMempool.begin(); it != mapMempool.end(); ) {
+            if (!inMempool(it->first)) {
+                mapMempool.erase(it++);
+                continue;
+            }
+            setSpent.insert(it->second.vSpent.begin(), it->second.vSpent.end());
+            ++it;
+        }
+
+        if (assetid.IsNull()) {
+            for (std::map<COutPoint, CAssetOrder>::const_iterator it = mapOrders.begin(); it != mapOrders.end(); it++)
+                orders.push_back(it->second);
+        } else {
+            std::map<uint256, std::set<COutPoint> >::const_iterator itToken = mapTokenOrders.find(assetid);
+            if (itToken != mapTokenOrders.end()) {
+                for (std::set<COutPoint>::const_iterator it = itToken->second.begin(); it != itToken->second.end(); it++)
+                    orders.push_back(mapOrders[*it]);
+            }
+        }
+        for (std::map<uint256, MempoolTx>::const_iterator it = mapMempool.begin(); it != mapMempool.end(); it++) {
+            for (std::vector<CAssetOrder>::const_iterator itOrder = it->second.vCreated.begin(); itOrder != it->second.vCreated.end(); itOrder++) {
+                if (assetid.IsNull() || itOrder->assetid == assetid)
+                    orders.push_back(*itOrder);
+            }
+        }
+
+        orders.erase(std::remove_if(orders.begin(), orders.end(), [&setSpent](const CAssetOrder &order) {
+            return order.amount == 0 || setSpent.count(order.outpoint) != 0;
+        }), orders.end());
+    }
+
+    bids.clear();
+    asks.clear();
+    for (std::vector<CAssetOrder>::const_iterator it = orders.begin(); it != orders.end(); it++)
+        (it->IsBid() ? bids : asks).push_back(*it);
+    std::sort(bids.begin(), bids.end(), BidOrder);
+    std::sort(asks.begin(), asks.end(), AskOrder);
+}
+
+void CAssetsOrderBook::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    Reset();
+    mapMempool.clear();
+}
+
+void CAssetsOrderBook::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
+{
+    // the transactions of a block come with ChainTip
+    if (pblock == NULL)
+        AddMempoolTx(tx);
+}
+
+void CAssetsOrderBook::ChainTip(const CBlockIndex *pindex, const CBlock *pblock, SproutMerkleTree sproutTree, SaplingMerkleTree saplingTree, bool added)
+{
+    if (pindex == NULL || pblock == NULL)
+        return;
+    const uint256 hashPrev = pindex->pprev != NULL ? pindex->pprev->GetBlockHash() : uint256();
+    if (added)
+        ConnectBlock(*pblock, hashPrev, pindex->GetBlockHash());
+    else
+        DisconnectBlock(*pblock, pindex->GetBlockHash(), hashPrev);
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_ASSETSORDERBOOK_H
+#define CC_ASSETSORDERBOOK_H
+
+#include "amount.h"
+#include "primitives/block.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+/** An open order of the assets module: an output of an assets transaction on an assets global address */
+struct CAssetOrder
+{
+    uint8_t funcid;
+    COutPoint outpoint;
+    CAmount amount;             //!< value of the order output
+    CAmount amount0;            //!< value of vout 0 of the order transaction
+    uint256 assetid;
+    uint256 assetid2;
+    int64_t price;              //!< from the opreturn: the tokens required by a bid, the coins required by an ask
+    std::vector<uint8_t> origpubkey;
+    uint8_t evalcode2;          //!< evalcode of the non-fungible tokens address of an ask, 0 on the fungible addresses
+
+    CAssetOrder() : funcid(0), amount(0), amount0(0), price(0), evalcode2(0) {}
+
+    bool IsBid() const { return funcid == 'b' || funcid == 'B'; }
+    /** Coins per token, 0 if the opreturn has no price */
+    double UnitPrice() const;
+};
+
+/**
+ * The open orders of the assets module by tokenid, so that the order book is
+ * not rebuilt from the assets global addresses on every tokenorders call.
+ *
+ * The confirmed orders are loaded once from the address index by the caller,
+ * for a tip, then kept up to date from the blocks connected to and
+ * disconnected from that tip. The orders spent by the last nMaxUndo blocks are
+ * kept to disconnect them, past that (or on a block that does not follow the
+ * tip) the book must be loaded again.
+ *
+ * The assets transactions accepted to the mempool are kept on top: the orders
+ * they create and the outputs they spend are applied when reading, for the
+ * transactions still in the mempool.
+ */
+class CAssetsOrderBook : public CValidationInterface
+{
+public:
+    /** Orders created by a transaction, returns false if it has no assets opreturn */
+    typedef std::function<bool(const CTransaction&, std::vector<CAssetOrder>&)> Decoder;
+    typedef std::function<bool(const uint256&)> MempoolCheck;
+
+private:
+    struct MempoolTx
+    {
+        std::vector<CAssetOrder> vCreated;
+        std::vector<COutPoint> vSpent;
+    };
+
+    struct BlockUndo
+    {
+        uint256 hashBlock;
+        std::vector<CAssetOrder> vSpent;
+    };
+
+    const Decoder decoder;
+    const MempoolCheck inMempool;
+    const size_t nMaxUndo;
+
+    boost::mutex mutex;
+    bool fLoaded;
+    //! Block the confirmed orders are for
+    uint256 hashTip;
+    //! The evalcode2 of the addresses loaded, 0 for the fungible ones
+    std::set<uint8_t> setLoaded;
+    std::map<COutPoint, CAssetOrder> mapOrders;
+    std::map<uint256, std::set<COutPoint> > mapTokenOrders;
+    std::deque<BlockUndo> dequeUndo;
+    std::map<uint256, MempoolTx> mapMempool;
+
+    //! Require mutex
+    void AddOrder(const CAssetOrder &order);
+    bool EraseOrder(const COutPoint &outpoint, CAssetOrder *pOrder);
+    void Reset();
+
+protected:
+    void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
+    void ChainTip(const CBlockIndex *pindex, const CBlock *pblock, SproutMerkleTree sproutTree, SaplingMerkleTree saplingTree, bool added);
+
+public:
+    CAssetsOrderBook(const Decoder &decoderIn, const MempoolCheck &inMempoolIn, size_t nMaxUndoIn) :
+        decoder(decoderIn), inMempool(inMempoolIn), nMaxUndo(nMaxUndoIn), fLoaded(false) {}
+
+    /** Whether the orders on the addresses of evalcode2 are loaded for this tip */
+    bool IsLoaded(const uint256 &hashTipIn, uint8_t evalcode2);
+
+    /****
+     * Add the confirmed orders on the addresses of evalcode2, read at hashTipIn.
+     * The book is emptied first if it was for another tip, or for evalcode2 0.
+     */
+    void Load(const uint256 &hashTipIn, uint8_t evalcode2, const std::vector<CAssetOrder> &orders);
+
+    void ConnectBlock(const CBlock &block, const uint256 &hashPrev, const uint256 &hashBlock);
+    void DisconnectBlock(const CBlock &block, const uint256 &hashBlock, const uint256 &hashPrev);
+    void AddMempoolTx(const CTransaction &tx);
+
+    /****
+     * Read the open orders with the mempool applied
+     * @param assetid the token, null for all
+     * @param bids set to the bids, the highest price first
+     * @param asks set to the other orders, the lowest price first
+     */
+    void GetOrders(const uint256 &assetid, std::vector<CAssetOrder> &bids, std::vector<CAssetOrder> &asks);
+
+    void Clear();
+};
+
+#endif // CC_ASSETSORDERBOOK_H
@@ -17,7 +17,46 @@
 #include "CCtokens.h"
 #include "komodo_bitcoind.h"
 
-UniValue AssetOrders(uint256 refassetid, CPubKey pk, uint8_t additionalEvalCode)
+// load the confirmed orders on the assets global addresses of evalcode2 into the order book
+static void LoadAssetOrders(struct CCcontract_info *cpAssets, uint8_t evalcode2)
+{
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    std::set<COutPoint> unspents;
+    std::set<uint256> txids;
+    std::vector<CAssetOrder> orders, txorders;
+    char assetsUnspendableAddr[64];
+
+    AssertLockHeld(cs_main);
+    if (evalcode2 == 0) {
+        // bids
+        GetCCaddress(cpAssets, assetsUnspendableAddr, GetUnspendable(cpAssets, NULL));
+        SetCCunspents(unspentOutputs, assetsUnspendableAddr, true);
+    }
+    // asks
+    cpAssets->additionalTokensEvalcode2 = evalcode2;
+    GetTokensCCaddress(cpAssets, assetsUnspendableAddr, GetUnspendable(cpAssets, NULL));
+    SetCCunspents(unspentOutputs, assetsUnspendableAddr, true);
+    cpAssets->additionalTokensEvalcode2 = 0;
+
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = unspentOutputs.begin(); it != unspentOutputs.end(); it++) {
+        unspents.insert(COutPoint(it->first.txhash, it->first.index));
+        txids.insert(it->first.txhash);
+    }
+    for (std::set<uint256>::const_iterator it = txids.begin(); it != txids.end(); it++) {
+        CTransaction ordertx;
+        uint256 hashBlock;
+        if (myGetTransaction(*it, ordertx, hashBlock) == 0 || !DecodeAssetOrders(ordertx, txorders))
+            continue;
+        for (std::vector<CAssetOrder>::const_iterator itOrder = txorders.begin(); itOrder != txorders.end(); itOrder++) {
+            if (itOrder->evalcode2 == evalcode2 && unspents.count(itOrder->outpoint) != 0)
+                orders.push_back(*itOrder);
+        }
+    }
+    LOGSTREAM("ccassets", CCLOG_DEBUG1, stream << "LoadAssetOrders() evalcode2=" << (int)evalcode2 << " loaded orders=" << orders.size() << std::endl);
+    assetsOrderBook.Load(chainActive.Tip()->GetBlockHash(), evalcode2, orders);
+}
+
+UniValue AssetOrders(uint256 refassetid, CPubKey pk, uint8_t additionalEvalCode, int32_t offset, int32_t limit)
 {
 	UniValue result(UniValue::VARR);  
 
@@ -27,130 +66,95 @@ UniValue AssetOrders(uint256 refassetid, CPubKey pk, uint8_t additionalEvalCode)
     cpAssets = CCinit(&assetsC, EVAL_ASSETS);
     cpTokens = CCinit(&tokensC, EVAL_TOKENS);
 
-	auto addOrders = [&](struct CCcontract_info *cp, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it)
+	auto addOrder = [&](const CAssetOrder &order)
 	{
-		uint256 txid, hashBlock, assetid, assetid2;
-		int64_t price;
-		std::vector<uint8_t> origpubkey;
-		CTransaction ordertx;
-		uint8_t funcid, evalCode;
 		char numstr[32], funcidstr[16], origaddr[64], origtokenaddr[64];
 
-        txid = it->first.txhash;
-        LOGSTREAM("ccassets", CCLOG_DEBUG2, stream << "addOrders() checking txid=" << txid.GetHex() << std::endl);
-        if ( myGetTransaction(txid, ordertx, hashBlock) != 0 )
+        UniValue item(UniValue::VOBJ);
+
+        funcidstr[0] = order.funcid;
+        funcidstr[1] = 0;
+        item.push_back(Pair("funcid", funcidstr));
+        item.push_back(Pair("txid", order.outpoint.hash.GetHex()));
+        item.push_back(Pair("vout", (int64_t)order.outpoint.n));
+        if (order.IsBid())
+        {
+            sprintf(numstr, "%.8f", (double)order.amount / COIN);
+            item.push_back(Pair("amount", numstr));
+            sprintf(numstr, "%.8f", (double)order.amount0 / COIN);
+            item.push_back(Pair("bidamount", numstr));
+        }
+        else
+        {
+            sprintf(numstr, "%llu", (long long)order.amount);
+            item.push_back(Pair("amount", numstr));
+            sprintf(numstr, "%llu", (long long)order.amount0);
+            item.push_back(Pair("askamount", numstr));
+        }
+        if (order.origpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
         {
-			// for logging: funcid = DecodeAssetOpRet(vintx.vout[vintx.vout.size() - 1].scriptPubKey, evalCode, assetid, assetid2, price, origpubkey);
-            if (ordertx.vout.size() > 0 && (funcid = DecodeAssetTokenOpRet(ordertx.vout[ordertx.vout.size()-1].scriptPubKey, evalCode, assetid, assetid2, price, origpubkey)) != 0)
+            GetCCaddress(cpAssets, origaddr, pubkey2pk(order.origpubkey));  
+            item.push_back(Pair("origaddress", origaddr));
+            GetTokensCCaddress(cpTokens, origtokenaddr, pubkey2pk(order.origpubkey));
+            item.push_back(Pair("origtokenaddress", origtokenaddr));
+        }
+        if (order.assetid != zeroid)
+            item.push_back(Pair("tokenid", order.assetid.GetHex()));
+        if (order.assetid2 != zeroid)
+            item.push_back(Pair("otherid", order.assetid2.GetHex()));
+        if (order.price > 0)
+        {
+            if (order.funcid == 's' || order.funcid == 'S' || order.funcid == 'e')
             {
-                LOGSTREAM("ccassets", CCLOG_DEBUG2, stream << "addOrders() checking ordertx.vout.size()=" << ordertx.vout.size() << " funcid=" << (char)(funcid ? funcid : ' ') << " assetid=" << assetid.GetHex() << std::endl);
-
-                if (pk == CPubKey() && (refassetid == zeroid || assetid == refassetid)  // tokenorders
-                    || pk != CPubKey() && pk == pubkey2pk(origpubkey) && (funcid == 'S' || funcid == 's'))  // mytokenorders, returns only asks (is this correct?)
-                {
-
-                    LOGSTREAM("ccassets", CCLOG_DEBUG2, stream << "addOrders() it->first.index=" << it->first.index << " ordertx.vout[it->first.index].nValue=" << ordertx.vout[it->first.index].nValue << std::endl);
-                    if (ordertx.vout[it->first.index].nValue == 0) {
-                        LOGSTREAM("ccassets", CCLOG_DEBUG2, stream << "addOrders() order with value=0 skipped" << std::endl);
-                        return;
-                    }
-
-                    UniValue item(UniValue::VOBJ);
-
-                    funcidstr[0] = funcid;
-                    funcidstr[1] = 0;
-                    item.push_back(Pair("funcid", funcidstr));
-                    item.push_back(Pair("txid", txid.GetHex()));
-                    item.push_back(Pair("vout", (int64_t)it->first.index));
-                    if (funcid == 'b' || funcid == 'B')
-                    {
-                        sprintf(numstr, "%.8f", (double)ordertx.vout[it->first.index].nValue / COIN);
-                        item.push_back(Pair("amount", numstr));
-                        sprintf(numstr, "%.8f", (double)ordertx.vout[0].nValue / COIN);
-                        item.push_back(Pair("bidamount", numstr));
-                    }
-                    else
-                    {
-                        sprintf(numstr, "%llu", (long long)ordertx.vout[it->first.index].nValue);
-                        item.push_back(Pair("amount", numstr));
-                        sprintf(numstr, "%llu", (long long)ordertx.vout[0].nValue);
-                        item.push_back(Pair("askamount", numstr));
-                    }
-                    if (origpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
-                    {
-                        GetCCaddress(cp, origaddr, pubkey2pk(origpubkey));  
-                        item.push_back(Pair("origaddress", origaddr));
-                        GetTokensCCaddress(cpTokens, origtokenaddr, pubkey2pk(origpubkey));
-                        item.push_back(Pair("origtokenaddress", origtokenaddr));
-                    }
-                    if (assetid != zeroid)
-                        item.push_back(Pair("tokenid", assetid.GetHex()));
-                    if (assetid2 != zeroid)
-                        item.push_back(Pair("otherid", assetid2.GetHex()));
-                    if (price > 0)
-                    {
-                        if (funcid == 's' || funcid == 'S' || funcid == 'e' || funcid == 'e')
-                        {
-                            sprintf(numstr, "%.8f", (double)price / COIN);
-                            item.push_back(Pair("totalrequired", numstr));
-                            sprintf(numstr, "%.8f", (double)price / (COIN * ordertx.vout[0].nValue));
-                            item.push_back(Pair("price", numstr));
-                        }
-                        else
-                        {
-                            item.push_back(Pair("totalrequired", (int64_t)price));
-                            sprintf(numstr, "%.8f", (double)ordertx.vout[0].nValue / (price * COIN));
-                            item.push_back(Pair("price", numstr));
-                        }
-                    }
-                    result.push_back(item);
-                    LOGSTREAM("ccassets", CCLOG_DEBUG1, stream << "addOrders() added order funcId=" << (char)(funcid ? funcid : ' ') << " it->first.index=" << it->first.index << " ordertx.vout[it->first.index].nValue=" << ordertx.vout[it->first.index].nValue << " tokenid=" << assetid.GetHex() << std::endl);
-                }
+                sprintf(numstr, "%.8f", (double)order.price / COIN);
+                item.push_back(Pair("totalrequired", numstr));
             }
+            else
+                item.push_back(Pair("totalrequired", (int64_t)order.price));
+            sprintf(numstr, "%.8f", order.UnitPrice());
+            item.push_back(Pair("price", numstr));
         }
+        result.push_back(item);
 	};
 
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputsTokens, unspentOutputsDualEvalTokens, unspentOutputsCoins;
-
-	char assetsUnspendableAddr[64];
-	GetCCaddress(cpAssets, assetsUnspendableAddr, GetUnspendable(cpAssets, NULL));
-	SetCCunspents(unspentOutputsCoins, assetsUnspendableAddr,true);
-
-	char assetsTokensUnspendableAddr[64];
+    // the non-fungible tokens asks are on the address with their evalcode
+    uint8_t evalcode2 = additionalEvalCode;
     std::vector<uint8_t> vopretNonfungible;
     if (refassetid != zeroid) {
         GetNonfungibleData(refassetid, vopretNonfungible);
         if (vopretNonfungible.size() > 0)
-            cpAssets->additionalTokensEvalcode2 = vopretNonfungible.begin()[0];
+            evalcode2 = vopretNonfungible.begin()[0];
     }
-	GetTokensCCaddress(cpAssets, assetsTokensUnspendableAddr, GetUnspendable(cpAssets, NULL));
-	SetCCunspents(unspentOutputsTokens, assetsTokensUnspendableAddr,true);
-
-    // tokenbids:
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator itCoins = unspentOutputsCoins.begin();
-        itCoins != unspentOutputsCoins.end();
-        itCoins++)
-        addOrders(cpAssets, itCoins);
-    
-    // tokenasks:
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator itTokens = unspentOutputsTokens.begin();
-		itTokens != unspentOutputsTokens.end();
-		itTokens++)
-		addOrders(cpAssets, itTokens);
-
-    if (additionalEvalCode != 0) {  //this would be mytokenorders
-        char assetsDualEvalTokensUnspendableAddr[64];
-
-        // try also dual eval tokenasks (and we do not need bids):
-        cpAssets->additionalTokensEvalcode2 = additionalEvalCode;
-        GetTokensCCaddress(cpAssets, assetsDualEvalTokensUnspendableAddr, GetUnspendable(cpAssets, NULL));
-        SetCCunspents(unspentOutputsDualEvalTokens, assetsDualEvalTokensUnspendableAddr,true);
-
-        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator itDualEvalTokens = unspentOutputsDualEvalTokens.begin();
-            itDualEvalTokens != unspentOutputsDualEvalTokens.end();
-            itDualEvalTokens++)
-            addOrders(cpAssets, itDualEvalTokens);
+
+    std::vector<CAssetOrder> bids, asks;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip() == NULL)
+            return(result);
+        // the order book is not updated without the validation interface
+        if (KOMODO_NSPV_SUPERLITE || !assetsOrderBook.IsLoaded(chainActive.Tip()->GetBlockHash(), 0))
+            LoadAssetOrders(cpAssets, 0);
+        if (evalcode2 != 0 && !assetsOrderBook.IsLoaded(chainActive.Tip()->GetBlockHash(), evalcode2))
+            LoadAssetOrders(cpAssets, evalcode2);
+    }
+    assetsOrderBook.GetOrders(refassetid, bids, asks);
+
+    // tokenbids, then tokenasks
+    int32_t n = 0;
+    bids.insert(bids.end(), asks.begin(), asks.end());
+    for (std::vector<CAssetOrder>::const_iterator it = bids.begin(); it != bids.end(); it++)
+    {
+        if (it->evalcode2 != 0 && it->evalcode2 != evalcode2)
+            continue;
+        if (pk != CPubKey() && (pk != pubkey2pk(it->origpubkey) || it->funcid != 'S' && it->funcid != 's'))  // mytokenorders, returns only asks (is this correct?)
+            continue;
+        if (n++ < offset)
+            continue;
+        if (limit > 0 && result.size() >= (size_t)limit)
+            break;
+        addOrder(*it);
     }
+    LOGSTREAM("ccassets", CCLOG_DEBUG1, stream << "AssetOrders() bids=" << bids.size() - asks.size() << " asks=" << asks.size() << " returned=" << result.size() << std::endl);
     return(result);
 }
 
@@ -331,12 +331,23 @@ bool GetCCParams(Eval* eval, const CTransaction &tx, uint32_t nIn,
                  CTransaction &txOut, std::vector<std::vector<unsigned char>> &preConditions, std::vector<std::vector<unsigned char>> &params);
 
 /// \cond INTERNAL
-int64_t OraclePrice(int32_t height,uint256 reforacletxid,char *markeraddr,char *format);
+int64_t OraclePrice(int32_t height,uint256 reforacletxid,const std::string &format);
 uint256 OracleMerkle(int32_t height,uint256 reforacletxid,char *format,std::vector<struct oracle_merklepair>publishers);
 uint256 OraclesBatontxid(uint256 oracletxid,CPubKey pk);
 uint8_t DecodeOraclesCreateOpRet(const CScript &scriptPubKey,std::string &name,std::string &description,std::string &format);
 uint8_t DecodeOraclesOpRet(const CScript &scriptPubKey,uint256 &oracletxid,CPubKey &pk,int64_t &num);
+CScript EncodeOraclesData(uint8_t funcid,uint256 oracletxid,uint256 batontxid,CPubKey pk,std::vector <uint8_t>data);
 uint8_t DecodeOraclesData(const CScript &scriptPubKey,uint256 &oracletxid,uint256 &batontxid,CPubKey &pk,std::vector <uint8_t>&data);
+
+/// DecodeGatewaysStateOpRet decodes the step a gateways transaction makes in the lifecycle of a deposit or a withdraw,
+/// the transaction moves it from fromstage to tostage if it spends vout 0 of the last transaction of the lifecycle
+/// @param tx the transaction
+/// @param[out] bindtxid the bind, null for partialsign, completesigning and markdone whose opreturn only has the withdraw
+/// @param[out] origintxid the deposit or the withdraw
+/// @param[out] fromstage 0 if the transaction is the deposit or the withdraw
+/// @param[out] tostage the stage: 'D' deposited, 'C' claimed, 'W' withdrawn or partially signed, 'S' signing complete, 'M' marked done
+/// @returns funcid of the transaction, 0 if it is not a step of a lifecycle
+uint8_t DecodeGatewaysStateOpRet(const CTransaction &tx,uint256 &bindtxid,uint256 &origintxid,uint8_t &fromstage,uint8_t &tostage);
 int32_t oracle_format(uint256 *hashp,int64_t *valp,char *str,uint8_t fmt,uint8_t *data,int32_t offset,int32_t datalen);
 /// \endcond
 
@@ -366,6 +377,17 @@ int64_t AddTokenCCInputs(struct CCcontract_info *cp, CMutableTransaction &mtx, C
 /// @returns true if vout is true token with the reftokenid id
 int64_t IsTokensvout(bool goDeeper, bool checkPubkeys, struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, int32_t v, uint256 reftokenid);
 
+/// IsTokensvoutConfirmed is IsTokensvout with goDeeper for a vout of a transaction loaded with its block hash.
+/// The result for a transaction in a block of the active chain is cached, so the previous token transactions are checked once
+/// @param cp CCcontract_info structure initialized for EVAL_TOKENS eval code
+/// @param eval could be NULL, if not NULL then the eval parameter is used to report validation error
+/// @param tx transaction object to check
+/// @param hashBlock block of the transaction as returned by myGetTransaction, null if it is in the mempool
+/// @param v vout number (starting from 0)
+/// @param reftokenid id of the token
+/// @returns the token amount of the vout, 0 if it is not a true token vout with the reftokenid id
+int64_t IsTokensvoutConfirmed(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, const uint256 &hashBlock, int32_t v, uint256 reftokenid);
+
 /// Decodes transaction object into hex encoding
 /// @param tx transaction object
 /// @param[out] strHexTx transaction in hex encoding
@@ -715,6 +737,35 @@ int64_t CCtoken_balance(char *destaddr,uint256 tokenid);
 /// @private
 int64_t CCtoken_balance2(char *destaddr,uint256 tokenid);
 
+/// CCtoken_indexbalance returns the token balance of an address from the token index
+/// @param destaddr cc address to read the balance of
+/// @param tokenid id of the token
+/// @param[out] balance the balance of the confirmed outputs
+/// @returns false if the token index is not enabled, then the caller should add up the address unspents
+bool CCtoken_indexbalance(char *destaddr,uint256 tokenid,int64_t &balance);
+
+/// CCoracle_indexsamples reads the last data samples of an oracle publisher from the oracle index
+/// @param batonaddr baton cc address of the publisher
+/// @param oracletxid id of the oracle
+/// @param maxheight the samples above this height are skipped
+/// @param num number of samples to read, 0 for all
+/// @param[out] samples the confirmed samples, newest first
+/// @returns false if the oracle index is not enabled, then the caller should walk the baton transactions
+bool CCoracle_indexsamples(char *batonaddr,uint256 oracletxid,int32_t maxheight,int32_t num,std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples);
+
+/// CCoracle_indexlatest reads the last data sample of each publisher of an oracle from the oracle index, for the RPCs only
+/// @param oracletxid id of the oracle
+/// @param[out] samples the confirmed samples, one per publisher
+/// @returns false if the oracle index is not enabled
+bool CCoracle_indexlatest(uint256 oracletxid,std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples);
+
+/// CCgateways_indexstates reads the confirmed deposits or withdraws of a gateways bind at a stage of their lifecycle from the gateways index
+/// @param bindtxid id of the bind
+/// @param stage the stage, as for DecodeGatewaysStateOpRet
+/// @param[out] states the deposits or withdraws with the transactions of their lifecycle
+/// @returns false if the gateways index is not enabled, then the caller should scan the gateways address unspents
+bool CCgateways_indexstates(uint256 bindtxid,uint8_t stage,std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &states);
+
 /// _GetCCaddress retrieves the address for the scriptPubKey for the cryptocondition that is made for eval code and public key
 /// @param[out] destaddr the address for the cc scriptPubKey. Should have at least 64 char buffer space
 /// @param evalcode eval code for which cryptocondition will be made
@@ -847,6 +898,13 @@ void SetCCtxids(std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex
 /// @param func funcid for which outputs will be filtered
 void SetCCtxids(std::vector<uint256> &txids,char *coinaddr,bool ccflag, uint8_t evalcode, uint256 filtertxid, uint8_t func);
 
+/// SetCCtxidsByFuncid returns the txids of the transactions with an opreturn of this evalcode and funcid, from the cc index
+/// @param[out] txids returned vector of txids, in height order
+/// @param evalcode evalcode of the cc module in the opreturn (or in the module data of a tokens opreturn)
+/// @param func funcid in the opreturn
+/// @returns false if the cc index is not enabled, then the caller should look for the txids on the module addresses
+bool SetCCtxidsByFuncid(std::vector<uint256> &txids, uint8_t evalcode, uint8_t func);
+
 /// In NSPV mode adds normal (not cc) inputs to the transaction object vin array for the specified total amount using available utxos on mypk's TX_PUBKEY address
 /// @param mtx mutable transaction object
 /// @param mypk pubkey to make TX_PUBKEY address from
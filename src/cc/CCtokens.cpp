@@ -16,6 +16,10 @@
 #include "CCtokens.h"
 #include "importcoin.h"
 #include "komodo_bitcoind.h"
+#include "tokencache.h"
+
+static const size_t TOKEN_VOUT_CACHE_ENTRIES = 100000;
+static CTokenVoutCache tokenVoutCache(TOKEN_VOUT_CACHE_ENTRIES);
 
 /* TODO: correct this:
 -----------------------------
@@ -498,6 +502,27 @@ int64_t IsTokensvout(bool goDeeper, bool checkPubkeys /*<--not used, always true
 	return(0);
 }
 
+int64_t IsTokensvoutConfirmed(struct CCcontract_info *cp, Eval* eval, const CTransaction& tx, const uint256 &hashBlock, int32_t v, uint256 reftokenid)
+{
+    // only the vouts of the transactions in the active chain are cached, their ancestors cannot change under them
+    bool fConfirmed = false;
+    if (!hashBlock.IsNull()) {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hashBlock);
+        fConfirmed = (mi != mapBlockIndex.end() && mi->second != NULL && chainActive.Contains(mi->second));
+    }
+
+    int64_t amount;
+    const COutPoint outpoint(tx.GetHash(), v);
+    if (fConfirmed && tokenVoutCache.Get(outpoint, reftokenid, hashBlock, amount))
+        return amount;
+    amount = IsTokensvout(true, true, cp, eval, tx, v, reftokenid);
+    // a validation error reported from the previous transactions is not cached, it must be reported again
+    if (fConfirmed && (eval == NULL || eval->state.IsValid()))
+        tokenVoutCache.Put(outpoint, reftokenid, hashBlock, amount);
+    return amount;
+}
+
 bool IsTokenMarkerVout(CTxOut vout) {
     struct CCcontract_info *cpTokens, CCtokens_info;
     cpTokens = CCinit(&CCtokens_info, EVAL_TOKENS);
@@ -539,7 +564,10 @@ bool TokensExactAmounts(bool goDeeper, struct CCcontract_info *cp, int64_t &inpu
 
                 // validate vouts of vintx  
                 tokenValIndentSize++;
-				tokenoshis = IsTokensvout(goDeeper, true, cpTokens, eval, vinTx, tx.vin[i].prevout.n, reftokenid);
+				if (goDeeper)
+					tokenoshis = IsTokensvoutConfirmed(cpTokens, eval, vinTx, hashBlock, tx.vin[i].prevout.n, reftokenid);
+				else
+					tokenoshis = IsTokensvout(false, true, cpTokens, eval, vinTx, tx.vin[i].prevout.n, reftokenid);
 				tokenValIndentSize--;
 				if (tokenoshis != 0)
 				{
@@ -661,7 +689,7 @@ int64_t AddTokenCCInputs(struct CCcontract_info *cp, CMutableTransaction &mtx, C
 			
             LOGSTREAM((char *)"cctokens", CCLOG_DEBUG1, stream << "AddTokenCCInputs() check vintx vout destaddress=" << destaddr << " amount=" << vintx.vout[vout].nValue << std::endl);
 
-			if ((nValue = IsTokensvout(true, true/*<--add only valid token uxtos */, cp, NULL, vintx, vout, tokenid)) > 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,vintxid, vout) == 0)
+			if ((nValue = IsTokensvoutConfirmed(cp, NULL, vintx, hashBlock, vout, tokenid)) > 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,vintxid, vout) == 0)
 			{
 				//for non-fungible tokens check payload:
                 if (!vopretNonfungible.empty()) {
@@ -930,6 +958,18 @@ int64_t GetTokenBalance(CPubKey pk, uint256 tokenid)
 
 	struct CCcontract_info *cp, C;
 	cp = CCinit(&C, EVAL_TOKENS);
+
+    // the token index has the balance of the token address (for non-fungible tokens the address with their evalcode)
+    vscript_t vopretNonfungible;
+    char tokenaddr[64];
+    int64_t balance;
+    GetNonfungibleData(tokenid, vopretNonfungible);
+    if (vopretNonfungible.size() > 0)
+        cp->additionalTokensEvalcode2 = vopretNonfungible.begin()[0];
+    GetTokensCCaddress(cp, tokenaddr, pk);
+    if (CCtoken_indexbalance(tokenaddr, tokenid, balance))
+        return balance;
+
 	return(AddTokenCCInputs(cp, mtx, pk, tokenid, 0, 0));
 }
 
@@ -972,9 +1012,16 @@ UniValue TokenInfo(uint256 tokenid)
 	result.push_back(Pair("name", name));
 
     int64_t supply = 0, output;
-    for (int v = 0; v < tokenbaseTx.vout.size() - 1; v++)
-        if ((output = IsTokensvout(false, true, cpTokens, NULL, tokenbaseTx, v, tokenid)) > 0)
-            supply += output;
+    CTokenSupplyValue indexSupply;
+    if (!KOMODO_NSPV_SUPERLITE && !hashBlock.IsNull() && GetTokenIndexSupply(tokenid, indexSupply)) {
+        supply = indexSupply.supply;
+        result.push_back(Pair("holders", indexSupply.holders));
+    }
+    else {
+        for (int v = 0; v < tokenbaseTx.vout.size() - 1; v++)
+            if ((output = IsTokensvout(false, true, cpTokens, NULL, tokenbaseTx, v, tokenid)) > 0)
+                supply += output;
+    }
 	result.push_back(Pair("supply", supply));
 	result.push_back(Pair("description", description));
 
@@ -1039,6 +1086,12 @@ UniValue TokenList()
         }
     };
 
+    if (SetCCtxidsByFuncid(txids, cp->evalcode, 'c')) {                                  // find by the cc index
+        for (std::vector<uint256>::const_iterator it = txids.begin(); it != txids.end(); it++)
+            addTokenId(*it);
+        return(result);
+    }
+
 	SetCCtxids(txids, cp->normaladdr,false,cp->evalcode,zeroid,'c');                      // find by old normal addr marker
    	for (std::vector<uint256>::const_iterator it = txids.begin(); it != txids.end(); it++) 	{
         addTokenId(*it);
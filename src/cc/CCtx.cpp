@@ -471,6 +471,16 @@ void SetCCtxids(std::vector<uint256> &txids,char *coinaddr,bool ccflag, uint8_t
     } 
 }
 
+bool SetCCtxidsByFuncid(std::vector<uint256> &txids, uint8_t evalcode, uint8_t func)
+{
+    std::vector<std::pair<CContractIndexKey, int32_t> > contractIndex;
+    if ( KOMODO_NSPV_SUPERLITE || GetContractIndex(evalcode, func, contractIndex) == 0 )
+        return false;
+    for (std::vector<std::pair<CContractIndexKey, int32_t> >::const_iterator it=contractIndex.begin(); it!=contractIndex.end(); it++)
+        txids.push_back(it->first.txhash);
+    return true;
+}
+
 int64_t CCutxovalue(char *coinaddr,uint256 utxotxid,int32_t utxovout,int32_t CCflag)
 {
     uint256 txid; std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
@@ -554,6 +564,43 @@ int64_t CCfullsupply(uint256 tokenid)
     return(0);
 }
 
+bool CCtoken_indexbalance(char *coinaddr,uint256 tokenid,int64_t &balance)
+{
+    uint160 hashBytes; int type; CAmount amount;
+    if ( KOMODO_NSPV_SUPERLITE )
+        return false;
+    CBitcoinAddress address(coinaddr);
+    if ( address.GetIndexKey(hashBytes, type, true) == 0 || GetTokenIndexBalance(tokenid, hashBytes, amount) == 0 )
+        return false;
+    balance = amount;
+    return true;
+}
+
+bool CCoracle_indexsamples(char *batonaddr,uint256 oracletxid,int32_t maxheight,int32_t num,std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples)
+{
+    uint160 hashBytes; int type;
+    if ( KOMODO_NSPV_SUPERLITE )
+        return false;
+    CBitcoinAddress address(batonaddr);
+    if ( address.GetIndexKey(hashBytes, type, true) == 0 )
+        return false;
+    return GetOracleSamples(oracletxid, hashBytes, maxheight, num, samples);
+}
+
+bool CCoracle_indexlatest(uint256 oracletxid,std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples)
+{
+    if ( KOMODO_NSPV_SUPERLITE )
+        return false;
+    return GetOracleLatestSamples(oracletxid, samples);
+}
+
+bool CCgateways_indexstates(uint256 bindtxid,uint8_t stage,std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &states)
+{
+    if ( KOMODO_NSPV_SUPERLITE )
+        return false;
+    return GetGatewaysStates(bindtxid, stage, states);
+}
+
 int64_t CCtoken_balance(char *coinaddr,uint256 reftokenid)
 {
     int64_t price,sum = 0; int32_t numvouts; CTransaction tx; uint256 tokenid,txid,hashBlock; 
@@ -561,6 +608,8 @@ int64_t CCtoken_balance(char *coinaddr,uint256 reftokenid)
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 	uint8_t evalCode;
 
+    if ( CCtoken_indexbalance(coinaddr,reftokenid,sum) != 0 )
+        return(sum);
     SetCCunspents(unspentOutputs,coinaddr,true);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
     {
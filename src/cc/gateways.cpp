@@ -362,6 +362,55 @@ uint8_t DecodeGatewaysOpRet(const CScript &scriptPubKey)
     return(0);
 }
 
+uint8_t DecodeGatewaysStateOpRet(const CTransaction &tx,uint256 &bindtxid,uint256 &origintxid,uint8_t &fromstage,uint8_t &tostage)
+{
+    std::string coin,hex; std::vector<CPubKey> publishers; std::vector<uint256> txids; std::vector<uint8_t> proof;
+    uint256 tokenid,cointxid,completetxid; CPubKey pub; int32_t numvouts,height,claimvout; int64_t amount; uint8_t funcid,K;
+
+    bindtxid = origintxid = zeroid;
+    fromstage = tostage = 0;
+    if ( (numvouts= tx.vout.size()) < 2 || (funcid= DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey)) == 0 )
+        return(0);
+    const CScript &opret = tx.vout[numvouts-1].scriptPubKey;
+    // vout 0 of the transactions that can be followed is the marker the next one spends
+    switch ( funcid )
+    {
+        case 'D':
+            if ( DecodeGatewaysDepositOpRet(opret,bindtxid,coin,publishers,txids,height,cointxid,claimvout,hex,proof,pub,amount) != 'D' || tx.vout[0].nValue != CC_MARKER_VALUE )
+                return(0);
+            origintxid = tx.GetHash(), tostage = 'D';
+            break;
+        case 'C':
+            if ( DecodeGatewaysClaimOpRet(opret,tokenid,bindtxid,coin,origintxid,pub,amount) != 'C' )
+                return(0);
+            fromstage = 'D', tostage = 'C';
+            break;
+        case 'W':
+            if ( DecodeGatewaysWithdrawOpRet(opret,tokenid,bindtxid,coin,pub,amount) != 'W' || tx.vout[0].nValue != CC_MARKER_VALUE )
+                return(0);
+            origintxid = tx.GetHash(), tostage = 'W';
+            break;
+        case 'P':
+            if ( DecodeGatewaysPartialOpRet(opret,origintxid,coin,K,pub,hex) != 'P' || tx.vout[0].nValue != CC_MARKER_VALUE )
+                return(0);
+            fromstage = tostage = 'W';
+            break;
+        case 'S':
+            if ( DecodeGatewaysCompleteSigningOpRet(opret,origintxid,coin,K,hex) != 'S' || tx.vout[0].nValue != CC_MARKER_VALUE )
+                return(0);
+            fromstage = 'W', tostage = 'S';
+            break;
+        case 'M':
+            if ( DecodeGatewaysMarkDoneOpRet(opret,origintxid,coin,completetxid) != 'M' )
+                return(0);
+            fromstage = 'S', tostage = 'M';
+            break;
+        default:
+            return(0);
+    }
+    return(funcid);
+}
+
 int64_t IsGatewaysvout(struct CCcontract_info *cp,const CTransaction& tx,int32_t v)
 {
     char destaddr[64];
@@ -1218,6 +1267,54 @@ UniValue GatewaysMarkDone(const CPubKey& pk, uint64_t txfee,uint256 completetxid
     CCERR_RESULT("gatewayscc",CCLOG_INFO, stream << "error adding funds for markdone");
 }
 
+/// the deposits or withdraws of a bind at a stage of their lifecycle, from the gateways index with the mempool transactions applied
+/// queue gets the transactions of each lifecycle, the deposit or withdraw first, returns false if there is no gateways index
+static bool GatewaysIndexQueue(uint256 bindtxid,uint8_t stage,std::vector<std::vector<uint256> > &queue)
+{
+    std::map<uint256,std::pair<uint8_t,std::vector<uint256> > > states; std::map<uint256,std::pair<uint8_t,std::vector<uint256> > >::iterator it;
+    std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > confirmed; std::vector<CTransaction> txs;
+    uint256 tmpbindtxid,origintxid; uint8_t fromstage,tostage; int32_t i,changed;
+
+    if ( CCgateways_indexstates(bindtxid,stage,confirmed) == 0 )
+        return false;
+    // a withdraw can get its completesigning in the mempool
+    if ( stage == 'S' && CCgateways_indexstates(bindtxid,'W',confirmed) == 0 )
+        return false;
+    for (std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> >::const_iterator itc=confirmed.begin(); itc!=confirmed.end(); itc++)
+        states[itc->first.origintxid] = std::make_pair(itc->first.stage,itc->second.vtxid);
+    myGet_mempool_txs(txs,EVAL_GATEWAYS,0);
+    // the mempool is not in spending order, apply until nothing moves
+    do
+    {
+        changed = 0;
+        for (std::vector<CTransaction>::const_iterator itx=txs.begin(); itx!=txs.end(); itx++)
+        {
+            if ( DecodeGatewaysStateOpRet(*itx,tmpbindtxid,origintxid,fromstage,tostage) == 0 || (tmpbindtxid != zeroid && tmpbindtxid != bindtxid) )
+                continue;
+            if ( fromstage == 0 )
+            {
+                if ( states.count(origintxid) == 0 )
+                    states[origintxid] = std::make_pair(tostage,std::vector<uint256>(1,origintxid)), changed = 1;
+                continue;
+            }
+            if ( (it= states.find(origintxid)) == states.end() || it->second.first != fromstage )
+                continue;
+            for (i=0; i<itx->vin.size(); i++)
+                if ( itx->vin[i].prevout.hash == it->second.second.back() && itx->vin[i].prevout.n == 0 )
+                {
+                    it->second.first = tostage;
+                    it->second.second.push_back(itx->GetHash());
+                    changed = 1;
+                    break;
+                }
+        }
+    } while ( changed != 0 );
+    for (it=states.begin(); it!=states.end(); it++)
+        if ( it->second.first == stage )
+            queue.push_back(it->second.second);
+    return true;
+}
+
 UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string refcoin)
 {
     UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin,hex,pub; 
@@ -1225,7 +1322,7 @@ UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string
     uint256 tmpbindtxid,hashBlock,txid,tokenid,oracletxid,cointxid; uint8_t M,N,taddr,prefix,prefix2,wiftype;
     char depositaddr[65],coinaddr[65],str[65],destaddr[65],txidaddr[65]; std::vector<uint8_t> proof;
     int32_t numvouts,vout,claimvout,height; int64_t totalsupply,nValue,amount; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::vector<std::vector<uint256> > queue; std::vector<uint256> lasttxids;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1243,15 +1340,30 @@ UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string
         result.push_back(Pair("error",strprintf("invalid bindtxid %s coin.%s",uint256_str(str,bindtxid),coin.c_str())));     
         return(result);
     }  
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    // the index holds the deposits of every claimant, like the scan of mypk's address only the caller's are listed below
+    if ( GatewaysIndexQueue(bindtxid,'D',queue) != 0 )
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
+        for (std::vector<std::vector<uint256> >::const_iterator it=queue.begin(); it!=queue.end(); it++)
+            lasttxids.push_back(it->back());
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            if ( vout == 0 && nValue == CC_MARKER_VALUE && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
+                lasttxids.push_back(txid);
+        }
+    }
+    for (std::vector<uint256>::const_iterator it=lasttxids.begin(); it!=lasttxids.end(); it++)
+    {
+        txid = *it;
+        if ( myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
             DecodeGatewaysDepositOpRet(tx.vout[numvouts-1].scriptPubKey,tmpbindtxid,coin,publishers,txids,height,cointxid,claimvout,hex,proof,destpub,amount) == 'D'
-            && tmpbindtxid==bindtxid && refcoin == coin && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
+            && tmpbindtxid==bindtxid && refcoin == coin && destpub == mypk )
         {   
             UniValue obj(UniValue::VOBJ);
             obj.push_back(Pair("cointxid",uint256_str(str,cointxid)));
@@ -1279,7 +1391,7 @@ UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::strin
     std::vector<CPubKey> msigpubkeys; uint256 hashBlock,tokenid,txid,tmpbindtxid,tmptokenid,oracletxid,withdrawtxid; uint8_t K,M,N,taddr,prefix,prefix2,wiftype;
     char funcid,depositaddr[65],coinaddr[65],tokensaddr[65],destaddr[65],str[65],withaddr[65],numstr[32],signeraddr[65],txidaddr[65];
     int32_t i,n,numvouts,vout,queueflag; int64_t totalsupply,amount,nValue; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::vector<std::vector<uint256> > queue; std::vector<uint256> lasttxids;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1306,15 +1418,30 @@ UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::strin
             queueflag = 1;
             break;
         }    
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    // the last transaction of each pending withdraw, the withdraw or its last partialsign
+    if ( GatewaysIndexQueue(bindtxid,'W',queue) != 0 )
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
+        for (std::vector<std::vector<uint256> >::const_iterator it=queue.begin(); it!=queue.end(); it++)
+            lasttxids.push_back(it->back());
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            if ( vout == 0 && nValue == CC_MARKER_VALUE && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
+                lasttxids.push_back(txid);
+        }
+    }
+    for (std::vector<uint256>::const_iterator it=lasttxids.begin(); it!=lasttxids.end(); it++)
+    {
+        txid = *it;
         K=0;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
-            (funcid=DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey))!=0 && (funcid=='W' || funcid=='P') && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
+        if ( myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
+            (funcid=DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey))!=0 && (funcid=='W' || funcid=='P') )
         {
             if (funcid=='W')
             {
@@ -1365,10 +1492,10 @@ UniValue GatewaysProcessedWithdraws(const CPubKey& pk, uint256 bindtxid,std::str
 {
     UniValue result(UniValue::VOBJ),processed(UniValue::VARR); CTransaction tx; std::string coin,hex; 
     CPubKey mypk,gatewayspk,withdrawpub; std::vector<CPubKey> msigpubkeys;
-    uint256 withdrawtxid,hashBlock,txid,tokenid,tmptokenid,oracletxid; uint8_t K,M,N,taddr,prefix,prefix2,wiftype;
+    uint256 withdrawtxid,hashBlock,txid,tokenid,tmptokenid,tmpbindtxid,oracletxid; uint8_t K,M,N,taddr,prefix,prefix2,wiftype;
     char depositaddr[65],coinaddr[65],str[65],numstr[32],withaddr[65],txidaddr[65];
     int32_t i,n,numvouts,vout,queueflag; int64_t totalsupply,nValue,amount; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::vector<std::vector<uint256> > queue; std::vector<uint256> lasttxids;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1394,17 +1521,32 @@ UniValue GatewaysProcessedWithdraws(const CPubKey& pk, uint256 bindtxid,std::str
             queueflag = 1;
             break;
         }    
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    // the completesigning of each withdraw not marked done
+    if ( GatewaysIndexQueue(bindtxid,'S',queue) != 0 )
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
-            DecodeGatewaysCompleteSigningOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,coin,K,hex) == 'S' && refcoin == coin && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
+        for (std::vector<std::vector<uint256> >::const_iterator it=queue.begin(); it!=queue.end(); it++)
+            lasttxids.push_back(it->back());
+    }
+    else
+    {
+        SetCCunspents(unspentOutputs,coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            txid = it->first.txhash;
+            vout = (int32_t)it->first.index;
+            nValue = (int64_t)it->second.satoshis;
+            if ( vout == 0 && nValue == CC_MARKER_VALUE && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
+                lasttxids.push_back(txid);
+        }
+    }
+    for (std::vector<uint256>::const_iterator it=lasttxids.begin(); it!=lasttxids.end(); it++)
+    {
+        txid = *it;
+        if ( myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
+            DecodeGatewaysCompleteSigningOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,coin,K,hex) == 'S' && refcoin == coin )
         {   
             if (myGetTransaction(withdrawtxid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0
-                && DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,bindtxid,coin,withdrawpub,amount) == 'W' || refcoin!=coin || tmptokenid!=tokenid)          
+                && DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,coin,withdrawpub,amount) == 'W' && refcoin==coin && tmptokenid==tokenid && tmpbindtxid==bindtxid)
             {
                 UniValue obj(UniValue::VOBJ);
                 obj.push_back(Pair("completesigningtxid",uint256_str(str,txid)));
@@ -1431,7 +1573,8 @@ UniValue GatewaysList()
 {
     UniValue result(UniValue::VARR); std::vector<uint256> txids; struct CCcontract_info *cp,C; uint256 txid,hashBlock,oracletxid,tokenid; CTransaction vintx; std::string coin; int64_t totalsupply; char str[65],depositaddr[64]; uint8_t M,N,taddr,prefix,prefix2,wiftype; std::vector<CPubKey> pubkeys;
     cp = CCinit(&C,EVAL_GATEWAYS);
-    SetCCtxids(txids,cp->unspendableCCaddr,true,EVAL_GATEWAYS,zeroid,'B');
+    if ( SetCCtxidsByFuncid(txids,EVAL_GATEWAYS,'B') == 0 )
+        SetCCtxids(txids,cp->unspendableCCaddr,true,EVAL_GATEWAYS,zeroid,'B');
     for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
     {
         txid = *it;
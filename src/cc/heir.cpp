@@ -544,7 +544,7 @@ template <class Helper> int64_t Add1of2AddressInputs(struct CCcontract_info* cp,
             if ((txid == fundingtxid || fundingTxidInOpret == fundingtxid) &&
                 funcId != 0 &&
                 isMyFuncId(funcId) &&
-                (typeid(Helper) != typeid(TokenHelper) || IsTokensvout(true, true, cp, nullptr, heirtx, voutIndex, tokenid) > 0) && // token validation logic
+                (typeid(Helper) != typeid(TokenHelper) || IsTokensvoutConfirmed(cp, nullptr, heirtx, hashBlock, voutIndex, tokenid) > 0) && // token validation logic
                 //(voutValue = IsHeirFundingVout<Helper>(cp, heirtx, voutIndex, ownerPubkey, heirPubkey)) > 0 &&		// heir contract vout validation logic - not used since we moved to 2-eval vouts
                 !myIsutxo_spentinmempool(ignoretxid,ignorevin,txid, voutIndex))
             {
@@ -595,7 +595,7 @@ template <class Helper> int64_t LifetimeHeirContractFunds(struct CCcontract_info
             if (funcId != 0 &&
                 (txid == fundingtxid || fundingTxidInOpret == fundingtxid) &&
                 isMyFuncId(funcId) && !isSpendingTx(funcId) &&
-                (typeid(Helper) != typeid(TokenHelper) || IsTokensvout(true, true, cp, nullptr, heirtx, ivout, tokenid) > 0) &&
+                (typeid(Helper) != typeid(TokenHelper) || IsTokensvoutConfirmed(cp, nullptr, heirtx, hashBlock, ivout, tokenid) > 0) &&
                 !myIsutxo_spentinmempool(ignoretxid,ignorevin,txid, ivout)) // exclude tx in mempool
             {
                 total += it->second; // dont do this: tx.vout[ivout].nValue; // in vin[0] always is the pay to 1of2 addr (funding or change)
@@ -1234,21 +1234,27 @@ UniValue HeirInfo(uint256 fundingtxid)
 void _HeirList(struct CCcontract_info *cp, UniValue &result)
 {
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspentOutputs;
+    std::vector<uint256> txids;
     char markeraddr[64];
 
-	GetCCaddress(cp, markeraddr, GetUnspendable(cp, NULL));
-    SetCCunspents(unspentOutputs, markeraddr,true);
-    
-    //std::cerr << "HeirList() finding heir marker from unspendable addr=" << markeraddr << " unspentOutputs.size()=" << unspentOutputs.size() << '\n';
-    
-    // TODO: move marker to special cc addr to prevent checking all tokens
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>::const_iterator it = unspentOutputs.begin(); it != unspentOutputs.end(); it++) {
+    // the funding transactions from the cc index, else from their markers
+    if (!SetCCtxidsByFuncid(txids, cp->evalcode, 'F')) {
+        GetCCaddress(cp, markeraddr, GetUnspendable(cp, NULL));
+        SetCCunspents(unspentOutputs, markeraddr,true);
+
+        //std::cerr << "HeirList() finding heir marker from unspendable addr=" << markeraddr << " unspentOutputs.size()=" << unspentOutputs.size() << '\n';
+
+        // TODO: move marker to special cc addr to prevent checking all tokens
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>::const_iterator it = unspentOutputs.begin(); it != unspentOutputs.end(); it++)
+            txids.push_back(it->first.txhash);
+    }
+
+    for (std::vector<uint256>::const_iterator it = txids.begin(); it != txids.end(); it++) {
         uint256 hashBlock;
-        uint256 txid = it->first.txhash;
+        uint256 txid = *it;
         uint256 tokenid;
-        int32_t vout = (int32_t)it->first.index;
-        
-        //std::cerr << "HeirList() checking txid=" << txid.GetHex() << " vout=" << vout << '\n';
+
+        //std::cerr << "HeirList() checking txid=" << txid.GetHex() << '\n';
         
         CTransaction fundingtx;
         if (myGetTransaction(txid, fundingtx, hashBlock)) {
@@ -495,13 +495,15 @@ int64_t correlate_price(int32_t height,int64_t *prices,int32_t n)
 
 int64_t OracleCorrelatedPrice(int32_t height,std::vector <int64_t> origprices)
 {
-    std::vector <int64_t> sorted; int32_t i,n; int64_t *prices,price;
-    if ( (n= origprices.size()) == 1 )
+    int32_t i,n; int64_t *prices,price;
+    if ( (n= origprices.size()) == 0 )
+        return(0);
+    else if ( n == 1 )
         return(origprices[0]);
     std::sort(origprices.begin(), origprices.end());
     prices = (int64_t *)calloc(n,sizeof(*prices));
     i = 0;
-    for (std::vector<int64_t>::const_iterator it=sorted.begin(); it!=sorted.end(); it++)
+    for (std::vector<int64_t>::const_iterator it=origprices.begin(); it!=origprices.end(); it++)
         prices[i++] = *it;
     price = correlate_price(height,prices,i);
     free(prices);
@@ -534,36 +536,23 @@ int32_t oracleprice_add(std::vector<struct oracleprice_info> &publishers,CPubKey
     } else return(0);
 }
 
-/*int64_t OraclePrice(int32_t height,uint256 reforacletxid,char *markeraddr,char *format)
+// the price of an 'L' format oracle, correlated over the last sample of each publisher, read from the oracle index (RPC only, 0 without the index)
+int64_t OraclePrice(int32_t height,uint256 reforacletxid,const std::string &format)
 {
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    CTransaction regtx; uint256 hash,txid,oracletxid,batontxid; CPubKey pk; int32_t i,ht,maxheight=0; int64_t datafee,price; char batonaddr[64]; std::vector <uint8_t> data; struct CCcontract_info *cp,C; std::vector <struct oracleprice_info> publishers; std::vector <int64_t> prices;
-    if ( format[0] != 'L' )
+    std::vector<std::pair<COracleSampleKey, COracleSampleValue> > samples; uint256 hash; int32_t maxheight=0; int64_t price; std::vector <int64_t> prices;
+    if ( format.empty() || format[0] != 'L' || CCoracle_indexlatest(reforacletxid,samples) == 0 )
         return(0);
-    cp = CCinit(&C,EVAL_ORACLES);
-    SetCCunspents(unspentOutputs,markeraddr,false);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
-    {
-        txid = it->first.txhash;
-        ht = (int32_t)it->second.blockHeight;
-        if ( myGetTransaction(txid,regtx,hash) != 0 )
-        {
-            if ( regtx.vout.size() > 0 && DecodeOraclesOpRet(regtx.vout[regtx.vout.size()-1].scriptPubKey,oracletxid,pk,datafee) == 'R' && oracletxid == reforacletxid )
-            {
-                Getscriptaddress(batonaddr,regtx.vout[1].scriptPubKey);
-                batontxid = OracleBatonUtxo(10000,cp,oracletxid,batonaddr,pk,data);
-                if ( batontxid != zeroid && (ht= oracleprice_add(publishers,pk,ht,data,maxheight)) > maxheight )
-                    maxheight = ht;
-            }
-        }
-    }
+    for (std::vector<std::pair<COracleSampleKey, COracleSampleValue> >::const_iterator it=samples.begin(); it!=samples.end(); it++)
+        if ( it->first.blockHeight > maxheight )
+            maxheight = it->first.blockHeight;
     if ( maxheight > 10 )
     {
-        for (std::vector<struct oracleprice_info>::const_iterator it=publishers.begin(); it!=publishers.end(); it++)
+        for (std::vector<std::pair<COracleSampleKey, COracleSampleValue> >::const_iterator it=samples.begin(); it!=samples.end(); it++)
         {
-            if ( it->height >= maxheight-10 )
+            if ( it->first.blockHeight >= maxheight-10 )
             {
-                oracle_format(&hash,&price,0,'L',(uint8_t *)it->data.data(),0,(int32_t)it->data.size());
+                price = 0;
+                oracle_format(&hash,&price,0,'L',(uint8_t *)it->second.data.data(),0,(int32_t)it->second.data.size());
                 if ( price != 0 )
                     prices.push_back(price);
             }
@@ -571,7 +560,7 @@ int32_t oracleprice_add(std::vector<struct oracleprice_info> &publishers,CPubKey
         return(OracleCorrelatedPrice(height,prices));
     }
     return(0);
-}*/
+}
 
 int64_t IsOraclesvout(struct CCcontract_info *cp,const CTransaction& tx,int32_t v)
 {
@@ -1068,7 +1057,7 @@ UniValue OracleDataSamples(uint256 reforacletxid,char* batonaddr,int32_t num)
 {
     UniValue result(UniValue::VOBJ),b(UniValue::VARR); CTransaction tx,oracletx; uint256 txid,hashBlock,btxid,oracletxid; 
     CPubKey pk; std::string name,description,format; int32_t numvouts,n=0,vout; std::vector<uint8_t> data; char *formatstr = 0, addr[64];
-    std::vector<uint256> txids; int64_t nValue;
+    std::vector<uint256> txids; int64_t nValue; std::vector<std::pair<COracleSampleKey, COracleSampleValue> > samples;
     
     result.push_back(Pair("result","success"));
     if ( myGetTransaction(reforacletxid,oracletx,hashBlock) != 0 && (numvouts=oracletx.vout.size()) > 0 )
@@ -1098,6 +1087,20 @@ UniValue OracleDataSamples(uint256 reforacletxid,char* batonaddr,int32_t num)
                     }
                 }
             }
+            if ( CCoracle_indexsamples(batonaddr,reforacletxid,std::numeric_limits<int32_t>::max(),num != 0 ? num-n : 0,samples) != 0 )
+            {
+                for (std::vector<std::pair<COracleSampleKey, COracleSampleValue> >::const_iterator it=samples.begin(); it!=samples.end(); it++)
+                {
+                    if ( (formatstr= (char *)format.c_str()) == 0 )
+                        formatstr = (char *)"";
+                    UniValue a(UniValue::VOBJ);
+                    a.push_back(Pair("txid",it->first.txhash.GetHex()));
+                    a.push_back(Pair("data",OracleFormat((uint8_t *)it->second.data.data(),(int32_t)it->second.data.size(),formatstr,(int32_t)format.size())));
+                    b.push_back(a);
+                }
+                result.push_back(Pair("samples",b));
+                return(result);
+            }
             SetCCtxids(txids,batonaddr,true,EVAL_ORACLES,reforacletxid,'D');
             if (txids.size()>0)
             {
@@ -1139,7 +1142,7 @@ UniValue OracleInfo(uint256 origtxid)
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; int32_t height;
     CMutableTransaction mtx = CreateNewContextualCMutableTransaction(Params().GetConsensus(), komodo_nextheight());
     CTransaction tx; std::string name,description,format; uint256 hashBlock,txid,oracletxid,batontxid; CPubKey pk;
-    struct CCcontract_info *cp,C; int64_t datafee,funding; char str[67],markeraddr[64],numstr[64],batonaddr[64]; std::vector <uint8_t> data;
+    struct CCcontract_info *cp,C; int64_t datafee,funding,price; char str[67],markeraddr[64],numstr[64],batonaddr[64]; std::vector <uint8_t> data;
     std::map<CPubKey,std::pair<uint256,int32_t>> publishers;
 
     cp = CCinit(&C,EVAL_ORACLES);
@@ -1198,6 +1201,8 @@ UniValue OracleInfo(uint256 origtxid)
                 }
             }
             result.push_back(Pair("registered",a));
+            if ( (price= OraclePrice(komodo_nextheight(),origtxid,format)) != 0 )
+                result.push_back(Pair("price",price));
         }
         else
             CCERR_RESULT("oraclescc",CCLOG_INFO, stream << "invalid oracletxid " << oracletxid.GetHex());
@@ -1211,7 +1216,8 @@ UniValue OraclesList()
 {
     UniValue result(UniValue::VARR); std::vector<uint256> txids; struct CCcontract_info *cp,C; uint256 txid,hashBlock; CTransaction createtx; std::string name,description,format; char str[65];
     cp = CCinit(&C,EVAL_ORACLES);
-    SetCCtxids(txids,cp->normaladdr,false,cp->evalcode,zeroid,'C');
+    if ( SetCCtxidsByFuncid(txids,cp->evalcode,'C') == 0 )
+        SetCCtxids(txids,cp->normaladdr,false,cp->evalcode,zeroid,'C');
     for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
     {
         txid = *it;
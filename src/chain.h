@@ -437,13 +437,17 @@ class CDiskBlockIndex : public CBlockIndex
 {
 public:
     uint256 hashPrev;
+    //! Hash of this block when already known (e.g. the database key), not serialized.
+    uint256 hashBlock;
 
     CDiskBlockIndex() : CBlockIndex() {
         hashPrev = uint256();
+        hashBlock = uint256();
     }
 
     explicit CDiskBlockIndex(const CBlockIndex* pindex, std::function<std::vector<unsigned char>()> getSolution) : CBlockIndex(*pindex) {
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
+        hashBlock = (phashBlock ? *phashBlock : uint256());
         if (!HasSolution()) {
             nSolution = getSolution();
         }
@@ -538,6 +542,8 @@ private:
 public:
     uint256 GetBlockHash() const
     {
+        if (!hashBlock.IsNull())
+            return hashBlock;
         return GetBlockHeader().GetHash();
     }
 
@@ -29,6 +29,7 @@
 #include "komodo_bitcoind.h"
 #include "komodo_interest.h"
 
+#include <algorithm>
 #include <assert.h>
 
 /**
@@ -67,6 +68,13 @@ bool CCoinsView::GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree)
 bool CCoinsView::GetNullifier(const uint256 &nullifier, ShieldedType type) const { return false; }
 bool CCoinsView::GetCoins(const uint256 &txid, CCoins &coins) const { return false; }
 bool CCoinsView::HaveCoins(const uint256 &txid) const { return false; }
+bool CCoinsView::GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const {
+    CCoins coins;
+    if (!GetCoins(outpoint.hash, coins) || !coins.IsAvailable(outpoint.n))
+        return false;
+    coin = CCoinsOutput(coins, outpoint.n);
+    return true;
+}
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 uint256 CCoinsView::GetBestAnchor(ShieldedType type) const { return uint256(); };
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins,
@@ -87,6 +95,7 @@ bool CCoinsViewBacked::GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &
 bool CCoinsViewBacked::GetNullifier(const uint256 &nullifier, ShieldedType type) const { return base->GetNullifier(nullifier, type); }
 bool CCoinsViewBacked::GetCoins(const uint256 &txid, CCoins &coins) const { return base->GetCoins(txid, coins); }
 bool CCoinsViewBacked::HaveCoins(const uint256 &txid) const { return base->HaveCoins(txid); }
+bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const { return base->GetCoin(outpoint, coin); }
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 uint256 CCoinsViewBacked::GetBestAnchor(ShieldedType type) const { return base->GetBestAnchor(type); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
@@ -111,6 +120,7 @@ CCoinsViewCache::~CCoinsViewCache()
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) +
+           memusage::DynamicUsage(cacheOutputs) +
            memusage::DynamicUsage(cacheSproutAnchors) +
            memusage::DynamicUsage(cacheSaplingAnchors) +
            memusage::DynamicUsage(cacheSproutNullifiers) +
@@ -125,6 +135,7 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const
     CCoins tmp;
     if (!base->GetCoins(txid, tmp))
         return cacheCoins.end();
+    UncacheOutputs(txid);
     CCoinsMap::iterator ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry())).first;
     tmp.swap(ret->second.coins);
     if (ret->second.coins.IsPruned()) {
@@ -136,6 +147,27 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const
     return ret;
 }
 
+CCoinsOutputMap::const_iterator CCoinsViewCache::FetchOutput(const COutPoint &outpoint) const {
+    CCoinsOutputMap::iterator it = cacheOutputs.find(outpoint);
+    if (it != cacheOutputs.end())
+        return it;
+    CCoinsOutput coin;
+    if (!base->GetCoin(outpoint, coin))
+        return cacheOutputs.end();
+    it = cacheOutputs.insert(std::make_pair(outpoint, CCoinsOutput())).first;
+    std::swap(it->second, coin);
+    cachedCoinsUsage += it->second.DynamicMemoryUsage();
+    return it;
+}
+
+void CCoinsViewCache::UncacheOutputs(const uint256 &txid) const {
+    CCoinsOutputMap::iterator it = cacheOutputs.lower_bound(COutPoint(txid, 0));
+    while (it != cacheOutputs.end() && it->first.hash == txid) {
+        cachedCoinsUsage -= it->second.DynamicMemoryUsage();
+        cacheOutputs.erase(it++);
+    }
+}
+
 
 bool CCoinsViewCache::GetSproutAnchorAt(const uint256 &rt, SproutMerkleTree &tree) const {
     CAnchorsSproutMap::const_iterator it = cacheSproutAnchors.find(rt);
@@ -364,6 +396,7 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
     std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
     size_t cachedCoinUsage = 0;
     if (ret.second) {
+        UncacheOutputs(txid);
         if (!base->GetCoins(txid, ret.first->second.coins)) {
             // The parent view does not have this entry; mark it as fresh.
             ret.first->second.coins.Clear();
@@ -373,13 +406,28 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
         }
     } else {
-        cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
+        cachedCoinUsage = ret.first->second.DynamicMemoryUsage();
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
     return CCoinsModifier(*this, ret.first, cachedCoinUsage);
 }
 
+bool CCoinsViewCache::HaveCoinsInCache(const uint256 &txid) const {
+    return cacheCoins.count(txid) != 0;
+}
+
+void CCoinsViewCache::AddFetchedCoins(const uint256 &txid, CCoins &coins) {
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
+    if (!ret.second)
+        return;
+    UncacheOutputs(txid);
+    coins.swap(ret.first->second.coins);
+    if (ret.first->second.coins.IsPruned())
+        ret.first->second.flags = CCoinsCacheEntry::FRESH;
+    cachedCoinsUsage += ret.first->second.DynamicMemoryUsage();
+}
+
 const CCoins* CCoinsViewCache::AccessCoins(const uint256 &txid) const {
     CCoinsMap::const_iterator it = FetchCoins(txid);
     if (it == cacheCoins.end()) {
@@ -389,6 +437,29 @@ const CCoins* CCoinsViewCache::AccessCoins(const uint256 &txid) const {
     }
 }
 
+const CTxOut* CCoinsViewCache::AccessOutput(const COutPoint &outpoint) const {
+    CCoinsMap::const_iterator it = cacheCoins.find(outpoint.hash);
+    if (it != cacheCoins.end())
+        return it->second.coins.IsAvailable(outpoint.n) ? &it->second.coins.vout[outpoint.n] : NULL;
+    CCoinsOutputMap::const_iterator itOut = FetchOutput(outpoint);
+    return itOut == cacheOutputs.end() ? NULL : &itOut->second.out;
+}
+
+bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const {
+    CCoinsMap::const_iterator it = cacheCoins.find(outpoint.hash);
+    if (it != cacheCoins.end()) {
+        if (!it->second.coins.IsAvailable(outpoint.n))
+            return false;
+        coin = CCoinsOutput(it->second.coins, outpoint.n);
+        return true;
+    }
+    CCoinsOutputMap::const_iterator itOut = FetchOutput(outpoint);
+    if (itOut == cacheOutputs.end())
+        return false;
+    coin = itOut->second;
+    return true;
+}
+
 bool CCoinsViewCache::HaveCoins(const uint256 &txid) const {
     CCoinsMap::const_iterator it = FetchCoins(txid);
     // We're using vtx.empty() instead of IsPruned here for performance reasons,
@@ -501,6 +572,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
     assert(!hasModifier);
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) { // Ignore non-dirty entries (optimization).
+            UncacheOutputs(it->first);
             CCoinsMap::iterator itUs = cacheCoins.find(it->first);
             if (itUs == cacheCoins.end()) {
                 if (!it->second.coins.IsPruned()) {
@@ -511,7 +583,8 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                     assert(it->second.flags & CCoinsCacheEntry::FRESH);
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
-                    cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
+                    entry.dirtyOutputs.swap(it->second.dirtyOutputs);
+                    cachedCoinsUsage += entry.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
                 }
             } else {
@@ -519,13 +592,15 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                     // The grandparent does not have an entry, and the child is
                     // modified and being pruned. This means we can just delete
                     // it from the parent.
-                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage -= itUs->second.DynamicMemoryUsage();
                     cacheCoins.erase(itUs);
                 } else {
-                    // A normal modification.
-                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
+                    // A normal modification. The outputs that differ from the
+                    // grandparent are those we changed plus those the child changed.
+                    cachedCoinsUsage -= itUs->second.DynamicMemoryUsage();
                     itUs->second.coins.swap(it->second.coins);
-                    cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
+                    itUs->second.dirtyOutputs.insert(it->second.dirtyOutputs.begin(), it->second.dirtyOutputs.end());
+                    cachedCoinsUsage += itUs->second.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
             }
@@ -549,6 +624,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor, cacheSproutAnchors, cacheSaplingAnchors, cacheSproutNullifiers, cacheSaplingNullifiers);
     cacheCoins.clear();
+    cacheOutputs.clear();
     cacheSproutAnchors.clear();
     cacheSaplingAnchors.clear();
     cacheSproutNullifiers.clear();
@@ -563,9 +639,9 @@ unsigned int CCoinsViewCache::GetCacheSize() const {
 
 const CTxOut &CCoinsViewCache::GetOutputFor(const CTxIn& input) const
 {
-    const CCoins* coins = AccessCoins(input.prevout.hash);
-    assert(coins && coins->IsAvailable(input.prevout.n));
-    return coins->vout[input.prevout.n];
+    const CTxOut* out = AccessOutput(input.prevout);
+    assert(out);
+    return *out;
 }
 
 const CScript &CCoinsViewCache::GetSpendFor(const CCoins *coins, const CTxIn& input)
@@ -576,8 +652,7 @@ const CScript &CCoinsViewCache::GetSpendFor(const CCoins *coins, const CTxIn& in
 
 const CScript &CCoinsViewCache::GetSpendFor(const CTxIn& input) const
 {
-    const CCoins* coins = AccessCoins(input.prevout.hash);
-    return GetSpendFor(coins, input);
+    return GetOutputFor(input).scriptPubKey;
 }
 
 /** 
@@ -677,8 +752,7 @@ bool CCoinsViewCache::HaveInputs(const CTransaction& tx) const
     if (!tx.IsMint()) {
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             const COutPoint &prevout = tx.vin[i].prevout;
-            const CCoins* coins = AccessCoins(prevout.hash);
-            if (!coins || !coins->IsAvailable(prevout.n)) {
+            if (AccessOutput(prevout) == NULL) {
                 //fprintf(stderr,"HaveInputs missing input %s/v%d\n",prevout.hash.ToString().c_str(),prevout.n);
                 return false;
             }
@@ -719,18 +793,35 @@ double CCoinsViewCache::GetPriority(const CTransaction &tx, int nHeight) const
 CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage) : cache(cache_), it(it_), cachedCoinUsage(usage) {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
+    const CCoins &coins = it->second.coins;
+    vAvailBefore.resize(coins.vout.size());
+    for (unsigned int i = 0; i < coins.vout.size(); i++)
+        vAvailBefore[i] = !coins.vout[i].IsNull();
+    fCoinBaseBefore = coins.fCoinBase;
+    nHeightBefore = coins.nHeight;
+    nVersionBefore = coins.nVersion;
 }
 
 CCoinsModifier::~CCoinsModifier()
 {
     assert(cache.hasModifier);
     cache.hasModifier = false;
-    it->second.coins.Cleanup();
+    CCoins &coins = it->second.coins;
+    coins.Cleanup();
+    // Outputs are only ever spent or restored, so the changed ones are those whose
+    // availability changed. A change of the transaction metadata touches all of them.
+    bool fMetaChanged = coins.fCoinBase != fCoinBaseBefore || coins.nHeight != nHeightBefore || coins.nVersion != nVersionBefore;
+    size_t nOutputs = std::max(vAvailBefore.size(), coins.vout.size());
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        bool fAvailBefore = i < vAvailBefore.size() && vAvailBefore[i];
+        if (fAvailBefore != coins.IsAvailable(i) || (fMetaChanged && (fAvailBefore || coins.IsAvailable(i))))
+            it->second.dirtyOutputs.insert(i);
+    }
     cache.cachedCoinsUsage -= cachedCoinUsage; // Subtract the old usage
-    if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
+    if ((it->second.flags & CCoinsCacheEntry::FRESH) && coins.IsPruned()) {
         cache.cacheCoins.erase(it);
     } else {
         // If the coin still exists after the modification, add the new usage
-        cache.cachedCoinsUsage += it->second.coins.DynamicMemoryUsage();
+        cache.cachedCoinsUsage += it->second.DynamicMemoryUsage();
     }
 }
@@ -33,6 +33,8 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <map>
+#include <set>
 #include <vector>
 #include <unordered_map>
 
@@ -273,6 +275,48 @@ public:
     }
 };
 
+/**
+ * One unspent output with the metadata of its transaction, as stored per output in the coins database
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nHeight * 2 + fCoinBase)
+ * - the CTxOut (via CTxOutCompressor)
+ */
+class CCoinsOutput
+{
+public:
+    bool fCoinBase;
+    int nHeight;
+    int nVersion;
+    CTxOut out;
+
+    CCoinsOutput() : fCoinBase(false), nHeight(0), nVersion(0) {}
+    CCoinsOutput(const CCoins &coins, uint32_t n) : fCoinBase(coins.fCoinBase), nHeight(coins.nHeight), nVersion(coins.nVersion), out(coins.vout[n]) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        uint32_t nCode = nHeight * 2 + (fCoinBase ? 1 : 0);
+        ::Serialize(s, VARINT(this->nVersion));
+        ::Serialize(s, VARINT(nCode));
+        ::Serialize(s, CTxOutCompressor(REF(out)));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        uint32_t nCode = 0;
+        ::Unserialize(s, VARINT(this->nVersion));
+        ::Unserialize(s, VARINT(nCode));
+        nHeight = nCode / 2;
+        fCoinBase = nCode & 1;
+        ::Unserialize(s, REF(CTxOutCompressor(out)));
+    }
+
+    size_t DynamicMemoryUsage() const {
+        return RecursiveDynamicUsage(out.scriptPubKey);
+    }
+};
+
 class CCoinsKeyHasher
 {
 private:
@@ -295,6 +339,7 @@ struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    std::set<uint32_t> dirtyOutputs; // The outputs that are potentially different from the version in the parent view.
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -302,6 +347,10 @@ struct CCoinsCacheEntry
     };
 
     CCoinsCacheEntry() : coins(), flags(0) {}
+
+    size_t DynamicMemoryUsage() const {
+        return coins.DynamicMemoryUsage() + memusage::DynamicUsage(dirtyOutputs);
+    }
 };
 
 struct CAnchorsSproutCacheEntry
@@ -352,6 +401,8 @@ typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsM
 typedef boost::unordered_map<uint256, CAnchorsSproutCacheEntry, CCoinsKeyHasher> CAnchorsSproutMap;
 typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, CCoinsKeyHasher> CAnchorsSaplingMap;
 typedef boost::unordered_map<uint256, CNullifiersCacheEntry, CCoinsKeyHasher> CNullifiersMap;
+//! Ordered by txid, so the outputs of a transaction are adjacent
+typedef std::map<COutPoint, CCoinsOutput> CCoinsOutputMap;
 
 struct CCoinsStats
 {
@@ -387,6 +438,9 @@ public:
     //! This may (but cannot always) return true for fully spent transactions
     virtual bool HaveCoins(const uint256 &txid) const;
 
+    //! Retrieve a single unspent output, by default through GetCoins
+    virtual bool GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const;
+
     //! Retrieve the block hash whose state this CCoinsView currently represents
     virtual uint256 GetBestBlock() const;
 
@@ -425,6 +479,7 @@ public:
     bool GetNullifier(const uint256 &nullifier, ShieldedType type) const;
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const;
     uint256 GetBestBlock() const;
     uint256 GetBestAnchor(ShieldedType type) const;
     void SetBackend(CCoinsView &viewIn);
@@ -453,6 +508,10 @@ private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
     size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    std::vector<bool> vAvailBefore; // Availability of the outputs before modification
+    bool fCoinBaseBefore;
+    int nHeightBefore;
+    int nVersionBefore;
     CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
@@ -491,8 +550,13 @@ protected:
     mutable CAnchorsSaplingMap cacheSaplingAnchors;
     mutable CNullifiersMap cacheSproutNullifiers;
     mutable CNullifiersMap cacheSaplingNullifiers;
+    /**
+     * Single outputs read from the base view, for transactions that are not in cacheCoins.
+     * They are never modified: an entry of cacheCoins for the txid replaces them.
+     */
+    mutable CCoinsOutputMap cacheOutputs;
 
-    /* Cached dynamic memory usage for the inner CCoins objects. */
+    /* Cached dynamic memory usage for the inner CCoins and CCoinsOutput objects. */
     mutable size_t cachedCoinsUsage;
 
 public:
@@ -505,6 +569,7 @@ public:
     bool GetNullifier(const uint256 &nullifier, ShieldedType type) const;
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const;
     uint256 GetBestBlock() const;
     uint256 GetBestAnchor(ShieldedType type) const;
     void SetBestBlock(const uint256 &hashBlock);
@@ -536,6 +601,13 @@ public:
      */
     const CCoins* AccessCoins(const uint256 &txid) const;
 
+    /**
+     * Return a pointer to an unspent output in the cache, or NULL if not found.
+     * Unless the transaction is cached already, only that output is read from
+     * the base view. The pointer is valid until the transaction is modified.
+     */
+    const CTxOut* AccessOutput(const COutPoint &outpoint) const;
+
     /**
      * Return a modifiable reference to a CCoins. If no entry with the given
      * txid exists, a new one is created. Simultaneous modifications are not
@@ -543,6 +615,16 @@ public:
      */
     CCoinsModifier ModifyCoins(const uint256 &txid);
 
+    //! Check whether the cache has an entry for the txid, without reading the base view
+    bool HaveCoinsInCache(const uint256 &txid) const;
+
+    /**
+     * Add coins read from the base view by other means (e.g. in parallel), as if
+     * they were fetched through the cache. Has no effect if the cache already has
+     * an entry for the txid. The coins are moved out of the argument.
+     */
+    void AddFetchedCoins(const uint256 &txid, CCoins &coins);
+
     /**
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to be forgotten.
@@ -597,6 +679,11 @@ private:
     CCoinsMap::iterator FetchCoins(const uint256 &txid);
     CCoinsMap::const_iterator FetchCoins(const uint256 &txid) const;
 
+    //! Find or read a single output, for a transaction that is not in cacheCoins
+    CCoinsOutputMap::const_iterator FetchOutput(const COutPoint &outpoint) const;
+    //! Drop the single outputs of a transaction, before it gets an entry in cacheCoins
+    void UncacheOutputs(const uint256 &txid) const;
+
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
@@ -0,0 +1,160 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsnapshot.h"
+
+#include "chain.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "komodo.h"
+#include "komodo_globals.h"
+#include "komodo_notary.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+/**
+ * Coins view that records the changes flushed into it as serialized coins
+ * database records instead of writing them. Reads go to the database.
+ */
+class CCoinsViewRecorder : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB *db;
+    CCoinsDBRecordMap &records;
+
+public:
+    CCoinsViewRecorder(CCoinsViewDB *dbIn, CCoinsDBRecordMap &recordsIn) : CCoinsViewBacked(dbIn), db(dbIn), records(recordsIn) {}
+
+    bool BatchWrite(CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    CAnchorsSproutMap &mapSproutAnchors,
+                    CAnchorsSaplingMap &mapSaplingAnchors,
+                    CNullifiersMap &mapSproutNullifiers,
+                    CNullifiersMap &mapSaplingNullifiers)
+    {
+        db->RecordBatch(records, mapCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor,
+                mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers);
+        return true;
+    }
+};
+
+bool DumpTxOutSetSnapshot(const boost::filesystem::path &path, CTxOutSetSnapshotInfo &info, std::string &strError)
+{
+    boost::scoped_ptr<CDBIterator> pcursor;
+    CCoinsDBRecordMap overlay;
+    std::vector<uint8_t> events;
+    CTxOutSetSnapshotMetadata &metadata = info.metadata;
+    {
+        LOCK(cs_main);
+        int32_t prevMoMheight;
+        uint256 notarizedHash, notarizedDestTxid;
+        int32_t notarizedHeight = komodo_notarized_height(&prevMoMheight, &notarizedHash, &notarizedDestTxid);
+        CBlockIndex *pindexBase = notarizedHeight > 0 ? chainActive[notarizedHeight] : NULL;
+        if (pindexBase == NULL || pindexBase->GetBlockHash() != notarizedHash) {
+            strError = "No notarized block in the active chain";
+            return false;
+        }
+
+        // The cursor sees the database as of its creation, i.e. the flushed tip
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->RawCursor());
+
+        // Rewind the tip state to the notarized block, in memory only
+        CCoinsViewRecorder recorder(pcoinsdbview, overlay);
+        CCoinsViewCache view(&recorder);
+        for (CBlockIndex *pindex = chainActive.Tip(); pindex != pindexBase; pindex = pindex->pprev) {
+            boost::this_thread::interruption_point();
+            CBlock block;
+            CValidationState state;
+            bool fClean = true;
+            if (!ReadBlockFromDisk(block, pindex, 0)) {
+                strError = strprintf("Failed to read block %s", pindex->GetBlockHash().ToString());
+                return false;
+            }
+            if (!DisconnectBlock(block, state, pindex, view, &fClean) || !fClean) {
+                strError = strprintf("Failed to rewind block %s", pindex->GetBlockHash().ToString());
+                return false;
+            }
+        }
+        view.Flush();
+
+        if (!komodo_stateevents(pindexBase->nHeight, events)) {
+            strError = strprintf("Failed to read %s", KOMODO_STATE_FILENAME);
+            return false;
+        }
+        metadata.symbol = chainName.symbol();
+        metadata.hashBlock = pindexBase->GetBlockHash();
+        metadata.nHeight = pindexBase->nHeight;
+        metadata.notarizationTxid = notarizedDestTxid;
+    }
+
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".incomplete";
+    FILE *file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = strprintf("Unable to open %s for writing", pathTmp.string());
+        return false;
+    }
+
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    try {
+        fileout << metadata;
+        hasher << metadata;
+
+        // Merge the database records with the rewound changes, both in key order
+        pcursor->SeekToFirst();
+        CCoinsDBRecordMap::const_iterator it = overlay.begin();
+        while (pcursor->Valid() || it != overlay.end()) {
+            boost::this_thread::interruption_point();
+            std::string key;
+            boost::optional<std::string> value;
+            if (!pcursor->Valid() || (it != overlay.end() && it->first <= pcursor->GetKeyRaw())) {
+                if (pcursor->Valid() && it->first == pcursor->GetKeyRaw())
+                    pcursor->Next();
+                key = it->first;
+                value = it->second;
+                ++it;
+            } else {
+                key = pcursor->GetKeyRaw();
+                value = pcursor->GetValueRaw();
+                pcursor->Next();
+            }
+            if (!value)
+                continue;
+            fileout << key << *value;
+            hasher << key << *value;
+            info.nRecords++;
+        }
+        std::string terminator;
+        fileout << terminator;
+        hasher << terminator;
+
+        fileout << events;
+        hasher << events;
+        info.nEventBytes = events.size();
+
+        info.hashSnapshot = hasher.GetHash();
+        fileout << info.hashSnapshot;
+    } catch (const std::exception &e) {
+        strError = strprintf("Failed to write snapshot: %s", e.what());
+        return false;
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, path)) {
+        strError = strprintf("Unable to rename %s to %s", pathTmp.string(), path.string());
+        return false;
+    }
+    LogPrintf("%s: wrote %u records at height %d to %s, hash %s\n", __func__, info.nRecords,
+            metadata.nHeight, path.string(), info.hashSnapshot.ToString());
+    return true;
+}
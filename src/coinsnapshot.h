@@ -0,0 +1,80 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_COINSNAPSHOT_H
+#define KOMODO_COINSNAPSHOT_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/**
+ * Header of a UTXO set snapshot file. The file holds the coins database
+ * records (coins, Sprout/Sapling anchors and nullifiers, best block) and the
+ * komodo state events as of a notarized block, followed by a hash of it all.
+ */
+class CTxOutSetSnapshotMetadata
+{
+public:
+    static const uint32_t SNAPSHOT_MAGIC = 0x504e534b; // "KSNP"
+    static const int32_t CURRENT_VERSION = 3; // per-output coins records and a header per transaction
+
+    uint32_t nMagic;
+    int32_t nVersion;
+    std::string symbol;
+    uint256 hashBlock;
+    int32_t nHeight;
+    uint256 notarizationTxid; // notarization of hashBlock on the destination chain
+
+    CTxOutSetSnapshotMetadata()
+    {
+        SetNull();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nMagic);
+        READWRITE(nVersion);
+        READWRITE(symbol);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(notarizationTxid);
+    }
+
+    void SetNull()
+    {
+        nMagic = SNAPSHOT_MAGIC;
+        nVersion = CURRENT_VERSION;
+        symbol.clear();
+        hashBlock.SetNull();
+        nHeight = 0;
+        notarizationTxid.SetNull();
+    }
+};
+
+/** Summary of a dumped UTXO set snapshot */
+struct CTxOutSetSnapshotInfo
+{
+    CTxOutSetSnapshotMetadata metadata;
+    uint64_t nRecords = 0;
+    uint64_t nEventBytes = 0;
+    uint256 hashSnapshot;
+};
+
+/****
+ * Write the UTXO set as of the last notarized block of the active chain to a file
+ * @param path the file to write
+ * @param info the summary of the written snapshot
+ * @param strError the reason on failure
+ * @returns true on success
+ */
+bool DumpTxOutSetSnapshot(const boost::filesystem::path &path, CTxOutSetSnapshotInfo &info, std::string &strError);
+
+#endif // KOMODO_COINSNAPSHOT_H
@@ -0,0 +1,354 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Multi-lane BLAKE2b (RFC 7693) for hashing many inputs that only differ in a
+// short suffix, as Equihash does for every index of a solution.
+
+#include "crypto/blake2b_multi.h"
+#include "crypto/common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#define BLAKE2B_MULTI_X86 1
+#endif
+
+namespace
+{
+/// Portable BLAKE2b compression function.
+namespace blake2b
+{
+const uint64_t IV[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+const uint8_t SIGMA[12][16] = {
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+    {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3},
+    {11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4},
+    { 7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8},
+    { 9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13},
+    { 2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9},
+    {12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11},
+    {13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10},
+    { 6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5},
+    {10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0},
+    { 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15},
+    {14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3}
+};
+
+uint64_t inline Rotr(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+void inline G(uint64_t* v, int a, int b, int c, int d, uint64_t x, uint64_t y)
+{
+    v[a] = v[a] + v[b] + x;
+    v[d] = Rotr(v[d] ^ v[a], 32);
+    v[c] = v[c] + v[d];
+    v[b] = Rotr(v[b] ^ v[c], 24);
+    v[a] = v[a] + v[b] + y;
+    v[d] = Rotr(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = Rotr(v[b] ^ v[c], 63);
+}
+
+/** Compress one 128-byte block into h. t0/t1 is the byte counter including this block. */
+void Compress(uint64_t* h, const unsigned char* block, uint64_t t0, uint64_t t1, bool last)
+{
+    uint64_t m[16], v[16];
+    for (int i = 0; i < 16; i++) m[i] = ReadLE64(block + 8 * i);
+    for (int i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = IV[i];
+    }
+    v[12] ^= t0;
+    v[13] ^= t1;
+    if (last) v[14] = ~v[14];
+    for (int r = 0; r < 12; r++) {
+        const uint8_t* s = SIGMA[r];
+        G(v, 0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+        G(v, 1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+        G(v, 2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+        G(v, 3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+        G(v, 0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+        G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(v, 2, 7,  8, 13, m[s[12]], m[s[13]]);
+        G(v, 3, 4,  9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) h[i] ^= v[i] ^ v[i + 8];
+}
+
+/** Lay out the final block of every lane: the shared tail plus its own suffix. */
+void inline PrepareBlocks(const Blake2bMidstate& mid, const uint32_t* suffix, unsigned char blocks[BLAKE2B_LANES][128])
+{
+    for (size_t l = 0; l < BLAKE2B_LANES; l++) {
+        memset(blocks[l], 0, 128);
+        memcpy(blocks[l], mid.buf, mid.buflen);
+        WriteLE32(blocks[l] + mid.buflen, suffix[l]);
+    }
+}
+
+void inline FinalCounter(const Blake2bMidstate& mid, uint64_t& t0, uint64_t& t1)
+{
+    t0 = mid.t[0] + mid.buflen + 4;
+    t1 = mid.t[1] + (t0 < mid.t[0] ? 1 : 0);
+}
+
+void inline WriteDigest(const uint64_t* h, unsigned char* out, size_t outlen)
+{
+    unsigned char full[64];
+    for (int i = 0; i < 8; i++) WriteLE64(full + 8 * i, h[i]);
+    memcpy(out, full, outlen);
+}
+
+void FinalizeLanes(const Blake2bMidstate& mid, const uint32_t* suffix, unsigned char* out, size_t outlen)
+{
+    unsigned char blocks[BLAKE2B_LANES][128];
+    uint64_t t0, t1;
+    PrepareBlocks(mid, suffix, blocks);
+    FinalCounter(mid, t0, t1);
+    for (size_t l = 0; l < BLAKE2B_LANES; l++) {
+        uint64_t h[8];
+        memcpy(h, mid.h, sizeof(h));
+        Compress(h, blocks[l], t0, t1, true);
+        WriteDigest(h, out + l * outlen, outlen);
+    }
+}
+} // namespace blake2b
+
+#ifdef BLAKE2B_MULTI_X86
+/// Two lanes per 128-bit register; plain SSE2 is part of the x86-64 baseline.
+namespace blake2b_sse2
+{
+__m128i inline Rotr32(__m128i x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+__m128i inline Rotr24(__m128i x) { return _mm_or_si128(_mm_srli_epi64(x, 24), _mm_slli_epi64(x, 40)); }
+__m128i inline Rotr16(__m128i x) { return _mm_or_si128(_mm_srli_epi64(x, 16), _mm_slli_epi64(x, 48)); }
+__m128i inline Rotr63(__m128i x) { return _mm_or_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x)); }
+
+void inline G(__m128i* v, int a, int b, int c, int d, __m128i x, __m128i y)
+{
+    v[a] = _mm_add_epi64(_mm_add_epi64(v[a], v[b]), x);
+    v[d] = Rotr32(_mm_xor_si128(v[d], v[a]));
+    v[c] = _mm_add_epi64(v[c], v[d]);
+    v[b] = Rotr24(_mm_xor_si128(v[b], v[c]));
+    v[a] = _mm_add_epi64(_mm_add_epi64(v[a], v[b]), y);
+    v[d] = Rotr16(_mm_xor_si128(v[d], v[a]));
+    v[c] = _mm_add_epi64(v[c], v[d]);
+    v[b] = Rotr63(_mm_xor_si128(v[b], v[c]));
+}
+
+void Compress2(const uint64_t* h, const unsigned char* b0, const unsigned char* b1,
+               uint64_t t0, uint64_t t1, uint64_t* out0, uint64_t* out1)
+{
+    __m128i m[16], v[16];
+    for (int i = 0; i < 16; i++)
+        m[i] = _mm_set_epi64x(ReadLE64(b1 + 8 * i), ReadLE64(b0 + 8 * i));
+    for (int i = 0; i < 8; i++) {
+        v[i] = _mm_set1_epi64x(h[i]);
+        v[i + 8] = _mm_set1_epi64x(blake2b::IV[i]);
+    }
+    v[12] = _mm_xor_si128(v[12], _mm_set1_epi64x(t0));
+    v[13] = _mm_xor_si128(v[13], _mm_set1_epi64x(t1));
+    v[14] = _mm_xor_si128(v[14], _mm_set1_epi64x(-1));
+    for (int r = 0; r < 12; r++) {
+        const uint8_t* s = blake2b::SIGMA[r];
+        G(v, 0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+        G(v, 1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+        G(v, 2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+        G(v, 3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+        G(v, 0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+        G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(v, 2, 7,  8, 13, m[s[12]], m[s[13]]);
+        G(v, 3, 4,  9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) {
+        uint64_t lanes[2];
+        __m128i x = _mm_xor_si128(_mm_set1_epi64x(h[i]), _mm_xor_si128(v[i], v[i + 8]));
+        _mm_storeu_si128((__m128i*)lanes, x);
+        out0[i] = lanes[0];
+        out1[i] = lanes[1];
+    }
+}
+
+void FinalizeLanes(const Blake2bMidstate& mid, const uint32_t* suffix, unsigned char* out, size_t outlen)
+{
+    unsigned char blocks[BLAKE2B_LANES][128];
+    uint64_t t0, t1;
+    blake2b::PrepareBlocks(mid, suffix, blocks);
+    blake2b::FinalCounter(mid, t0, t1);
+    for (size_t l = 0; l < BLAKE2B_LANES; l += 2) {
+        uint64_t h0[8], h1[8];
+        Compress2(mid.h, blocks[l], blocks[l + 1], t0, t1, h0, h1);
+        blake2b::WriteDigest(h0, out + l * outlen, outlen);
+        blake2b::WriteDigest(h1, out + (l + 1) * outlen, outlen);
+    }
+}
+} // namespace blake2b_sse2
+
+/// Four lanes per 256-bit register, selected at runtime when the CPU and OS support AVX2.
+namespace blake2b_avx2
+{
+#define BLAKE2B_AVX2 __attribute__((target("avx2")))
+
+BLAKE2B_AVX2 __m256i inline Rotr32(__m256i x) { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+BLAKE2B_AVX2 __m256i inline Rotr24(__m256i x)
+{
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    return _mm256_shuffle_epi8(x, r24);
+}
+BLAKE2B_AVX2 __m256i inline Rotr16(__m256i x)
+{
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    return _mm256_shuffle_epi8(x, r16);
+}
+BLAKE2B_AVX2 __m256i inline Rotr63(__m256i x) { return _mm256_or_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x)); }
+
+BLAKE2B_AVX2 void inline G(__m256i* v, int a, int b, int c, int d, __m256i x, __m256i y)
+{
+    v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]), x);
+    v[d] = Rotr32(_mm256_xor_si256(v[d], v[a]));
+    v[c] = _mm256_add_epi64(v[c], v[d]);
+    v[b] = Rotr24(_mm256_xor_si256(v[b], v[c]));
+    v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]), y);
+    v[d] = Rotr16(_mm256_xor_si256(v[d], v[a]));
+    v[c] = _mm256_add_epi64(v[c], v[d]);
+    v[b] = Rotr63(_mm256_xor_si256(v[b], v[c]));
+}
+
+BLAKE2B_AVX2 void FinalizeLanes(const Blake2bMidstate& mid, const uint32_t* suffix, unsigned char* out, size_t outlen)
+{
+    unsigned char blocks[BLAKE2B_LANES][128];
+    uint64_t t0, t1;
+    blake2b::PrepareBlocks(mid, suffix, blocks);
+    blake2b::FinalCounter(mid, t0, t1);
+
+    __m256i m[16], v[16];
+    for (int i = 0; i < 16; i++)
+        m[i] = _mm256_set_epi64x(ReadLE64(blocks[3] + 8 * i), ReadLE64(blocks[2] + 8 * i),
+                                 ReadLE64(blocks[1] + 8 * i), ReadLE64(blocks[0] + 8 * i));
+    for (int i = 0; i < 8; i++) {
+        v[i] = _mm256_set1_epi64x(mid.h[i]);
+        v[i + 8] = _mm256_set1_epi64x(blake2b::IV[i]);
+    }
+    v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x(t0));
+    v[13] = _mm256_xor_si256(v[13], _mm256_set1_epi64x(t1));
+    v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi64x(-1));
+    for (int r = 0; r < 12; r++) {
+        const uint8_t* s = blake2b::SIGMA[r];
+        G(v, 0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+        G(v, 1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+        G(v, 2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+        G(v, 3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+        G(v, 0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+        G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        G(v, 2, 7,  8, 13, m[s[12]], m[s[13]]);
+        G(v, 3, 4,  9, 14, m[s[14]], m[s[15]]);
+    }
+
+    uint64_t h[BLAKE2B_LANES][8];
+    for (int i = 0; i < 8; i++) {
+        uint64_t lanes[4];
+        __m256i x = _mm256_xor_si256(_mm256_set1_epi64x(mid.h[i]), _mm256_xor_si256(v[i], v[i + 8]));
+        _mm256_storeu_si256((__m256i*)lanes, x);
+        for (size_t l = 0; l < BLAKE2B_LANES; l++) h[l][i] = lanes[l];
+    }
+    for (size_t l = 0; l < BLAKE2B_LANES; l++)
+        blake2b::WriteDigest(h[l], out + l * outlen, outlen);
+}
+
+#undef BLAKE2B_AVX2
+} // namespace blake2b_avx2
+
+bool HaveAVX2()
+{
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    // The OS must save the YMM registers (OSXSAVE + AVX, then XCR0 bits 1 and 2).
+    if (!((ecx >> 27) & 1) || !((ecx >> 28) & 1)) return false;
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6) return false;
+    if (__get_cpuid_max(0, nullptr) < 7) return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx >> 5) & 1;
+}
+#endif // BLAKE2B_MULTI_X86
+
+typedef void (*FinalizeLanesType)(const Blake2bMidstate&, const uint32_t*, unsigned char*, size_t);
+
+/** Compare an implementation against the portable one for every split of a short prefix. */
+bool SelfTest(FinalizeLanesType fn)
+{
+    static const uint32_t suffix[BLAKE2B_LANES] = {0, 1, 0x01020304, 0xffffffff};
+    unsigned char prefix[200];
+    for (size_t i = 0; i < sizeof(prefix); i++) prefix[i] = (unsigned char)(i * 7 + 3);
+    for (size_t len = 0; len <= sizeof(prefix); len += 25) {
+        uint64_t h[8], t[2] = {0, 0};
+        memcpy(h, blake2b::IV, sizeof(h));
+        h[0] ^= 0x01010000ULL ^ 50;
+        Blake2bMidstate mid;
+        if (!Blake2bMidstateInit(mid, h, t, prefix, len)) continue;
+        unsigned char expected[BLAKE2B_LANES * 50], got[BLAKE2B_LANES * 50];
+        blake2b::FinalizeLanes(mid, suffix, expected, 50);
+        fn(mid, suffix, got, 50);
+        if (memcmp(expected, got, sizeof(got))) return false;
+    }
+    return true;
+}
+
+FinalizeLanesType FinalizeLanes = blake2b::FinalizeLanes;
+
+} // namespace
+
+bool Blake2bMidstateInit(Blake2bMidstate& mid, const uint64_t h[8], const uint64_t t[2],
+                         const unsigned char* buf, size_t buflen)
+{
+    memcpy(mid.h, h, sizeof(mid.h));
+    mid.t[0] = t[0];
+    mid.t[1] = t[1];
+    // A full pending block cannot be the last one once a suffix follows, so it
+    // is shared by all lanes and can be compressed now.
+    while (buflen >= 128) {
+        mid.t[0] += 128;
+        if (mid.t[0] < 128) mid.t[1]++;
+        blake2b::Compress(mid.h, buf, mid.t[0], mid.t[1], false);
+        buf += 128;
+        buflen -= 128;
+    }
+    if (buflen + 4 > 128) return false;
+    memcpy(mid.buf, buf, buflen);
+    mid.buflen = buflen;
+    return true;
+}
+
+void Blake2bFinalizeLanesLE32(const Blake2bMidstate& mid, const uint32_t suffix[BLAKE2B_LANES],
+                              unsigned char* out, size_t outlen)
+{
+    assert(mid.buflen + 4 <= 128);
+    assert(outlen > 0 && outlen <= 64);
+    FinalizeLanes(mid, suffix, out, outlen);
+}
+
+std::string Blake2bMultiAutoDetect()
+{
+#ifdef BLAKE2B_MULTI_X86
+    if (HaveAVX2()) {
+        FinalizeLanes = blake2b_avx2::FinalizeLanes;
+        assert(SelfTest(FinalizeLanes));
+        return "avx2";
+    }
+    FinalizeLanes = blake2b_sse2::FinalizeLanes;
+    assert(SelfTest(FinalizeLanes));
+    return "sse2";
+#endif
+
+    assert(SelfTest(FinalizeLanes));
+    return "standard";
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_BLAKE2B_MULTI_H
+#define BITCOIN_CRYPTO_BLAKE2B_MULTI_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Number of independent inputs hashed by one Blake2bFinalizeLanesLE32 call. */
+static const size_t BLAKE2B_LANES = 4;
+
+/**
+ * BLAKE2b state after absorbing a prefix that is shared by several inputs
+ * (e.g. the Equihash I||V header). Every full block of the prefix has already
+ * been compressed; buf holds the pending bytes of the last, partial block.
+ */
+struct Blake2bMidstate
+{
+    uint64_t h[8];
+    uint64_t t[2];
+    unsigned char buf[128];
+    size_t buflen;
+};
+
+/**
+ * Build a midstate from raw BLAKE2b chaining values, byte counter and pending
+ * (not yet compressed) input. Returns false if a 4-byte suffix would not fit
+ * into a single final block, in which case callers must hash one lane at a time.
+ */
+bool Blake2bMidstateInit(Blake2bMidstate& mid, const uint64_t h[8], const uint64_t t[2],
+                         const unsigned char* buf, size_t buflen);
+
+/**
+ * Compute BLAKE2B_LANES digests of prefix||le32(suffix[i]) and write outlen
+ * bytes of lane i to out + i*outlen. outlen must match the digest length the
+ * midstate was initialised with.
+ */
+void Blake2bFinalizeLanesLE32(const Blake2bMidstate& mid, const uint32_t suffix[BLAKE2B_LANES],
+                              unsigned char* out, size_t outlen);
+
+/** Autodetect the best available multi-lane BLAKE2b implementation.
+ *  Returns the name of the implementation.
+ */
+std::string Blake2bMultiAutoDetect();
+
+#endif // BITCOIN_CRYPTO_BLAKE2B_MULTI_H
@@ -17,6 +17,7 @@
 #endif
 
 #include "compat/endian.h"
+#include "crypto/blake2b_multi.h"
 #include "crypto/equihash.h"
 #include "util.h"
 #ifndef __linux__
@@ -57,6 +58,9 @@
 
 static EhSolverCancelledException solver_cancelled;
 
+/** Number of consecutive BLAKE2b outputs generated at once while building the initial solver lists. */
+static const size_t EH_HASH_BATCH = 16;
+
 int8_t ZeroizeUnusedBits(size_t N, unsigned char* hash, size_t hLen)
 {
     uint8_t rem = N % 8;
@@ -98,33 +102,113 @@ int Equihash<N,K>::InitialiseState(eh_HashState& base_state)
                                                          personalization);
 }
 
-void GenerateHash(const eh_HashState& base_state, eh_index g,
-                  unsigned char* hash, size_t hLen, size_t N)
+/**
+ * libsodium keeps the BLAKE2b state in an opaque buffer laid out as
+ * h[8], t[2], f[2], buf[256], buflen. Read it back so that the multi-lane
+ * backend can continue from the same midstate.
+ */
+static bool MidstateFromSodium(const eh_HashState& state, Blake2bMidstate& mid)
 {
-    if ( ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0 )
-    {
+    BOOST_STATIC_ASSERT(sizeof(eh_HashState) >= 352 + sizeof(size_t));
+    const unsigned char* raw = (const unsigned char*)&state;
+    uint64_t h[8], t[2], f[2];
+    size_t buflen;
+    memcpy(h, raw, sizeof(h));
+    memcpy(t, raw + 64, sizeof(t));
+    memcpy(f, raw + 80, sizeof(f));
+    memcpy(&buflen, raw + 352, sizeof(buflen));
+    if (f[0] != 0 || f[1] != 0 || buflen > 256)
+        return false;
+    return Blake2bMidstateInit(mid, h, t, raw + 96, buflen);
+}
+
+/**
+ * The multi-lane path is only used when a SIMD backend is available and the
+ * libsodium state layout matches, which is checked once against libsodium.
+ */
+static bool MultiLaneUsable()
+{
+    static const bool usable = []() {
+        if (Blake2bMultiAutoDetect() == "standard")
+            return false;
+        unsigned char personalization[crypto_generichash_blake2b_PERSONALBYTES] = "EhLayoutCheck";
+        unsigned char header[140];
+        for (size_t i = 0; i < sizeof(header); i++)
+            header[i] = (unsigned char)i;
+        eh_HashState base_state;
+        crypto_generichash_blake2b_init_salt_personal(&base_state, NULL, 0, 50, NULL, personalization);
+        crypto_generichash_blake2b_update(&base_state, header, sizeof(header));
+        Blake2bMidstate mid;
+        if (!MidstateFromSodium(base_state, mid))
+            return false;
+        const uint32_t suffix[BLAKE2B_LANES] = {0, 1, 2, 0xfffffffe};
+        unsigned char lanes[BLAKE2B_LANES * 50];
+        Blake2bFinalizeLanesLE32(mid, suffix, lanes, 50);
+        for (size_t l = 0; l < BLAKE2B_LANES; l++) {
+            eh_HashState state = base_state;
+            eh_index lei = htole32(suffix[l]);
+            unsigned char expected[50];
+            crypto_generichash_blake2b_update(&state, (const unsigned char*) &lei, sizeof(eh_index));
+            crypto_generichash_blake2b_final(&state, expected, sizeof(expected));
+            if (memcmp(expected, lanes + l * 50, sizeof(expected)))
+                return false;
+        }
+        return true;
+    }();
+    return usable;
+}
+
+void GenerateIndexHashes(const eh_HashState& base_state, const eh_index* g, size_t count,
+                         unsigned char* hashes, size_t hLen)
+{
+    size_t i = 0;
+    Blake2bMidstate mid;
+    if (count > 1 && MultiLaneUsable() && MidstateFromSodium(base_state, mid)) {
+        for (; i + BLAKE2B_LANES <= count; i += BLAKE2B_LANES)
+            Blake2bFinalizeLanesLE32(mid, g + i, hashes + i * hLen, hLen);
+        if (i < count) {
+            // Pad the last batch by repeating its final index.
+            uint32_t tail[BLAKE2B_LANES];
+            unsigned char out[BLAKE2B_LANES * BLAKE2B_OUTBYTES];
+            for (size_t l = 0; l < BLAKE2B_LANES; l++)
+                tail[l] = g[std::min(i + l, count - 1)];
+            Blake2bFinalizeLanesLE32(mid, tail, out, hLen);
+            memcpy(hashes + i * hLen, out, (count - i) * hLen);
+            i = count;
+        }
+    }
+    for (; i < count; i++) {
         eh_HashState state;
         state = base_state;
-        eh_index lei = htole32(g);
+        eh_index lei = htole32(g[i]);
         crypto_generichash_blake2b_update(&state, (const unsigned char*) &lei,
                                           sizeof(eh_index));
-        crypto_generichash_blake2b_final(&state, hash, hLen);
+        crypto_generichash_blake2b_final(&state, hashes + i * hLen, hLen);
+    }
+}
+
+void GenerateHash(const eh_HashState& base_state, eh_index g,
+                  unsigned char* hash, size_t hLen, size_t N)
+{
+    if ( ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0 )
+    {
+        GenerateIndexHashes(base_state, &g, 1, hash, hLen);
     }
     else 
     {
         uint32_t myHash[16] = {0};
         uint32_t startIndex = g & 0xFFFFFFF0;
+        eh_index g2s[16];
+        unsigned char tmpHashes[16 * BLAKE2B_OUTBYTES];
+        size_t count = g - startIndex + 1;
 
-        for (uint32_t g2 = startIndex; g2 <= g; g2++) {
+        for (size_t j = 0; j < count; j++)
+            g2s[j] = startIndex + j;
+        GenerateIndexHashes(base_state, g2s, count, tmpHashes, hLen);
+
+        for (size_t j = 0; j < count; j++) {
     	    uint32_t tmpHash[16] = {0};
-    	 
-    	    eh_HashState state;	
-    	    state = base_state;
-    	    eh_index lei = htole32(g2);
-    	    crypto_generichash_blake2b_update(&state, (const unsigned char*) &lei,
-    		                              sizeof(eh_index));
-    	    
-    	    crypto_generichash_blake2b_final(&state, (unsigned char*)&tmpHash[0], static_cast<uint8_t>(hLen));
+    	    memcpy(&tmpHash[0], tmpHashes + j * hLen, hLen);
 
     	    for (uint32_t idx = 0; idx < 16; idx++) myHash[idx] += tmpHash[idx];
         }
@@ -134,6 +218,16 @@ void GenerateHash(const eh_HashState& base_state, eh_index g,
     }
 }
 
+void GenerateHashes(const eh_HashState& base_state, const eh_index* g, size_t count,
+                    unsigned char* hashes, size_t hLen, size_t N)
+{
+    if ( ASSETCHAINS_NK[0] == 0 && ASSETCHAINS_NK[1] == 0 )
+        GenerateIndexHashes(base_state, g, count, hashes, hLen);
+    else
+        for (size_t i = 0; i < count; i++)
+            GenerateHash(base_state, g[i], hashes + i * hLen, hLen, N);
+}
+
 void ExpandArray(const unsigned char* in, size_t in_len,
                  unsigned char* out, size_t out_len,
                  size_t bit_len, size_t byte_pad)
@@ -423,12 +517,19 @@ bool Equihash<N,K>::BasicSolve(const eh_HashState& base_state,
     size_t lenIndices = sizeof(eh_index);
     std::vector<FullStepRow<FullWidth>> X;
     X.reserve(init_size);
-    unsigned char tmpHash[HashOutput];
-    for (eh_index g = 0; X.size() < init_size; g++) {
-        GenerateHash(base_state, g, tmpHash, HashOutput, N);
-        for (eh_index i = 0; i < IndicesPerHashOutput && X.size() < init_size; i++) {
-            X.emplace_back(tmpHash+(i*GetSizeInBytes(N)), GetSizeInBytes(N), HashLength,
-                           CollisionBitLength, static_cast<int>(g*IndicesPerHashOutput)+i);
+    eh_index gs[EH_HASH_BATCH];
+    unsigned char tmpHashes[EH_HASH_BATCH * HashOutput];
+    for (eh_index g0 = 0; X.size() < init_size; g0 += EH_HASH_BATCH) {
+        for (size_t b = 0; b < EH_HASH_BATCH; b++)
+            gs[b] = g0 + b;
+        GenerateHashes(base_state, gs, EH_HASH_BATCH, tmpHashes, HashOutput, N);
+        for (size_t b = 0; b < EH_HASH_BATCH && X.size() < init_size; b++) {
+            const eh_index g = gs[b];
+            const unsigned char* tmpHash = tmpHashes + b * HashOutput;
+            for (eh_index i = 0; i < IndicesPerHashOutput && X.size() < init_size; i++) {
+                X.emplace_back(tmpHash+(i*GetSizeInBytes(N)), GetSizeInBytes(N), HashLength,
+                               CollisionBitLength, static_cast<int>(g*IndicesPerHashOutput)+i);
+            }
         }
         if (cancelled(ListGeneration)) throw solver_cancelled;
     }
@@ -603,12 +704,19 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
         size_t lenIndices = sizeof(eh_trunc);
         std::vector<TruncatedStepRow<TruncatedWidth>> Xt;
         Xt.reserve(init_size);
-        unsigned char tmpHash[HashOutput];
-        for (eh_index g = 0; Xt.size() < init_size; g++) {
-            GenerateHash(base_state, g, tmpHash, HashOutput, N);
-            for (eh_index i = 0; i < IndicesPerHashOutput && Xt.size() < init_size; i++) {
-                Xt.emplace_back(tmpHash+(i*GetSizeInBytes(N)), GetSizeInBytes(N), HashLength, CollisionBitLength,
-                    static_cast<eh_index>(g*IndicesPerHashOutput)+i, static_cast<unsigned int>(CollisionBitLength + 1));
+        eh_index gs[EH_HASH_BATCH];
+        unsigned char tmpHashes[EH_HASH_BATCH * HashOutput];
+        for (eh_index g0 = 0; Xt.size() < init_size; g0 += EH_HASH_BATCH) {
+            for (size_t b = 0; b < EH_HASH_BATCH; b++)
+                gs[b] = g0 + b;
+            GenerateHashes(base_state, gs, EH_HASH_BATCH, tmpHashes, HashOutput, N);
+            for (size_t b = 0; b < EH_HASH_BATCH && Xt.size() < init_size; b++) {
+                const eh_index g = gs[b];
+                const unsigned char* tmpHash = tmpHashes + b * HashOutput;
+                for (eh_index i = 0; i < IndicesPerHashOutput && Xt.size() < init_size; i++) {
+                    Xt.emplace_back(tmpHash+(i*GetSizeInBytes(N)), GetSizeInBytes(N), HashLength, CollisionBitLength,
+                        static_cast<eh_index>(g*IndicesPerHashOutput)+i, static_cast<unsigned int>(CollisionBitLength + 1));
+                }
             }
             if (cancelled(ListGeneration)) throw solver_cancelled;
         }
@@ -721,7 +829,6 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
         std::set<std::vector<unsigned char>> solns;
         size_t hashLen;
         size_t lenIndices;
-        unsigned char tmpHash[HashOutput];
         std::vector<boost::optional<std::vector<FullStepRow<FinalFullWidth>>>> X;
         X.reserve(K+1);
 
@@ -730,12 +837,18 @@ bool Equihash<N,K>::OptimisedSolve(const eh_HashState& base_state,
             // 1) Generate first list of possibilities
             std::vector<FullStepRow<FinalFullWidth>> icv;
             icv.reserve(recreate_size);
+            // All candidates share their truncated prefix, so their hashes
+            // come from one contiguous run of BLAKE2b outputs.
+            const eh_index firstIndex { UntruncateIndex(partialSoln.get()[i], 0, CollisionBitLength + 1) };
+            const eh_index firstBlock = firstIndex/IndicesPerHashOutput;
+            std::vector<eh_index> blocks((firstIndex + recreate_size - 1)/IndicesPerHashOutput - firstBlock + 1);
+            for (size_t b = 0; b < blocks.size(); b++)
+                blocks[b] = firstBlock + b;
+            std::vector<unsigned char> blockHashes(blocks.size() * HashOutput);
+            GenerateHashes(base_state, blocks.data(), blocks.size(), blockHashes.data(), HashOutput, N);
             for (eh_index j = 0; j < recreate_size; j++) {
                 eh_index newIndex { UntruncateIndex(partialSoln.get()[i], j, CollisionBitLength + 1) };
-                if (j == 0 || newIndex % IndicesPerHashOutput == 0) {
-                    GenerateHash(base_state, newIndex/IndicesPerHashOutput,
-                                 tmpHash, HashOutput, N);
-                }
+                const unsigned char* tmpHash = blockHashes.data() + (newIndex/IndicesPerHashOutput - firstBlock) * HashOutput;
                 icv.emplace_back(tmpHash+((newIndex % IndicesPerHashOutput) * GetSizeInBytes(N)),
                                  GetSizeInBytes(N), HashLength, CollisionBitLength, newIndex);
                 if (cancelled(PartialGeneration)) throw solver_cancelled;
@@ -814,12 +927,18 @@ bool Equihash<N,K>::IsValidSolution(const eh_HashState& base_state, std::vector<
         return false;
     }
 
+    std::vector<eh_index> indices = GetIndicesFromMinimal(soln, CollisionBitLength);
+    std::vector<eh_index> blocks(indices.size());
+    for (size_t j = 0; j < indices.size(); j++)
+        blocks[j] = indices[j]/IndicesPerHashOutput;
+    std::vector<unsigned char> tmpHashes(blocks.size() * HashOutput);
+    GenerateHashes(base_state, blocks.data(), blocks.size(), tmpHashes.data(), HashOutput, N);
+
     std::vector<FullStepRow<FinalFullWidth>> X;
     X.reserve(1 << K);
-    unsigned char tmpHash[HashOutput];
-    for (eh_index i : GetIndicesFromMinimal(soln, CollisionBitLength)) {
-        GenerateHash(base_state, i/IndicesPerHashOutput, tmpHash, HashOutput, N);
-        X.emplace_back(tmpHash+((i % IndicesPerHashOutput) * GetSizeInBytes(N)),
+    for (size_t j = 0; j < indices.size(); j++) {
+        eh_index i = indices[j];
+        X.emplace_back(tmpHashes.data()+(j * HashOutput)+((i % IndicesPerHashOutput) * GetSizeInBytes(N)),
                        GetSizeInBytes(N), HashLength, CollisionBitLength, i);
     }
 
@@ -44,6 +44,14 @@ std::vector<eh_index> GetIndicesFromMinimal(std::vector<unsigned char> minimal,
 std::vector<unsigned char> GetMinimalFromIndices(std::vector<eh_index> indices,
                                                  size_t cBitLen);
 
+/** Write BLAKE2b(base_state || le32(g[i])) to hashes + i*hLen, several lanes
+ *  at a time when a SIMD backend is available. */
+void GenerateIndexHashes(const eh_HashState& base_state, const eh_index* g, size_t count,
+                         unsigned char* hashes, size_t hLen);
+/** As GenerateIndexHashes, applying the N&K summation on chains that use it. */
+void GenerateHashes(const eh_HashState& base_state, const eh_index* g, size_t count,
+                    unsigned char* hashes, size_t hLen, size_t N);
+
 template<size_t WIDTH>
 class StepRow
 {
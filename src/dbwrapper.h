@@ -52,6 +52,12 @@ public:
      */
     CDBBatch(const CDBWrapper &_parent) : parent(_parent) { };
 
+    /** Drop the queued changes, e.g. after the batch was written */
+    void Clear()
+    {
+        batch.Clear();
+    }
+
     template <typename K, typename V>
     void Write(const K& key, const V& value)
     {
@@ -78,6 +84,18 @@ public:
 
         batch.Delete(slKey);
     }
+
+    /** Queue a record whose key and value are already serialized */
+    void WriteRaw(const std::string& key, const std::string& value)
+    {
+        batch.Put(leveldb::Slice(key), leveldb::Slice(value));
+    }
+
+    /** Queue the removal of a record whose key is already serialized */
+    void EraseRaw(const std::string& key)
+    {
+        batch.Delete(leveldb::Slice(key));
+    }
 };
 
 class CDBIterator
@@ -152,6 +170,16 @@ public:
         return piter->value().size();
     }
 
+    /** @returns the serialized key of the current record */
+    std::string GetKeyRaw() {
+        return piter->key().ToString();
+    }
+
+    /** @returns the serialized value of the current record */
+    std::string GetValueRaw() {
+        return piter->value().ToString();
+    }
+
 };
 
 /****
@@ -24,6 +24,7 @@
 
 #include "init.h"
 #include "crypto/common.h"
+#include "crypto/blake2b_multi.h"
 #include "primitives/block.h"
 #include "addrman.h"
 #include "amount.h"
@@ -48,6 +49,7 @@
 #include "metrics.h"
 #include "miner.h"
 #include "net.h"
+#include "netpoller.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/standard.h"
@@ -58,6 +60,7 @@
 #include "util.h"
 #include "utilmoneystr.h"
 #include "validationinterface.h"
+#include "cc/CCassetsorderbook.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
@@ -104,6 +107,9 @@ using namespace std;
 #include "komodo_gateway.h"
 #include "rpc/net.h"
 extern void ThreadSendAlert();
+extern void NSPV_cache_load();
+extern void NSPV_cache_save();
+extern CAssetsOrderBook assetsOrderBook;
 //extern bool komodo_dailysnapshot(int32_t height);  //todo remove
 //extern int32_t KOMODO_SNAPSHOT_INTERVAL;
 
@@ -201,10 +207,18 @@ public:
             abort();
         }
     }
+    bool GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const {
+        try {
+            return CCoinsViewBacked::GetCoin(outpoint, coin);
+        } catch(const std::runtime_error& e) {
+            uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
+            LogPrintf("Error reading from database: %s\n", e.what());
+            abort();
+        }
+    }
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -255,6 +269,9 @@ void Shutdown()
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
 
+    if ( KOMODO_NSPV_SUPERLITE )
+        NSPV_cache_save();
+
     if (fFeeEstimatesInitialized)
     {
         boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
@@ -385,6 +402,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-assumenotarized=<hex>", strprintf(_("Skip the script and CryptoCondition verification of this notarized block and its ancestors once the best header chain, through the last checkpoint, has %d headers above it (default: none)"), ASSUMENOTARIZED_MIN_DEPTH));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 288));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
@@ -402,7 +420,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-mempooltxinputlimit=<n>", _("[DEPRECATED FROM OVERWINTER] Set the maximum number of transparent inputs in a transaction that the mempool will accept (default: 0 = no limit applied)"));
-    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-mmapblockfiles=<n>", strprintf(_("Read transactions, blocks and undo data of up to <n> finalized blk/rev files through memory mappings (0 = disabled, default: %d)"), DEFAULT_MMAP_BLOCK_FILES));
+#endif
+    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script and header verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef _WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "komodod.pid"));
@@ -418,6 +439,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-ccindex", strprintf(_("Maintain an index of the CC transactions by evalcode and funcid, used by the CC list calls (default: %u)"), DEFAULT_CCINDEX));
+    strUsage += HelpMessageOpt("-tokenindex", strprintf(_("Maintain the token balances of the CC addresses and the token supplies, used by tokenbalance and tokeninfo (default: %u)"), DEFAULT_TOKENINDEX));
+    strUsage += HelpMessageOpt("-oracleindex", strprintf(_("Maintain an index of the oracle data samples by oracle and publisher, used by oraclessamples and the price in oraclesinfo (default: %u)"), DEFAULT_ORACLEINDEX));
+    strUsage += HelpMessageOpt("-gatewaysindex", strprintf(_("Maintain an index of the gateways deposits and withdraws by bind and lifecycle stage, used by the gateways pending and processed lists (default: %u)"), DEFAULT_GATEWAYSINDEX));
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
     strUsage += HelpMessageOpt("-asmap=<file>", strprintf("Specify asn mapping used for bucketing of the peers (default: %s). Relative paths will be prefixed by the net-specific datadir location.", DEFAULT_ASMAP_FILENAME));
@@ -435,11 +460,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), DEFAULT_MAX_PEER_CONNECTIONS));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-netpoller=<backend>", strprintf(_("Wait for socket events with <backend>: %s; select limits the connections to %u (default: %s)"),
+        CSocketPoller::GetAvailableNames(), FD_SETSIZE, CSocketPoller::GetDefaultName()));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with Bloom filters (default: %u)"), 1));
     strUsage += HelpMessageOpt("-nspv_msg", strprintf(_("Enable NSPV messages processing (default: %u)"), DEFAULT_NSPV_PROCESSING));
+    strUsage += HelpMessageOpt("-nspvthreads=<n>", strprintf(_("Serve NSPV requests with <n> threads, 0 serves them with the other messages (0-%d, default: %d)"), MAX_NSPV_THREADS, DEFAULT_NSPV_THREADS));
     if (showDebug)
         strUsage += HelpMessageOpt("-enforcenodebloom", strprintf("Enforce minimum protocol version to limit use of Bloom filters (default: %u)", 0));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 7770, 17770));
@@ -951,6 +979,27 @@ bool AttemptDatabaseOpen(size_t nBlockTreeDBCache, bool dbCompression, size_t db
                 CleanupBlockRevFiles();
         }
 
+        // Record the format before upgrading, so that a partly upgraded database is not taken for an older format
+        int nCoinsFormat;
+        if (!pblocktree->ReadCoinsFormat(nCoinsFormat)) {
+            strLoadError = _("Error reading block database");
+            return false;
+        }
+        if (nCoinsFormat > COINS_DB_FORMAT) {
+            strLoadError = _("The chainstate database was written by a newer version");
+            return false;
+        }
+        if (nCoinsFormat < COINS_DB_FORMAT && !pblocktree->WriteCoinsFormat(COINS_DB_FORMAT)) {
+            strLoadError = _("Error writing to block database");
+            return false;
+        }
+
+        uiInterface.InitMessage(_("Upgrading UTXO database..."));
+        if (!pcoinsdbview->Upgrade()) {
+            strLoadError = _("Error upgrading chainstate database");
+            return false;
+        }
+
         if (!LoadBlockIndex(fReindex)) {
             strLoadError = _("Error loading block database");
             return false;
@@ -1194,11 +1243,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             LogPrintf("%s: parameter interaction: -zapwallettxes=<mode> -> setting -rescan=1\n", __func__);
     }
 
+    std::string strNetPoller = GetArg("-netpoller", "");
+    if (!SetSocketPoller(strNetPoller))
+        return InitError(strprintf(_("Unknown or unavailable -netpoller backend: '%s'"), strNetPoller));
+
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     //fprintf(stderr,"nMaxConnections %d\n",nMaxConnections);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    if (SocketPollerLimitedToSelectable())
+        nMaxConnections = std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
+    nMaxConnections = std::max(nMaxConnections, 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     //fprintf(stderr,"nMaxConnections %d FD_SETSIZE.%d nBind.%d expr.%d \n",nMaxConnections,FD_SETSIZE,nBind,(int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
@@ -1258,6 +1313,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", true);
+    hashAssumeNotarized = uint256S(GetArg("-assumenotarized", "0"));
+    if (!hashAssumeNotarized.IsNull())
+        LogPrintf("Assuming ancestors of notarized block %s have valid scripts\n", hashAssumeNotarized.GetHex());
 
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
@@ -1439,6 +1497,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string blake2b_algo = Blake2bMultiAutoDetect();
+    LogPrintf("Using the '%s' multi-lane BLAKE2b implementation\n", blake2b_algo);
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
 
@@ -1491,6 +1551,22 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // Received headers are Equihash-checked by a pool of the same size
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderCheck);
+        // Coins spent by blocks about to be connected are read ahead by a pool of the same size
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadCoinsPrefetch);
+        // Blocks to connect during initial block download are read and prepared ahead
+        for (int i=0; i<std::min(nScriptCheckThreads-1, 4); i++)
+            threadGroup.create_thread(&ThreadBlockReadAhead);
+    }
+
+    if (GetBoolArg("-nspv_msg", DEFAULT_NSPV_PROCESSING)) {
+        nNSPVThreads = std::max(0, std::min((int)GetArg("-nspvthreads", DEFAULT_NSPV_THREADS), MAX_NSPV_THREADS));
+        LogPrintf("Using %u threads for NSPV requests\n", nNSPVThreads);
+        for (int i=0; i<nNSPVThreads; i++)
+            threadGroup.create_thread(&ThreadNSPVRequests);
     }
 
     // Start the lightweight task scheduler thread
@@ -1671,6 +1747,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     BOOST_FOREACH(const std::string& strDest, mapMultiArgs["-seednode"])
         AddOneShot(strDest);
 
+    // kept up to date from the blocks and the mempool once tokenorders loads it
+    if (ASSETCHAINS_CC != 0)
+        RegisterValidationInterface(&assetsOrderBook);
+
 #if ENABLE_ZMQ
     pzmqNotificationInterface = CZMQNotificationInterface::CreateWithArguments(mapArgs);
 
@@ -1698,6 +1778,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     {
         std::vector<boost::filesystem::path> vImportFiles;
         threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+        NSPV_cache_load();
         StartNode(threadGroup, scheduler);
         pcoinsTip = new CCoinsViewCache(pcoinscatcher);
         InitBlockIndex();
@@ -1743,6 +1824,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
+    int nMappedBlockFiles = GetArg("-mmapblockfiles", DEFAULT_MMAP_BLOCK_FILES);
+    SetMappedBlockFiles(nMappedBlockFiles);
+    if (nMappedBlockFiles > 0)
+        LogPrintf("* Mapping up to %d finalized block and undo files in memory\n", nMappedBlockFiles);
 
     if ( !fReindex )
     {
@@ -1764,6 +1849,42 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             fprintf(stderr,"set spentindex, will reindex. could take a while.\n");
             fReindex = true;
         }
+        bool fCCIndex = GetBoolArg("-ccindex", DEFAULT_CCINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("ccindex", checkval);
+        if ( checkval != fCCIndex && fCCIndex != 0 )
+        {
+            pblocktree->WriteFlag("ccindex", fCCIndex);
+            fprintf(stderr,"set ccindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+        bool fTokenIndex = GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("tokenindex", checkval);
+        if ( checkval != fTokenIndex && fTokenIndex != 0 )
+        {
+            pblocktree->WriteFlag("tokenindex", fTokenIndex);
+            fprintf(stderr,"set tokenindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+        bool fOracleIndex = GetBoolArg("-oracleindex", DEFAULT_ORACLEINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("oracleindex", checkval);
+        if ( checkval != fOracleIndex && fOracleIndex != 0 )
+        {
+            pblocktree->WriteFlag("oracleindex", fOracleIndex);
+            fprintf(stderr,"set oracleindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
+        bool fGatewaysIndex = GetBoolArg("-gatewaysindex", DEFAULT_GATEWAYSINDEX);
+        checkval = false;
+        pblocktree->ReadFlag("gatewaysindex", checkval);
+        if ( checkval != fGatewaysIndex && fGatewaysIndex != 0 )
+        {
+            pblocktree->WriteFlag("gatewaysindex", fGatewaysIndex);
+            fprintf(stderr,"set gatewaysindex, will reindex. could take a while.\n");
+            fReindex = true;
+        }
     }
 
     // ************
@@ -2044,6 +2165,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+    // returns at once unless an older address index is missing its balances
+    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "addrbal", &ThreadAddressBalanceIndex));
     {
         CBlockIndex *tip = nullptr;
         {
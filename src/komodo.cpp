@@ -198,6 +198,69 @@ int32_t komodo_parsestatefiledata(struct komodo_state *sp,uint8_t *filedata,long
     return func;
 }
 
+/****
+ * @brief Get the state file events up to a height
+ * @param[in] height the last height to include
+ * @param[out] events the events, in state file format
+ * @returns true on success
+ */
+bool komodo_stateevents(int32_t height, std::vector<uint8_t> &events)
+{
+    char fname[MAX_STATEFNAME+1],symbol[KOMODO_ASSETCHAIN_MAXLEN],dest[KOMODO_ASSETCHAIN_MAXLEN];
+
+    events.clear();
+    if ( komodo_stateptr(symbol,dest) == nullptr )
+        return false;
+    if ( fp != nullptr )
+        fflush(fp);
+    komodo_statefname(fname, chainName.symbol().c_str(), KOMODO_STATE_FILENAME);
+    std::vector<uint8_t> filedata;
+    FILE *statefp = fopen(fname,"rb");
+    if ( statefp != nullptr )
+    {
+        uint8_t buf[65536];
+        size_t len;
+        while ( (len= fread(buf,1,sizeof(buf),statefp)) > 0 )
+            filedata.insert(filedata.end(), buf, buf+len);
+        fclose(statefp);
+    }
+
+    // only parse the events to find their size, nothing is applied to the state
+    long fpos = 0, datalen = filedata.size();
+    try
+    {
+        while ( fpos < datalen )
+        {
+            long start = fpos;
+            int32_t func = filedata[fpos++];
+            int32_t ht;
+            mem_read(ht, filedata.data(), fpos, datalen);
+            if ( func == 'P' )
+                komodo::event_pubkeys pk(filedata.data(), fpos, datalen, ht);
+            else if ( func == 'N' || func == 'M' )
+                komodo::event_notarized ntz(filedata.data(), fpos, datalen, ht, dest, func == 'M');
+            else if ( func == 'U' )
+                komodo::event_u u(filedata.data(), fpos, datalen, ht);
+            else if ( func == 'K' || func == 'T' )
+                komodo::event_kmdheight kmd_ht(filedata.data(), fpos, datalen, ht, func == 'T');
+            else if ( func == 'R' )
+                komodo::event_opreturn opret(filedata.data(), fpos, datalen, ht);
+            else if ( func == 'V' )
+                komodo::event_pricefeed pf(filedata.data(), fpos, datalen, ht);
+            else if ( func != 'D' && func != 'B' )
+                throw komodo::parse_error("Unable to parse file data: unknown event");
+            if ( ht <= height )
+                events.insert(events.end(), filedata.begin()+start, filedata.begin()+fpos);
+        }
+    }
+    catch( const komodo::parse_error& pe )
+    {
+        LogPrintf("%s: unable to parse %s: %s\n", __func__, KOMODO_STATE_FILENAME, pe.what());
+        return false;
+    }
+    return true;
+}
+
 void komodo_stateupdate(int32_t height,uint8_t notarypubs[][33],uint8_t numnotaries,
         uint8_t notaryid,uint256 txhash,uint32_t *pvals,
         uint8_t numpvals,int32_t KMDheight,uint32_t KMDtimestamp,uint64_t opretvalue,
@@ -32,6 +32,7 @@
 //#include "komodo_events.h"
 //#include "komodo_ccdata.h"
 #include <cstdint>
+#include <vector>
 
 const char KOMODO_STATE_FILENAME[] = "komodoevents";
 
@@ -43,6 +44,14 @@ int32_t komodo_currentheight();
 
 int32_t komodo_parsestatefiledata(struct komodo_state *sp,uint8_t *filedata,long *fposp,long datalen,const char *symbol, const char *dest);
 
+/****
+ * @brief Get the state file events up to a height
+ * @param[in] height the last height to include
+ * @param[out] events the events, in state file format
+ * @returns true on success
+ */
+bool komodo_stateevents(int32_t height, std::vector<uint8_t> &events);
+
 void komodo_stateupdate(int32_t height,uint8_t notarypubs[][33],uint8_t numnotaries,uint8_t notaryid,
         uint256 txhash,uint32_t *pvals,uint8_t numpvals,int32_t KMDheight,uint32_t KMDtimestamp,
         uint64_t opretvalue,uint8_t *opretbuf,uint16_t opretlen,uint16_t vout,uint256 MoM,int32_t MoMdepth);
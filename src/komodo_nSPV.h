@@ -196,6 +196,53 @@ void NSPV_txidsresp_copy(struct NSPV_txidsresp *dest,struct NSPV_txidsresp *ptr)
     }
 }
 
+int32_t NSPV_rwcursor(int32_t rwflag,uint8_t *serialized,uint8_t *cursorlenp,uint8_t *cursor)
+{
+    int32_t len = 0;
+    len += iguana_rwnum(rwflag,&serialized[len],sizeof(*cursorlenp),cursorlenp);
+    if ( *cursorlenp > NSPV_MAXCURSORLEN )
+        *cursorlenp = 0;
+    if ( rwflag != 0 )
+        memcpy(&serialized[len],cursor,*cursorlenp);
+    else memcpy(cursor,&serialized[len],*cursorlenp);
+    len += *cursorlenp;
+    return(len);
+}
+
+int32_t NSPV_rwutxospage(int32_t rwflag,uint8_t *serialized,struct NSPV_utxospage *ptr)
+{
+    int32_t len = 0;
+    len += NSPV_rwutxosresp(rwflag,&serialized[len],&ptr->U);
+    len += NSPV_rwcursor(rwflag,&serialized[len],&ptr->cursorlen,ptr->cursor);
+    return(len);
+}
+
+void NSPV_utxospage_purge(struct NSPV_utxospage *ptr)
+{
+    if ( ptr != 0 )
+    {
+        NSPV_utxosresp_purge(&ptr->U);
+        memset(ptr,0,sizeof(*ptr));
+    }
+}
+
+int32_t NSPV_rwtxidspage(int32_t rwflag,uint8_t *serialized,struct NSPV_txidspage *ptr)
+{
+    int32_t len = 0;
+    len += NSPV_rwtxidsresp(rwflag,&serialized[len],&ptr->T);
+    len += NSPV_rwcursor(rwflag,&serialized[len],&ptr->cursorlen,ptr->cursor);
+    return(len);
+}
+
+void NSPV_txidspage_purge(struct NSPV_txidspage *ptr)
+{
+    if ( ptr != 0 )
+    {
+        NSPV_txidsresp_purge(&ptr->T);
+        memset(ptr,0,sizeof(*ptr));
+    }
+}
+
 int32_t NSPV_rwmempoolresp(int32_t rwflag,uint8_t *serialized,struct NSPV_mempoolresp *ptr)
 {
     int32_t i,len = 0;
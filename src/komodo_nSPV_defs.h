@@ -53,6 +53,12 @@
 #define NSPV_CC_TXIDS 16
 #define NSPV_REMOTERPC 0x14
 #define NSPV_REMOTERPCRESP 0x15
+#define NSPV_UTXOSPAGE 0x16
+#define NSPV_UTXOSPAGERESP 0x17
+#define NSPV_TXIDSPAGE 0x18
+#define NSPV_TXIDSPAGERESP 0x19
+#define NSPV_MAXPAGE 1024
+#define NSPV_MAXCURSORLEN 64
 
 extern int32_t KOMODO_NSPV;
 
@@ -112,6 +118,21 @@ struct NSPV_txidsresp
     uint16_t numtxids,CCflag;
 };
 
+// a page of utxos or txids, with the opaque cursor to request the next page from, empty after the last page
+struct NSPV_utxospage
+{
+    struct NSPV_utxosresp U;
+    uint8_t cursorlen;
+    uint8_t cursor[NSPV_MAXCURSORLEN];
+};
+
+struct NSPV_txidspage
+{
+    struct NSPV_txidsresp T;
+    uint8_t cursorlen;
+    uint8_t cursor[NSPV_MAXCURSORLEN];
+};
+
 struct NSPV_mempoolresp
 {
     uint256 *txids;
@@ -20,6 +20,7 @@
 // NSPV_get... functions need to return the exact serialized length, which is the size of the structure minus size of pointers, plus size of allocated data
 
 #include "notarisationdb.h"
+#include "nspvcache.h"
 #include "rpc/server.h"
 #include "komodo_bitcoind.h"
 
@@ -159,6 +160,7 @@ int32_t NSPV_getaddressutxos(struct NSPV_utxosresp *ptr,char *coinaddr,bool isCC
     int64_t total = 0,interest=0; uint32_t locktime; int32_t ind=0,tipheight,maxlen,txheight,n = 0,len = 0;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
     SetCCunspents(unspentOutputs,coinaddr,isCC);
+    LOCK(cs_main); // the tip and the accrued interest read chainActive, the address index was read without it
     maxlen = MAX_BLOCK_SIZE(tipheight) - 512;
     maxlen /= sizeof(*ptr->utxos);
     strncpy(ptr->coinaddr,coinaddr,sizeof(ptr->coinaddr)-1);
@@ -334,7 +336,10 @@ int32_t NSPV_getccmoduleutxos(struct NSPV_utxosresp *ptr, char *coinaddr, int64_
     ptr->numutxos = 0;
     strncpy(ptr->coinaddr, coinaddr, sizeof(ptr->coinaddr) - 1);
     ptr->CCflag = 1;
-    tipheight = chainActive.Tip()->nHeight;  
+    {
+        LOCK(cs_main);
+        tipheight = chainActive.Tip()->nHeight;
+    }
     ptr->nodeheight = tipheight; // will be checked in libnspv
     //}
    
@@ -442,7 +447,10 @@ int32_t NSPV_getaddresstxids(struct NSPV_txidsresp *ptr,char *coinaddr,bool isCC
     int32_t maxlen,txheight,ind=0,n = 0,len = 0; CTransaction tx; uint256 hashBlock;
     std::vector<std::pair<CAddressIndexKey, CAmount> > txids;
     SetCCtxids(txids,coinaddr,isCC);
-    ptr->nodeheight = chainActive.Tip()->nHeight;
+    {
+        LOCK(cs_main);
+        ptr->nodeheight = chainActive.Tip()->nHeight;
+    }
     maxlen = MAX_BLOCK_SIZE(ptr->nodeheight) - 512;
     maxlen /= sizeof(*ptr->txids);
     strncpy(ptr->coinaddr,coinaddr,sizeof(ptr->coinaddr)-1);
@@ -484,6 +492,112 @@ int32_t NSPV_getaddresstxids(struct NSPV_txidsresp *ptr,char *coinaddr,bool isCC
     return(0);
 }
 
+// cursors are the address index key of the last record read, without the address part
+
+template <typename Key>
+int32_t NSPV_setcursor(uint8_t *cursor,const Key &key)
+{
+    CDataStream ss(SER_DISK,CLIENT_VERSION);
+    ss << key;
+    ss.ignore(CAddressIndexIteratorKey().GetSerializeSize(SER_DISK,CLIENT_VERSION));
+    if ( ss.size() > NSPV_MAXCURSORLEN )
+        return(0);
+    memcpy(cursor,&ss[0],ss.size());
+    return((int32_t)ss.size());
+}
+
+template <typename Key>
+bool NSPV_getcursor(Key &key,int32_t type,uint160 hashBytes,const uint8_t *cursor,int32_t cursorlen)
+{
+    CDataStream ss(SER_DISK,CLIENT_VERSION);
+    ss << CAddressIndexIteratorKey(type,hashBytes);
+    if ( cursorlen + ss.size() != key.GetSerializeSize(SER_DISK,CLIENT_VERSION) )
+        return(false);
+    ss.write((const char *)cursor,cursorlen);
+    ss >> key;
+    return(true);
+}
+
+// one page of the utxos of an address, read from the address index after the cursor
+int32_t NSPV_getaddressutxospage(struct NSPV_utxospage *ptr,char *coinaddr,bool isCC,uint32_t filter,int32_t maxcount,uint8_t *cursor,int32_t cursorlen)
+{
+    int64_t total = 0,interest = 0; uint32_t locktime; int32_t type = 0,txheight,tipheight,ind = 0; uint160 hashBytes; bool fMore;
+    CAddressUnspentKey keyAfter; std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    if ( CBitcoinAddress(std::string(coinaddr)).GetIndexKey(hashBytes,type,isCC) == 0 )
+        return(0);
+    if ( cursorlen != 0 && NSPV_getcursor(keyAfter,type,hashBytes,cursor,cursorlen) == 0 )
+        return(0);
+    if ( maxcount <= 0 || maxcount > NSPV_MAXPAGE )
+        maxcount = NSPV_MAXPAGE;
+    if ( GetAddressUnspentPage(hashBytes,type,cursorlen != 0 ? &keyAfter : 0,maxcount,unspentOutputs,fMore) == 0 )
+        return(0);
+    LOCK(cs_main); // the tip and the accrued interest read chainActive, the page was read without it
+    tipheight = chainActive.Tip()->nHeight;
+    strncpy(ptr->U.coinaddr,coinaddr,sizeof(ptr->U.coinaddr)-1);
+    ptr->U.CCflag = isCC;
+    ptr->U.filter = filter;
+    ptr->U.nodeheight = tipheight;
+    if ( unspentOutputs.size() > 0 )
+        ptr->U.utxos = (struct NSPV_utxoresp *)calloc(unspentOutputs.size(),sizeof(*ptr->U.utxos));
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    {
+        if ( myIsutxo_spentinmempool(ignoretxid,ignorevin,it->first.txhash,(int32_t)it->first.index) != 0 )
+            continue;
+        ptr->U.utxos[ind].txid = it->first.txhash;
+        ptr->U.utxos[ind].vout = (int32_t)it->first.index;
+        ptr->U.utxos[ind].satoshis = it->second.satoshis;
+        ptr->U.utxos[ind].height = it->second.blockHeight;
+        if ( chainName.isKMD() && it->second.satoshis >= 10*COIN )
+        {
+            ptr->U.utxos[ind].extradata = komodo_accrued_interest(&txheight,&locktime,ptr->U.utxos[ind].txid,ptr->U.utxos[ind].vout,ptr->U.utxos[ind].height,ptr->U.utxos[ind].satoshis,tipheight);
+            interest += ptr->U.utxos[ind].extradata;
+        }
+        total += it->second.satoshis;
+        ind++;
+    }
+    ptr->U.numutxos = ind;
+    ptr->U.total = total;
+    ptr->U.interest = interest;
+    // the cursor is the last record read, spent in mempool or not
+    ptr->cursorlen = fMore ? NSPV_setcursor(ptr->cursor,unspentOutputs.back().first) : 0;
+    return((int32_t)(sizeof(ptr->U) + sizeof(*ptr->U.utxos)*ptr->U.numutxos - sizeof(ptr->U.utxos)) + 1 + ptr->cursorlen);
+}
+
+// one page of the address index of an address, oldest first, after the cursor
+int32_t NSPV_getaddresstxidspage(struct NSPV_txidspage *ptr,char *coinaddr,bool isCC,uint32_t filter,int32_t maxcount,uint8_t *cursor,int32_t cursorlen)
+{
+    int32_t type = 0,ind = 0; uint160 hashBytes; bool fMore;
+    CAddressIndexKey keyAfter; std::vector<std::pair<CAddressIndexKey, CAmount> > txids;
+    if ( CBitcoinAddress(std::string(coinaddr)).GetIndexKey(hashBytes,type,isCC) == 0 )
+        return(0);
+    if ( cursorlen != 0 && NSPV_getcursor(keyAfter,type,hashBytes,cursor,cursorlen) == 0 )
+        return(0);
+    if ( maxcount <= 0 || maxcount > NSPV_MAXPAGE )
+        maxcount = NSPV_MAXPAGE;
+    if ( GetAddressIndexPage(hashBytes,type,cursorlen != 0 ? &keyAfter : 0,maxcount,txids,fMore) == 0 )
+        return(0);
+    strncpy(ptr->T.coinaddr,coinaddr,sizeof(ptr->T.coinaddr)-1);
+    ptr->T.CCflag = isCC;
+    ptr->T.filter = filter;
+    {
+        LOCK(cs_main);
+        ptr->T.nodeheight = chainActive.Tip()->nHeight;
+    }
+    if ( txids.size() > 0 )
+        ptr->T.txids = (struct NSPV_txidresp *)calloc(txids.size(),sizeof(*ptr->T.txids));
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=txids.begin(); it!=txids.end(); it++)
+    {
+        ptr->T.txids[ind].txid = it->first.txhash;
+        ptr->T.txids[ind].vout = (int32_t)it->first.index;
+        ptr->T.txids[ind].satoshis = (int64_t)it->second;
+        ptr->T.txids[ind].height = (int64_t)it->first.blockHeight;
+        ind++;
+    }
+    ptr->T.numtxids = ind;
+    ptr->cursorlen = fMore ? NSPV_setcursor(ptr->cursor,txids.back().first) : 0;
+    return((int32_t)(sizeof(ptr->T) + sizeof(*ptr->T.txids)*ptr->T.numtxids - sizeof(ptr->T.txids)) + 1 + ptr->cursorlen);
+}
+
 int32_t NSPV_mempoolfuncs(bits256 *satoshisp,int32_t *vindexp,std::vector<uint256> &txids,char *coinaddr,bool isCC,uint8_t funcid,uint256 txid,int32_t vout)
 {
     int32_t num = 0,vini = 0,vouti = 0; uint8_t evalcode=0,func=0;  std::vector<uint8_t> vopret; char destaddr[64];
@@ -625,7 +739,10 @@ int32_t NSPV_mempoolfuncs(bits256 *satoshisp,int32_t *vindexp,std::vector<uint25
 int32_t NSPV_mempooltxids(struct NSPV_mempoolresp *ptr,char *coinaddr,uint8_t isCC,uint8_t funcid,uint256 txid,int32_t vout)
 {
     std::vector<uint256> txids; bits256 satoshis; uint256 tmp,tmpdest; int32_t i,len = 0;
-    ptr->nodeheight = chainActive.Tip()->nHeight;
+    {
+        LOCK(cs_main);
+        ptr->nodeheight = chainActive.Tip()->nHeight;
+    }
     strncpy(ptr->coinaddr,coinaddr,sizeof(ptr->coinaddr)-1);
     ptr->CCflag = isCC;
     ptr->txid = txid;
@@ -876,15 +993,74 @@ int32_t NSPV_getspentinfo(struct NSPV_spentinfo *ptr,uint256 txid,int32_t vout)
     return(len);
 }
 
+bool NSPV_ischeapreq(uint8_t reqtype) // served before the other requests by the nSPV request threads
+{
+    switch ( reqtype )
+    {
+        case NSPV_INFO: case NSPV_NTZS: case NSPV_NTZSPROOF: case NSPV_SPENTINFO: case NSPV_BROADCAST:
+            return(true);
+        default:
+            return(false);
+    }
+}
+
+bool NSPV_needschainlock(uint8_t reqtype) // served with cs_main held, the address requests only lock it around their chain reads
+{
+    switch ( reqtype )
+    {
+        case NSPV_INFO: case NSPV_NTZS: case NSPV_NTZSPROOF: case NSPV_TXPROOF: case NSPV_SPENTINFO: case NSPV_BROADCAST:
+            return(true);
+        default:
+            return(false);
+    }
+}
+
+#define NSPV_CACHE_MAXBYTES (32 * 1024 * 1024)
+#define NSPV_CACHE_FINALSECONDS (6 * 3600)
+
+static CNSPVResponseCache nspvresponsecache(NSPV_CACHE_MAXBYTES,NSPV_CACHE_FINALSECONDS);
+
+bool NSPV_iscachedreq(uint8_t reqtype) // the same answer for every light client until the next block
+{
+    switch ( reqtype )
+    {
+        case NSPV_INFO: case NSPV_NTZS: case NSPV_NTZSPROOF: case NSPV_TXPROOF:
+            return(true);
+        default:
+            return(false);
+    }
+}
+
+void NSPV_cacheresponse(const std::vector<uint8_t> &request,const std::vector<uint8_t> &response,int32_t anchorheight,uint32_t timestamp)
+{
+    int32_t prevMoMheight,ntzheight; uint256 ntzhash,ntztxid;
+    // only notarized history can no longer change, anything else is answered again for the next tip
+    ntzheight = komodo_notarized_height(&prevMoMheight,&ntzhash,&ntztxid);
+    if ( anchorheight <= 0 || anchorheight > ntzheight )
+        anchorheight = -1;
+    LOCK(cs_main);
+    nspvresponsecache.Put(request,response,chainActive.Tip(),anchorheight,timestamp);
+}
+
 void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request) // received a request
 {
-    int32_t len,slen,ind,reqheight,n; std::vector<uint8_t> response; uint32_t timestamp = (uint32_t)time(NULL);
+    int32_t len,slen,ind,reqheight,n; std::vector<uint8_t> response; uint32_t timestamp = (uint32_t)time(NULL); CBlockIndex *tip;
     if ( (len= request.size()) > 0 )
     {
+        {
+            LOCK(cs_main);
+            tip = chainActive.Tip();
+        }
         if ( (ind= request[0]>>1) >= sizeof(pfrom->prevtimes)/sizeof(*pfrom->prevtimes) )
             ind = (int32_t)(sizeof(pfrom->prevtimes)/sizeof(*pfrom->prevtimes)) - 1;
         if ( pfrom->prevtimes[ind] > timestamp )
             pfrom->prevtimes[ind] = 0;
+        if ( NSPV_iscachedreq(request[0]) != 0 && timestamp > pfrom->prevtimes[ind] && nspvresponsecache.Get(request,tip,timestamp,response) != 0 )
+        {
+            pfrom->PushMessage("nSPV",response);
+            pfrom->prevtimes[ind] = timestamp;
+            return;
+        }
         if ( request[0] == NSPV_INFO ) // info
         {
             //fprintf(stderr,"check info %u vs %u, ind.%d\n",timestamp,pfrom->prevtimes[ind],ind);
@@ -906,6 +1082,7 @@ void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request) // received a req
                         //fprintf(stderr,"send info resp to id %d\n",(int32_t)pfrom->id);
                         pfrom->PushMessage("nSPV",response);
                         pfrom->prevtimes[ind] = timestamp;
+                        NSPV_cacheresponse(request,response,-1,timestamp);
                     }
                     NSPV_inforesp_purge(&I);
                 }
@@ -993,6 +1170,56 @@ void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request) // received a req
                 } else fprintf(stderr,"len.%d req1.%d\n",len,request[1]);
             }
         }
+        else if ( request[0] == NSPV_UTXOSPAGE || request[0] == NSPV_TXIDSPAGE )
+        {
+            // addrlen, addr, isCC, filter, maxcount, cursorlen, cursor
+            if ( timestamp > pfrom->prevtimes[ind] && len > 2 && request[1] < 64 && len > 2+request[1]+1+sizeof(uint32_t)+sizeof(uint16_t) )
+            {
+                char coinaddr[64]; uint8_t isCC,cursorlen; uint32_t filter; uint16_t maxcount;
+                n = 2;
+                memcpy(coinaddr,&request[n],request[1]), n += request[1];
+                coinaddr[request[1]] = 0;
+                isCC = (request[n++] != 0);
+                n += iguana_rwnum(0,&request[n],sizeof(filter),&filter);
+                n += iguana_rwnum(0,&request[n],sizeof(maxcount),&maxcount);
+                cursorlen = request[n++];
+                if ( cursorlen <= NSPV_MAXCURSORLEN && len == n+cursorlen )
+                {
+                    if ( request[0] == NSPV_UTXOSPAGE )
+                    {
+                        struct NSPV_utxospage U;
+                        memset(&U,0,sizeof(U));
+                        if ( (slen= NSPV_getaddressutxospage(&U,coinaddr,isCC,filter,maxcount,&request[n],cursorlen)) > 0 )
+                        {
+                            response.resize(1 + slen);
+                            response[0] = NSPV_UTXOSPAGERESP;
+                            if ( NSPV_rwutxospage(1,&response[1],&U) == slen )
+                            {
+                                pfrom->PushMessage("nSPV",response);
+                                pfrom->prevtimes[ind] = timestamp;
+                            }
+                        }
+                        NSPV_utxospage_purge(&U);
+                    }
+                    else
+                    {
+                        struct NSPV_txidspage T;
+                        memset(&T,0,sizeof(T));
+                        if ( (slen= NSPV_getaddresstxidspage(&T,coinaddr,isCC,filter,maxcount,&request[n],cursorlen)) > 0 )
+                        {
+                            response.resize(1 + slen);
+                            response[0] = NSPV_TXIDSPAGERESP;
+                            if ( NSPV_rwtxidspage(1,&response[1],&T) == slen )
+                            {
+                                pfrom->PushMessage("nSPV",response);
+                                pfrom->prevtimes[ind] = timestamp;
+                            }
+                        }
+                        NSPV_txidspage_purge(&T);
+                    }
+                }
+            }
+        }
         else if ( request[0] == NSPV_MEMPOOL )
         {
             if ( timestamp > pfrom->prevtimes[ind] )
@@ -1047,6 +1274,8 @@ void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request) // received a req
                         {
                             pfrom->PushMessage("nSPV",response);
                             pfrom->prevtimes[ind] = timestamp;
+                            // the bracket is final once the next notarization is found
+                            NSPV_cacheresponse(request,response,N.nextntz.height != 0 ? std::max(N.nextntz.height,N.nextntz.txidheight) : -1,timestamp);
                         }
                         NSPV_ntzsresp_purge(&N);
                     }
@@ -1072,6 +1301,7 @@ void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request) // received a req
                         {
                             pfrom->PushMessage("nSPV",response);
                             pfrom->prevtimes[ind] = timestamp;
+                            NSPV_cacheresponse(request,response,std::max(P.common.nextht,std::max(P.prevtxidht,P.nexttxidht)),timestamp);
                         }
                         NSPV_ntzsproofresp_purge(&P);
                     } else fprintf(stderr,"err.%d\n",slen);
@@ -1100,6 +1330,7 @@ void komodo_nSPVreq(CNode *pfrom,std::vector<uint8_t> request) // received a req
                             //fprintf(stderr,"send response\n");
                             pfrom->PushMessage("nSPV",response);
                             pfrom->prevtimes[ind] = timestamp;
+                            NSPV_cacheresponse(request,response,-1,timestamp); // unspentvalue changes with the tip
                         }
                         NSPV_txproof_purge(&P);
                     } else fprintf(stderr,"gettxproof error.%d\n",slen);
@@ -18,7 +18,7 @@
 #define KOMODO_NSPVSUPERLITE_H
 
 // nSPV client. VERY simplistic "single threaded" networking model. for production GUI best to multithread, etc.
-// no caching, no optimizations, no reducing the number of ntzsproofs needed by detecting overlaps, etc.
+// no caching beyond the verified proofs kept in nspvcache.dat, no optimizations, no reducing the number of ntzsproofs needed by detecting overlaps, etc.
 // advantage is that it is simpler to implement and understand to create a design for a more performant version
 
 
@@ -32,6 +32,8 @@ std::string NSPV_address;
 struct NSPV_inforesp NSPV_inforesult;
 struct NSPV_utxosresp NSPV_utxosresult;
 struct NSPV_txidsresp NSPV_txidsresult;
+struct NSPV_utxospage NSPV_utxospageresult;
+struct NSPV_txidspage NSPV_txidspageresult;
 struct NSPV_mempoolresp NSPV_mempoolresult;
 struct NSPV_spentinfo NSPV_spentresult;
 struct NSPV_ntzsresp NSPV_ntzsresult;
@@ -42,6 +44,10 @@ struct NSPV_broadcastresp NSPV_broadcastresult;
 struct NSPV_ntzsresp NSPV_ntzsresp_cache[NSPV_MAXVINS];
 struct NSPV_ntzsproofresp NSPV_ntzsproofresp_cache[NSPV_MAXVINS * 2];
 struct NSPV_txproof NSPV_txproof_cache[NSPV_MAXVINS * 4];
+// when the cache entries were received, to prune the on-disk cache by age
+uint32_t NSPV_ntzsresp_cachetime[NSPV_MAXVINS];
+uint32_t NSPV_ntzsproofresp_cachetime[NSPV_MAXVINS * 2];
+uint32_t NSPV_txproof_cachetime[NSPV_MAXVINS * 4];
 
 struct NSPV_ntzsresp *NSPV_ntzsresp_find(int32_t reqheight)
 {
@@ -62,6 +68,7 @@ struct NSPV_ntzsresp *NSPV_ntzsresp_add(struct NSPV_ntzsresp *ptr)
         i = (rand() % (sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache)));
     NSPV_ntzsresp_purge(&NSPV_ntzsresp_cache[i]);
     NSPV_ntzsresp_copy(&NSPV_ntzsresp_cache[i],ptr);
+    NSPV_ntzsresp_cachetime[i] = (uint32_t)time(NULL);
     fprintf(stderr,"ADD CACHE ntzsresp req.%d\n",ptr->reqheight);
     return(&NSPV_ntzsresp_cache[i]);
 }
@@ -89,6 +96,7 @@ struct NSPV_txproof *NSPV_txproof_add(struct NSPV_txproof *ptr)
             {
                 NSPV_txproof_purge(&NSPV_txproof_cache[i]);
                 NSPV_txproof_copy(&NSPV_txproof_cache[i],ptr);
+                NSPV_txproof_cachetime[i] = (uint32_t)time(NULL);
                 return(&NSPV_txproof_cache[i]);
             }
             else if ( NSPV_txproof_cache[i].txprooflen != 0 || ptr->txprooflen == 0 )
@@ -101,6 +109,7 @@ struct NSPV_txproof *NSPV_txproof_add(struct NSPV_txproof *ptr)
         i = (rand() % (sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache)));
     NSPV_txproof_purge(&NSPV_txproof_cache[i]);
     NSPV_txproof_copy(&NSPV_txproof_cache[i],ptr);
+    NSPV_txproof_cachetime[i] = (uint32_t)time(NULL);
     fprintf(stderr,"ADD CACHE txproof %s\n",ptr->txid.GetHex().c_str());
     return(&NSPV_txproof_cache[i]);
 }
@@ -124,10 +133,225 @@ struct NSPV_ntzsproofresp *NSPV_ntzsproof_add(struct NSPV_ntzsproofresp *ptr)
         i = (rand() % (sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache)));
     NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresp_cache[i]);
     NSPV_ntzsproofresp_copy(&NSPV_ntzsproofresp_cache[i],ptr);
+    NSPV_ntzsproofresp_cachetime[i] = (uint32_t)time(NULL);
     fprintf(stderr,"ADD CACHE ntzsproof %s %s\n",ptr->prevtxid.GetHex().c_str(),ptr->nexttxid.GetHex().c_str());
     return(&NSPV_ntzsproofresp_cache[i]);
 }
 
+// on-disk cache of the notarization brackets, headers proofs and tx proofs, saved at shutdown and loaded at startup
+// everything is verified again when loaded, without the network: the headers chain and notary signatures of the
+// headers proofs (with the times of the notarized headers they carry), then the brackets and tx proofs against them
+
+#define NSPV_CACHE_FILENAME "nspvcache.dat"
+#define NSPV_CACHE_MAXAGE (7 * 24 * 3600)
+
+int32_t NSPV_ntzverify(uint8_t *data,int32_t datalen,uint256 txid,int32_t ntzheight,struct NSPV_equihdr *hdr)
+{
+    CTransaction tx; std::vector<uint8_t> opret; uint8_t elected[64][33]; int32_t height; uint256 blockhash;
+    if ( data == 0 || NSPV_txextract(tx,data,datalen) < 0 || tx.GetHash() != txid || tx.vout.size() < 2 )
+        return(-1);
+    GetOpReturnData(tx.vout[1].scriptPubKey,opret);
+    if ( opret.size() < 32*2+4 )
+        return(-2);
+    NSPV_opretextract(&height,&blockhash,chainName.ToString().c_str(),opret,txid);
+    if ( height != ntzheight || NSPV_hdrhash(hdr) != blockhash )
+        return(-3);
+    komodo_notaries(elected,height,hdr->nTime);
+    if ( NSPV_fastnotariescount(tx,elected,hdr->nTime) < 12 )
+        return(-4);
+    return(0);
+}
+
+int32_t NSPV_ntzsproof_verify(struct NSPV_ntzsproofresp *ptr)
+{
+    int32_t i;
+    if ( ptr->common.hdrs == 0 || ptr->common.numhdrs <= 0 || ptr->common.nextht-ptr->common.prevht+1 != ptr->common.numhdrs )
+        return(-1);
+    for (i=ptr->common.numhdrs-1; i>0; i--)
+        if ( NSPV_hdrhash(&ptr->common.hdrs[i-1]) != ptr->common.hdrs[i].hashPrevBlock )
+            return(-2);
+    if ( NSPV_ntzverify(ptr->prevntz,ptr->prevtxlen,ptr->prevtxid,ptr->common.prevht,&ptr->common.hdrs[0]) < 0 )
+        return(-3);
+    if ( NSPV_ntzverify(ptr->nextntz,ptr->nexttxlen,ptr->nexttxid,ptr->common.nextht,&ptr->common.hdrs[ptr->common.numhdrs-1]) < 0 )
+        return(-4);
+    return(0);
+}
+
+int32_t NSPV_ntzsresp_verify(struct NSPV_ntzsresp *ptr)
+{
+    struct NSPV_ntzsproofresp *proof;
+    if ( (proof= NSPV_ntzsproof_find(ptr->prevntz.txid,ptr->nextntz.txid)) == 0 )
+        return(-1);
+    if ( ptr->prevntz.height != proof->common.prevht || ptr->nextntz.height != proof->common.nextht )
+        return(-2);
+    return(0);
+}
+
+int32_t NSPV_txproof_verify(struct NSPV_txproof *ptr)
+{
+    CTransaction tx; std::vector<uint8_t> proof; std::vector<uint256> txids; uint256 proofroot; int32_t i;
+    if ( ptr->tx == 0 || NSPV_txextract(tx,ptr->tx,ptr->txlen) < 0 || tx.GetHash() != ptr->txid )
+        return(-1);
+    if ( ptr->txproof == 0 || ptr->txprooflen <= 0 )
+        return(-2);
+    proof.resize(ptr->txprooflen);
+    memcpy(&proof[0],ptr->txproof,ptr->txprooflen);
+    proofroot = BitcoinGetProofMerkleRoot(proof,txids);
+    if ( txids.size() == 0 || txids[0] != ptr->txid )
+        return(-3);
+    for (i=0; i<sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
+    {
+        struct NSPV_ntzsproofresp *hdrsproof = &NSPV_ntzsproofresp_cache[i];
+        if ( hdrsproof->common.hdrs != 0 && ptr->height >= hdrsproof->common.prevht && ptr->height <= hdrsproof->common.nextht )
+        {
+            if ( hdrsproof->common.hdrs[ptr->height - hdrsproof->common.prevht].hashMerkleRoot == proofroot )
+                return(0);
+        }
+    }
+    return(-4);
+}
+
+template <typename T>
+std::vector<uint8_t> NSPV_cache_serialize(int32_t (*rwfunc)(int32_t,uint8_t *,T *),T *ptr,int32_t maxlen)
+{
+    std::vector<uint8_t> data(maxlen);
+    data.resize((*rwfunc)(1,&data[0],ptr));
+    return(data);
+}
+
+void NSPV_cache_save()
+{
+    std::vector<std::pair<uint32_t,std::vector<uint8_t> > > proofs,ntzs,txproofs; uint32_t now = (uint32_t)time(NULL); int32_t i;
+    for (i=0; i<sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
+    {
+        struct NSPV_ntzsproofresp *ptr = &NSPV_ntzsproofresp_cache[i];
+        if ( ptr->common.hdrs != 0 && now - NSPV_ntzsproofresp_cachetime[i] < NSPV_CACHE_MAXAGE )
+            proofs.push_back(std::make_pair(NSPV_ntzsproofresp_cachetime[i],NSPV_cache_serialize(NSPV_rwntzsproofresp,ptr,(int32_t)(sizeof(*ptr) + sizeof(*ptr->common.hdrs)*ptr->common.numhdrs + ptr->prevtxlen + ptr->nexttxlen))));
+    }
+    for (i=0; i<sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
+    {
+        struct NSPV_ntzsresp *ptr = &NSPV_ntzsresp_cache[i];
+        if ( ptr->reqheight != 0 && now - NSPV_ntzsresp_cachetime[i] < NSPV_CACHE_MAXAGE && NSPV_ntzsresp_verify(ptr) == 0 )
+            ntzs.push_back(std::make_pair(NSPV_ntzsresp_cachetime[i],NSPV_cache_serialize(NSPV_rwntzsresp,ptr,(int32_t)sizeof(*ptr))));
+    }
+    for (i=0; i<sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
+    {
+        struct NSPV_txproof *ptr = &NSPV_txproof_cache[i];
+        if ( ptr->txlen > 0 && ptr->txprooflen > 0 && now - NSPV_txproof_cachetime[i] < NSPV_CACHE_MAXAGE )
+            txproofs.push_back(std::make_pair(NSPV_txproof_cachetime[i],NSPV_cache_serialize(NSPV_rwtxproof,ptr,(int32_t)(sizeof(*ptr) + ptr->txlen + ptr->txprooflen))));
+    }
+
+    // serialize, checksum data up to that point, then append csum
+    CDataStream ss(SER_DISK,CLIENT_VERSION);
+    ss << FLATDATA(Params().MessageStart());
+    ss << chainName.ToString();
+    ss << (int32_t)NSPV_PROTOCOL_VERSION;
+    ss << proofs << ntzs << txproofs;
+    uint256 hash = Hash(ss.begin(),ss.end());
+    ss << hash;
+
+    boost::filesystem::path pathCache = GetDataDir() / NSPV_CACHE_FILENAME;
+    boost::filesystem::path pathTmp = GetDataDir() / (NSPV_CACHE_FILENAME ".new");
+    FILE *file = fopen(pathTmp.string().c_str(),"wb");
+    CAutoFile fileout(file,SER_DISK,CLIENT_VERSION);
+    if ( fileout.IsNull() )
+    {
+        LogPrintf("%s: failed to open %s\n",__func__,pathTmp.string());
+        return;
+    }
+    try {
+        fileout << ss;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: I/O error - %s\n",__func__,e.what());
+        return;
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    if ( !RenameOver(pathTmp,pathCache) )
+        LogPrintf("%s: rename into place failed\n",__func__);
+    else LogPrintf("nSPV cache: saved %d headers proofs, %d notarizations, %d tx proofs\n",(int32_t)proofs.size(),(int32_t)ntzs.size(),(int32_t)txproofs.size());
+}
+
+void NSPV_cache_load()
+{
+    std::vector<std::pair<uint32_t,std::vector<uint8_t> > > proofs,ntzs,txproofs; uint32_t now = (uint32_t)time(NULL);
+    int32_t numproofs = 0,numntzs = 0,numtxproofs = 0; int64_t nStart = GetTimeMillis();
+    boost::filesystem::path pathCache = GetDataDir() / NSPV_CACHE_FILENAME;
+    if ( !boost::filesystem::exists(pathCache) )
+        return;
+    FILE *file = fopen(pathCache.string().c_str(),"rb");
+    CAutoFile filein(file,SER_DISK,CLIENT_VERSION);
+    if ( filein.IsNull() )
+        return;
+    int64_t dataSize = (int64_t)boost::filesystem::file_size(pathCache) - (int64_t)sizeof(uint256);
+    if ( dataSize <= 0 )
+        return;
+    std::vector<unsigned char> vchData(dataSize); uint256 hashIn;
+    try {
+        filein.read((char *)&vchData[0],dataSize);
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: I/O error - %s\n",__func__,e.what());
+        return;
+    }
+    filein.fclose();
+    CDataStream ss(vchData,SER_DISK,CLIENT_VERSION);
+    if ( hashIn != Hash(ss.begin(),ss.end()) )
+    {
+        LogPrintf("%s: checksum mismatch, ignoring %s\n",__func__,pathCache.string());
+        return;
+    }
+    try {
+        unsigned char pchMagic[4]; std::string symbol; int32_t version;
+        ss >> FLATDATA(pchMagic) >> symbol >> version;
+        if ( memcmp(pchMagic,Params().MessageStart(),sizeof(pchMagic)) != 0 || symbol != chainName.ToString() || version != NSPV_PROTOCOL_VERSION )
+            return;
+        ss >> proofs >> ntzs >> txproofs;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: deserialize error - %s\n",__func__,e.what());
+        return;
+    }
+
+    // the headers proofs first, the other entries are checked against them
+    for (int32_t i=0; i<proofs.size(); i++)
+    {
+        struct NSPV_ntzsproofresp P,*ptr;
+        memset(&P,0,sizeof(P));
+        if ( now - proofs[i].first < NSPV_CACHE_MAXAGE && proofs[i].second.size() > 0 && NSPV_rwntzsproofresp(0,&proofs[i].second[0],&P) == proofs[i].second.size() && NSPV_ntzsproof_verify(&P) == 0 )
+        {
+            ptr = NSPV_ntzsproof_add(&P);
+            NSPV_ntzsproofresp_cachetime[ptr - NSPV_ntzsproofresp_cache] = proofs[i].first;
+            numproofs++;
+        }
+        NSPV_ntzsproofresp_purge(&P);
+    }
+    for (int32_t i=0; i<ntzs.size(); i++)
+    {
+        struct NSPV_ntzsresp N,*ptr;
+        memset(&N,0,sizeof(N));
+        if ( now - ntzs[i].first < NSPV_CACHE_MAXAGE && ntzs[i].second.size() > 0 && NSPV_rwntzsresp(0,&ntzs[i].second[0],&N) == ntzs[i].second.size() && NSPV_ntzsresp_verify(&N) == 0 && NSPV_ntzsresp_find(N.reqheight) == 0 )
+        {
+            ptr = NSPV_ntzsresp_add(&N);
+            NSPV_ntzsresp_cachetime[ptr - NSPV_ntzsresp_cache] = ntzs[i].first;
+            numntzs++;
+        }
+        NSPV_ntzsresp_purge(&N);
+    }
+    for (int32_t i=0; i<txproofs.size(); i++)
+    {
+        struct NSPV_txproof T,*ptr;
+        memset(&T,0,sizeof(T));
+        if ( now - txproofs[i].first < NSPV_CACHE_MAXAGE && txproofs[i].second.size() > 0 && NSPV_rwtxproof(0,&txproofs[i].second[0],&T) == txproofs[i].second.size() && NSPV_txproof_verify(&T) == 0 )
+        {
+            ptr = NSPV_txproof_add(&T);
+            NSPV_txproof_cachetime[ptr - NSPV_txproof_cache] = txproofs[i].first;
+            numtxproofs++;
+        }
+        NSPV_txproof_purge(&T);
+    }
+    LogPrintf("nSPV cache: loaded %d of %d headers proofs, %d of %d notarizations, %d of %d tx proofs in %dms\n",numproofs,(int32_t)proofs.size(),numntzs,(int32_t)ntzs.size(),numtxproofs,(int32_t)txproofs.size(),(int32_t)(GetTimeMillis() - nStart));
+}
+
 // komodo_nSPVresp is called from async message processing
 
 void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a response
@@ -167,6 +391,16 @@ void komodo_nSPVresp(CNode *pfrom,std::vector<uint8_t> response) // received a r
                 NSPV_rwtxidsresp(0,&response[1],&NSPV_txidsresult);
                 fprintf(stderr,"got txids response %u size.%d %s CC.%d num.%d\n",timestamp,(int32_t)response.size(),NSPV_txidsresult.coinaddr,NSPV_txidsresult.CCflag,NSPV_txidsresult.numtxids);
                 break;
+            case NSPV_UTXOSPAGERESP:
+                NSPV_utxospage_purge(&NSPV_utxospageresult);
+                NSPV_rwutxospage(0,&response[1],&NSPV_utxospageresult);
+                fprintf(stderr,"got utxos page response %u size.%d num.%d more.%d\n",timestamp,(int32_t)response.size(),NSPV_utxospageresult.U.numutxos,NSPV_utxospageresult.cursorlen != 0);
+                break;
+            case NSPV_TXIDSPAGERESP:
+                NSPV_txidspage_purge(&NSPV_txidspageresult);
+                NSPV_rwtxidspage(0,&response[1],&NSPV_txidspageresult);
+                fprintf(stderr,"got txids page response %u size.%d num.%d more.%d\n",timestamp,(int32_t)response.size(),NSPV_txidspageresult.T.numtxids,NSPV_txidspageresult.cursorlen != 0);
+                break;
             case NSPV_MEMPOOLRESP:
                 NSPV_mempoolresp_purge(&NSPV_mempoolresult);
                 NSPV_rwmempoolresp(0,&response[1],&NSPV_mempoolresult);
@@ -446,6 +680,20 @@ UniValue NSPV_txidsresp_json(struct NSPV_txidsresp *ptr)
     return(result);
 }
 
+UniValue NSPV_utxospage_json(struct NSPV_utxospage *ptr)
+{
+    UniValue result = NSPV_utxosresp_json(&ptr->U);
+    result.push_back(Pair("cursor",HexStr(ptr->cursor,ptr->cursor+ptr->cursorlen)));
+    return(result);
+}
+
+UniValue NSPV_txidspage_json(struct NSPV_txidspage *ptr)
+{
+    UniValue result = NSPV_txidsresp_json(&ptr->T);
+    result.push_back(Pair("cursor",HexStr(ptr->cursor,ptr->cursor+ptr->cursorlen)));
+    return(result);
+}
+
 UniValue NSPV_mempoolresp_json(struct NSPV_mempoolresp *ptr)
 {
     UniValue result(UniValue::VOBJ),array(UniValue::VARR); int32_t i;
@@ -665,6 +913,55 @@ UniValue NSPV_addresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,int32
     return(result);
 }
 
+// pages through the utxos (NSPV_UTXOSPAGE) or txids (NSPV_TXIDSPAGE) of an address, the cursor of a page is passed to get the next one
+UniValue NSPV_addresspage(uint8_t reqtype,char *coinaddr,int32_t CCflag,std::string cursorhex,int32_t maxcount)
+{
+    UniValue result(UniValue::VOBJ); uint8_t msg[512]; int32_t i,iter,slen,len = 0; uint32_t filter = 0; uint16_t count;
+    std::vector<uint8_t> cursor = ParseHex(cursorhex);
+    if ( reqtype == NSPV_UTXOSPAGE )
+        NSPV_utxospage_purge(&NSPV_utxospageresult);
+    else NSPV_txidspage_purge(&NSPV_txidspageresult);
+    if ( bitcoin_base58decode(msg,coinaddr) != 25 )
+    {
+        result.push_back(Pair("result","error"));
+        result.push_back(Pair("error","invalid address"));
+        return(result);
+    }
+    if ( cursor.size() > NSPV_MAXCURSORLEN )
+    {
+        result.push_back(Pair("result","error"));
+        result.push_back(Pair("error","invalid cursor"));
+        return(result);
+    }
+    count = (maxcount <= 0 || maxcount > NSPV_MAXPAGE) ? NSPV_MAXPAGE : maxcount;
+    slen = (int32_t)strlen(coinaddr);
+    msg[len++] = reqtype;
+    msg[len++] = slen;
+    memcpy(&msg[len],coinaddr,slen), len += slen;
+    msg[len++] = (CCflag != 0);
+    len += iguana_rwnum(1,&msg[len],sizeof(filter),&filter);
+    len += iguana_rwnum(1,&msg[len],sizeof(count),&count);
+    msg[len++] = (uint8_t)cursor.size();
+    if ( cursor.size() > 0 )
+        memcpy(&msg[len],&cursor[0],cursor.size()), len += cursor.size();
+    for (iter=0; iter<3; iter++)
+    if ( NSPV_req(0,msg,len,NODE_ADDRINDEX,msg[0]>>1) != 0 )
+    {
+        for (i=0; i<NSPV_POLLITERS; i++)
+        {
+            usleep(NSPV_POLLMICROS);
+            if ( reqtype == NSPV_UTXOSPAGE && strcmp(coinaddr,NSPV_utxospageresult.U.coinaddr) == 0 && CCflag == NSPV_utxospageresult.U.CCflag )
+                return(NSPV_utxospage_json(&NSPV_utxospageresult));
+            if ( reqtype == NSPV_TXIDSPAGE && strcmp(coinaddr,NSPV_txidspageresult.T.coinaddr) == 0 && CCflag == NSPV_txidspageresult.T.CCflag )
+                return(NSPV_txidspage_json(&NSPV_txidspageresult));
+        }
+    } else sleep(1);
+    result.push_back(Pair("result","error"));
+    result.push_back(Pair("error","no page result"));
+    result.push_back(Pair("lastpeer",NSPV_lastpeer));
+    return(result);
+}
+
 UniValue NSPV_ccaddresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,uint256 filtertxid,uint8_t evalcode, uint8_t func)
 {
     UniValue result(UniValue::VOBJ); uint8_t msg[512],funcid=NSPV_CC_TXIDS; char zeroes[64]; int32_t i,iter,slen,len = 0,vout;
@@ -451,6 +451,31 @@ int32_t komodo_notarizeddata(int32_t nHeight,uint256 *notarized_hashp,uint256 *n
     return 0;
 }
 
+/****
+ * Get the hash of a notarized block
+ * @param[in] notarized_height the height of the notarized block
+ * @param[out] notarized_hashp the notarized hash, null if the height was never notarized
+ * @returns true if a notarization of that height is known
+ */
+bool komodo_notarizedhash(int32_t notarized_height,uint256 *notarized_hashp)
+{
+    char symbol[KOMODO_ASSETCHAIN_MAXLEN];
+    char dest[KOMODO_ASSETCHAIN_MAXLEN];
+
+    notarized_hashp->SetNull();
+    komodo_state *sp = komodo_stateptr(symbol,dest);
+    if ( sp != nullptr )
+    {
+        const notarized_checkpoint *np = sp->CheckpointForNotarizedHeight(notarized_height);
+        if ( np != nullptr )
+        {
+            *notarized_hashp = np->notarized_hash;
+            return true;
+        }
+    }
+    return false;
+}
+
 /***
  * Add a notarized checkpoint to the komodo_state
  * @param[in] sp the komodo_state to add to
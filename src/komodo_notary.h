@@ -98,6 +98,14 @@ int32_t komodo_MoMdata(int32_t *notarized_htp,uint256 *MoMp,uint256 *kmdtxidp,in
  */
 int32_t komodo_notarizeddata(int32_t nHeight,uint256 *notarized_hashp,uint256 *notarized_desttxidp);
 
+/****
+ * Get the hash of a notarized block
+ * @param[in] notarized_height the height of the notarized block
+ * @param[out] notarized_hashp the notarized hash, null if the height was never notarized
+ * @returns true if a notarization of that height is known
+ */
+bool komodo_notarizedhash(int32_t notarized_height,uint256 *notarized_hashp);
+
 /***
  * Add a notarized checkpoint to the komodo_state
  * @param[in] sp the komodo_state to add to
@@ -351,6 +351,7 @@ std::ostream& operator<<(std::ostream& os, const event_pricefeed& in)
  */
 void komodo_state::AddCheckpoint(const notarized_checkpoint &in)
 {
+    NPOINTS_by_notarized_height[in.notarized_height] = NPOINTS.size();
     NPOINTS.push_back(in);
     last = in;
 }
@@ -485,7 +486,20 @@ const notarized_checkpoint *komodo_state::CheckpointAtHeight(int32_t height) con
     return nullptr;
 }
 
-void komodo_state::clear_checkpoints() { NPOINTS.clear(); }
+/******
+ * @brief Find the notarization of a particular block
+ * @param notarized_height the height of the notarized block
+ * @returns the most recent checkpoint for that height or nullptr
+ */
+const notarized_checkpoint *komodo_state::CheckpointForNotarizedHeight(int32_t notarized_height) const
+{
+    auto itr = NPOINTS_by_notarized_height.find(notarized_height);
+    if ( itr == NPOINTS_by_notarized_height.end() || itr->second >= NPOINTS.size() )
+        return nullptr;
+    return &NPOINTS[itr->second];
+}
+
+void komodo_state::clear_checkpoints() { NPOINTS.clear(); NPOINTS_by_notarized_height.clear(); }
 const uint256& komodo_state::LastNotarizedHash() const { return last.notarized_hash; }
 void komodo_state::SetLastNotarizedHash(const uint256 &in) { last.notarized_hash = in; }
 const uint256& komodo_state::LastNotarizedDestTxId() const { return last.notarized_desttxid; }
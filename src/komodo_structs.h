@@ -15,6 +15,7 @@
 #pragma once
 #include <memory>
 #include <list>
+#include <map>
 #include <vector>
 #include <cstdint>
 
@@ -304,6 +305,7 @@ protected:
     void clear_checkpoints();
     std::vector<notarized_checkpoint> NPOINTS; // collection of notarizations
     mutable size_t NPOINTS_last_index = 0; // caches checkpoint linear search position
+    std::map<int32_t, size_t> NPOINTS_by_notarized_height; // index in NPOINTS of the latest notarization of a height
     notarized_checkpoint last;
 
 public:
@@ -326,6 +328,13 @@ public:
 
     uint64_t NumCheckpoints() const;
 
+    /******
+     * @brief Find the notarization of a particular block
+     * @param notarized_height the height of the notarized block
+     * @returns the most recent checkpoint for that height or nullptr
+     */
+    const notarized_checkpoint *CheckpointForNotarizedHeight(int32_t notarized_height) const;
+
     /****
      * Get the notarization data below a particular height
      * @param[in] nHeight the height desired
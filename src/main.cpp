@@ -29,15 +29,19 @@
 #include "importcoin.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "blockencodings.h"
+#include "blockreader.h"
 #include "checkqueue.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
 #include "deprecation.h"
 #include "init.h"
+#include "mappedfile.h"
 #include "merkleblock.h"
 #include "metrics.h"
 #include "notarisationdb.h"
 #include "net.h"
+#include "nspvqueue.h"
 #include "pow.h"
 #include "script/interpreter.h"
 #include "txdb.h"
@@ -66,6 +70,7 @@
 #include <atomic>
 #include <sstream>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -99,11 +104,17 @@ static int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nNSPVThreads = 0;
 bool fExperimentalMode = true;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = false;
 bool fAddressIndex = false;
+std::atomic<bool> fAddressBalanceIndex(false);
+bool fCCIndex = false;
+bool fTokenIndex = false;
+bool fOracleIndex = false;
+bool fGatewaysIndex = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
@@ -111,6 +122,7 @@ bool fPruneMode = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = true;
+uint256 hashAssumeNotarized;
 bool fCoinbaseEnforcedProtectionEnabled = true;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
@@ -247,9 +259,19 @@ namespace {
         int64_t nTime;  //! Time of "getdata" request in microseconds.
         bool fValidatedHeaders;  //! Whether this block has validated headers at the time of request.
         int64_t nTimeDisconnect; //! The timeout for this block request (for disconnecting a slow peer)
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;  //! Optional, used for compact blocks.
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
+    /** Outbound peers we asked to announce new blocks with "cmpctblock" right away. Protected by cs_main. */
+    list<NodeId> lNodesAnnouncingHeaderAndIDs;
+    /** Number of peers asked to announce new blocks with "cmpctblock". */
+    static const unsigned int MAX_CMPCTBLOCK_ANNOUNCING_PEERS = 3;
+    /** Blocks deeper than this below the tip are sent in full when requested as compact blocks. */
+    static const int MAX_CMPCTBLOCK_DEPTH = 10;
+    /** Blocks deeper than this below the tip are not served to "getblocktxn". */
+    static const int MAX_BLOCKTXN_DEPTH = 10;
+
     /** Number of blocks in flight with validated headers. */
     int nQueuedValidatedHeaders = 0;
 
@@ -310,6 +332,13 @@ namespace {
         int nBlocksInFlightValidHeaders;
         //! Whether we consider this a preferred download peer.
         bool fPreferredDownload;
+        //! Whether this peer understands compact blocks ("sendcmpct" received).
+        bool fProvidesHeaderAndIDs;
+        //! Whether this peer wants new blocks announced with "cmpctblock" instead of "inv".
+        bool fPreferHeaderAndIDs;
+        //! Blocks rebuilt from this peer's compact blocks, and how many of them needed "getblocktxn".
+        int nCmpctBlocksReconstructed;
+        int nCmpctBlocksTxnRequested;
 
         CNodeState() {
             fCurrentlyConnected = false;
@@ -323,6 +352,10 @@ namespace {
             nBlocksInFlight = 0;
             nBlocksInFlightValidHeaders = 0;
             fPreferredDownload = false;
+            fProvidesHeaderAndIDs = false;
+            fPreferHeaderAndIDs = false;
+            nCmpctBlocksReconstructed = 0;
+            nCmpctBlocksTxnRequested = 0;
         }
     };
 
@@ -387,6 +420,7 @@ namespace {
         mapBlocksInFlight.erase(entry.hash);
         EraseOrphansFor(nodeid);
         nPreferredDownload -= state->fPreferredDownload;
+        lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
         mapNodeState.erase(nodeid);
     }
@@ -421,7 +455,9 @@ namespace {
     }
 
     // Requires cs_main.
-    void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Params& consensusParams, CBlockIndex *pindex = NULL) {
+    // pit is set to the queue entry, e.g. to attach the partial block of a compact block.
+    void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Params& consensusParams, CBlockIndex *pindex = NULL,
+                             list<QueuedBlock>::iterator *pit = NULL) {
         CNodeState *state = State(nodeid);
         assert(state != NULL);
 
@@ -435,6 +471,49 @@ namespace {
         state->nBlocksInFlight++;
         state->nBlocksInFlightValidHeaders += newentry.fValidatedHeaders;
         mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
+        if (pit)
+            *pit = it;
+    }
+
+    // Requires cs_main.
+    /**
+     * Ask an outbound peer that understands compact blocks to announce new blocks with them, up to a few peers.
+     * With fRotate, as for a peer that just delivered a new tip, the peer asked the longest ago makes room
+     * for it (BIP152), so the announcers follow the peers that are fastest to relay.
+     */
+    void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, bool fRotate) {
+        CNodeState *nodestate = State(nodeid);
+        if (nodestate == NULL || !nodestate->fProvidesHeaderAndIDs)
+            return;
+        for (list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+            if (*it == nodeid) {
+                if (fRotate)
+                    lNodesAnnouncingHeaderAndIDs.splice(lNodesAnnouncingHeaderAndIDs.end(), lNodesAnnouncingHeaderAndIDs, it);
+                return;
+            }
+        }
+        const bool fFull = lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_ANNOUNCING_PEERS;
+        if (fFull && !fRotate)
+            return;
+
+        LOCK(cs_vNodes);
+        CNode *pfrom = NULL, *pnodeStop = NULL;
+        BOOST_FOREACH(CNode* pnode, vNodes) {
+            if (pnode->GetId() == nodeid)
+                pfrom = pnode;
+            else if (fFull && pnode->GetId() == lNodesAnnouncingHeaderAndIDs.front())
+                pnodeStop = pnode;
+        }
+        if (pfrom == NULL || pfrom->fInbound)
+            return;
+        uint64_t nCMPCTBLOCKVersion = CMPCTBLOCKS_VERSION;
+        if (fFull) {
+            if (pnodeStop != NULL)
+                pnodeStop->PushMessage("sendcmpct", false, nCMPCTBLOCKVersion);
+            lNodesAnnouncingHeaderAndIDs.pop_front();
+        }
+        pfrom->PushMessage("sendcmpct", true, nCMPCTBLOCKVersion);
+        lNodesAnnouncingHeaderAndIDs.push_back(nodeid);
     }
 
     /** Check whether the last unknown block a peer advertized is not yet known. */
@@ -585,6 +664,9 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    stats.fProvidesHeaderAndIDs = state->fProvidesHeaderAndIDs;
+    stats.nCmpctBlocksReconstructed = state->nCmpctBlocksReconstructed;
+    stats.nCmpctBlocksTxnRequested = state->nCmpctBlocksTxnRequested;
     BOOST_FOREACH(const QueuedBlock& queue, state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -629,6 +711,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache *pcoinsTip = nullptr;
+CCoinsViewDB *pcoinsdbview = nullptr;
 CBlockTreeDB *pblocktree = nullptr;
 
 // Komodo globals
@@ -2145,6 +2228,143 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool GetContractIndex(uint8_t evalcode, uint8_t funcid, std::vector<std::pair<CContractIndexKey, int32_t> > &contractIndex)
+{
+    if (!fCCIndex)
+        return false;
+
+    if (!pblocktree->ReadContractIndex(evalcode, funcid, contractIndex))
+        return error("unable to get txids for evalcode");
+
+    return true;
+}
+
+bool GetTokenIndexBalance(const uint256 &tokenid, const uint160 &addressHash, CAmount &balance)
+{
+    if (!fTokenIndex)
+        return false;
+
+    if (!pblocktree->ReadTokenBalance(tokenid, addressHash, balance))
+        return error("unable to get token balance");
+
+    return true;
+}
+
+bool GetTokenIndexSupply(const uint256 &tokenid, CTokenSupplyValue &supply)
+{
+    if (!fTokenIndex)
+        return false;
+
+    if (!pblocktree->ReadTokenSupply(tokenid, supply))
+        return error("unable to get token supply");
+
+    return true;
+}
+
+bool GetOracleSamples(const uint256 &oracletxid, const uint160 &publisherHash, int maxHeight, int num,
+                      std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples)
+{
+    if (!fOracleIndex)
+        return false;
+
+    if (!pblocktree->ReadOracleSamples(oracletxid, publisherHash, maxHeight, num, samples))
+        return error("unable to get oracle samples");
+
+    return true;
+}
+
+bool GetOracleLatestSamples(const uint256 &oracletxid, std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples)
+{
+    if (!fOracleIndex)
+        return false;
+
+    if (!pblocktree->ReadOracleLatestSamples(oracletxid, samples))
+        return error("unable to get oracle samples");
+
+    return true;
+}
+
+bool GetGatewaysStates(const uint256 &bindtxid, uint8_t stage, std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &states)
+{
+    if (!fGatewaysIndex)
+        return false;
+
+    if (!pblocktree->ReadGatewaysStates(bindtxid, stage, states))
+        return error("unable to get gateways states");
+
+    return true;
+}
+
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance)
+{
+    if (!fAddressIndex || !fAddressBalanceIndex)
+        return false;
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, balance))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
+//! Address index records read while holding cs_main, per step of the address balances backfill
+static const size_t ADDRESS_BALANCE_BACKFILL_RECORDS = 50000;
+
+void ThreadAddressBalanceIndex()
+{
+    if (!fAddressIndex || fAddressBalanceIndex)
+        return;
+
+    CAddressIndexIteratorKey keyLast;
+    bool fStarted = pblocktree->ReadAddressBalanceBackfill(keyLast);
+    LogPrintf("Backfilling the address balances%s\n", fStarted ? ", resuming" : "");
+    int64_t nStart = GetTimeMillis();
+    bool fDone = false;
+    while (!fDone) {
+        boost::this_thread::interruption_point();
+        {
+            // blocks are connected and disconnected under cs_main: the totals of an address
+            // are computed from all its records, then only updated with the next blocks
+            LOCK(cs_main);
+            if (!pblocktree->BackfillAddressBalances(fStarted ? &keyLast : NULL, ADDRESS_BALANCE_BACKFILL_RECORDS, keyLast, fDone)) {
+                LogPrintf("%s: failed to backfill the address balances\n", __func__);
+                return;
+            }
+            fStarted = true;
+            if (fDone) {
+                pblocktree->WriteFlag("addressbalanceindex", true);
+                fAddressBalanceIndex = true;
+            }
+        }
+        MilliSleep(1);
+    }
+    LogPrintf("Backfilled the address balances in %ds\n", (int)((GetTimeMillis() - nStart) / 1000));
+}
+
+bool GetAddressIndexPage(uint160 addressHash, int type, const CAddressIndexKey *pkeyAfter, size_t nMax,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore,
+                         int start, int end)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndexPage(addressHash, type, pkeyAfter, nMax, addressIndex, fMore, start, end))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspentPage(uint160 addressHash, int type, const CAddressUnspentKey *pkeyAfter, size_t nMax,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, bool &fMore)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndexPage(addressHash, type, pkeyAfter, nMax, unspentOutputs, fMore))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
 /****
  * @brief add a transaction to the mempool
  * @param[in] tx the transaction
@@ -2173,6 +2393,36 @@ bool myAddtomempool(const CTransaction &tx, CValidationState *pstate, bool fSkip
     return true;
 }
 
+/** Memory mappings of the finalized block and undo files, see -mmapblockfiles */
+static CMappedFileCache mappedBlockFiles;
+static CMappedFileCache mappedUndoFiles;
+
+void SetMappedBlockFiles(int nFiles)
+{
+    mappedBlockFiles.SetMaxFiles(std::max(nFiles, 0));
+    mappedUndoFiles.SetMaxFiles(std::max(nFiles, 0));
+}
+
+/****
+ * Get the memory mapping of a block or undo file
+ * @param pos the position that will be read
+ * @param prefix the type of file ("blk" or "rev")
+ * @returns the mapping, or NULL to read the file with OpenDiskFile
+ */
+static std::shared_ptr<const CMappedFile> GetMappedDiskFile(const CDiskBlockPos &pos, const char *prefix)
+{
+    CMappedFileCache &cache = strcmp(prefix, "rev") == 0 ? mappedUndoFiles : mappedBlockFiles;
+    if (pos.IsNull() || !cache.Enabled())
+        return nullptr;
+    {
+        // The file being written is truncated when it gets finalized, which must not happen under a mapping
+        LOCK(cs_LastBlockFile);
+        if (pos.nFile >= nLastBlockFile)
+            return nullptr;
+    }
+    return cache.Get(pos.nFile, GetBlockPosFilename(pos, prefix), pos.nPos);
+}
+
 /*****
  * @brief get a transaction by its hash (without locks)
  * @param[in] hash what to look for
@@ -2211,18 +2461,20 @@ bool myGetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlo
         if (pblocktree->ReadTxIndex(hash, postx)) 
         {
             // Found the transaction in the index. Load the block to get the block hash
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+            std::shared_ptr<const CMappedFile> mapped = GetMappedDiskFile(postx, "blk");
+            CDiskFileStream file(mapped, postx.nPos, mapped ? NULL : OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
             if (file.IsNull())
                 return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
             try {
                 file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                file.ignore(postx.nTxOffset);
                 file >> txOut;
             } catch (const std::exception& e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
             }
-            hashBlock = header.GetHash();
+            // entries written by older versions do not carry the block hash
+            hashBlock = postx.hashBlock.IsNull() ? header.GetHash() : postx.hashBlock;
             if (txOut.GetHash() != hash)
                 return error("%s: txid mismatch", __func__);
             return true;
@@ -2271,18 +2523,20 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+            std::shared_ptr<const CMappedFile> mapped = GetMappedDiskFile(postx, "blk");
+            CDiskFileStream file(mapped, postx.nPos, mapped ? NULL : OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
             if (file.IsNull())
                 return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
             try {
                 file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                file.ignore(postx.nTxOffset);
                 file >> txOut;
             } catch (const std::exception& e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
             }
-            hashBlock = header.GetHash();
+            // entries written by older versions do not carry the block hash
+            hashBlock = postx.hashBlock.IsNull() ? header.GetHash() : postx.hashBlock;
             if (txOut.GetHash() != hash)
                 return error("%s: txid mismatch", __func__);
             return true;
@@ -2356,7 +2610,8 @@ bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bo
     block.SetNull();
 
     // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    std::shared_ptr<const CMappedFile> mapped = GetMappedDiskFile(pos, "blk");
+    CDiskFileStream filein(mapped, pos.nPos, mapped ? NULL : OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
     {
         //fprintf(stderr,"readblockfromdisk err A\n");
@@ -2399,6 +2654,63 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex,bool checkPOW)
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& raw, const CBlockIndex* pindex)
+{
+    if ( pindex == 0 )
+        return false;
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("ReadRawBlockFromDisk: invalid position %s", pos.ToString());
+
+    // The block is preceded by the message start and its size, see WriteBlockToDisk
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+    std::shared_ptr<const CMappedFile> mapped = GetMappedDiskFile(posHeader, "blk");
+    CDiskFileStream filein(mapped, posHeader.nPos, mapped ? NULL : OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    CBlockHeader header;
+    try {
+        unsigned char buf[MESSAGE_START_SIZE];
+        unsigned int nSize;
+        filein >> FLATDATA(buf) >> nSize;
+        if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE) || nSize < CBlockHeader::HEADER_SIZE || nSize > MAX_BLOCK_SIZE(pindex->nHeight))
+            return error("%s: no block record at %s", __func__, pos.ToString());
+        raw.resize(nSize);
+        filein.read((char*)&raw[0], nSize);
+
+        // Only the header is deserialized to check the hash
+        filein.Seek(pos.nPos);
+        filein >> header;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    if (header.GetHash() != pindex->GetBlockHash())
+        return error("ReadRawBlockFromDisk: GetHash() doesn't match index for %s at %s",
+                     pindex->ToString(), pos.ToString());
+    return true;
+}
+
+/** Total size of the recently served raw blocks kept in memory */
+static const size_t RAW_BLOCK_CACHE_BYTES = 32 * 1024 * 1024;
+
+static CRawBlockCache rawblockcache(RAW_BLOCK_CACHE_BYTES);
+
+CRawBlockRef GetRawBlock(const CBlockIndex* pindex)
+{
+    if ( pindex == 0 )
+        return nullptr;
+    CRawBlockRef raw = rawblockcache.Get(pindex->GetBlockHash());
+    if (raw)
+        return raw;
+    std::shared_ptr<std::vector<unsigned char> > pread = std::make_shared<std::vector<unsigned char> >();
+    if (!ReadRawBlockFromDisk(*pread, pindex))
+        return nullptr;
+    rawblockcache.Insert(pindex->GetBlockHash(), pread);
+    return pread;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int32_t numhalvings,i; uint64_t numerator; CAmount nSubsidy = 3 * COIN;
@@ -2731,10 +3043,14 @@ namespace Consensus {
         for (unsigned int i = 0; i < tx.vin.size(); i++)
         {
             const COutPoint &prevout = tx.vin[i].prevout;
-            const CCoins *coins = inputs.AccessCoins(prevout.hash);
-            assert(coins);
+            // only the spent output is read, unless it comes from a coinbase
+            CCoinsOutput coin;
+            bool fHave = inputs.GetCoin(prevout, coin);
+            assert(fHave);
 
-            if (coins->IsCoinBase()) {
+            if (coin.fCoinBase) {
+                const CCoins *coins = inputs.AccessCoins(prevout.hash);
+                assert(coins);
                 // ensure that output of coinbases are not still time locked
                 if (coins->TotalTxValue() >= ASSETCHAINS_TIMELOCKGTE)
                 {
@@ -2765,21 +3081,21 @@ namespace Consensus {
             }
 
             // Check for negative or overflow input values
-            nValueIn += coins->vout[prevout.n].nValue;
+            nValueIn += coin.out.nValue;
 #ifdef KOMODO_ENABLE_INTEREST
             if ( chainName.isKMD() && nSpendHeight > 60000 )//chainActive.Tip() != 0 && chainActive.Tip()->nHeight >= 60000 )
             {
-                if ( coins->vout[prevout.n].nValue >= 10*COIN )
+                if ( coin.out.nValue >= 10*COIN )
                 {
                     int64_t interest; int32_t txheight; uint32_t locktime;
-                    if ( (interest= komodo_accrued_interest(&txheight,&locktime,prevout.hash,prevout.n,0,coins->vout[prevout.n].nValue,(int32_t)nSpendHeight-1)) != 0 )
+                    if ( (interest= komodo_accrued_interest(&txheight,&locktime,prevout.hash,prevout.n,0,coin.out.nValue,(int32_t)nSpendHeight-1)) != 0 )
                     {
                         nValueIn += interest;
                     }
                 }
             }
 #endif
-            if (!MoneyRange(coins->vout[prevout.n].nValue) || !MoneyRange(nValueIn))
+            if (!MoneyRange(coin.out.nValue) || !MoneyRange(nValueIn))
                 return state.DoS(100, error("CheckInputs(): txin values out of range"),
                                  REJECT_INVALID, "bad-txns-inputvalues-outofrange");
 
@@ -2840,11 +3156,11 @@ bool ContextualCheckInputs(
         if (fScriptChecks) {
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
-                const CCoins* coins = inputs.AccessCoins(prevout.hash);
-                assert(coins);
+                const CTxOut* out = inputs.AccessOutput(prevout);
+                assert(out);
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore, consensusBranchId, &txdata);
+                CScriptCheck check(*out, tx, i, flags, cacheStore, consensusBranchId, &txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -2856,7 +3172,7 @@ bool ContextualCheckInputs(
                         // arguments; if so, don't trigger DoS protection to
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
-                        CScriptCheck check2(*coins, tx, i,
+                        CScriptCheck check2(*out, tx, i,
                                             flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, consensusBranchId, &txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
@@ -2915,7 +3231,8 @@ namespace {
     bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
     {
         // Open history file to read
-        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+        std::shared_ptr<const CMappedFile> mapped = GetMappedDiskFile(pos, "rev");
+        CDiskFileStream filein(mapped, pos.nPos, mapped ? NULL : OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
         if (filein.IsNull())
             return error("%s: OpenBlockFile failed", __func__);
 
@@ -3049,6 +3366,226 @@ int8_t GetAddressType(const CScript &scriptPubKey, CTxDestination &vDest, txnout
     return keyType;
 }
 
+/****
+ * The CC index records of the transactions of a block: the evalcode and funcid of the opreturn,
+ * and for a tokens opreturn also those of the module data it carries
+ */
+void GetContractIndexEntries(const CBlock &block, int nHeight, std::vector<std::pair<CContractIndexKey, int32_t> > &contractIndex)
+{
+    for (const CTransaction &tx : block.vtx) {
+        std::vector<uint8_t> vopret;
+        if (tx.vout.size() == 0 || !GetOpReturnData(tx.vout.back().scriptPubKey, vopret) || vopret.size() < 2)
+            continue;
+        std::set<std::pair<uint8_t, uint8_t> > funcs;
+        funcs.insert(std::make_pair(vopret[0], vopret[1]));
+        if (vopret[0] == EVAL_TOKENS) {
+            uint8_t evalcode;
+            uint256 tokenid;
+            std::vector<CPubKey> pubkeys;
+            std::vector<std::pair<uint8_t, vscript_t> > oprets;
+            if (DecodeTokenOpRet(tx.vout.back().scriptPubKey, evalcode, tokenid, pubkeys, oprets) != 0) {
+                for (const std::pair<uint8_t, vscript_t> &opret : oprets) {
+                    if (opret.second.size() >= 2)
+                        funcs.insert(std::make_pair(opret.second[0], opret.second[1]));
+                }
+            }
+        }
+        for (const std::pair<uint8_t, uint8_t> &func : funcs)
+            contractIndex.push_back(std::make_pair(CContractIndexKey(func.first, func.second, nHeight, tx.GetHash()), (int32_t)tx.vout.size() - 1));
+    }
+}
+
+/****
+ * The tokens outputs created by the transactions of a block, as found by IsTokensvout, and the
+ * tokens outputs they spend. The outputs spent from earlier blocks are read from the token index.
+ * Consensus does not check the token amounts, each output is checked against its transaction inputs.
+ */
+void GetTokenIndexEntries(const CBlock &block, std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                                 std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent)
+{
+    struct CCcontract_info *cpTokens, C;
+    cpTokens = CCinit(&C, EVAL_TOKENS);
+    std::map<COutPoint, CTokenOutputValue> mapCreated;
+
+    for (const CTransaction &tx : block.vtx) {
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn &input : tx.vin) {
+                if (!IsCCInput(input.scriptSig))
+                    continue;
+                CTokenOutputValue value;
+                std::map<COutPoint, CTokenOutputValue>::const_iterator it = mapCreated.find(input.prevout);
+                if (it != mapCreated.end())
+                    vSpent.push_back(std::make_pair(input.prevout, it->second));
+                else if (pblocktree->ReadTokenOutput(input.prevout, value))
+                    vSpent.push_back(std::make_pair(input.prevout, value));
+            }
+        }
+
+        std::vector<uint8_t> vopret;
+        if (tx.vout.size() < 2 || !GetOpReturnData(tx.vout.back().scriptPubKey, vopret) || vopret.size() < 2 || vopret[0] != EVAL_TOKENS)
+            continue;
+        uint256 tokenid;
+        if (vopret[1] == 'c')
+            tokenid = tx.GetHash();
+        else {
+            uint8_t evalcode;
+            std::vector<CPubKey> pubkeys;
+            std::vector<std::pair<uint8_t, vscript_t> > oprets;
+            if (DecodeTokenOpRet(tx.vout.back().scriptPubKey, evalcode, tokenid, pubkeys, oprets) == 0)
+                continue;
+        }
+        for (int32_t v = 0; v < (int32_t)tx.vout.size() - 1; v++) {
+            const CTxOut &out = tx.vout[v];
+            txnouttype txType;
+            std::vector<std::vector<unsigned char> > vSols;
+            // a transfer paying more than its token inputs, or a forged tokenbase, creates nothing
+            if (!out.scriptPubKey.IsPayToCryptoCondition() || IsTokensvoutConfirmed(cpTokens, NULL, tx, block.GetHash(), v, tokenid) <= 0)
+                continue;
+            if (!Solver(out.scriptPubKey, txType, vSols) || txType != TX_CRYPTOCONDITION || vSols.empty())
+                continue;
+            const COutPoint outpoint(tx.GetHash(), v);
+            const CTokenOutputValue value(tokenid, uint160(vSols[0]), out.nValue);
+            mapCreated[outpoint] = value;
+            vCreated.push_back(std::make_pair(outpoint, value));
+        }
+    }
+}
+
+/****
+ * The token index records of a connected block, read back from the token index
+ */
+void ReadTokenIndexEntries(const CBlock &block, std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                                  std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent)
+{
+    for (const CTransaction &tx : block.vtx) {
+        CTokenOutputValue value;
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn &input : tx.vin) {
+                if (IsCCInput(input.scriptSig) && pblocktree->ReadTokenOutput(input.prevout, value))
+                    vSpent.push_back(std::make_pair(input.prevout, value));
+            }
+        }
+        for (uint32_t v = 0; v < tx.vout.size(); v++) {
+            const COutPoint outpoint(tx.GetHash(), v);
+            if (tx.vout[v].scriptPubKey.IsPayToCryptoCondition() && pblocktree->ReadTokenOutput(outpoint, value))
+                vCreated.push_back(std::make_pair(outpoint, value));
+        }
+    }
+}
+
+/****
+ * The oracle data samples of a block: the data transactions passing the baton of their publisher
+ */
+void GetOracleSampleEntries(const CBlock &block, int nHeight, std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples)
+{
+    for (const CTransaction &tx : block.vtx) {
+        std::vector<uint8_t> vopret;
+        if (tx.vout.size() < 3 || !GetOpReturnData(tx.vout.back().scriptPubKey, vopret) || vopret.size() < 2 || vopret[0] != EVAL_ORACLES || vopret[1] != 'D')
+            continue;
+        uint256 oracletxid, batontxid;
+        CPubKey publisher;
+        std::vector<uint8_t> data;
+        txnouttype txType;
+        std::vector<std::vector<unsigned char> > vSols;
+        // vout 1 is the baton, on the baton address of the publisher (the marker value as oraclessamples expects)
+        if (DecodeOraclesData(tx.vout.back().scriptPubKey, oracletxid, batontxid, publisher, data) != 'D' || tx.vout[1].nValue != 10000)
+            continue;
+        if (!Solver(tx.vout[1].scriptPubKey, txType, vSols) || txType != TX_CRYPTOCONDITION || vSols.empty())
+            continue;
+        // only the publisher can spend the previous baton, anyone can pay to the baton address
+        bool fBaton = false;
+        for (const CTxIn &input : tx.vin)
+            fBaton |= (input.prevout.hash == batontxid && input.prevout.n == 1);
+        if (!fBaton)
+            continue;
+        samples.push_back(std::make_pair(COracleSampleKey(oracletxid, uint160(vSols[0]), nHeight, tx.GetHash()), COracleSampleValue(publisher, data)));
+    }
+}
+
+/****
+ * The gateways index records changed by a block. A deposit or a withdraw moves to the next stage of its
+ * lifecycle with the transaction spending vout 0 of its last transaction, and back on disconnect.
+ * Records for null values are to be erased, as are the withdraws for a null bindtxid.
+ */
+void GetGatewaysIndexEntries(const CBlock &block, bool fConnect, std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &states,
+                             std::vector<std::pair<uint256, uint256> > &withdraws)
+{
+    // the records as the transactions so far leave them, by deposit or withdraw
+    std::map<uint256, std::pair<CGatewaysStateKey, CGatewaysStateValue> > mapStates;
+    std::map<uint256, uint256> mapWithdraws;
+    std::vector<CGatewaysStateKey> vRead;
+
+    auto findState = [&](const uint256 &origintxid, uint256 bindtxid, uint8_t stage) -> std::pair<CGatewaysStateKey, CGatewaysStateValue>* {
+        std::map<uint256, std::pair<CGatewaysStateKey, CGatewaysStateValue> >::iterator it = mapStates.find(origintxid);
+        if (it != mapStates.end()) {
+            if (it->second.second.IsNull() || it->second.first.stage != stage || (!bindtxid.IsNull() && it->second.first.bindtxid != bindtxid))
+                return NULL;
+            return &it->second;
+        }
+        if (bindtxid.IsNull()) {
+            std::map<uint256, uint256>::iterator itWithdraw = mapWithdraws.find(origintxid);
+            if (itWithdraw != mapWithdraws.end())
+                bindtxid = itWithdraw->second;
+            else if (!pblocktree->ReadGatewaysWithdrawBind(origintxid, bindtxid))
+                return NULL;
+            if (bindtxid.IsNull())
+                return NULL;
+        }
+        const CGatewaysStateKey key(bindtxid, stage, origintxid);
+        CGatewaysStateValue value;
+        if (!pblocktree->ReadGatewaysState(key, value) || value.IsNull())
+            return NULL;
+        vRead.push_back(key);
+        return &(mapStates[origintxid] = std::make_pair(key, value));
+    };
+
+    // disconnected in reverse order
+    for (size_t n = 0; n < block.vtx.size(); n++) {
+        const CTransaction &tx = block.vtx[fConnect ? n : block.vtx.size() - 1 - n];
+        uint256 bindtxid, origintxid;
+        uint8_t fromstage, tostage;
+        const uint8_t funcid = DecodeGatewaysStateOpRet(tx, bindtxid, origintxid, fromstage, tostage);
+        if (funcid == 0)
+            continue;
+        const uint256 txid = tx.GetHash();
+        std::pair<CGatewaysStateKey, CGatewaysStateValue> *pstate;
+
+        if (fromstage == 0) {
+            if (fConnect)
+                mapStates[origintxid] = std::make_pair(CGatewaysStateKey(bindtxid, tostage, origintxid), CGatewaysStateValue(origintxid));
+            else if ((pstate = findState(origintxid, bindtxid, tostage)) != NULL && pstate->second.vtxid.size() == 1)
+                pstate->second.SetNull();
+            if (funcid == 'W')
+                mapWithdraws[origintxid] = fConnect ? bindtxid : uint256();
+        } else if (fConnect) {
+            if ((pstate = findState(origintxid, bindtxid, fromstage)) == NULL)
+                continue;
+            const uint256 &lasttxid = pstate->second.vtxid.back();
+            for (const CTxIn &input : tx.vin) {
+                if (input.prevout.hash == lasttxid && input.prevout.n == 0) {
+                    pstate->first.stage = tostage;
+                    pstate->second.vtxid.push_back(txid);
+                    break;
+                }
+            }
+        } else {
+            if ((pstate = findState(origintxid, bindtxid, tostage)) == NULL || pstate->second.vtxid.size() < 2 || pstate->second.vtxid.back() != txid)
+                continue;
+            pstate->first.stage = fromstage;
+            pstate->second.vtxid.pop_back();
+        }
+    }
+
+    // the records read are replaced by the ones left
+    for (const CGatewaysStateKey &key : vRead)
+        states.push_back(std::make_pair(key, CGatewaysStateValue()));
+    for (std::map<uint256, std::pair<CGatewaysStateKey, CGatewaysStateValue> >::const_iterator it = mapStates.begin(); it != mapStates.end(); it++) {
+        if (!it->second.second.IsNull())
+            states.push_back(it->second);
+    }
+    withdraws.insert(withdraws.end(), mapWithdraws.begin(), mapWithdraws.end());
+}
+
 bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
@@ -3193,6 +3730,39 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         }
     }
 
+    if (fCCIndex) {
+        std::vector<std::pair<CContractIndexKey, int32_t> > contractIndex;
+        GetContractIndexEntries(block, pindex->nHeight, contractIndex);
+        if (!pblocktree->EraseContractIndex(contractIndex)) {
+            return AbortNode(state, "Failed to delete cc index");
+        }
+    }
+
+    if (fTokenIndex) {
+        std::vector<std::pair<COutPoint, CTokenOutputValue> > vCreated, vSpent;
+        ReadTokenIndexEntries(block, vCreated, vSpent);
+        if (!pblocktree->EraseTokenIndex(vCreated, vSpent, block.GetHash())) {
+            return AbortNode(state, "Failed to delete token index");
+        }
+    }
+
+    if (fOracleIndex) {
+        std::vector<std::pair<COracleSampleKey, COracleSampleValue> > samples;
+        GetOracleSampleEntries(block, pindex->nHeight, samples);
+        if (!pblocktree->EraseOracleSampleIndex(samples)) {
+            return AbortNode(state, "Failed to delete oracle index");
+        }
+    }
+
+    if (fGatewaysIndex) {
+        std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > states;
+        std::vector<std::pair<uint256, uint256> > withdraws;
+        GetGatewaysIndexEntries(block, false, states, withdraws);
+        if (!pblocktree->UpdateGatewaysIndex(states, withdraws)) {
+            return AbortNode(state, "Failed to delete gateways index");
+        }
+    }
+
     return fClean;
 }
 
@@ -3228,6 +3798,233 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Equihash check of a single received header, run on the header check pool.
+ * The verdict is written to *presult (1 valid, -1 invalid); headers skipped
+ * by the queue after a failure keep 0 and are checked by the caller.
+ */
+class CEquihashCheck
+{
+private:
+    const CBlockHeader *pheader;
+    int8_t *presult;
+
+public:
+    CEquihashCheck(): pheader(NULL), presult(NULL) {}
+    CEquihashCheck(const CBlockHeader *pheaderIn, int8_t *presultIn): pheader(pheaderIn), presult(presultIn) {}
+
+    bool operator()() {
+        bool fValid = CheckEquihashSolution(pheader, Params());
+        *presult = fValid ? 1 : -1;
+        return fValid;
+    }
+
+    void swap(CEquihashCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(presult, check.presult);
+    }
+};
+
+static CCheckQueue<CEquihashCheck> headercheckqueue(8);
+
+void ThreadHeaderCheck() {
+    RenameThread("komodo-hdrcheck");
+    headercheckqueue.Thread();
+}
+
+/**
+ * Verify the Equihash solutions of a headers message on the header check
+ * pool, without holding cs_main. vResults[i] is set to 1/-1 for headers that
+ * were checked and left at 0 for skipped ones (vSkip, or work abandoned after
+ * the first failure), which the caller must still check in order.
+ */
+static void CheckHeadersEquihash(const std::vector<CBlockHeader>& headers, const std::vector<bool>& vSkip, std::vector<int8_t>& vResults)
+{
+    vResults.assign(headers.size(), 0);
+    if (nScriptCheckThreads == 0)
+        return;
+    std::vector<CEquihashCheck> vChecks;
+    vChecks.reserve(headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (!vSkip[i])
+            vChecks.push_back(CEquihashCheck(&headers[i], &vResults[i]));
+    }
+    CCheckQueueControl<CEquihashCheck> control(&headercheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+/**
+ * Read of the coins of one transaction from the coins database, run on the
+ * coins prefetch pool. *pcoins is left pruned if the database has none, or
+ * if the read failed, in which case ConnectBlock reads it again.
+ */
+class CCoinsPrefetch
+{
+private:
+    const uint256 *ptxid;
+    CCoins *pcoins;
+
+public:
+    CCoinsPrefetch(): ptxid(NULL), pcoins(NULL) {}
+    CCoinsPrefetch(const uint256 *ptxidIn, CCoins *pcoinsIn): ptxid(ptxidIn), pcoins(pcoinsIn) {}
+
+    bool operator()() {
+        try {
+            if (!pcoinsdbview->GetCoins(*ptxid, *pcoins))
+                pcoins->Clear();
+        } catch (const std::runtime_error&) {
+            pcoins->Clear();
+        }
+        return true;
+    }
+
+    void swap(CCoinsPrefetch &check) {
+        std::swap(ptxid, check.ptxid);
+        std::swap(pcoins, check.pcoins);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetch> coinsprefetchqueue(128);
+
+void ThreadCoinsPrefetch() {
+    RenameThread("komodo-prefetch");
+    coinsprefetchqueue.Thread();
+}
+
+//! Number of blocks whose inputs are prefetched together during initial block download
+static const int COINS_PREFETCH_BLOCKS = 8;
+//! Number of blocks read ahead of the ones being connected during initial block download
+static const int BLOCK_READ_AHEAD = 2 * COINS_PREFETCH_BLOCKS;
+//! Number of blocks prepared ahead of the one being imported from a block file
+static const size_t BLOCK_IMPORT_READ_AHEAD = 16;
+
+static CBlockReadAhead blockreadahead(BLOCK_READ_AHEAD);
+
+void ThreadBlockReadAhead() {
+    blockreadahead.Thread();
+}
+
+//! Blocks read ahead of ConnectTip whose inputs are already prefetched, by hash
+static std::map<uint256, std::shared_ptr<CBlock> > mapPrefetchedBlocks;
+
+/**
+ * Warm pcoinsTip with the coins spent by the given blocks. The ones it does
+ * not have are read from the coins database in parallel on the prefetch pool,
+ * so ConnectBlock finds them in memory instead of missing one at a time.
+ * Address, spent and timestamp index entries are only written by ConnectBlock,
+ * from the spent coins, so warming the coins covers them too.
+ */
+static void PrefetchBlockInputs(const std::vector<const CBlock*>& vBlocks)
+{
+    AssertLockHeld(cs_main);
+    std::set<uint256> setCreated;
+    for (const CBlock *pblock : vBlocks) {
+        for (const CTransaction &tx : pblock->vtx)
+            setCreated.insert(tx.GetHash());
+    }
+    std::set<uint256> setTxids;
+    for (const CBlock *pblock : vBlocks) {
+        for (const CTransaction &tx : pblock->vtx) {
+            if (tx.IsCoinBase())
+                continue;
+            for (const CTxIn &txin : tx.vin) {
+                const uint256 &hash = txin.prevout.hash;
+                if (setCreated.count(hash) == 0 && !pcoinsTip->HaveCoinsInCache(hash))
+                    setTxids.insert(hash);
+            }
+        }
+    }
+    if (setTxids.size() < 2)
+        return;
+
+    std::vector<uint256> vTxids(setTxids.begin(), setTxids.end());
+    std::vector<CCoins> vCoins(vTxids.size());
+    std::vector<CCoinsPrefetch> vChecks;
+    vChecks.reserve(vTxids.size());
+    for (size_t i = 0; i < vTxids.size(); i++)
+        vChecks.push_back(CCoinsPrefetch(&vTxids[i], &vCoins[i]));
+    {
+        CCheckQueueControl<CCoinsPrefetch> control(&coinsprefetchqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    size_t nFound = 0;
+    for (size_t i = 0; i < vTxids.size(); i++) {
+        if (!vCoins[i].IsPruned()) {
+            pcoinsTip->AddFetchedCoins(vTxids[i], vCoins[i]);
+            nFound++;
+        }
+    }
+    LogPrint("bench", "  - Prefetched coins of %u/%u transactions for %u blocks\n", nFound, vTxids.size(), vBlocks.size());
+}
+
+/**
+ * Prefetch the inputs of the block to connect and, during initial block download,
+ * of the next ones towards pindexMostWork, which are kept for the next calls.
+ * Blocks further ahead are queued on the read-ahead threads meanwhile.
+ * @param pindexConnect the block about to be connected
+ * @param pindexMostWork the tip being connected to
+ * @param pblock the block of pindexMostWork if available, or NULL
+ * @returns the block of pindexConnect if it was read here, NULL otherwise
+ */
+static std::shared_ptr<CBlock> PrefetchConnectBlocks(CBlockIndex *pindexConnect, CBlockIndex *pindexMostWork, CBlock *pblock)
+{
+    if (nScriptCheckThreads == 0 || !KOMODO_NSPV_FULLNODE)
+        return nullptr;
+    bool fInitialDownload = IsInitialBlockDownload();
+    if (fInitialDownload) {
+        int nLastAhead = std::min(pindexConnect->nHeight + BLOCK_READ_AHEAD - 1, pindexMostWork->nHeight);
+        for (int nHeight = pindexConnect->nHeight; nHeight <= nLastAhead; nHeight++) {
+            CBlockIndex *pindex = pindexMostWork->GetAncestor(nHeight);
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || (pindex == pindexMostWork && pblock != NULL))
+                break;
+            if (mapPrefetchedBlocks.count(pindex->GetBlockHash()) == 0 &&
+                    !blockreadahead.Request(pindex->GetBlockHash(), pindex->nHeight, pindex->GetBlockPos()))
+                break;
+        }
+    }
+
+    std::map<uint256, std::shared_ptr<CBlock> >::iterator it = mapPrefetchedBlocks.find(pindexConnect->GetBlockHash());
+    if (it != mapPrefetchedBlocks.end()) {
+        std::shared_ptr<CBlock> pblockConnect = it->second;
+        mapPrefetchedBlocks.erase(it);
+        return pblockConnect;
+    }
+    mapPrefetchedBlocks.clear();
+
+    int nLastHeight = pindexConnect->nHeight;
+    if (fInitialDownload)
+        nLastHeight = std::min(pindexConnect->nHeight + COINS_PREFETCH_BLOCKS - 1, pindexMostWork->nHeight);
+    std::shared_ptr<CBlock> pblockConnect;
+    std::vector<const CBlock*> vBlocks;
+    for (int nHeight = pindexConnect->nHeight; nHeight <= nLastHeight; nHeight++) {
+        CBlockIndex *pindex = pindexMostWork->GetAncestor(nHeight);
+        if (pindex == pindexMostWork && pblock != NULL) {
+            vBlocks.push_back(pblock);
+            break;
+        }
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            break;
+        std::shared_ptr<CBlock> pblockRead = blockreadahead.Take(pindex->GetBlockHash());
+        if (!pblockRead) {
+            pblockRead = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockRead, pindex, 1))
+                break;
+        }
+        vBlocks.push_back(pblockRead.get());
+        if (pindex == pindexConnect)
+            pblockConnect = pblockRead;
+        else
+            mapPrefetchedBlocks[pindex->GetBlockHash()] = pblockRead;
+    }
+    if (!fInitialDownload)
+        blockreadahead.Clear();
+    if (!vBlocks.empty())
+        PrefetchBlockInputs(vBlocks);
+    return pblockConnect;
+}
+
 //
 // Called periodically asynchronously; alerts if it smells like
 // we're being fed a bad chain (blocks being generated much
@@ -3311,6 +4108,46 @@ CCriticalSection& get_cs_main()
     return cs_main;
 }
 
+/*****
+ * @brief check whether a block is buried under the notarized block given by -assumenotarized
+ * @note during IBD the notarization of the block is only recorded after it is connected, so the
+ * header chain stands for it: it must pass through the last hard-coded checkpoint and bury the
+ * block under ASSUMENOTARIZED_MIN_DEPTH headers. A notarization already recorded must agree.
+ * @param pindex the block
+ * @returns true if pindex is an ancestor of the -assumenotarized block and that block is deep enough in the best header chain
+ */
+static bool IsAssumedNotarized(const CBlockIndex* pindex)
+{
+    if (hashAssumeNotarized.IsNull() || pindexBestHeader == nullptr)
+        return false;
+    BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeNotarized);
+    if (it == mapBlockIndex.end() || it->second == nullptr)
+        return false;
+    const CBlockIndex* pindexNotarized = it->second;
+    if (pindexNotarized->GetAncestor(pindex->nHeight) != pindex)
+        return false;
+    if (pindexBestHeader->nHeight - pindexNotarized->nHeight < ASSUMENOTARIZED_MIN_DEPTH ||
+            pindexBestHeader->GetAncestor(pindexNotarized->nHeight) != pindexNotarized)
+        return false;
+    const MapCheckpoints& checkpoints = Params().Checkpoints().mapCheckpoints;
+    if (!checkpoints.empty()) {
+        const CBlockIndex* pindexCheckpoint = pindexBestHeader->GetAncestor(checkpoints.rbegin()->first);
+        if (pindexCheckpoint == nullptr || pindexCheckpoint->GetBlockHash() != checkpoints.rbegin()->second)
+            return false;
+    }
+    uint256 notarizedHash;
+    if (komodo_notarizedhash(pindexNotarized->nHeight, &notarizedHash) && notarizedHash != hashAssumeNotarized)
+    {
+        static bool fWarned;
+        if (!fWarned)
+            LogPrintf("%s: -assumenotarized block %s conflicts with notarization %s at height %d, ignoring it\n",
+                    __func__, hashAssumeNotarized.GetHex(), notarizedHash.GetHex(), pindexNotarized->nHeight);
+        fWarned = true;
+        return false;
+    }
+    return true;
+}
+
 /*****
  * @brief Apply the effects of this block (with given index) on the UTXO set represented by coins
  * @param block the block to add
@@ -3338,6 +4175,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             fExpensiveChecks = false;
         }
     }
+    // Scripts and CryptoConditions of blocks buried under a trusted notarization are
+    // not evaluated. Amounts, UTXOs and shielded proofs are still checked.
+    bool fScriptAndCCChecks = fExpensiveChecks && !IsAssumedNotarized(pindex);
     auto verifier = libzcash::ProofVerifier::Strict();
     auto disabledVerifier = libzcash::ProofVerifier::Disabled();
     int32_t futureblock;
@@ -3451,7 +4291,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
     }
     */
-    CCheckQueueControl<CScriptCheck> control(fExpensiveChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+    CCheckQueueControl<CScriptCheck> control(fScriptAndCCChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
@@ -3459,7 +4299,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     uint64_t valueout;
     int64_t voutsum = 0, prevsum = 0, interest, sum = 0, stakeTxValue = 0;
     unsigned int nSigOps = 0;
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()), fJustCheck ? uint256() : pindex->GetBlockHash());
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
@@ -3592,7 +4432,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             sum += interest;
 
             std::vector<CScriptCheck> vChecks;
-            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, flags, false, txdata[i], chainparams.GetConsensus(), consensusBranchId, nScriptCheckThreads ? &vChecks : NULL))
+            if (!ContextualCheckInputs(tx, state, view, fScriptAndCCChecks, flags, false, txdata[i], chainparams.GetConsensus(), consensusBranchId, nScriptCheckThreads ? &vChecks : NULL))
                 return false;
             control.Add(vChecks);
         }
@@ -3795,6 +4635,39 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->UpdateSpentIndex(spentIndex))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (fCCIndex) {
+        std::vector<std::pair<CContractIndexKey, int32_t> > contractIndex;
+        GetContractIndexEntries(block, pindex->nHeight, contractIndex);
+        if (!pblocktree->WriteContractIndex(contractIndex)) {
+            return AbortNode(state, "Failed to write cc index");
+        }
+    }
+
+    if (fTokenIndex) {
+        std::vector<std::pair<COutPoint, CTokenOutputValue> > vCreated, vSpent;
+        GetTokenIndexEntries(block, vCreated, vSpent);
+        if (!pblocktree->WriteTokenIndex(vCreated, vSpent, block.GetHash())) {
+            return AbortNode(state, "Failed to write token index");
+        }
+    }
+
+    if (fOracleIndex) {
+        std::vector<std::pair<COracleSampleKey, COracleSampleValue> > samples;
+        GetOracleSampleEntries(block, pindex->nHeight, samples);
+        if (!pblocktree->WriteOracleSampleIndex(samples)) {
+            return AbortNode(state, "Failed to write oracle index");
+        }
+    }
+
+    if (fGatewaysIndex) {
+        std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > states;
+        std::vector<std::pair<uint256, uint256> > withdraws;
+        GetGatewaysIndexEntries(block, true, states, withdraws);
+        if (!pblocktree->UpdateGatewaysIndex(states, withdraws)) {
+            return AbortNode(state, "Failed to write gateways index");
+        }
+    }
+
     if (fTimestampIndex)
     {
         unsigned int logicalTS = pindex->nTime;
@@ -4060,6 +4933,9 @@ bool static DisconnectTip(CValidationState &state, bool fBare = false) {
     pindexDelete->zfunds = 0;
 
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
+    // the blocks read ahead were picked towards the tip being disconnected from
+    mapPrefetchedBlocks.clear();
+    blockreadahead.Clear();
     uint256 sproutAnchorAfterDisconnect = pcoinsTip->GetBestAnchor(SPROUT);
     uint256 saplingAnchorAfterDisconnect = pcoinsTip->GetBestAnchor(SAPLING);
     // Write the chain state to disk, if necessary.
@@ -4237,7 +5113,12 @@ bool ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *pblock)
             }
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
-        mapBlockSource.erase(pindexNew->GetBlockHash());
+        std::map<uint256, NodeId>::iterator itSource = mapBlockSource.find(pindexNew->GetBlockHash());
+        if (itSource != mapBlockSource.end()) {
+            if (!IsInitialBlockDownload())
+                MaybeSetPeerAsAnnouncingHeaderAndIDs(itSource->second, true);
+            mapBlockSource.erase(itSource);
+        }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
         if ( KOMODO_NSPV_FULLNODE )
@@ -4494,7 +5375,9 @@ static bool ActivateBestChainStep(bool fSkipdpow, CValidationState &state, CBloc
         // Connect new blocks.
         BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect) 
         {
-            if (!ConnectTip(state, pindexConnect, pindexConnect == pindexMostWork ? pblock : NULL)) 
+            std::shared_ptr<CBlock> pblockPrefetched = PrefetchConnectBlocks(pindexConnect, pindexMostWork, pblock);
+            CBlock *pblockConnect = pblockPrefetched ? pblockPrefetched.get() : (pindexConnect == pindexMostWork ? pblock : NULL);
+            if (!ConnectTip(state, pindexConnect, pblockConnect)) 
             {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
@@ -4519,6 +5402,12 @@ static bool ActivateBestChainStep(bool fSkipdpow, CValidationState &state, CBloc
         }
     }
 
+    // only initial block download reads ahead, what is left of it when it ends is dropped
+    if (!mapPrefetchedBlocks.empty() && !IsInitialBlockDownload()) {
+        mapPrefetchedBlocks.clear();
+        blockreadahead.Clear();
+    }
+
     if (fBlocksDisconnected) {
         mempool.removeForReorg(pcoinsTip, chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
     }
@@ -4575,14 +5464,42 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, CBlock *pblock)
             if (nLocalServices & NODE_NETWORK) 
             {
                 int ht = 0;
+                std::set<NodeId> setCmpctPeers;
                 {
                     LOCK(cs_main);
                     ht = chainActive.Height();
+                    for (map<NodeId, CNodeState>::iterator it = mapNodeState.begin(); it != mapNodeState.end(); ++it)
+                        if (it->second.fPreferHeaderAndIDs)
+                            setCmpctPeers.insert(it->first);
+                }
+                // Peers that asked for high-bandwidth relay get the compact block right away instead of an inv
+                std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock;
+                if (!setCmpctPeers.empty()) {
+                    if (pblock && pblock->GetHash() == hashNewTip)
+                        pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
+                    else {
+                        CBlock block;
+                        if (ReadBlockFromDisk(block, pindexNewTip, 1))
+                            pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(block);
+                    }
                 }
+                CInv inv(MSG_BLOCK, hashNewTip);
                 LOCK(cs_vNodes);
                 for(CNode* pnode : vNodes)
-                    if (ht > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                        pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                    if (ht > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate)) {
+                        if (pcmpctblock && setCmpctPeers.count(pnode->GetId())) {
+                            bool fKnown;
+                            {
+                                LOCK(pnode->cs_inventory);
+                                fKnown = pnode->setInventoryKnown.count(inv) != 0;
+                            }
+                            if (!fKnown) {
+                                pnode->AddInventoryKnown(inv);
+                                pnode->PushMessage("cmpctblock", *pcmpctblock);
+                            }
+                        } else
+                            pnode->PushInventory(inv);
+                    }
             }
             // Notify external listeners about the new tip.
             GetMainSignals().UpdatedBlockTip(pindexNewTip);
@@ -5173,7 +6090,7 @@ bool CheckBlock(int32_t *futureblockp, int32_t height, CBlockIndex *pindex, cons
     if (fCheckMerkleRoot) 
     {
         bool mutated;
-        uint256 hashMerkleRoot2 = block.BuildMerkleTree(&mutated);
+        uint256 hashMerkleRoot2 = block.GetMerkleRoot(&mutated);
         if (block.hashMerkleRoot != hashMerkleRoot2)
             return state.DoS(100, error("CheckBlock: hashMerkleRoot mismatch"),
                              REJECT_INVALID, "bad-txnmrklroot", true);
@@ -5948,6 +6865,8 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        mappedBlockFiles.Erase(*it);
+        mappedUndoFiles.Erase(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -6129,7 +7048,14 @@ bool static LoadBlockIndexDB()
         CBlockIndex* pindex = item.second;
         vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
+    // Break height ties by hash rather than by pointer value: the index
+    // objects are allocated by several loader threads.
+    sort(vSortedByHeight.begin(), vSortedByHeight.end(),
+        [](const pair<int, CBlockIndex*>& a, const pair<int, CBlockIndex*>& b) {
+            if (a.first != b.first)
+                return a.first < b.first;
+            return a.second->GetBlockHash() < b.second->GetBlockHash();
+        });
 
     for(const auto& item : vSortedByHeight)
     {
@@ -6264,6 +7190,9 @@ bool static LoadBlockIndexDB()
     // Check whether we have an address index
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
+    bool fBalances = false;
+    pblocktree->ReadFlag("addressbalanceindex", fBalances);
+    fAddressBalanceIndex = fBalances;
 
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
@@ -6273,6 +7202,22 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
+    // Check whether we have a cc index
+    pblocktree->ReadFlag("ccindex", fCCIndex);
+    LogPrintf("%s: cc index %s\n", __func__, fCCIndex ? "enabled" : "disabled");
+
+    // Check whether we have a token index
+    pblocktree->ReadFlag("tokenindex", fTokenIndex);
+    LogPrintf("%s: token index %s\n", __func__, fTokenIndex ? "enabled" : "disabled");
+
+    // Check whether we have an oracle index
+    pblocktree->ReadFlag("oracleindex", fOracleIndex);
+    LogPrintf("%s: oracle index %s\n", __func__, fOracleIndex ? "enabled" : "disabled");
+
+    // Check whether we have a gateways index
+    pblocktree->ReadFlag("gatewaysindex", fGatewaysIndex);
+    LogPrintf("%s: gateways index %s\n", __func__, fGatewaysIndex ? "enabled" : "disabled");
+
     // Fill in-memory data
     for(const auto& item : mapBlockIndex)
     {
@@ -6651,6 +7596,9 @@ bool InitBlockIndex()
         // Use the provided setting for -addressindex in the new database
         fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
         pblocktree->WriteFlag("addressindex", fAddressIndex);
+        // a new address index keeps the address balances from the start
+        fAddressBalanceIndex = fAddressIndex;
+        pblocktree->WriteFlag("addressbalanceindex", fAddressIndex);
         
         // Use the provided setting for -timestampindex in the new database
         fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -6658,6 +7606,18 @@ bool InitBlockIndex()
         
         fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
         pblocktree->WriteFlag("spentindex", fSpentIndex);
+
+        fCCIndex = GetBoolArg("-ccindex", DEFAULT_CCINDEX);
+        pblocktree->WriteFlag("ccindex", fCCIndex);
+
+        fTokenIndex = GetBoolArg("-tokenindex", DEFAULT_TOKENINDEX);
+        pblocktree->WriteFlag("tokenindex", fTokenIndex);
+
+        fOracleIndex = GetBoolArg("-oracleindex", DEFAULT_ORACLEINDEX);
+        pblocktree->WriteFlag("oracleindex", fOracleIndex);
+
+        fGatewaysIndex = GetBoolArg("-gatewaysindex", DEFAULT_GATEWAYSINDEX);
+        pblocktree->WriteFlag("gatewaysindex", fGatewaysIndex);
         fprintf(stderr,"fAddressIndex.%d/%d fSpentIndex.%d/%d\n",fAddressIndex,DEFAULT_ADDRESSINDEX,fSpentIndex,DEFAULT_SPENTINDEX);
         LogPrintf("Initializing databases...\n");
     }
@@ -6701,44 +7661,18 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        //CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE(10000000), MAX_BLOCK_SIZE(10000000)+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        // Blocks are read and prepared on a background thread while earlier ones are processed
+        CBlockFileReader reader(fileIn, BLOCK_IMPORT_READ_AHEAD);
+        std::shared_ptr<CBlock> pblockRead;
+        uint64_t nBlockPos;
+        while (reader.Next(pblockRead, nBlockPos)) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
             try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE(10000000))
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                CBlock block;
-                uint64_t nBlockPos = blkdat.GetPos();
+                CBlock &block = *pblockRead;
                 if (dbp)
                     dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                blkdat >> block;
-                
-                nRewind = blkdat.GetPos();
+
                 // detect out of order blocks, and store them for later
                 uint256 hash = block.GetHash();
                 if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
@@ -7107,7 +8041,7 @@ void static ProcessGetData(CNode* pfrom)
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
             {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
@@ -7132,24 +8066,42 @@ void static ProcessGetData(CNode* pfrom)
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
                 {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second,1))
+                    if (inv.type == MSG_CMPCT_BLOCK && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH)
                     {
-                        assert(!"cannot load block from disk");
+                        // The peer can only rebuild recent blocks from its mempool
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second,1))
+                        {
+                            assert(!"cannot load block from disk");
+                        }
+                        else
+                        {
+                            CBlockHeaderAndShortTxIDs cmpctblock(block);
+                            pfrom->PushMessage("cmpctblock", cmpctblock);
+                        }
+                    }
+                    else if (inv.type == MSG_BLOCK || inv.type == MSG_CMPCT_BLOCK)
+                    {
+                        // Send the block as stored on disk, it is already in network format
+                        CRawBlockRef raw = GetRawBlock((*mi).second);
+                        if (!raw)
+                        {
+                            assert(!"cannot load block from disk");
+                        }
+                        else
+                        {
+                            pfrom->PushMessage("block", CFlatData((void*)raw->data(), (void*)(raw->data() + raw->size())));
+                        }
                     }
-                    else
+                    else // MSG_FILTERED_BLOCK)
                     {
-                        if (inv.type == MSG_BLOCK)
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(block, (*mi).second,1))
                         {
-                            //uint256 hash; int32_t z;
-                            //hash = block.GetHash();
-                            //for (z=31; z>=0; z--)
-                            //    fprintf(stderr,"%02x",((uint8_t *)&hash)[z]);
-                            //fprintf(stderr," send block %d\n",komodo_block2height(&block));
-                            pfrom->PushMessage("block", block);
+                            assert(!"cannot load block from disk");
                         }
-                        else // MSG_FILTERED_BLOCK)
+                        else
                         {
                             LOCK(pfrom->cs_filter);
                             if (pfrom->pfilter)
@@ -7211,7 +8163,7 @@ void static ProcessGetData(CNode* pfrom)
                 }
             }
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -7236,8 +8188,51 @@ void static ProcessGetData(CNode* pfrom)
 #include "komodo_nSPV_superlite.h"  // nSPV superlite client, issuing requests and handling nSPV responses
 #include "komodo_nSPV_wallet.h"     // nSPV_send and support functions, really all the rest is to support this
 
+/** Serve an nSPV request, with cs_main held for the ones reading the chain outside of the address index */
+static void ProcessNSPVRequest(CNode* pfrom, const std::vector<uint8_t>& request)
+{
+    if (!request.empty() && NSPV_needschainlock(request[0])) {
+        LOCK(cs_main);
+        komodo_nSPVreq(pfrom, request);
+    } else
+        komodo_nSPVreq(pfrom, request);
+}
+
+//! nSPV requests queued by a peer before the message handler stops reading from it
+static const size_t NSPV_MAX_PEER_REQUESTS = 8;
+//! nSPV requests queued in total before the message handler stops reading from the peers with queued requests
+static const size_t NSPV_MAX_QUEUED_REQUESTS = 1024;
+
+static CNSPVRequestQueue nspvrequestqueue(&ProcessNSPVRequest, NSPV_MAX_PEER_REQUESTS, NSPV_MAX_QUEUED_REQUESTS);
+
+void ThreadNSPVRequests() {
+    RenameThread("komodo-nspv");
+    nspvrequestqueue.Thread();
+}
+
 void komodo_netevent(std::vector<uint8_t> payload);
 
+/** Process a block received from a peer in full or rebuilt from a compact block, must be called without cs_main */
+static void ProcessBlockFromPeer(CNode* pfrom, CBlock& block, const string& strCommand)
+{
+    CValidationState state;
+    // Process all blocks from whitelisted peers, even if not requested,
+    // unless we're still syncing with the network.
+    // Such an unrequested block may still be processed, subject to the
+    // conditions in AcceptBlock().
+    bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload();
+    ProcessNewBlock(0,0,state, pfrom, &block, forceProcessing, NULL);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     int32_t nProtocolVersion;
@@ -7433,6 +8428,15 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        // Tell the peer we understand compact blocks, without asking for them to be announced yet.
+        // Peers that don't know "sendcmpct" ignore it.
+        if ( !KOMODO_NSPV_SUPERLITE )
+        {
+            bool fAnnounceUsingCMPCTBLOCK = false;
+            uint64_t nCMPCTBLOCKVersion = CMPCTBLOCKS_VERSION;
+            pfrom->PushMessage("sendcmpct", fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+        }
     }
 
 
@@ -7663,7 +8667,12 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         vRecv >> payload;
 
         if (strCommand == "getnSPV" && KOMODO_NSPV == 0) {
-            komodo_nSPVreq(pfrom, payload);
+            // Served by the nSPV request threads, cheap requests first, so that address
+            // scans and proofs don't hold up the other messages
+            if (nNSPVThreads > 0 && !payload.empty())
+                nspvrequestqueue.Push(pfrom, payload, NSPV_ischeapreq(payload[0]));
+            else
+                ProcessNSPVRequest(pfrom, payload);
         } else if (strCommand == "nSPV" && KOMODO_NSPV_SUPERLITE) {
             komodo_nSPVresp(pfrom, payload);
         }
@@ -7671,6 +8680,19 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
     else if ( KOMODO_NSPV_SUPERLITE )
         return(true);
+    else if (strCommand == "sendcmpct")
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            LOCK(cs_main);
+            CNodeState *nodestate = State(pfrom->GetId());
+            nodestate->fProvidesHeaderAndIDs = true;
+            nodestate->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+            MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom->GetId(), false);
+        }
+    }
     else if (strCommand == "inv")
     {
         vector<CInv> vInv;
@@ -7713,7 +8735,11 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     CNodeState *nodestate = State(pfrom->GetId());
                     if (chainActive.Tip()->GetBlockTime() > GetTime() - chainparams.GetConsensus().nPowTargetSpacing * 20 &&
                         nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
-                        vToFetch.push_back(inv);
+                        // Peers that understand compact blocks send them, we rebuild the block from our mempool
+                        if (nodestate->fProvidesHeaderAndIDs && !IsInitialBlockDownload())
+                            vToFetch.push_back(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                        else
+                            vToFetch.push_back(inv);
                         // Mark block as in flight already, even though the actual "getdata" message only goes out
                         // later (within the same cs_main lock, though).
                         MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
@@ -7996,13 +9022,25 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
-        LOCK(cs_main);
-
         if (nCount == 0) {
             // Nothing interesting. Stop asking this peers for more headers.
             return true;
         }
 
+        // Check the Equihash solutions of headers we don't know yet on the
+        // header check pool before taking cs_main; they are still accepted
+        // one by one, in order, below.
+        std::vector<bool> vKnown(nCount);
+        {
+            LOCK(cs_main);
+            for (unsigned int n = 0; n < nCount; n++)
+                vKnown[n] = mapBlockIndex.count(headers[n].GetHash()) != 0;
+        }
+        std::vector<int8_t> vEquihashValid;
+        CheckHeadersEquihash(headers, vKnown, vEquihashValid);
+
+        LOCK(cs_main);
+
         bool hasNewHeaders = true;
 
         // only KMD have checkpoints in sources, so, using IsInitialBlockDownload() here is
@@ -8029,7 +9067,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
 
         CBlockIndex *pindexLast = NULL;
-        BOOST_FOREACH(const CBlockHeader& header, headers) {
+        for (unsigned int n = 0; n < nCount; n++) {
+            const CBlockHeader& header = headers[n];
             //printf("size.%i, solution size.%i\n", (int)sizeof(header), (int)header.nSolution.size());
             //printf("hash.%s prevhash.%s nonce.%s\n", header.GetHash().ToString().c_str(), header.hashPrevBlock.ToString().c_str(), header.nNonce.ToString().c_str());
 
@@ -8038,8 +9077,12 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 Misbehaving(pfrom->GetId(), 20);
                 return error("non-continuous headers sequence");
             }
-            int32_t futureblock;
-            if (!AcceptBlockHeader(&futureblock,header, state, &pindexLast)) {
+            int32_t futureblock = 0;
+            if (!vKnown[n] && vEquihashValid[n] == 0)
+                vEquihashValid[n] = CheckEquihashSolution(&header, Params()) ? 1 : -1;
+            if (vEquihashValid[n] < 0)
+                state.DoS(100, error("%s: Equihash solution invalid", __func__), REJECT_INVALID, "invalid-solution");
+            if (vEquihashValid[n] < 0 || !AcceptBlockHeader(&futureblock,header, state, &pindexLast)) {
                 int nDoS;
                 if (state.IsInvalid(nDoS) && futureblock == 0)
                 {
@@ -8086,23 +9129,201 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
         pfrom->AddInventoryKnown(inv);
 
-        CValidationState state;
-        // Process all blocks from whitelisted peers, even if not requested,
-        // unless we're still syncing with the network.
-        // Such an unrequested block may still be processed, subject to the
-        // conditions in AcceptBlock().
-        bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload();
-        ProcessNewBlock(0,0,state, pfrom, &block, forceProcessing, NULL);
-        int nDoS;
-        if (state.IsInvalid(nDoS)) {
-            pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
+        ProcessBlockFromPeer(pfrom, block, strCommand);
+    }
+
+
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        const uint256 hash = cmpctblock.header.GetHash();
+        CInv inv(MSG_BLOCK, hash);
+        LogPrint("net", "received cmpctblock %s peer=%d\n", hash.ToString(), pfrom->id);
+
+        pfrom->AddInventoryKnown(inv);
+
+        // Check the Equihash solution of a new header before taking cs_main, like "headers"
+        bool fKnown;
+        {
+            LOCK(cs_main);
+            fKnown = mapBlockIndex.count(hash) != 0;
+        }
+        if (!fKnown && !CheckEquihashSolution(&cmpctblock.header, chainparams)) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100);
+            return error("cmpctblock %s with invalid Equihash solution from peer=%d", hash.ToString(), pfrom->id);
+        }
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
+                // The block doesn't connect to our headers, ask for the ones leading to it
+                if (!IsInitialBlockDownload())
+                    pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256());
+                return true;
             }
+
+            CBlockIndex *pindex = NULL;
+            CValidationState state;
+            int32_t futureblock = 0;
+            if (!AcceptBlockHeader(&futureblock, cmpctblock.header, state, &pindex)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && futureblock == 0) {
+                    if (nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS);
+                    return error("invalid header received in cmpctblock from peer=%d", pfrom->id);
+                }
+                return true;
+            }
+            if (pindex == NULL)
+                return true;
+            UpdateBlockAvailability(pfrom->GetId(), hash);
+
+            // Nothing to rebuild if we have the block already or it doesn't extend our best chain
+            if ((pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nChainWork <= chainActive.Tip()->nChainWork)
+                return true;
+
+            CNodeState *nodestate = State(pfrom->GetId());
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator blockInFlightIt = mapBlocksInFlight.find(hash);
+            if (blockInFlightIt != mapBlocksInFlight.end() && blockInFlightIt->second.first != pfrom->GetId()) {
+                // Another peer is sending the block already, only use this one if the mempool has everything
+                PartiallyDownloadedBlock tempBlock(&mempool);
+                if (tempBlock.InitData(cmpctblock) == READ_STATUS_OK &&
+                    tempBlock.FillBlock(block, std::vector<CTransaction>()) == READ_STATUS_OK) {
+                    nodestate->nCmpctBlocksReconstructed++;
+                    fBlockReconstructed = true;
+                }
+            } else {
+                list<QueuedBlock>::iterator it;
+                if (blockInFlightIt != mapBlocksInFlight.end()) {
+                    // Requested from this peer with MSG_CMPCT_BLOCK
+                    it = blockInFlightIt->second.second;
+                    if (it->partialBlock)
+                        return true; // duplicate cmpctblock
+                } else {
+                    // Announced unrequested by a peer we asked for high-bandwidth relay
+                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER)
+                        return true;
+                    MarkBlockAsInFlight(pfrom->GetId(), hash, chainparams.GetConsensus(), pindex, &it);
+                }
+
+                it->partialBlock = std::make_shared<PartiallyDownloadedBlock>(&mempool);
+                PartiallyDownloadedBlock& partialBlock = *it->partialBlock;
+                ReadStatus status = partialBlock.InitData(cmpctblock);
+                if (status == READ_STATUS_INVALID) {
+                    MarkBlockAsReceived(hash); // Reset in-flight state in case of whitelist
+                    Misbehaving(pfrom->GetId(), 100);
+                    return error("peer=%d sent us an invalid cmpctblock", pfrom->id);
+                } else if (status == READ_STATUS_FAILED) {
+                    // Short id collision, the block stays in flight and is requested in full
+                    it->partialBlock.reset();
+                    std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                    pfrom->PushMessage("getdata", vInv);
+                    return true;
+                }
+
+                BlockTransactionsRequest req;
+                for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                    if (!partialBlock.IsTxAvailable(i))
+                        req.indexes.push_back(i);
+                }
+                if (req.indexes.empty()) {
+                    status = partialBlock.FillBlock(block, std::vector<CTransaction>());
+                    it->partialBlock.reset();
+                    if (status == READ_STATUS_OK) {
+                        nodestate->nCmpctBlocksReconstructed++;
+                        fBlockReconstructed = true;
+                    } else {
+                        std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                        pfrom->PushMessage("getdata", vInv);
+                    }
+                } else {
+                    req.blockhash = hash;
+                    nodestate->nCmpctBlocksTxnRequested++;
+                    pfrom->PushMessage("getblocktxn", req);
+                }
+            }
+        }
+
+        if (fBlockReconstructed)
+            ProcessBlockFromPeer(pfrom, block, strCommand);
+    }
+
+
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+        if (it == mapBlockIndex.end() || it->second == NULL || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "peer=%d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+        // Only the recent blocks of our chain are served this way, older ones are fetched in full
+        if (!chainActive.Contains(it->second) || it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            LogPrint("net", "peer=%d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            return true;
         }
 
+        CBlock block;
+        if (!ReadBlockFromDisk(block, it->second, 1))
+            return error("getblocktxn: unable to read block %s", req.blockhash.ToString());
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer=%d sent us a getblocktxn with out-of-bounds tx indexes", pfrom->id);
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator it = mapBlocksInFlight.find(resp.blockhash);
+            if (it == mapBlocksInFlight.end() || it->second.first != pfrom->GetId() || !it->second.second->partialBlock) {
+                LogPrint("net", "peer=%d sent us blocktxn for a block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            std::shared_ptr<PartiallyDownloadedBlock> partialBlock = it->second.second->partialBlock;
+            it->second.second->partialBlock.reset();
+            ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer=%d sent us a blocktxn not matching the cmpctblock", pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // Short id collision, the block stays in flight and is requested in full
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, resp.blockhash));
+                pfrom->PushMessage("getdata", vInv);
+            } else {
+                State(pfrom->GetId())->nCmpctBlocksReconstructed++;
+                fBlockReconstructed = true;
+            }
+        }
+
+        if (fBlockReconstructed)
+            ProcessBlockFromPeer(pfrom, block, strCommand);
     }
 
 
@@ -8277,6 +9498,7 @@ bool ProcessMessages(CNode* pfrom)
     //  (x) data
     //
     bool fOk = true;
+    pfrom->fPauseRecv = false;
 
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom);
@@ -8290,6 +9512,13 @@ bool ProcessMessages(CNode* pfrom)
         if (pfrom->nSendSize >= SendBufferSize())
             break;
 
+        // Read no more from a peer whose nSPV requests are still queued, the queue
+        // wakes the message handler once it has served one
+        if (nNSPVThreads > 0 && nspvrequestqueue.IsBusy(pfrom->GetId())) {
+            pfrom->fPauseRecv = true;
+            break;
+        }
+
         // get next message
         CNetMessage& msg = *it;
 
@@ -26,6 +26,7 @@
 #endif
 
 #include "amount.h"
+#include "blockreader.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "coins.h"
@@ -45,6 +46,7 @@
 #include "uint256.h"
 
 #include <algorithm>
+#include <atomic>
 #include <exception>
 #include <map>
 #include <set>
@@ -57,6 +59,7 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewDB;
 class CBloomFilter;
 class CInv;
 class CScriptCheck;
@@ -95,6 +98,8 @@ static const unsigned int MAX_TEMPFILE_SIZE = 0x1000000; // 16 MiB 0x8000000
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** -mmapblockfiles default (number of finalized blk/rev files kept memory-mapped for reads, 0 = disabled) */
+static const int DEFAULT_MMAP_BLOCK_FILES = 0;
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
@@ -121,12 +126,19 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 
 /** Default NSPV support enabled */
 static const bool DEFAULT_NSPV_PROCESSING = false;
+/** Threads serving the nSPV requests of light clients, 0 serves them on the message handler thread */
+static const int DEFAULT_NSPV_THREADS = 2;
+static const int MAX_NSPV_THREADS = 16;
 
 //static const bool DEFAULT_ADDRESSINDEX = false;
 //static const bool DEFAULT_SPENTINDEX = false;
 #define DEFAULT_ADDRESSINDEX (GetArg("-ac_cc",0) != 0 || GetArg("-ac_ccactivate",0) != 0)
 #define DEFAULT_SPENTINDEX (GetArg("-ac_cc",0) != 0 || GetArg("-ac_ccactivate",0) != 0)
 static const bool DEFAULT_TIMESTAMPINDEX = false;
+static const bool DEFAULT_CCINDEX = false;
+static const bool DEFAULT_TOKENINDEX = false;
+static const bool DEFAULT_ORACLEINDEX = false;
+static const bool DEFAULT_GATEWAYSINDEX = false;
 static const unsigned int DEFAULT_DB_MAX_OPEN_FILES = 1000;
 static const bool DEFAULT_DB_COMPRESSION = true;
 
@@ -158,10 +170,17 @@ extern bool fExperimentalMode;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nNSPVThreads;
 extern bool fTxIndex;
+/** Whether the address balances are complete, false while they are backfilled for an older address index */
+extern std::atomic<bool> fAddressBalanceIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Block hash given by -assumenotarized, null if not set */
+extern uint256 hashAssumeNotarized;
+/** Headers the best header chain must have above the -assumenotarized block before its ancestors skip script checks (about a day) */
+static const int ASSUMENOTARIZED_MIN_DEPTH = 1440;
 // TODO: remove this flag by structuring our code such that
 // it is unneeded for testing
 extern bool fCoinbaseEnforcedProtectionEnabled;
@@ -253,6 +272,14 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header Equihash checking thread */
+void ThreadHeaderCheck();
+/** Run an instance of the coins prefetching thread */
+void ThreadCoinsPrefetch();
+/** Run an instance of the block read-ahead thread */
+void ThreadBlockReadAhead();
+/** Run an instance of the nSPV request thread */
+void ThreadNSPVRequests();
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
@@ -329,6 +356,9 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    bool fProvidesHeaderAndIDs;
+    int nCmpctBlocksReconstructed;
+    int nCmpctBlocksTxnRequested;
 };
 
 struct CTimestampIndexIteratorKey {
@@ -663,19 +693,409 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
-struct CDiskTxPos : public CDiskBlockPos
-{
-    unsigned int nTxOffset; // after header
+/** Running totals of the address index records of an address, keyed by CAddressIndexIteratorKey */
+struct CAddressBalanceValue {
+    CAmount received;   //!< sum of the outputs to the address (including change)
+    CAmount sent;       //!< sum of the outputs of the address spent
+    int64_t txcount;    //!< transactions with an output to or an input from the address
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(received);
+        READWRITE(sent);
+        READWRITE(txcount);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        received = 0;
+        sent = 0;
+        txcount = 0;
+    }
+
+    bool IsNull() const {
+        return (received == 0 && sent == 0 && txcount == 0);
+    }
+
+    CAmount Balance() const {
+        return received - sent;
+    }
+};
+
+/** A transaction with a CC opreturn, by evalcode and funcid of the opreturn (or of the module data in a tokens opreturn) */
+struct CContractIndexKey {
+    uint8_t evalcode;
+    uint8_t funcid;
+    int blockHeight;
+    uint256 txhash;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 38;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, evalcode);
+        ser_writedata8(s, funcid);
+        // Heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, blockHeight);
+        txhash.Serialize(s);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        evalcode = ser_readdata8(s);
+        funcid = ser_readdata8(s);
+        blockHeight = ser_readdata32be(s);
+        txhash.Unserialize(s);
+    }
+
+    CContractIndexKey(uint8_t evalcodeIn, uint8_t funcidIn, int height, uint256 txid) {
+        evalcode = evalcodeIn;
+        funcid = funcidIn;
+        blockHeight = height;
+        txhash = txid;
+    }
+
+    CContractIndexKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        evalcode = 0;
+        funcid = 0;
+        blockHeight = 0;
+        txhash.SetNull();
+    }
+};
+
+struct CContractIndexIteratorKey {
+    uint8_t evalcode;
+    uint8_t funcid;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 2;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        ser_writedata8(s, evalcode);
+        ser_writedata8(s, funcid);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        evalcode = ser_readdata8(s);
+        funcid = ser_readdata8(s);
+    }
+
+    CContractIndexIteratorKey(uint8_t evalcodeIn, uint8_t funcidIn) {
+        evalcode = evalcodeIn;
+        funcid = funcidIn;
+    }
+
+    CContractIndexIteratorKey() {
+        evalcode = 0;
+        funcid = 0;
+    }
+};
+
+/** A tokens output, keyed by its outpoint. Kept once spent, so that a disconnected block can give its inputs back */
+struct CTokenOutputValue {
+    uint256 tokenid;
+    uint160 addressHash;    //!< hash of the CC address of the output
+    CAmount satoshis;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tokenid);
+        READWRITE(addressHash);
+        READWRITE(satoshis);
+    }
+
+    CTokenOutputValue(const uint256 &tokenidIn, const uint160 &addressHashIn, CAmount satoshisIn) {
+        tokenid = tokenidIn;
+        addressHash = addressHashIn;
+        satoshis = satoshisIn;
+    }
+
+    CTokenOutputValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        tokenid.SetNull();
+        addressHash.SetNull();
+        satoshis = 0;
+    }
+
+    bool IsNull() const {
+        return tokenid.IsNull();
+    }
+};
+
+/** Totals of a token, keyed by its tokenid */
+struct CTokenSupplyValue {
+    CAmount supply;     //!< sum of the tokens outputs of the token creation transaction
+    int64_t holders;    //!< addresses with a balance of the token
 
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(*(CDiskBlockPos*)this);
-        READWRITE(VARINT(nTxOffset));
+        READWRITE(supply);
+        READWRITE(holders);
+    }
+
+    CTokenSupplyValue() {
+        SetNull();
     }
 
-    CDiskTxPos(const CDiskBlockPos &blockIn, unsigned int nTxOffsetIn) : CDiskBlockPos(blockIn.nFile, blockIn.nPos), nTxOffset(nTxOffsetIn) {
+    void SetNull() {
+        supply = 0;
+        holders = 0;
+    }
+
+    bool IsNull() const {
+        return (supply == 0 && holders == 0);
+    }
+};
+
+/** An oracle data sample, by oracle, publisher and height */
+struct COracleSampleKey {
+    uint256 oracletxid;
+    uint160 publisherHash;  //!< hash of the baton CC address of the publisher
+    int blockHeight;
+    uint256 txhash;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 88;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        oracletxid.Serialize(s);
+        publisherHash.Serialize(s);
+        // Heights are stored big-endian for key sorting in LevelDB
+        ser_writedata32be(s, blockHeight);
+        txhash.Serialize(s);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        oracletxid.Unserialize(s);
+        publisherHash.Unserialize(s);
+        blockHeight = ser_readdata32be(s);
+        txhash.Unserialize(s);
+    }
+
+    COracleSampleKey(const uint256 &oracletxidIn, const uint160 &publisherHashIn, int height, const uint256 &txid) {
+        oracletxid = oracletxidIn;
+        publisherHash = publisherHashIn;
+        blockHeight = height;
+        txhash = txid;
+    }
+
+    COracleSampleKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        oracletxid.SetNull();
+        publisherHash.SetNull();
+        blockHeight = 0;
+        txhash.SetNull();
+    }
+};
+
+struct COracleSampleIteratorKey {
+    uint256 oracletxid;
+    uint160 publisherHash;
+    int blockHeight;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 56;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        oracletxid.Serialize(s);
+        publisherHash.Serialize(s);
+        ser_writedata32be(s, blockHeight);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        oracletxid.Unserialize(s);
+        publisherHash.Unserialize(s);
+        blockHeight = ser_readdata32be(s);
+    }
+
+    COracleSampleIteratorKey(const uint256 &oracletxidIn, const uint160 &publisherHashIn, int height) {
+        oracletxid = oracletxidIn;
+        publisherHash = publisherHashIn;
+        blockHeight = height;
+    }
+
+    COracleSampleIteratorKey() {
+        oracletxid.SetNull();
+        publisherHash.SetNull();
+        blockHeight = 0;
+    }
+};
+
+/** The publisher and the data of an oracle data sample, as in its opreturn */
+struct COracleSampleValue {
+    CPubKey publisher;
+    std::vector<uint8_t> data;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(publisher);
+        READWRITE(data);
+    }
+
+    COracleSampleValue(const CPubKey &publisherIn, const std::vector<uint8_t> &dataIn) {
+        publisher = publisherIn;
+        data = dataIn;
+    }
+
+    COracleSampleValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        publisher = CPubKey();
+        data.clear();
+    }
+};
+
+/**
+ * A deposit or a withdraw of a gateways bind, by the stage of its lifecycle:
+ * 'D' deposited, 'C' claimed, 'W' withdrawn (or partially signed), 'S' signing complete, 'M' marked done
+ */
+struct CGatewaysStateKey {
+    uint256 bindtxid;
+    uint8_t stage;
+    uint256 origintxid;     //!< the deposit or withdraw transaction
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 65;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        bindtxid.Serialize(s);
+        ser_writedata8(s, stage);
+        origintxid.Serialize(s);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        bindtxid.Unserialize(s);
+        stage = ser_readdata8(s);
+        origintxid.Unserialize(s);
+    }
+
+    CGatewaysStateKey(const uint256 &bindtxidIn, uint8_t stageIn, const uint256 &origintxidIn) {
+        bindtxid = bindtxidIn;
+        stage = stageIn;
+        origintxid = origintxidIn;
+    }
+
+    CGatewaysStateKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        bindtxid.SetNull();
+        stage = 0;
+        origintxid.SetNull();
+    }
+};
+
+struct CGatewaysStateIteratorKey {
+    uint256 bindtxid;
+    uint8_t stage;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 33;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        bindtxid.Serialize(s);
+        ser_writedata8(s, stage);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        bindtxid.Unserialize(s);
+        stage = ser_readdata8(s);
+    }
+
+    CGatewaysStateIteratorKey(const uint256 &bindtxidIn, uint8_t stageIn) {
+        bindtxid = bindtxidIn;
+        stage = stageIn;
+    }
+
+    CGatewaysStateIteratorKey() {
+        bindtxid.SetNull();
+        stage = 0;
+    }
+};
+
+/** The transactions of the lifecycle of a deposit or a withdraw so far, the deposit or withdraw first */
+struct CGatewaysStateValue {
+    std::vector<uint256> vtxid;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vtxid);
+    }
+
+    CGatewaysStateValue(const uint256 &origintxid) {
+        vtxid.push_back(origintxid);
+    }
+
+    CGatewaysStateValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        vtxid.clear();
+    }
+
+    bool IsNull() const {
+        return vtxid.empty();
+    }
+};
+
+struct CDiskTxPos : public CDiskBlockPos
+{
+    unsigned int nTxOffset; // after header
+    uint256 hashBlock; // hash of the containing block, null for entries written by older versions
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        ::Serialize(s, *(const CDiskBlockPos*)this);
+        ::Serialize(s, VARINT(nTxOffset));
+        // Appended only when known, so entries stay readable by older versions
+        // (which ignore trailing bytes) and old entries stay readable by us.
+        if (!hashBlock.IsNull())
+            ::Serialize(s, hashBlock);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        ::Unserialize(s, *(CDiskBlockPos*)this);
+        ::Unserialize(s, VARINT(nTxOffset));
+        if (!s.empty())
+            ::Unserialize(s, hashBlock);
+        else
+            hashBlock.SetNull();
+    }
+
+    CDiskTxPos(const CDiskBlockPos &blockIn, unsigned int nTxOffsetIn, const uint256 &hashBlockIn = uint256()) : CDiskBlockPos(blockIn.nFile, blockIn.nPos), nTxOffset(nTxOffsetIn), hashBlock(hashBlockIn) {
     }
 
     CDiskTxPos() {
@@ -685,6 +1105,7 @@ struct CDiskTxPos : public CDiskBlockPos
     void SetNull() {
         CDiskBlockPos::SetNull();
         nTxOffset = 0;
+        hashBlock.SetNull();
     }
 };
 
@@ -811,6 +1232,9 @@ public:
     CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, uint32_t consensusBranchIdIn, PrecomputedTransactionData* txdataIn) :
         scriptPubKey(CCoinsViewCache::GetSpendFor(&txFromIn, txToIn.vin[nInIn])), amount(txFromIn.vout[txToIn.vin[nInIn].prevout.n].nValue),
         ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), consensusBranchId(consensusBranchIdIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
+    CScriptCheck(const CTxOut& outFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, uint32_t consensusBranchIdIn, PrecomputedTransactionData* txdataIn) :
+        scriptPubKey(outFromIn.scriptPubKey), amount(outFromIn.nValue),
+        ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), consensusBranchId(consensusBranchIdIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
 
@@ -836,12 +1260,55 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Read the transactions with a CC opreturn of this evalcode and funcid, in height order, with the vout of their opreturn */
+bool GetContractIndex(uint8_t evalcode, uint8_t funcid, std::vector<std::pair<CContractIndexKey, int32_t> > &contractIndex);
+/** The CC index records of a block, written on connect and erased on disconnect */
+void GetContractIndexEntries(const CBlock &block, int nHeight, std::vector<std::pair<CContractIndexKey, int32_t> > &contractIndex);
+/** Read the balance of a token on a CC address, false if there is no token index */
+bool GetTokenIndexBalance(const uint256 &tokenid, const uint160 &addressHash, CAmount &balance);
+/** Read the supply and holder count of a token, false if there is no token index */
+bool GetTokenIndexSupply(const uint256 &tokenid, CTokenSupplyValue &supply);
+/** The tokens outputs a block creates and spends, checked against their inputs, for its connect */
+void GetTokenIndexEntries(const CBlock &block, std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                          std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent);
+/** The tokens outputs a connected block created and spent, read back from the token index for its disconnect */
+void ReadTokenIndexEntries(const CBlock &block, std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                           std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent);
+/** Read the last num data samples of a publisher of an oracle at or below maxHeight, newest first (num 0 for all), false if there is no oracle index */
+bool GetOracleSamples(const uint256 &oracletxid, const uint160 &publisherHash, int maxHeight, int num,
+                      std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples);
+/** Read the last data sample of each publisher of an oracle, false if there is no oracle index */
+bool GetOracleLatestSamples(const uint256 &oracletxid, std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples);
+/** The oracle index records of a block, written on connect and erased on disconnect */
+void GetOracleSampleEntries(const CBlock &block, int nHeight, std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &samples);
+/** Read the confirmed deposits or withdraws of a gateways bind at a stage of their lifecycle, false if there is no gateways index */
+bool GetGatewaysStates(const uint256 &bindtxid, uint8_t stage, std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &states);
+/** The gateways index records a block moves, with the withdraws it creates or removes, for its connect or disconnect */
+void GetGatewaysIndexEntries(const CBlock &block, bool fConnect, std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &states,
+                             std::vector<std::pair<uint256, uint256> > &withdraws);
+/** Read the running totals of an address, false if the address balances are not complete */
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance);
+/** Backfill the address balances of an address index written before they were kept */
+void ThreadAddressBalanceIndex();
+/** Read the address index a page at a time, starting after the last key of the previous page (NULL for the first) */
+bool GetAddressIndexPage(uint160 addressHash, int type, const CAddressIndexKey *pkeyAfter, size_t nMax,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore,
+                         int start = 0, int end = 0);
+bool GetAddressUnspentPage(uint160 addressHash, int type, const CAddressUnspentKey *pkeyAfter, size_t nMax,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, bool &fMore);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
+bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex,bool checkPOW);
+/** Read a block's serialized bytes without deserializing its transactions, only its header is checked against the index */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& raw, const CBlockIndex* pindex);
+/** Get a block's serialized bytes from the cache of recently served blocks, or from disk */
+CRawBlockRef GetRawBlock(const CBlockIndex* pindex);
 bool PruneOneBlockFile(bool tempfile, const int fileNumber);
+/** Set the number of finalized block and undo files read through memory mappings (0 to read them with fread) */
+void SetMappedBlockFiles(int nFiles);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -976,6 +1443,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** Global variable that points to the coins database below pcoinsTip (protected by cs_main) */
+extern CCoinsViewDB *pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -0,0 +1,145 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mappedfile.h"
+
+#include "util.h"
+
+#include <errno.h>
+#include <string.h>
+#include <limits>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap(pdata, nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const boost::filesystem::path &path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > std::numeric_limits<size_t>::max()) {
+        close(fd);
+        return nullptr;
+    }
+    void *pdata = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (pdata == MAP_FAILED) {
+        LogPrintf("%s: unable to map %s: %s\n", __func__, path.string(), strerror(errno));
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile(pdata, st.st_size));
+#else
+    return nullptr;
+#endif
+}
+
+void CMappedFileCache::Trim()
+{
+    while (entries.size() > nMaxFiles) {
+        mapEntries.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void CMappedFileCache::SetMaxFiles(size_t nMaxFilesIn)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nMaxFiles = nMaxFilesIn;
+    Trim();
+}
+
+bool CMappedFileCache::Enabled()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nMaxFiles > 0;
+}
+
+std::shared_ptr<const CMappedFile> CMappedFileCache::Get(int nFile, const boost::filesystem::path &path, uint64_t nPos)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nMaxFiles == 0)
+        return nullptr;
+    std::map<int, EntryList::iterator>::iterator it = mapEntries.find(nFile);
+    if (it != mapEntries.end()) {
+        entries.splice(entries.begin(), entries, it->second);
+        if (nPos < it->second->second->size())
+            return it->second->second;
+        // appended to since it was mapped
+        entries.erase(it->second);
+        mapEntries.erase(it);
+    }
+    std::shared_ptr<const CMappedFile> mapped = CMappedFile::Open(path);
+    if (!mapped)
+        return nullptr;
+    entries.push_front(std::make_pair(nFile, mapped));
+    mapEntries[nFile] = entries.begin();
+    Trim();
+    return nPos < mapped->size() ? mapped : nullptr;
+}
+
+void CMappedFileCache::Erase(int nFile)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<int, EntryList::iterator>::iterator it = mapEntries.find(nFile);
+    if (it != mapEntries.end()) {
+        entries.erase(it->second);
+        mapEntries.erase(it);
+    }
+}
+
+void CDiskFileStream::read(char* pch, size_t nSize)
+{
+    if (mapped) {
+        if (nReadPos > mapped->size() || nSize > mapped->size() - nReadPos)
+            throw std::ios_base::failure("CDiskFileStream::read: end of file");
+        memcpy(pch, mapped->begin() + nReadPos, nSize);
+        nReadPos += nSize;
+        return;
+    }
+    if (!file)
+        throw std::ios_base::failure("CDiskFileStream::read: file handle is NULL");
+    if (fread(pch, 1, nSize, file) != nSize)
+        throw std::ios_base::failure(feof(file) ? "CDiskFileStream::read: end of file" : "CDiskFileStream::read: fread failed");
+}
+
+void CDiskFileStream::ignore(size_t nSize)
+{
+    if (mapped) {
+        if (nReadPos > mapped->size() || nSize > mapped->size() - nReadPos)
+            throw std::ios_base::failure("CDiskFileStream::ignore: end of file");
+        nReadPos += nSize;
+        return;
+    }
+    if (!file)
+        throw std::ios_base::failure("CDiskFileStream::ignore: file handle is NULL");
+    if (fseek(file, nSize, SEEK_CUR))
+        throw std::ios_base::failure("CDiskFileStream::ignore: fseek failed");
+}
+
+void CDiskFileStream::Seek(uint64_t nPos)
+{
+    if (mapped) {
+        if (nPos > mapped->size())
+            throw std::ios_base::failure("CDiskFileStream::Seek: end of file");
+        nReadPos = nPos;
+        return;
+    }
+    if (!file)
+        throw std::ios_base::failure("CDiskFileStream::Seek: file handle is NULL");
+    if (fseek(file, nPos, SEEK_SET))
+        throw std::ios_base::failure("CDiskFileStream::Seek: fseek failed");
+}
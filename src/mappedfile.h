@@ -0,0 +1,147 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_MAPPEDFILE_H
+#define KOMODO_MAPPEDFILE_H
+
+#include "serialize.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <list>
+#include <map>
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Read-only memory mapping of a whole file */
+class CMappedFile
+{
+private:
+    void *pdata;
+    size_t nSize;
+
+    CMappedFile(void *pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+
+    // Disallow copies
+    CMappedFile(const CMappedFile&);
+    CMappedFile& operator=(const CMappedFile&);
+
+public:
+    ~CMappedFile();
+
+    /****
+     * Map a file
+     * @param path the file
+     * @returns the mapping, or NULL if the file is empty or cannot be mapped
+     */
+    static std::shared_ptr<const CMappedFile> Open(const boost::filesystem::path &path);
+
+    const char *begin() const { return (const char *)pdata; }
+    const char *end() const { return (const char *)pdata + nSize; }
+    size_t size() const { return nSize; }
+};
+
+/**
+ * Keeps up to a number of block or undo files mapped, the least recently
+ * used ones are unmapped first. The files must only be appended to while
+ * they are mapped.
+ */
+class CMappedFileCache
+{
+private:
+    typedef std::list<std::pair<int, std::shared_ptr<const CMappedFile> > > EntryList;
+
+    size_t nMaxFiles;
+    boost::mutex mutex;
+    EntryList entries; // most recently used first
+    std::map<int, EntryList::iterator> mapEntries;
+
+    void Trim();
+
+public:
+    CMappedFileCache() : nMaxFiles(0) {}
+
+    //! Set the number of mapped files, 0 disables the mappings
+    void SetMaxFiles(size_t nMaxFilesIn);
+    bool Enabled();
+
+    /****
+     * Get the mapping of a file, mapping it again if it has grown past the mapped size
+     * @param nFile the file number
+     * @param path the file
+     * @param nPos the position that will be read
+     * @returns the mapping, or NULL if nPos is not in the file or it cannot be mapped
+     */
+    std::shared_ptr<const CMappedFile> Get(int nFile, const boost::filesystem::path &path, uint64_t nPos);
+
+    //! Unmap a file once its readers are done, e.g. before it is deleted
+    void Erase(int nFile);
+};
+
+/**
+ * Stream subset of CAutoFile to read from a block or undo file, either from
+ * its memory mapping or from a FILE* when the file is not mapped.
+ */
+class CDiskFileStream
+{
+private:
+    // Disallow copies
+    CDiskFileStream(const CDiskFileStream&);
+    CDiskFileStream& operator=(const CDiskFileStream&);
+
+    const int nType;
+    const int nVersion;
+
+    std::shared_ptr<const CMappedFile> mapped;
+    size_t nReadPos;
+    FILE *file;
+
+public:
+    /****
+     * @param mappedIn the file mapping, if any
+     * @param nPos the position to read from in the mapping
+     * @param fileIn the file to read from without mapping (positioned already), closed by the stream
+     */
+    CDiskFileStream(const std::shared_ptr<const CMappedFile> &mappedIn, uint64_t nPos, FILE *fileIn, int nTypeIn, int nVersionIn) :
+        nType(nTypeIn), nVersion(nVersionIn), mapped(mappedIn), nReadPos(nPos), file(mappedIn ? NULL : fileIn)
+    {
+        if (mapped && fileIn)
+            ::fclose(fileIn);
+    }
+
+    ~CDiskFileStream()
+    {
+        if (file)
+            ::fclose(file);
+    }
+
+    bool IsNull() const { return !mapped && file == NULL; }
+    bool IsMapped() const { return (bool)mapped; }
+
+    //
+    // Stream subset
+    //
+    int GetType() const          { return nType; }
+    int GetVersion() const       { return nVersion; }
+
+    void read(char* pch, size_t nSize);
+    void ignore(size_t nSize);
+
+    //! Move to a position in the file
+    void Seek(uint64_t nPos);
+
+    template<typename T>
+    CDiskFileStream& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        if (IsNull())
+            throw std::ios_base::failure("CDiskFileStream::operator>>: file handle is NULL");
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
+#endif // KOMODO_MAPPEDFILE_H
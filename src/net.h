@@ -98,9 +98,16 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest = NULL);
 bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOutbound = NULL, const char *strDest = NULL, bool fOneShot = false);
 unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
+/** Select the backend waiting for socket events (see CSocketPoller), before StartNode() and binding */
+bool SetSocketPoller(const std::string& strName);
+/** Whether the sockets of the peers have to be below FD_SETSIZE */
+bool SocketPollerLimitedToSelectable();
+bool IsPollableSocket(SOCKET hSocket);
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
+/** Wake the message handler thread, e.g. once a paused peer can be read from again */
+void WakeMessageHandler();
 
 typedef int NodeId;
 
@@ -314,6 +321,9 @@ public:
     bool fNetworkNode;
     bool fSuccessfullyConnected;
     bool fDisconnect;
+    // The message handler stops reading from the peer for now (e.g. its nSPV requests are queued),
+    // set by ProcessMessages under cs_vRecvMsg
+    bool fPauseRecv;
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in its version message that we should not relay tx invs
@@ -0,0 +1,278 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netpoller.h"
+
+#include "netbase.h"
+#include "util.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#ifndef WIN32
+#include <poll.h>
+#endif
+
+#ifdef __linux__
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+void CSocketPoller::Begin()
+{
+    nRound++;
+}
+
+bool CSocketPoller::Set(SOCKET hSocket, int nEvents, int64_t nKey)
+{
+    if (hSocket == INVALID_SOCKET)
+        return false;
+    nEvents &= RECV | SEND;
+
+    std::unordered_map<SOCKET, Entry>::iterator it = mapSockets.find(hSocket);
+    if (it != mapSockets.end() && it->second.nKey == nKey) {
+        it->second.nRound = nRound;
+        if (it->second.nEvents == nEvents)
+            return true;
+        if (!Register(hSocket, nEvents, false)) {
+            Unregister(hSocket);
+            mapSockets.erase(it);
+            return false;
+        }
+        it->second.nEvents = nEvents;
+        return true;
+    }
+    if (it != mapSockets.end()) {
+        // the socket number was closed and reused by another owner
+        Unregister(hSocket);
+        mapSockets.erase(it);
+    }
+    if (!Register(hSocket, nEvents, true))
+        return false;
+    Entry entry;
+    entry.nEvents = nEvents;
+    entry.nKey = nKey;
+    entry.nRound = nRound;
+    mapSockets[hSocket] = entry;
+    return true;
+}
+
+int CSocketPoller::Wait(int64_t nTimeoutMillis)
+{
+    for (std::unordered_map<SOCKET, Entry>::iterator it = mapSockets.begin(); it != mapSockets.end(); ) {
+        if (it->second.nRound != nRound) {
+            Unregister(it->first);
+            it = mapSockets.erase(it);
+        } else
+            ++it;
+    }
+    mapReady.clear();
+    return WaitReady(nTimeoutMillis);
+}
+
+int CSocketPoller::GetEvents(SOCKET hSocket) const
+{
+    std::unordered_map<SOCKET, int>::const_iterator it = mapReady.find(hSocket);
+    return it == mapReady.end() ? 0 : it->second;
+}
+
+void CSocketPoller::SetAllReady()
+{
+    for (std::unordered_map<SOCKET, Entry>::const_iterator it = mapSockets.begin(); it != mapSockets.end(); ++it)
+        mapReady[it->first] |= RECV;
+}
+
+/** select(), rebuilds the fd_sets on every call and only takes sockets below FD_SETSIZE */
+class CSelectPoller : public CSocketPoller
+{
+public:
+    std::string GetName() const { return "select"; }
+    bool LimitedToSelectable() const { return true; }
+
+protected:
+    bool Register(SOCKET hSocket, int nEvents, bool fNew)
+    {
+        return IsSelectableSocket(hSocket);
+    }
+
+    void Unregister(SOCKET hSocket) {}
+
+    int WaitReady(int64_t nTimeoutMillis)
+    {
+        struct timeval timeout = MillisToTimeval(nTimeoutMillis);
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+        for (std::unordered_map<SOCKET, Entry>::const_iterator it = mapSockets.begin(); it != mapSockets.end(); ++it) {
+            FD_SET(it->first, &fdsetError);
+            if (it->second.nEvents & RECV)
+                FD_SET(it->first, &fdsetRecv);
+            if (it->second.nEvents & SEND)
+                FD_SET(it->first, &fdsetSend);
+            hSocketMax = std::max(hSocketMax, it->first);
+        }
+
+        int nSelect = select(mapSockets.empty() ? 0 : hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        if (nSelect == SOCKET_ERROR)
+            return -1;
+        for (std::unordered_map<SOCKET, Entry>::const_iterator it = mapSockets.begin(); it != mapSockets.end() && nSelect > 0; ++it) {
+            int nEvents = (FD_ISSET(it->first, &fdsetRecv) ? RECV : 0) |
+                          (FD_ISSET(it->first, &fdsetSend) ? SEND : 0) |
+                          (FD_ISSET(it->first, &fdsetError) ? ERR : 0);
+            if (nEvents)
+                mapReady[it->first] = nEvents;
+        }
+        return mapReady.size();
+    }
+};
+
+#ifndef WIN32
+/** poll(), without the FD_SETSIZE limit but still passing every socket on each call */
+class CPollPoller : public CSocketPoller
+{
+private:
+    std::vector<struct pollfd> vPollFds;
+
+public:
+    std::string GetName() const { return "poll"; }
+
+protected:
+    bool Register(SOCKET hSocket, int nEvents, bool fNew) { return true; }
+    void Unregister(SOCKET hSocket) {}
+
+    int WaitReady(int64_t nTimeoutMillis)
+    {
+        vPollFds.resize(mapSockets.size());
+        size_t i = 0;
+        for (std::unordered_map<SOCKET, Entry>::const_iterator it = mapSockets.begin(); it != mapSockets.end(); ++it, ++i) {
+            vPollFds[i].fd = it->first;
+            vPollFds[i].events = ((it->second.nEvents & RECV) ? POLLIN : 0) | ((it->second.nEvents & SEND) ? POLLOUT : 0);
+            vPollFds[i].revents = 0;
+        }
+
+        int nPoll = poll(vPollFds.empty() ? NULL : &vPollFds[0], vPollFds.size(), nTimeoutMillis);
+        if (nPoll < 0)
+            return errno == EINTR ? 0 : -1;
+        for (i = 0; i < vPollFds.size() && nPoll > 0; i++) {
+            if (vPollFds[i].revents == 0)
+                continue;
+            mapReady[vPollFds[i].fd] = ((vPollFds[i].revents & POLLIN) ? RECV : 0) |
+                                       ((vPollFds[i].revents & POLLOUT) ? SEND : 0) |
+                                       ((vPollFds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ? ERR : 0);
+        }
+        return mapReady.size();
+    }
+};
+#endif
+
+#ifdef USE_EPOLL
+/** epoll, the sockets stay registered in the kernel and only the ready ones are returned */
+class CEpollPoller : public CSocketPoller
+{
+private:
+    //! Most events returned by one epoll_wait(), the others are returned by the next one
+    static const size_t MAX_EPOLL_EVENTS = 1024;
+
+    int fdEpoll;
+    std::vector<struct epoll_event> vEvents;
+
+public:
+    CEpollPoller() : fdEpoll(epoll_create1(EPOLL_CLOEXEC)) {}
+
+    ~CEpollPoller()
+    {
+        if (fdEpoll >= 0)
+            close(fdEpoll);
+    }
+
+    bool IsValid() const { return fdEpoll >= 0; }
+    std::string GetName() const { return "epoll"; }
+
+protected:
+    bool Register(SOCKET hSocket, int nEvents, bool fNew)
+    {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = ((nEvents & RECV) ? EPOLLIN : 0) | ((nEvents & SEND) ? EPOLLOUT : 0);
+        ev.data.fd = hSocket;
+        if (epoll_ctl(fdEpoll, fNew ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, hSocket, &ev) == 0)
+            return true;
+        // a closed socket leaves the epoll set by itself, its number may be registered again
+        if (errno == (fNew ? EEXIST : ENOENT))
+            return epoll_ctl(fdEpoll, fNew ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, hSocket, &ev) == 0;
+        LogPrint("net", "%s: epoll_ctl failed for socket %d: %s\n", __func__, hSocket, strerror(errno));
+        return false;
+    }
+
+    void Unregister(SOCKET hSocket)
+    {
+        // fails harmlessly if the socket was closed already
+        struct epoll_event ev;
+        epoll_ctl(fdEpoll, EPOLL_CTL_DEL, hSocket, &ev);
+    }
+
+    int WaitReady(int64_t nTimeoutMillis)
+    {
+        vEvents.resize(std::max((size_t)16, std::min(mapSockets.size(), (size_t)MAX_EPOLL_EVENTS)));
+        int nEpoll = epoll_wait(fdEpoll, &vEvents[0], vEvents.size(), nTimeoutMillis);
+        if (nEpoll < 0)
+            return errno == EINTR ? 0 : -1;
+        for (int i = 0; i < nEpoll; i++) {
+            mapReady[vEvents[i].data.fd] |= ((vEvents[i].events & EPOLLIN) ? RECV : 0) |
+                                            ((vEvents[i].events & EPOLLOUT) ? SEND : 0) |
+                                            ((vEvents[i].events & (EPOLLERR | EPOLLHUP)) ? ERR : 0);
+        }
+        return mapReady.size();
+    }
+};
+#endif
+
+std::string CSocketPoller::GetDefaultName()
+{
+#if defined(USE_EPOLL)
+    return "epoll";
+#elif !defined(WIN32)
+    return "poll";
+#else
+    return "select";
+#endif
+}
+
+std::string CSocketPoller::GetAvailableNames()
+{
+#if defined(USE_EPOLL)
+    return "epoll, poll, select";
+#elif !defined(WIN32)
+    return "poll, select";
+#else
+    return "select";
+#endif
+}
+
+CSocketPoller *CSocketPoller::Create(const std::string &strName)
+{
+    std::string strBackend = strName.empty() ? GetDefaultName() : strName;
+#ifdef USE_EPOLL
+    if (strBackend == "epoll") {
+        CEpollPoller *poller = new CEpollPoller();
+        if (poller->IsValid())
+            return poller;
+        LogPrintf("%s: epoll_create1 failed: %s\n", __func__, strerror(errno));
+        delete poller;
+        return NULL;
+    }
+#endif
+#ifndef WIN32
+    if (strBackend == "poll")
+        return new CPollPoller();
+#endif
+    if (strBackend == "select")
+        return new CSelectPoller();
+    return NULL;
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_NETPOLLER_H
+#define KOMODO_NETPOLLER_H
+
+#include "compat.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Waits for events on a set of sockets for ThreadSocketHandler. The sockets
+ * are declared again before every Wait(), backends that keep the set in the
+ * kernel (epoll) only make a system call for the sockets whose events changed.
+ *
+ * Backends: "epoll" (Linux), "poll" (not on Windows) and "select", which is
+ * limited to sockets below FD_SETSIZE.
+ */
+class CSocketPoller
+{
+public:
+    enum {
+        RECV = 1,
+        SEND = 2,
+        ERR = 4, //!< always reported, no need to wait for it
+    };
+
+    virtual ~CSocketPoller() {}
+
+    /****
+     * Create a backend
+     * @param strName the backend name, empty for the default one of the platform
+     * @returns NULL if the backend is unknown or not available here
+     */
+    static CSocketPoller *Create(const std::string &strName);
+    static std::string GetDefaultName();
+    //! Backends available on this platform, for the help message
+    static std::string GetAvailableNames();
+
+    virtual std::string GetName() const = 0;
+    //! Whether the sockets have to be below FD_SETSIZE (see IsSelectableSocket)
+    virtual bool LimitedToSelectable() const { return false; }
+
+    //! Start declaring the sockets of the next Wait(), the ones not declared again are forgotten
+    void Begin();
+
+    /****
+     * Declare a socket for the next Wait()
+     * @param hSocket the socket
+     * @param nEvents RECV and/or SEND, 0 to only get errors
+     * @param nKey identifies the owner of the socket (e.g. the node id), so that a
+     *             reused socket number is registered again
+     * @returns false if the socket cannot be waited for by this backend
+     */
+    bool Set(SOCKET hSocket, int nEvents, int64_t nKey);
+
+    /****
+     * Wait for events on the declared sockets
+     * @param nTimeoutMillis how long to wait at most
+     * @returns the number of ready sockets, or -1 on error (see WSAGetLastError)
+     */
+    int Wait(int64_t nTimeoutMillis);
+
+    //! Events of a socket after Wait()
+    int GetEvents(SOCKET hSocket) const;
+
+    //! Report all the declared sockets as ready to receive, so that errors are found by recv()
+    void SetAllReady();
+
+    size_t Size() const { return mapSockets.size(); }
+
+protected:
+    struct Entry
+    {
+        int nEvents;
+        int64_t nKey;
+        unsigned int nRound;
+    };
+
+    std::unordered_map<SOCKET, Entry> mapSockets;
+    std::unordered_map<SOCKET, int> mapReady;
+    unsigned int nRound;
+
+    CSocketPoller() : nRound(0) {}
+
+    //! Start waiting for nEvents on a new socket, or one whose events changed
+    virtual bool Register(SOCKET hSocket, int nEvents, bool fNew) = 0;
+    virtual void Unregister(SOCKET hSocket) = 0;
+    //! Fill mapReady
+    virtual int WaitReady(int64_t nTimeoutMillis) = 0;
+};
+
+#endif // KOMODO_NETPOLLER_H
@@ -0,0 +1,122 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nspvcache.h"
+
+size_t CNSPVResponseCache::EntryBytes(const std::vector<uint8_t> &request, const std::vector<uint8_t> &response)
+{
+    // twice the request, it is kept in the map and in the LRU list
+    return 2 * request.size() + response.size() + sizeof(Entry) + 64;
+}
+
+void CNSPVResponseCache::Erase(std::map<std::vector<uint8_t>, Entry>::iterator it)
+{
+    nBytes -= EntryBytes(it->first, it->second.response);
+    listLRU.erase(it->second.itLRU);
+    mapEntries.erase(it);
+}
+
+bool CNSPVResponseCache::Get(const std::vector<uint8_t> &request, const CBlockIndex *pindexTip, int64_t nNow, std::vector<uint8_t> &response)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<std::vector<uint8_t>, Entry>::iterator it = mapEntries.find(request);
+    if (it == mapEntries.end() || pindexTip == NULL) {
+        nMisses++;
+        return false;
+    }
+    const Entry &entry = it->second;
+    bool fValid;
+    if (entry.hashTip.IsNull()) {
+        const CBlockIndex *pindexAnchor = pindexTip->GetAncestor(entry.nAnchorHeight);
+        fValid = nNow - entry.nTime < nFinalLifetime && pindexAnchor != NULL && pindexAnchor->GetBlockHash() == entry.hashAnchor;
+    } else
+        fValid = entry.hashTip == pindexTip->GetBlockHash();
+    if (!fValid) {
+        Erase(it);
+        nMisses++;
+        return false;
+    }
+    listLRU.splice(listLRU.begin(), listLRU, entry.itLRU);
+    response = entry.response;
+    nHits++;
+    return true;
+}
+
+void CNSPVResponseCache::Put(const std::vector<uint8_t> &request, const std::vector<uint8_t> &response, const CBlockIndex *pindexTip, int nAnchorHeight, int64_t nNow)
+{
+    if (pindexTip == NULL)
+        return;
+    const CBlockIndex *pindexAnchor = NULL;
+    if (nAnchorHeight >= 0 && (pindexAnchor = pindexTip->GetAncestor(nAnchorHeight)) == NULL)
+        return;
+    const size_t nEntryBytes = EntryBytes(request, response);
+    if (nEntryBytes > nMaxBytes / 4)
+        return;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    const uint256 hashTip = pindexTip->GetBlockHash();
+    if (hashTip != hashLastTip) {
+        // the responses made for the previous tip are not served any more
+        for (std::map<std::vector<uint8_t>, Entry>::iterator it = mapEntries.begin(); it != mapEntries.end(); ) {
+            if (!it->second.hashTip.IsNull())
+                Erase(it++);
+            else
+                ++it;
+        }
+        hashLastTip = hashTip;
+    }
+
+    std::map<std::vector<uint8_t>, Entry>::iterator it = mapEntries.find(request);
+    if (it != mapEntries.end())
+        Erase(it);
+    while (nBytes + nEntryBytes > nMaxBytes && !listLRU.empty())
+        Erase(mapEntries.find(listLRU.back()));
+
+    listLRU.push_front(request);
+    Entry &entry = mapEntries[request];
+    entry.response = response;
+    if (pindexAnchor != NULL) {
+        entry.nAnchorHeight = nAnchorHeight;
+        entry.hashAnchor = pindexAnchor->GetBlockHash();
+    } else {
+        entry.hashTip = hashTip;
+        entry.nAnchorHeight = pindexTip->nHeight;
+        entry.hashAnchor = hashTip;
+    }
+    entry.nTime = nNow;
+    entry.itLRU = listLRU.begin();
+    nBytes += nEntryBytes;
+}
+
+void CNSPVResponseCache::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    mapEntries.clear();
+    listLRU.clear();
+    nBytes = 0;
+}
+
+size_t CNSPVResponseCache::Size()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return mapEntries.size();
+}
+
+size_t CNSPVResponseCache::Bytes()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nBytes;
+}
+
+uint64_t CNSPVResponseCache::GetHits()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nHits;
+}
+
+uint64_t CNSPVResponseCache::GetMisses()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nMisses;
+}
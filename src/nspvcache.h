@@ -0,0 +1,91 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_NSPVCACHE_H
+#define KOMODO_NSPVCACHE_H
+
+#include "chain.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Responses of the nSPV full node, keyed by the serialized request, so that
+ * the same question asked by many light clients after a block is answered
+ * once.
+ *
+ * An answer about the tip is only served while the tip is the same. An answer
+ * about notarized history is anchored to a block at or below the notarized
+ * height instead, and served while that block is in the chain the tip belongs
+ * to, up to nFinalLifetime. The least recently used responses are evicted
+ * past nMaxBytes.
+ */
+class CNSPVResponseCache
+{
+private:
+    struct Entry
+    {
+        std::vector<uint8_t> response;
+        uint256 hashTip;        //!< tip the response was made for, null if anchored
+        int nAnchorHeight;
+        uint256 hashAnchor;
+        int64_t nTime;
+        std::list<std::vector<uint8_t> >::iterator itLRU;
+    };
+
+    const size_t nMaxBytes;
+    const int64_t nFinalLifetime;
+
+    boost::mutex mutex;
+    std::map<std::vector<uint8_t>, Entry> mapEntries;
+    //! Requests, most recently used first
+    std::list<std::vector<uint8_t> > listLRU;
+    size_t nBytes;
+    //! Tip of the last Put(), the responses made for another tip are dropped when it changes
+    uint256 hashLastTip;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    //! Requires mutex
+    void Erase(std::map<std::vector<uint8_t>, Entry>::iterator it);
+    static size_t EntryBytes(const std::vector<uint8_t> &request, const std::vector<uint8_t> &response);
+
+public:
+    /****
+     * @param nMaxBytesIn memory used by the requests and responses before the least recently used are evicted
+     * @param nFinalLifetimeIn seconds an anchored response is kept for
+     */
+    CNSPVResponseCache(size_t nMaxBytesIn, int64_t nFinalLifetimeIn) :
+        nMaxBytes(nMaxBytesIn), nFinalLifetime(nFinalLifetimeIn), nBytes(0), nHits(0), nMisses(0) {}
+
+    /****
+     * Find the response to a request
+     * @param request the serialized request
+     * @param pindexTip the current tip
+     * @param nNow the current time, in seconds
+     * @param response set to the cached response
+     * @returns false if there is none still valid for this tip
+     */
+    bool Get(const std::vector<uint8_t> &request, const CBlockIndex *pindexTip, int64_t nNow, std::vector<uint8_t> &response);
+
+    /****
+     * Keep the response to a request
+     * @param nAnchorHeight the highest block the response depends on if it cannot change
+     *                      any more (notarized), -1 if it is only valid for this tip
+     */
+    void Put(const std::vector<uint8_t> &request, const std::vector<uint8_t> &response, const CBlockIndex *pindexTip, int nAnchorHeight, int64_t nNow);
+
+    void Clear();
+    size_t Size();
+    size_t Bytes();
+    uint64_t GetHits();
+    uint64_t GetMisses();
+};
+
+#endif // KOMODO_NSPVCACHE_H
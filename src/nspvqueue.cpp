@@ -0,0 +1,118 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "nspvqueue.h"
+
+#include "util.h"
+
+bool CNSPVRequestQueue::Next(NodeId &id, CNode *&pnode, std::vector<uint8_t> &request)
+{
+    for (int nTurns = 0; nTurns < 2; nTurns++) {
+        const bool fPriority = nTurns == 0;
+        std::deque<NodeId> &turns = fPriority ? turnsPriority : turnsNormal;
+        while (!turns.empty()) {
+            id = turns.front();
+            turns.pop_front();
+            std::map<NodeId, PeerQueue>::iterator it = mapPeers.find(id);
+            if (it == mapPeers.end())
+                continue;
+            PeerQueue &peer = it->second;
+            (fPriority ? peer.fInPriorityTurns : peer.fInNormalTurns) = false;
+            std::deque<std::vector<uint8_t> > &queue = fPriority ? peer.priority : peer.normal;
+            // a peer being served takes its turns again once done
+            if (peer.fActive || queue.empty())
+                continue;
+            request.swap(queue.front());
+            queue.pop_front();
+            nRequests--;
+            peer.fActive = true;
+            pnode = peer.pnode;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CNSPVRequestQueue::Thread()
+{
+    while (true) {
+        NodeId id;
+        CNode *pnode;
+        std::vector<uint8_t> request;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!Next(id, pnode, request))
+                condWork.wait(lock);
+        }
+
+        if (!pnode->fDisconnect) {
+            try {
+                handler(pnode, request);
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "CNSPVRequestQueue::Thread()");
+            }
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            std::map<NodeId, PeerQueue>::iterator it = mapPeers.find(id);
+            PeerQueue &peer = it->second;
+            peer.fActive = false;
+            if (!peer.priority.empty() && !peer.fInPriorityTurns) {
+                turnsPriority.push_back(id);
+                peer.fInPriorityTurns = true;
+            }
+            if (!peer.normal.empty() && !peer.fInNormalTurns) {
+                turnsNormal.push_back(id);
+                peer.fInNormalTurns = true;
+            }
+            if (peer.priority.empty() && peer.normal.empty())
+                mapPeers.erase(it);
+            else
+                condWork.notify_one();
+        }
+        {
+            LOCK(cs_vNodes);
+            pnode->Release();
+        }
+        // the peer, or the peers paused by a full queue, can be read from again
+        WakeMessageHandler();
+    }
+}
+
+void CNSPVRequestQueue::Push(CNode *pnode, const std::vector<uint8_t> &request, bool fPriority)
+{
+    {
+        // keep the node until its requests are served
+        LOCK(cs_vNodes);
+        pnode->AddRef();
+    }
+    boost::unique_lock<boost::mutex> lock(mutex);
+    const NodeId id = pnode->GetId();
+    PeerQueue &peer = mapPeers[id];
+    peer.pnode = pnode;
+    (fPriority ? peer.priority : peer.normal).push_back(request);
+    bool &fInTurns = fPriority ? peer.fInPriorityTurns : peer.fInNormalTurns;
+    if (!peer.fActive && !fInTurns) {
+        (fPriority ? turnsPriority : turnsNormal).push_back(id);
+        fInTurns = true;
+    }
+    nRequests++;
+    condWork.notify_one();
+}
+
+bool CNSPVRequestQueue::IsBusy(NodeId id)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<NodeId, PeerQueue>::const_iterator it = mapPeers.find(id);
+    if (it == mapPeers.end())
+        return false;
+    return it->second.priority.size() + it->second.normal.size() >= nMaxPeerRequests || nRequests >= nMaxRequests;
+}
+
+size_t CNSPVRequestQueue::Size()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nRequests;
+}
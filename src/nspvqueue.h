@@ -0,0 +1,85 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_NSPVQUEUE_H
+#define KOMODO_NSPVQUEUE_H
+
+#include "net.h"
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Queue of the nSPV requests received by a full node, served by a pool of
+ * worker threads so that expensive requests don't hold up the message
+ * handler thread.
+ *
+ * Each peer has its own queue and is served by one worker at a time, in
+ * order. Peers take turns, and peers with a cheap request pending (e.g.
+ * getinfo) are served before the others. Once a peer has too many requests
+ * queued, or the whole queue is full, the message handler stops reading from
+ * the peer (IsBusy) and is woken up each time a request has been served. The
+ * queued requests of a peer that disconnects are dropped.
+ */
+class CNSPVRequestQueue
+{
+public:
+    typedef std::function<void(CNode*, const std::vector<uint8_t>&)> Handler;
+
+private:
+    struct PeerQueue
+    {
+        CNode *pnode;
+        std::deque<std::vector<uint8_t> > priority;
+        std::deque<std::vector<uint8_t> > normal;
+        bool fActive; // a worker is serving the peer
+        bool fInPriorityTurns;
+        bool fInNormalTurns;
+        PeerQueue() : pnode(NULL), fActive(false), fInPriorityTurns(false), fInNormalTurns(false) {}
+    };
+
+    const Handler handler;
+    const size_t nMaxPeerRequests;
+    const size_t nMaxRequests;
+
+    boost::mutex mutex;
+    boost::condition_variable condWork;
+    std::map<NodeId, PeerQueue> mapPeers;
+    //! Peers taking turns, with cheap requests and with other requests
+    std::deque<NodeId> turnsPriority;
+    std::deque<NodeId> turnsNormal;
+    size_t nRequests;
+
+    //! Pick the next request, requires mutex
+    bool Next(NodeId &id, CNode *&pnode, std::vector<uint8_t> &request);
+
+public:
+    /****
+     * @param handlerIn serves a request, called from the worker threads
+     * @param nMaxPeerRequestsIn requests queued per peer before the peer is paused
+     * @param nMaxRequestsIn requests queued in total before the peers with queued requests are paused
+     */
+    CNSPVRequestQueue(const Handler &handlerIn, size_t nMaxPeerRequestsIn, size_t nMaxRequestsIn) :
+        handler(handlerIn), nMaxPeerRequests(nMaxPeerRequestsIn), nMaxRequests(nMaxRequestsIn), nRequests(0) {}
+
+    //! Worker thread
+    void Thread();
+
+    //! Queue a request of a peer, cheap ones are served first
+    void Push(CNode *pnode, const std::vector<uint8_t> &request, bool fPriority);
+
+    //! Whether no more requests should be read from a peer for now
+    bool IsBusy(NodeId id);
+
+    //! Number of queued requests, not counting the ones being served
+    size_t Size();
+};
+
+#endif // KOMODO_NSPVQUEUE_H
@@ -25,8 +25,10 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "crypto/equihash.h"
+#include "mruset.h"
 #include "primitives/block.h"
 #include "streams.h"
+#include "sync.h"
 #include "uint256.h"
 #include "util.h"
 #include "komodo.h"
@@ -550,12 +552,22 @@ unsigned int CalculateNextWorkRequired(arith_uint256 bnAvg,
     return bnNew.GetCompact();
 }
 
-bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& params)
+/**
+ * Hashes of headers whose Equihash solution has already been verified. The
+ * header hash commits to nNonce and nSolution, so a hit means the very same
+ * solution was checked before (e.g. during header sync, or by
+ * ProcessNewBlock before ConnectBlock checks it again).
+ */
+static CCriticalSection cs_equihashcache;
+static mruset<uint256> setEquihashVerified(EQUIHASH_VERIFIED_CACHE_SIZE);
+
+bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& params, bool fUseCache)
 {
     if (ASSETCHAINS_ALGO != ASSETCHAINS_EQUIHASH)
         return true;
     
-    if ( ASSETCHAINS_NK[0] != 0 && ASSETCHAINS_NK[1] != 0 && pblock->GetHash().ToString() == "027e3758c3a65b12aa1046462b486d0a63bfa1beae327897f56c5cfb7daaae71" )
+    uint256 hash = pblock->GetHash();
+    if ( ASSETCHAINS_NK[0] != 0 && ASSETCHAINS_NK[1] != 0 && hash.ToString() == "027e3758c3a65b12aa1046462b486d0a63bfa1beae327897f56c5cfb7daaae71" )
         return true;
 
     unsigned int n = params.EquihashN();
@@ -563,6 +575,12 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
 
     if ( Params().NetworkIDString() == "regtest" )
         return(true);
+    if ( fUseCache )
+    {
+        LOCK(cs_equihashcache);
+        if ( setEquihashVerified.count(hash) != 0 )
+            return true;
+    }
     // Hash state
     crypto_generichash_blake2b_state state;
     EhInitialiseState(n, k, state);
@@ -583,6 +601,11 @@ bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams& param
     if (!isValid)
         return error("CheckEquihashSolution(): invalid solution");
 
+    if ( fUseCache )
+    {
+        LOCK(cs_equihashcache);
+        setEquihashVerified.insert(hash);
+    }
     return true;
 }
 
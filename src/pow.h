@@ -37,8 +37,13 @@ unsigned int CalculateNextWorkRequired(arith_uint256 bnAvg,
                                        int64_t nLastBlockTime, int64_t nFirstBlockTime,
                                        const Consensus::Params&);
 
-/** Check whether the Equihash solution in a block header is valid */
-bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams&);
+/** Number of recently verified Equihash solutions remembered by CheckEquihashSolution */
+static const unsigned int EQUIHASH_VERIFIED_CACHE_SIZE = 32768;
+
+/** Check whether the Equihash solution in a block header is valid. Valid
+ *  solutions are remembered, so checking the same header again is cheap
+ *  unless fUseCache is false. */
+bool CheckEquihashSolution(const CBlockHeader *pblock, const CChainParams&, bool fUseCache = true);
 
 /**
  * @brief Check if given notaryid is allowed to mine a mindiff block in case of GAP
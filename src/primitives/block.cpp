@@ -110,7 +110,27 @@ uint256 CBlock::BuildMerkleTree(bool* fMutated) const
 {
     std::vector<uint256> leaves;
     for (int i=0; i<vtx.size(); i++) leaves.push_back(vtx[i].GetHash());
-    return ::BuildMerkleTree(fMutated, leaves, vMerkleTree);
+    uint256 root = ::BuildMerkleTree(&fMerkleTreeMutated, leaves, vMerkleTree);
+    if (fMutated) {
+        *fMutated = fMerkleTreeMutated;
+    }
+    return root;
+}
+
+uint256 CBlock::GetMerkleRoot(bool* fMutated) const
+{
+    size_t nTreeSize = vtx.size();
+    for (size_t nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
+        nTreeSize += (nSize + 1) / 2;
+    bool fBuilt = !vtx.empty() && vMerkleTree.size() == nTreeSize;
+    for (size_t i = 0; fBuilt && i < vtx.size(); i++)
+        fBuilt = vMerkleTree[i] == vtx[i].GetHash();
+    if (!fBuilt)
+        return BuildMerkleTree(fMutated);
+    if (fMutated) {
+        *fMutated = fMerkleTreeMutated;
+    }
+    return vMerkleTree.back();
 }
 
 
@@ -146,6 +146,7 @@ public:
 
     // memory only
     mutable std::vector<uint256> vMerkleTree;
+    mutable bool fMerkleTreeMutated; // whether a mutation was detected when vMerkleTree was built
 
     CBlock()
     {
@@ -171,6 +172,7 @@ public:
         CBlockHeader::SetNull();
         vtx.clear();
         vMerkleTree.clear();
+        fMerkleTreeMutated = false;
     }
 
     CBlockHeader GetBlockHeader() const
@@ -193,6 +195,10 @@ public:
     // merkle root).
     uint256 BuildMerkleTree(bool* mutated = NULL) const;
 
+    // Return the merkle root of the in-memory merkle tree if it was built for the
+    // current transactions (e.g. by a block reader thread), else build it.
+    uint256 GetMerkleRoot(bool* mutated = NULL) const;
+
     std::vector<uint256> GetMerkleBranch(int nIndex) const;
     static uint256 CheckMerkleBranch(uint256 hash, const std::vector<uint256>& vMerkleBranch, int nIndex);
     std::string ToString() const;
@@ -23,6 +23,7 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "coinsnapshot.h"
 #include "crosschain.h"
 #include "base58.h"
 #include "consensus/validation.h"
@@ -994,6 +995,54 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk
     return ret;
 }
 
+static UniValue SnapshotInfoToJSON(const CTxOutSetSnapshotInfo &info, const boost::filesystem::path &path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("height", (int64_t)info.metadata.nHeight));
+    ret.push_back(Pair("bestblock", info.metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("notarizationtxid", info.metadata.notarizationTxid.GetHex()));
+    ret.push_back(Pair("records", (int64_t)info.nRecords));
+    ret.push_back(Pair("eventbytes", (int64_t)info.nEventBytes));
+    ret.push_back(Pair("hash_snapshot", info.hashSnapshot.GetHex()));
+    return ret;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set, with the komodo state, as of the last\n"
+            "notarized block of the active chain to a file. Relative paths are taken from the data directory.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"                  (string, required) the file to write\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",         (string) the file written\n"
+            "  \"height\": n,              (numeric) the height of the snapshot block\n"
+            "  \"bestblock\": \"hex\",     (string) the snapshot block hash\n"
+            "  \"notarizationtxid\": \"hex\", (string) the notarization of the snapshot block\n"
+            "  \"records\": n,             (numeric) the number of chainstate records\n"
+            "  \"eventbytes\": n,          (numeric) the size of the komodo state events\n"
+            "  \"hash_snapshot\": \"hash\" (string) the hash of the snapshot file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    CTxOutSetSnapshotInfo info;
+    std::string strError;
+    if (!DumpTxOutSetSnapshot(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotInfoToJSON(info, path);
+}
 
 UniValue kvsearch(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
@@ -1915,6 +1964,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
 
     /* Not shown in help */
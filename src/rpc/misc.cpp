@@ -890,6 +890,136 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+// by time, then by key, so that a page of mempool deltas can start after the last one of the previous page
+bool timestampKeySort(const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> &a,
+                      const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> &b) {
+    if (a.second.time != b.second.time)
+        return a.second.time < b.second.time;
+    return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
+}
+
+/** Most records in a page of the address index RPCs */
+static const int MAX_ADDRESS_PAGE = 10000;
+/** Records in a page of the address index RPCs given a cursor without a limit */
+static const int DEFAULT_ADDRESS_PAGE = 1000;
+/** Most records the address index RPCs read without a limit, more have to be paged */
+static const int MAX_ADDRESS_UNPAGED = 100000;
+
+/****
+ * Get the paging parameters of the address index RPCs
+ * @param params the RPC params, paged if the object has a "limit" or a "cursor"
+ * @param limit the most records in the page
+ * @param cursor the "next" cursor of the previous page, empty for the first page
+ * @returns true if a page is asked for, false for all the records
+ */
+static bool getPageFromParams(const UniValue& params, int &limit, std::string &cursor)
+{
+    if (!params[0].isObject())
+        return false;
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull() && cursorValue.isNull())
+        return false;
+    limit = limitValue.isNull() ? DEFAULT_ADDRESS_PAGE : limitValue.get_int();
+    if (limit <= 0 || limit > MAX_ADDRESS_PAGE) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Limit is expected to be between 1 and %d", MAX_ADDRESS_PAGE));
+    }
+    cursor = cursorValue.isStr() ? cursorValue.get_str() : "";
+    return true;
+}
+
+/** Refuse an unpaged reply that would hold more than MAX_ADDRESS_UNPAGED records */
+static void checkUnpagedRecords(bool fMore)
+{
+    if (fMore) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("More than %d records, use \"limit\" and \"cursor\" to page through them", MAX_ADDRESS_UNPAGED));
+    }
+}
+
+// a cursor is the position in the addresses of the query and the last index key of the page, hex encoded
+template <typename Key>
+static std::string encodeAddressCursor(uint32_t nAddress, const Key *pkey)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << nAddress << (pkey != NULL);
+    if (pkey != NULL)
+        ss << *pkey;
+    return HexStr(ss.begin(), ss.end());
+}
+
+template <typename Key>
+static bool decodeAddressCursor(const std::string &cursor, uint32_t &nAddress, Key &key)
+{
+    bool fKey = false;
+    nAddress = 0;
+    if (cursor.empty())
+        return false;
+    if (!IsHex(cursor)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    try {
+        CDataStream ss(ParseHex(cursor), SER_DISK, CLIENT_VERSION);
+        ss >> nAddress >> fKey;
+        if (fKey)
+            ss >> key;
+    } catch (const std::exception& e) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    return fKey;
+}
+
+/****
+ * Read a page of the address index of the addresses, one address after the other
+ * @returns the cursor to the next page, empty if this is the last one
+ */
+static std::string getAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses, int limit, const std::string &cursor,
+                                       int start, int end, std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex)
+{
+    CAddressIndexKey keyAfter;
+    uint32_t nAddress;
+    bool fKey = decodeAddressCursor(cursor, nAddress, keyAfter);
+    bool fMore = false;
+
+    for (; nAddress < addresses.size() && addressIndex.size() < (size_t)limit; nAddress++, fKey = false) {
+        if (!GetAddressIndexPage(addresses[nAddress].first, addresses[nAddress].second, fKey ? &keyAfter : NULL, limit, addressIndex, fMore, start, end)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (fMore)
+            break;
+    }
+    if (fMore)
+        return encodeAddressCursor(nAddress, &addressIndex.back().first);
+    if (nAddress < addresses.size())
+        return encodeAddressCursor<CAddressIndexKey>(nAddress, NULL);
+    return "";
+}
+
+/****
+ * Read a page of the unspent outputs of the addresses, one address after the other
+ * @returns the cursor to the next page, empty if this is the last one
+ */
+static std::string getAddressUnspentPage(const std::vector<std::pair<uint160, int> > &addresses, int limit, const std::string &cursor,
+                                         std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+{
+    CAddressUnspentKey keyAfter;
+    uint32_t nAddress;
+    bool fKey = decodeAddressCursor(cursor, nAddress, keyAfter);
+    bool fMore = false;
+
+    for (; nAddress < addresses.size() && unspentOutputs.size() < (size_t)limit; nAddress++, fKey = false) {
+        if (!GetAddressUnspentPage(addresses[nAddress].first, addresses[nAddress].second, fKey ? &keyAfter : NULL, limit, unspentOutputs, fMore)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (fMore)
+            break;
+    }
+    if (fMore)
+        return encodeAddressCursor(nAddress, &unspentOutputs.back().first);
+    if (nAddress < addresses.size())
+        return encodeAddressCursor<CAddressUnspentKey>(nAddress, NULL);
+    return "";
+}
+
 UniValue getaddressmempool(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() > 2 || params.size() == 0)
@@ -902,7 +1032,10 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp, const CPubKey& my
             "    [\n"
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
-            "    ]\n"
+            "    ],\n"
+            "  \"limit\" (number, optional) Return at most this many deltas and a cursor to the next ones (1 to 10000, default 1000 with a cursor)\n"
+            "  \"cursor\" (string, optional) The \"next\" cursor of the previous page\n"
+            "  Without limit nor cursor, more than 100000 deltas are an error\n"
             "}\n"
             "\nCCvout (optional) Return CCvouts instead of normal vouts\n"
             "\nResult:\n"
@@ -917,6 +1050,11 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp, const CPubKey& my
             "    \"prevout\"  (string) The previous transaction output index (if spending)\n"
             "  }\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas as above\n"
+            "  \"next\"  (string) The cursor to the next page, if there is one\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressmempool", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
             + HelpExampleRpc("getaddressmempool", "{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]} (ccvout)")
@@ -934,12 +1072,47 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp, const CPubKey& my
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
-    std::sort(indexes.begin(), indexes.end(), timestampSort);
+    int limit = 0;
+    std::string cursor, next;
+    bool fPage = getPageFromParams(params, limit, cursor);
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::iterator itBegin = indexes.begin(), itEnd = indexes.end();
+
+    if (fPage) {
+        std::sort(indexes.begin(), indexes.end(), timestampKeySort);
+        itBegin = indexes.begin();
+        if (!cursor.empty()) {
+            // the mempool changes between pages, start after the last delta of the previous page
+            std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> last(CMempoolAddressDeltaKey(0, uint160()), CMempoolAddressDelta(0, 0));
+            if (!IsHex(cursor)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+            }
+            try {
+                CDataStream ss(ParseHex(cursor), SER_DISK, CLIENT_VERSION);
+                ss >> last.second.time >> last.first.type >> last.first.addressBytes >> last.first.txhash >> last.first.index >> last.first.spending;
+            } catch (const std::exception& e) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+            }
+            itBegin = std::upper_bound(indexes.begin(), indexes.end(), last, timestampKeySort);
+        }
+        if (indexes.end() - itBegin > limit) {
+            itEnd = itBegin + limit;
+            CDataStream ss(SER_DISK, CLIENT_VERSION);
+            const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> &last = *(itEnd - 1);
+            ss << last.second.time << last.first.type << last.first.addressBytes << last.first.txhash << last.first.index << last.first.spending;
+            next = HexStr(ss.begin(), ss.end());
+        }
+    } else {
+        if (indexes.size() > (size_t)MAX_ADDRESS_UNPAGED)
+            checkUnpagedRecords(true);
+        std::sort(indexes.begin(), indexes.end(), timestampSort);
+        itBegin = indexes.begin();
+        itEnd = indexes.end();
+    }
 
     UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::iterator it = indexes.begin();
-         it != indexes.end(); it++) {
+    for (std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::iterator it = itBegin;
+         it != itEnd; it++) {
 
         std::string address;
         if (!getAddressFromIndex(it->first.type, it->first.addressBytes, address)) {
@@ -959,6 +1132,13 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp, const CPubKey& my
         result.push_back(delta);
     }
 
+    if (fPage) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("deltas", result));
+        if (!next.empty())
+            page.push_back(Pair("next", next));
+        return page;
+    }
     return result;
 }
 
@@ -976,6 +1156,10 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp, const CPubKey& mypk
             "      ,...\n"
             "    ],\n"
             "  \"chainInfo\"  (boolean) Include chain info with results\n"
+            "  \"limit\" (number, optional) Return at most this many outputs and a cursor to the next ones (1 to 10000, default 1000 with a cursor),\n"
+            "            in index order (address, txid, output index) instead of height order\n"
+            "  \"cursor\" (string, optional) The \"next\" cursor of the previous page\n"
+            "  Without limit nor cursor, more than 100000 outputs are an error\n"
             "}\n"
             "\nCCvout (optional) Return CCvouts instead of normal vouts\n"
             "\nResult\n"
@@ -989,6 +1173,13 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp, const CPubKey& mypk
             "    \"satoshis\"  (number) The number of satoshis of the output\n"
             "  }\n"
             "]\n"
+            "\nResult (with chainInfo or limit):\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs as above\n"
+            "  \"hash\"  (string) The tip block hash (with chainInfo)\n"
+            "  \"height\"  (number) The tip block height (with chainInfo)\n"
+            "  \"next\"  (string) The cursor to the next page, if there is one (with limit)\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]} (ccvout)")
@@ -1009,15 +1200,17 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp, const CPubKey& mypk
     }
 
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    int limit = 0;
+    std::string cursor, next;
+    bool fPage = getPageFromParams(params, limit, cursor);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
+    if (fPage) {
+        next = getAddressUnspentPage(addresses, limit, cursor, unspentOutputs);
+    } else {
+        checkUnpagedRecords(!getAddressUnspentPage(addresses, MAX_ADDRESS_UNPAGED, "", unspentOutputs).empty());
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
-
     UniValue utxos(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
@@ -1036,13 +1229,17 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp, const CPubKey& mypk
         utxos.push_back(output);
     }
 
-    if (includeChainInfo) {
+    if (includeChainInfo || fPage) {
         UniValue result(UniValue::VOBJ);
         result.push_back(Pair("utxos", utxos));
 
-        LOCK(cs_main);
-        result.push_back(Pair("hash", chainActive.Tip()->GetBlockHash().GetHex()));
-        result.push_back(Pair("height", (int)chainActive.Height()));
+        if (includeChainInfo) {
+            LOCK(cs_main);
+            result.push_back(Pair("hash", chainActive.Tip()->GetBlockHash().GetHex()));
+            result.push_back(Pair("height", (int)chainActive.Height()));
+        }
+        if (!next.empty())
+            result.push_back(Pair("next", next));
         return result;
     } else {
         return utxos;
@@ -1065,6 +1262,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
             "  \"chainInfo\" (boolean) Include chain info in results, only applies if start and end specified\n"
+            "  \"limit\" (number, optional) Return at most this many deltas and a cursor to the next ones (1 to 10000, default 1000 with a cursor)\n"
+            "  \"cursor\" (string, optional) The \"next\" cursor of the previous page\n"
+            "  Without limit nor cursor, more than 100000 deltas are an error\n"
             "}\n"
             "\nCCvout (optional) Return CCvouts instead of normal vouts\n"
             "\nResult:\n"
@@ -1077,6 +1277,13 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (with chainInfo or limit):\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas as above\n"
+            "  \"start\"  (object) The hash and height of the start block (with chainInfo)\n"
+            "  \"end\"  (object) The hash and height of the end block (with chainInfo)\n"
+            "  \"next\"  (string) The cursor to the next page, if there is one (with limit)\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]} (ccvout)")
@@ -1113,17 +1320,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
     }
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    int limit = 0;
+    std::string cursor, next;
+    bool fPage = getPageFromParams(params, limit, cursor);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (fPage) {
+        next = getAddressIndexPage(addresses, limit, cursor, start, end, addressIndex);
+    } else {
+        checkUnpagedRecords(!getAddressIndexPage(addresses, MAX_ADDRESS_UNPAGED, "", start, end, addressIndex).empty());
     }
 
     UniValue deltas(UniValue::VARR);
@@ -1168,11 +1372,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp, const CPubKey& myp
         result.push_back(Pair("deltas", deltas));
         result.push_back(Pair("start", startInfo));
         result.push_back(Pair("end", endInfo));
-
-        return result;
+    } else if (fPage) {
+        result.push_back(Pair("deltas", deltas));
     } else {
         return deltas;
     }
+    if (!next.empty())
+        result.push_back(Pair("next", next));
+    return result;
 }
 
 CAmount checkburnaddress(CAmount &received, int64_t &nNotaryPay, int32_t &height, std::string sAddress)
@@ -1294,6 +1501,8 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp, const CPubKey& my
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"sent\"  (string) The total number of satoshis spent\n"
+            "  \"txcount\"  (number) The number of transactions of each address, summed\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
@@ -1306,27 +1515,46 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp, const CPubKey& my
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    CAmount received = 0;
+    CAmount sent = 0;
+    int64_t txcount = 0;
+    bool fBalances = true;
+
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end() && fBalances; it++) {
+        CAddressBalanceValue value;
+        if ((fBalances = GetAddressBalance((*it).first, (*it).second, value))) {
+            received += value.received;
+            sent += value.sent;
+            txcount += value.txcount;
         }
     }
 
-    CAmount balance = 0;
-    CAmount received = 0;
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    if (!fBalances) {
+        // the address balances are being backfilled, sum the address index records
+        received = sent = txcount = 0;
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+            std::set<uint256> txids;
+            for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+                if (it->second > 0) {
+                    received += it->second;
+                } else {
+                    sent -= it->second;
+                }
+                txids.insert(it->first.txhash);
+            }
+            txcount += txids.size();
         }
-        balance += it->second;
     }
 
     UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("balance", balance));
+    result.push_back(Pair("balance", received - sent));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("sent", sent));
+    result.push_back(Pair("txcount", txcount));
 
     return result;
 
@@ -1406,6 +1634,10 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Read at most this many address index records and return a cursor to the next ones (1 to 10000, default 1000 with a cursor),\n"
+            "            the txids are in height order for each address in turn and may repeat across pages\n"
+            "  \"cursor\" (string, optional) The \"next\" cursor of the previous page\n"
+            "  Without limit nor cursor, more than 100000 address index records are an error\n"
             "}\n"
             "\nCCvout (optional) Return CCvouts instead of normal vouts\n"
             "\nResult:\n"
@@ -1413,6 +1645,11 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"txids\"  (array) The transaction ids as above\n"
+            "  \"next\"  (string) The cursor to the next page, if there is one\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]}' (ccvout)")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"RY5LccmGiX9bUHYGtSWQouNy1yFhc5rM87\"]} (ccvout)")
@@ -1436,19 +1673,25 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp, const CPubKey& mypk
     }
 
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    int limit = 0;
+    std::string cursor;
+    if (getPageFromParams(params, limit, cursor)) {
+        std::string next = getAddressIndexPage(addresses, limit, cursor, start, end, addressIndex);
+        std::set<uint256> seen;
+        UniValue txids(UniValue::VARR);
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+            if (seen.insert(it->first.txhash).second)
+                txids.push_back(it->first.txhash.GetHex());
         }
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("txids", txids));
+        if (!next.empty())
+            page.push_back(Pair("next", next));
+        return page;
     }
 
+    checkUnpagedRecords(!getAddressIndexPage(addresses, MAX_ADDRESS_UNPAGED, "", start, end, addressIndex).empty());
+
     std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
 
@@ -108,7 +108,10 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"cmpctblock\": true|false,  (boolean) Whether the peer understands compact blocks (BIP152)\n"
+            "    \"cmpctblocks_reconstructed\": n, (numeric) Blocks rebuilt from this peer's compact blocks\n"
+            "    \"cmpctblocks_txn_requested\": n, (numeric) How many of those needed missing transactions from the peer\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -163,6 +166,9 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("cmpctblock", statestats.fProvidesHeaderAndIDs));
+            obj.push_back(Pair("cmpctblocks_reconstructed", statestats.nCmpctBlocksReconstructed));
+            obj.push_back(Pair("cmpctblocks_txn_requested", statestats.nCmpctBlocksTxnRequested));
         }
         obj.push_back(Pair("addr_processed", stats.m_addr_processed));
         obj.push_back(Pair("addr_rate_limited", stats.m_addr_rate_limited));
@@ -329,6 +329,7 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
     { "blockchain",         "getspentinfo",           &getspentinfo,           false },
     { "blockchain",         "notaries",               &notaries,               true  },
@@ -417,6 +418,8 @@ static const CRPCCommand vRPCCommands[] =
     { "nSPV",   "nspv_listunspent",     &nspv_listunspent,  true },
     { "nSPV",   "nspv_mempool",         &nspv_mempool,  true },
     { "nSPV",   "nspv_listtransactions",&nspv_listtransactions,  true },
+    { "nSPV",   "nspv_listunspentpage", &nspv_listunspentpage,  true },
+    { "nSPV",   "nspv_listtransactionspage",&nspv_listtransactionspage,  true },
     { "nSPV",   "nspv_spentinfo",       &nspv_spentinfo,    true },
     { "nSPV",   "nspv_notarizations",   &nspv_notarizations,    true },
     { "nSPV",   "nspv_hdrsproof",       &nspv_hdrsproof,    true },
@@ -417,6 +417,7 @@ extern UniValue getblockheader(const UniValue& params, bool fHelp, const CPubKey
 extern UniValue getlastsegidstakes(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
+extern UniValue dumptxoutset(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue gettxout(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue verifychain(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue getchaintips(const UniValue& params, bool fHelp, const CPubKey& mypk);
@@ -442,6 +443,8 @@ extern UniValue nspv_login(const UniValue& params, bool fHelp, const CPubKey& my
 extern UniValue nspv_listtransactions(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue nspv_mempool(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue nspv_listunspent(const UniValue& params, bool fHelp, const CPubKey& mypk);
+extern UniValue nspv_listunspentpage(const UniValue& params, bool fHelp, const CPubKey& mypk);
+extern UniValue nspv_listtransactionspage(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue nspv_spentinfo(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue nspv_notarizations(const UniValue& params, bool fHelp, const CPubKey& mypk);
 extern UniValue nspv_hdrsproof(const UniValue& params, bool fHelp, const CPubKey& mypk);
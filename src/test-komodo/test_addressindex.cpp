@@ -0,0 +1,618 @@
+#include <gtest/gtest.h>
+
+#include "main.h"
+#include "txdb.h"
+#include "txmempool.h"
+#include "script/cc.h"
+#include "cc/eval.h"
+#include "cc/CCinclude.h"
+#include "cc/CCGateways.h"
+
+#include <memory>
+
+namespace TestAddressIndex {
+
+    static uint256 TxHash(int n)
+    {
+        uint256 hash;
+        hash.begin()[0] = (uint8_t)n;
+        hash.begin()[1] = (uint8_t)(n >> 8);
+        return hash;
+    }
+
+    TEST(TestAddressIndex, address_index_pages) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint160 hashAddress, hashOther;
+        hashAddress.begin()[0] = 1;
+        hashOther.begin()[0] = 2;
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vWrite;
+        for (int i = 0; i < 25; i++)
+            vWrite.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 100 + i / 2, i % 2, TxHash(i), 0, false), (CAmount)i));
+        vWrite.push_back(std::make_pair(CAddressIndexKey(1, hashOther, 100, 0, TxHash(99), 0, false), (CAmount)99));
+        ASSERT_TRUE(db->WriteAddressIndex(vWrite));
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vAll;
+        CAddressIndexKey keyAfter;
+        bool fFirst = true, fMore = true;
+        int nPages = 0;
+        while (fMore) {
+            std::vector<std::pair<CAddressIndexKey, CAmount> > vPage;
+            ASSERT_TRUE(db->ReadAddressIndexPage(hashAddress, 1, fFirst ? NULL : &keyAfter, 10, vPage, fMore));
+            ASSERT_FALSE(vPage.empty());
+            EXPECT_LE(vPage.size(), 10);
+            keyAfter = vPage.back().first;
+            fFirst = false;
+            vAll.insert(vAll.end(), vPage.begin(), vPage.end());
+            nPages++;
+        }
+        EXPECT_EQ(nPages, 3);
+        ASSERT_EQ(vAll.size(), 25);
+        // in height order, without the other address
+        for (int i = 0; i < 25; i++) {
+            EXPECT_EQ(vAll[i].second, i);
+            EXPECT_EQ(vAll[i].first.hashBytes, hashAddress);
+        }
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vLast;
+        ASSERT_TRUE(db->ReadAddressIndexPage(hashAddress, 1, &keyAfter, 10, vLast, fMore));
+        EXPECT_TRUE(vLast.empty());
+        EXPECT_FALSE(fMore);
+    }
+
+    TEST(TestAddressIndex, address_index_height_range) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint160 hashAddress;
+        hashAddress.begin()[0] = 1;
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vWrite;
+        for (int i = 0; i < 20; i++)
+            vWrite.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 100 + i, 0, TxHash(i), 0, false), (CAmount)i));
+        ASSERT_TRUE(db->WriteAddressIndex(vWrite));
+
+        // heights 105 to 114, three at a time
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vAll;
+        CAddressIndexKey keyAfter;
+        bool fFirst = true, fMore = true;
+        while (fMore) {
+            std::vector<std::pair<CAddressIndexKey, CAmount> > vPage;
+            ASSERT_TRUE(db->ReadAddressIndexPage(hashAddress, 1, fFirst ? NULL : &keyAfter, 3, vPage, fMore, 105, 114));
+            if (vPage.empty())
+                break;
+            keyAfter = vPage.back().first;
+            fFirst = false;
+            vAll.insert(vAll.end(), vPage.begin(), vPage.end());
+        }
+        ASSERT_EQ(vAll.size(), 10);
+        EXPECT_EQ(vAll.front().first.blockHeight, 105);
+        EXPECT_EQ(vAll.back().first.blockHeight, 114);
+
+        // a start without an end is ignored, as by getaddressdeltas without a limit
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vPage;
+        ASSERT_TRUE(db->ReadAddressIndexPage(hashAddress, 1, NULL, 100, vPage, fMore, 105, 0));
+        EXPECT_EQ(vPage.size(), 20);
+    }
+
+    TEST(TestAddressIndex, address_balances) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint160 hashAddress, hashOther;
+        hashAddress.begin()[0] = 1;
+        hashOther.begin()[0] = 2;
+
+        // a block paying 10 and 5 in one transaction, then one spending 10 and paying 3 back as change
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vBlock1, vBlock2;
+        vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 100, 1, TxHash(1), 0, false), (CAmount)10));
+        vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 100, 1, TxHash(1), 1, false), (CAmount)5));
+        vBlock1.push_back(std::make_pair(CAddressIndexKey(1, hashOther, 100, 2, TxHash(2), 0, false), (CAmount)7));
+        vBlock2.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 101, 1, TxHash(3), 0, true), (CAmount)-10));
+        vBlock2.push_back(std::make_pair(CAddressIndexKey(1, hashAddress, 101, 1, TxHash(3), 1, false), (CAmount)3));
+        ASSERT_TRUE(db->WriteAddressIndex(vBlock1));
+        ASSERT_TRUE(db->WriteAddressIndex(vBlock2));
+        // a block replayed after an unclean shutdown is not counted twice
+        ASSERT_TRUE(db->WriteAddressIndex(vBlock2));
+
+        CAddressBalanceValue balance;
+        ASSERT_TRUE(db->ReadAddressBalance(hashAddress, 1, balance));
+        EXPECT_EQ(balance.received, 18);
+        EXPECT_EQ(balance.sent, 10);
+        EXPECT_EQ(balance.Balance(), 8);
+        EXPECT_EQ(balance.txcount, 2);
+
+        // the same totals when computed from the records, a few addresses at a time
+        CAddressIndexIteratorKey keyLast;
+        bool fDone = false;
+        int nSteps = 0;
+        while (!fDone) {
+            ASSERT_TRUE(db->BackfillAddressBalances(nSteps > 0 ? &keyLast : NULL, 1, keyLast, fDone));
+            nSteps++;
+        }
+        EXPECT_EQ(nSteps, 2);
+        ASSERT_TRUE(db->ReadAddressBalance(hashAddress, 1, balance));
+        EXPECT_EQ(balance.received, 18);
+        EXPECT_EQ(balance.sent, 10);
+        EXPECT_EQ(balance.txcount, 2);
+
+        // disconnecting the blocks takes their records back out
+        ASSERT_TRUE(db->EraseAddressIndex(vBlock2));
+        ASSERT_TRUE(db->EraseAddressIndex(vBlock2));
+        ASSERT_TRUE(db->ReadAddressBalance(hashAddress, 1, balance));
+        EXPECT_EQ(balance.Balance(), 15);
+        EXPECT_EQ(balance.txcount, 1);
+        ASSERT_TRUE(db->EraseAddressIndex(vBlock1));
+        ASSERT_TRUE(db->ReadAddressBalance(hashAddress, 1, balance));
+        EXPECT_TRUE(balance.IsNull());
+        ASSERT_TRUE(db->ReadAddressBalance(hashOther, 1, balance));
+        EXPECT_TRUE(balance.IsNull());
+    }
+
+    TEST(TestAddressIndex, contract_index) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+
+        std::vector<std::pair<CContractIndexKey, int32_t> > vWrite;
+        for (int i = 0; i < 6; i++)
+            vWrite.push_back(std::make_pair(CContractIndexKey(EVAL_ORACLES, 'C', 200 - i, TxHash(i)), (int32_t)i));
+        vWrite.push_back(std::make_pair(CContractIndexKey(EVAL_ORACLES, 'D', 100, TxHash(10)), (int32_t)1));
+        vWrite.push_back(std::make_pair(CContractIndexKey(EVAL_TOKENS, 'C', 100, TxHash(11)), (int32_t)1));
+        ASSERT_TRUE(db->WriteContractIndex(vWrite));
+
+        // only this evalcode and funcid, in height order
+        std::vector<std::pair<CContractIndexKey, int32_t> > vRead;
+        ASSERT_TRUE(db->ReadContractIndex(EVAL_ORACLES, 'C', vRead));
+        ASSERT_EQ(vRead.size(), 6);
+        for (int i = 0; i < 6; i++) {
+            EXPECT_EQ(vRead[i].first.blockHeight, 195 + i);
+            EXPECT_EQ(vRead[i].first.txhash, TxHash(5 - i));
+            EXPECT_EQ(vRead[i].second, 5 - i);
+        }
+
+        ASSERT_TRUE(db->EraseContractIndex(vWrite));
+        vRead.clear();
+        ASSERT_TRUE(db->ReadContractIndex(EVAL_ORACLES, 'C', vRead));
+        EXPECT_TRUE(vRead.empty());
+    }
+
+    TEST(TestAddressIndex, contract_index_entries) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        CKey key;
+        key.MakeNewKey(true);
+        const CPubKey pk = key.GetPubKey();
+
+        // an oracle data transaction, a tokens transfer carrying an assets order and a plain payment
+        CMutableTransaction mtxData, mtxTokens, mtxPlain;
+        mtxData.vin.push_back(CTxIn(TxHash(1), 1, CScript()));
+        mtxData.vout.push_back(MakeCC1vout(EVAL_ORACLES, 10000, pk));
+        mtxData.vout.push_back(CTxOut(0, EncodeOraclesData('D', TxHash(2), TxHash(1), pk, std::vector<uint8_t>(1, 7))));
+        std::vector<std::pair<uint8_t, vscript_t> > oprets;
+        oprets.push_back(std::make_pair((uint8_t)OPRETID_ASSETSDATA, vscript_t({ EVAL_ASSETS, 's' })));
+        mtxTokens.vin.push_back(CTxIn(TxHash(3), 0, CScript()));
+        mtxTokens.vout.push_back(MakeCC1vout(EVAL_TOKENS, 1, pk));
+        mtxTokens.vout.push_back(CTxOut(0, EncodeTokenOpRet(TxHash(4), std::vector<CPubKey>(1, pk), oprets)));
+        mtxPlain.vin.push_back(CTxIn(TxHash(5), 0, CScript()));
+        mtxPlain.vout.push_back(CTxOut(1000, CScript() << ToByteVector(pk) << OP_CHECKSIG));
+        CBlock block;
+        block.vtx.push_back(CTransaction(mtxData));
+        block.vtx.push_back(CTransaction(mtxTokens));
+        block.vtx.push_back(CTransaction(mtxPlain));
+
+        std::vector<std::pair<CContractIndexKey, int32_t> > contractIndex;
+        GetContractIndexEntries(block, 100, contractIndex);
+        ASSERT_EQ(contractIndex.size(), 3);
+        ASSERT_TRUE(db->WriteContractIndex(contractIndex));
+
+        std::vector<std::pair<CContractIndexKey, int32_t> > vRead;
+        ASSERT_TRUE(db->ReadContractIndex(EVAL_ORACLES, 'D', vRead));
+        ASSERT_EQ(vRead.size(), 1);
+        EXPECT_EQ(vRead[0].first.txhash, block.vtx[0].GetHash());
+        EXPECT_EQ(vRead[0].first.blockHeight, 100);
+        EXPECT_EQ(vRead[0].second, 1);
+        // the tokens transaction is found under both modules
+        vRead.clear();
+        ASSERT_TRUE(db->ReadContractIndex(EVAL_TOKENS, 't', vRead));
+        ASSERT_EQ(vRead.size(), 1);
+        EXPECT_EQ(vRead[0].first.txhash, block.vtx[1].GetHash());
+        vRead.clear();
+        ASSERT_TRUE(db->ReadContractIndex(EVAL_ASSETS, 's', vRead));
+        ASSERT_EQ(vRead.size(), 1);
+        EXPECT_EQ(vRead[0].first.txhash, block.vtx[1].GetHash());
+
+        // the disconnect computes the same records and removes them all
+        contractIndex.clear();
+        GetContractIndexEntries(block, 100, contractIndex);
+        ASSERT_TRUE(db->EraseContractIndex(contractIndex));
+        for (const std::pair<uint8_t, uint8_t> &func : { std::make_pair((uint8_t)EVAL_ORACLES, (uint8_t)'D'),
+                                                        std::make_pair((uint8_t)EVAL_TOKENS, (uint8_t)'t'),
+                                                        std::make_pair((uint8_t)EVAL_ASSETS, (uint8_t)'s') }) {
+            vRead.clear();
+            ASSERT_TRUE(db->ReadContractIndex(func.first, func.second, vRead));
+            EXPECT_TRUE(vRead.empty());
+        }
+    }
+
+    TEST(TestAddressIndex, token_balances) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint256 tokenid = TxHash(1);
+        uint160 hashCreator, hashOther;
+        hashCreator.begin()[0] = 1;
+        hashOther.begin()[0] = 2;
+
+        // the token is created with 100 on the creator address, then 30 are sent with 70 back as change
+        std::vector<std::pair<COutPoint, CTokenOutputValue> > vCreated1, vSpent1, vCreated2, vSpent2;
+        vCreated1.push_back(std::make_pair(COutPoint(tokenid, 0), CTokenOutputValue(tokenid, hashCreator, 100)));
+        vSpent2.push_back(vCreated1[0]);
+        vCreated2.push_back(std::make_pair(COutPoint(TxHash(2), 0), CTokenOutputValue(tokenid, hashOther, 30)));
+        vCreated2.push_back(std::make_pair(COutPoint(TxHash(2), 1), CTokenOutputValue(tokenid, hashCreator, 70)));
+        ASSERT_TRUE(db->WriteTokenIndex(vCreated1, vSpent1, TxHash(100)));
+        ASSERT_TRUE(db->WriteTokenIndex(vCreated2, vSpent2, TxHash(101)));
+        // a block replayed after an unclean shutdown is not counted twice
+        ASSERT_TRUE(db->WriteTokenIndex(vCreated2, vSpent2, TxHash(101)));
+
+        CAmount balance;
+        CTokenSupplyValue supply;
+        ASSERT_TRUE(db->ReadTokenBalance(tokenid, hashCreator, balance));
+        EXPECT_EQ(balance, 70);
+        ASSERT_TRUE(db->ReadTokenBalance(tokenid, hashOther, balance));
+        EXPECT_EQ(balance, 30);
+        ASSERT_TRUE(db->ReadTokenSupply(tokenid, supply));
+        EXPECT_EQ(supply.supply, 100);
+        EXPECT_EQ(supply.holders, 2);
+
+        // the spent output is still readable for a disconnect
+        CTokenOutputValue value;
+        ASSERT_TRUE(db->ReadTokenOutput(COutPoint(tokenid, 0), value));
+        EXPECT_EQ(value.satoshis, 100);
+        EXPECT_FALSE(db->ReadTokenOutput(COutPoint(TxHash(2), 2), value));
+
+        ASSERT_TRUE(db->EraseTokenIndex(vCreated2, vSpent2, TxHash(101)));
+        ASSERT_TRUE(db->EraseTokenIndex(vCreated2, vSpent2, TxHash(101)));
+        ASSERT_TRUE(db->ReadTokenBalance(tokenid, hashCreator, balance));
+        EXPECT_EQ(balance, 100);
+        ASSERT_TRUE(db->ReadTokenBalance(tokenid, hashOther, balance));
+        EXPECT_EQ(balance, 0);
+        ASSERT_TRUE(db->ReadTokenSupply(tokenid, supply));
+        EXPECT_EQ(supply.holders, 1);
+        EXPECT_FALSE(db->ReadTokenOutput(COutPoint(TxHash(2), 0), value));
+
+        ASSERT_TRUE(db->EraseTokenIndex(vCreated1, vSpent1, TxHash(100)));
+        ASSERT_TRUE(db->ReadTokenSupply(tokenid, supply));
+        EXPECT_TRUE(supply.IsNull());
+    }
+
+    TEST(TestAddressIndex, token_index_entries) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        CBlockTreeDB *pblocktreeSaved = pblocktree;
+        pblocktree = db.get();
+        CKey key, keyOther;
+        key.MakeNewKey(true);
+        keyOther.MakeNewKey(true);
+        const CPubKey creator = key.GetPubKey(), other = keyOther.GetPubKey();
+
+        // the tokenbase is funded by the creator, then all of it is sent to another pubkey
+        CMutableTransaction mtxFund;
+        mtxFund.vin.push_back(CTxIn(TxHash(1), 0, CScript()));
+        mtxFund.vout.push_back(CTxOut(2000, CScript() << ToByteVector(creator) << OP_CHECKSIG));
+        const CTransaction txFund(mtxFund);
+        CMutableTransaction mtxCreate;
+        mtxCreate.vin.push_back(CTxIn(txFund.GetHash(), 0, CScript()));
+        mtxCreate.vout.push_back(MakeCC1vout(EVAL_TOKENS, 1000, creator));
+        mtxCreate.vout.push_back(CTxOut(0, EncodeTokenCreateOpRet('c', vscript_t(creator.begin(), creator.end()), "token", "", vscript_t())));
+        const CTransaction txCreate(mtxCreate);
+        const uint256 tokenid = txCreate.GetHash();
+
+        CMutableTransaction mtxTransfer;
+        CC *cond = MakeCCcond1(EVAL_TOKENS, creator);
+        const uint256 sighash = TxHash(2);
+        cc_signTreeSecp256k1Msg32(cond, key.begin(), sighash.begin());
+        mtxTransfer.vin.push_back(CTxIn(tokenid, 0, CCSig(cond)));
+        cc_free(cond);
+        mtxTransfer.vout.push_back(MakeCC1vout(EVAL_TOKENS, 1000, other));
+        mtxTransfer.vout.push_back(CTxOut(0, EncodeTokenOpRet(tokenid, std::vector<CPubKey>(1, other), std::vector<std::pair<uint8_t, vscript_t> >())));
+        // the same outputs without the token input
+        CMutableTransaction mtxForged = mtxTransfer;
+        mtxForged.vin[0] = CTxIn(TxHash(3), 0, CScript());
+
+        CBlock block;
+        block.vtx.push_back(txCreate);
+        block.vtx.push_back(CTransaction(mtxTransfer));
+        block.vtx.push_back(CTransaction(mtxForged));
+        // the inputs are loaded from the mempool here, from the transaction index on a node
+        const uint32_t nBranchId = CurrentEpochBranchId(0, Params().GetConsensus());
+        mempool.addUnchecked(txFund.GetHash(), CTxMemPoolEntry(txFund, 0, 0, 0, 0, true, false, nBranchId), false);
+        mempool.addUnchecked(tokenid, CTxMemPoolEntry(txCreate, 0, 0, 0, 0, false, false, nBranchId), false);
+
+        std::vector<std::pair<COutPoint, CTokenOutputValue> > vCreated, vSpent;
+        GetTokenIndexEntries(block, vCreated, vSpent);
+        ASSERT_EQ(vCreated.size(), 2);
+        EXPECT_EQ(vCreated[0].first, COutPoint(tokenid, 0));
+        EXPECT_EQ(vCreated[1].first, COutPoint(block.vtx[1].GetHash(), 0));
+        EXPECT_EQ(vCreated[1].second.tokenid, tokenid);
+        EXPECT_EQ(vCreated[1].second.satoshis, 1000);
+        ASSERT_EQ(vSpent.size(), 1);
+        EXPECT_EQ(vSpent[0].first, COutPoint(tokenid, 0));
+
+        ASSERT_TRUE(pblocktree->WriteTokenIndex(vCreated, vSpent, block.GetHash()));
+        CAmount balance;
+        CTokenSupplyValue supply;
+        ASSERT_TRUE(pblocktree->ReadTokenBalance(tokenid, vCreated[1].second.addressHash, balance));
+        EXPECT_EQ(balance, 1000);
+        ASSERT_TRUE(pblocktree->ReadTokenSupply(tokenid, supply));
+        EXPECT_EQ(supply.supply, 1000);
+        EXPECT_EQ(supply.holders, 1);
+
+        // the disconnect reads back what the connect wrote
+        std::vector<std::pair<COutPoint, CTokenOutputValue> > vCreatedRead, vSpentRead;
+        ReadTokenIndexEntries(block, vCreatedRead, vSpentRead);
+        EXPECT_EQ(vCreatedRead.size(), 2);
+        EXPECT_EQ(vSpentRead.size(), 1);
+        ASSERT_TRUE(pblocktree->EraseTokenIndex(vCreatedRead, vSpentRead, block.GetHash()));
+        CTokenOutputValue value;
+        EXPECT_FALSE(pblocktree->ReadTokenOutput(COutPoint(tokenid, 0), value));
+        ASSERT_TRUE(pblocktree->ReadTokenBalance(tokenid, vCreated[1].second.addressHash, balance));
+        EXPECT_EQ(balance, 0);
+        ASSERT_TRUE(pblocktree->ReadTokenSupply(tokenid, supply));
+        EXPECT_TRUE(supply.IsNull());
+
+        mempool.clear();
+        pblocktree = pblocktreeSaved;
+    }
+
+    TEST(TestAddressIndex, oracle_samples) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint256 oracletxid = TxHash(1), otheroracle = TxHash(2);
+        uint160 hashPublisher1, hashPublisher2;
+        hashPublisher1.begin()[0] = 1;
+        hashPublisher2.begin()[0] = 2;
+
+        // publisher 1 posts at heights 100..109, publisher 2 at 100 and 105, on another oracle at 200
+        std::vector<std::pair<COracleSampleKey, COracleSampleValue> > vWrite;
+        for (int i = 0; i < 10; i++)
+            vWrite.push_back(std::make_pair(COracleSampleKey(oracletxid, hashPublisher1, 100 + i, TxHash(10 + i)), COracleSampleValue(CPubKey(), std::vector<uint8_t>(1, i))));
+        vWrite.push_back(std::make_pair(COracleSampleKey(oracletxid, hashPublisher2, 100, TxHash(30)), COracleSampleValue(CPubKey(), std::vector<uint8_t>(1, 30))));
+        vWrite.push_back(std::make_pair(COracleSampleKey(oracletxid, hashPublisher2, 105, TxHash(31)), COracleSampleValue(CPubKey(), std::vector<uint8_t>(1, 31))));
+        vWrite.push_back(std::make_pair(COracleSampleKey(otheroracle, hashPublisher1, 200, TxHash(40)), COracleSampleValue(CPubKey(), std::vector<uint8_t>(1, 40))));
+        ASSERT_TRUE(db->WriteOracleSampleIndex(vWrite));
+
+        // the last samples, newest first
+        std::vector<std::pair<COracleSampleKey, COracleSampleValue> > vRead;
+        ASSERT_TRUE(db->ReadOracleSamples(oracletxid, hashPublisher1, std::numeric_limits<int>::max(), 3, vRead));
+        ASSERT_EQ(vRead.size(), 3);
+        for (int i = 0; i < 3; i++) {
+            EXPECT_EQ(vRead[i].first.blockHeight, 109 - i);
+            EXPECT_EQ(vRead[i].second.data[0], 9 - i);
+        }
+        vRead.clear();
+        ASSERT_TRUE(db->ReadOracleSamples(oracletxid, hashPublisher1, 104, 0, vRead));
+        ASSERT_EQ(vRead.size(), 5);
+        EXPECT_EQ(vRead[0].first.txhash, TxHash(14));
+        vRead.clear();
+        ASSERT_TRUE(db->ReadOracleSamples(otheroracle, hashPublisher1, std::numeric_limits<int>::max(), 0, vRead));
+        ASSERT_EQ(vRead.size(), 1);
+
+        // the last sample of each publisher, the other oracle is not read
+        vRead.clear();
+        ASSERT_TRUE(db->ReadOracleLatestSamples(oracletxid, vRead));
+        ASSERT_EQ(vRead.size(), 2);
+        EXPECT_EQ(vRead[0].first.txhash, TxHash(19));
+        EXPECT_EQ(vRead[1].first.txhash, TxHash(31));
+        EXPECT_EQ(vRead[1].second.data[0], 31);
+        vRead.clear();
+        ASSERT_TRUE(db->ReadOracleLatestSamples(otheroracle, vRead));
+        ASSERT_EQ(vRead.size(), 1);
+        EXPECT_EQ(vRead[0].first.txhash, TxHash(40));
+
+        ASSERT_TRUE(db->EraseOracleSampleIndex(vWrite));
+        vRead.clear();
+        ASSERT_TRUE(db->ReadOracleSamples(oracletxid, hashPublisher1, std::numeric_limits<int>::max(), 0, vRead));
+        EXPECT_TRUE(vRead.empty());
+        ASSERT_TRUE(db->ReadOracleLatestSamples(oracletxid, vRead));
+        EXPECT_TRUE(vRead.empty());
+    }
+
+    TEST(TestAddressIndex, oracle_sample_entries) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        CKey key;
+        key.MakeNewKey(true);
+        const CPubKey publisher = key.GetPubKey();
+        const uint256 oracletxid = TxHash(1), batontxid = TxHash(2);
+
+        // a data transaction passing the baton, and one paying to the baton address without it
+        CMutableTransaction mtx;
+        mtx.vin.push_back(CTxIn(batontxid, 1, CScript()));
+        mtx.vout.push_back(MakeCC1vout(EVAL_ORACLES, 5000, publisher));
+        mtx.vout.push_back(MakeCC1vout(EVAL_ORACLES, 10000, publisher));
+        mtx.vout.push_back(CTxOut(0, EncodeOraclesData('D', oracletxid, batontxid, publisher, std::vector<uint8_t>(1, 7))));
+        CMutableTransaction mtxForged = mtx;
+        mtxForged.vin[0] = CTxIn(TxHash(3), 0, CScript());
+        CBlock block;
+        block.vtx.push_back(CTransaction(mtx));
+        block.vtx.push_back(CTransaction(mtxForged));
+
+        std::vector<std::pair<COracleSampleKey, COracleSampleValue> > samples;
+        GetOracleSampleEntries(block, 100, samples);
+        ASSERT_EQ(samples.size(), 1);
+        EXPECT_EQ(samples[0].first.txhash, block.vtx[0].GetHash());
+        EXPECT_EQ(samples[0].first.blockHeight, 100);
+        EXPECT_EQ(samples[0].second.publisher, publisher);
+
+        // connect then disconnect leaves nothing behind
+        ASSERT_TRUE(db->WriteOracleSampleIndex(samples));
+        std::vector<std::pair<COracleSampleKey, COracleSampleValue> > vRead;
+        ASSERT_TRUE(db->ReadOracleSamples(oracletxid, samples[0].first.publisherHash, 100, 0, vRead));
+        ASSERT_EQ(vRead.size(), 1);
+        EXPECT_EQ(vRead[0].second.data, std::vector<uint8_t>(1, 7));
+        samples.clear();
+        GetOracleSampleEntries(block, 100, samples);
+        ASSERT_TRUE(db->EraseOracleSampleIndex(samples));
+        vRead.clear();
+        ASSERT_TRUE(db->ReadOracleSamples(oracletxid, samples[0].first.publisherHash, 100, 0, vRead));
+        EXPECT_TRUE(vRead.empty());
+    }
+
+    TEST(TestAddressIndex, gateways_states) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint256 bindtxid = TxHash(1), otherbind = TxHash(2);
+
+        // two pending withdraws, one partially signed, a completed one and one on another bind
+        std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > vWrite;
+        std::vector<std::pair<uint256, uint256> > vWithdraws;
+        CGatewaysStateValue signing(TxHash(11));
+        signing.vtxid.push_back(TxHash(12));
+        vWrite.push_back(std::make_pair(CGatewaysStateKey(bindtxid, 'W', TxHash(10)), CGatewaysStateValue(TxHash(10))));
+        vWrite.push_back(std::make_pair(CGatewaysStateKey(bindtxid, 'W', TxHash(11)), signing));
+        vWrite.push_back(std::make_pair(CGatewaysStateKey(bindtxid, 'S', TxHash(13)), CGatewaysStateValue(TxHash(13))));
+        vWrite.push_back(std::make_pair(CGatewaysStateKey(otherbind, 'W', TxHash(20)), CGatewaysStateValue(TxHash(20))));
+        for (int i = 10; i < 14; i++)
+            vWithdraws.push_back(std::make_pair(TxHash(i), bindtxid));
+        ASSERT_TRUE(db->UpdateGatewaysIndex(vWrite, vWithdraws));
+
+        std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > vRead;
+        ASSERT_TRUE(db->ReadGatewaysStates(bindtxid, 'W', vRead));
+        ASSERT_EQ(vRead.size(), 2);
+        EXPECT_EQ(vRead[1].first.origintxid, TxHash(11));
+        EXPECT_EQ(vRead[1].second.vtxid.back(), TxHash(12));
+        vRead.clear();
+        ASSERT_TRUE(db->ReadGatewaysStates(bindtxid, 'S', vRead));
+        ASSERT_EQ(vRead.size(), 1);
+        vRead.clear();
+        ASSERT_TRUE(db->ReadGatewaysStates(bindtxid, 'D', vRead));
+        EXPECT_TRUE(vRead.empty());
+
+        uint256 tmpbindtxid;
+        ASSERT_TRUE(db->ReadGatewaysWithdrawBind(TxHash(12), tmpbindtxid));
+        EXPECT_EQ(tmpbindtxid, bindtxid);
+
+        // a completesigning moves the partially signed withdraw, a null value erases the old record
+        CGatewaysStateValue value;
+        ASSERT_TRUE(db->ReadGatewaysState(CGatewaysStateKey(bindtxid, 'W', TxHash(11)), value));
+        value.vtxid.push_back(TxHash(14));
+        vWrite.clear();
+        vWithdraws.clear();
+        vWrite.push_back(std::make_pair(CGatewaysStateKey(bindtxid, 'W', TxHash(11)), CGatewaysStateValue()));
+        vWrite.push_back(std::make_pair(CGatewaysStateKey(bindtxid, 'S', TxHash(11)), value));
+        vWithdraws.push_back(std::make_pair(TxHash(10), uint256()));
+        ASSERT_TRUE(db->UpdateGatewaysIndex(vWrite, vWithdraws));
+        EXPECT_FALSE(db->ReadGatewaysState(CGatewaysStateKey(bindtxid, 'W', TxHash(11)), value));
+        EXPECT_FALSE(db->ReadGatewaysWithdrawBind(TxHash(10), tmpbindtxid));
+        vRead.clear();
+        ASSERT_TRUE(db->ReadGatewaysStates(bindtxid, 'S', vRead));
+        ASSERT_EQ(vRead.size(), 2);
+        EXPECT_EQ(vRead[0].second.vtxid.size(), 3);
+    }
+
+    TEST(TestAddressIndex, gateways_index_entries) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        CBlockTreeDB *pblocktreeSaved = pblocktree;
+        pblocktree = db.get();
+        CKey key;
+        key.MakeNewKey(true);
+        const CPubKey pk = key.GetPubKey();
+        const uint256 bindtxid = TxHash(1), tokenid = TxHash(2);
+        // vout 0 is the marker the next step of a deposit or a withdraw spends
+        const CTxOut marker = MakeCC1vout(EVAL_GATEWAYS, 10000, pk);
+        auto makeTx = [&](const COutPoint &prevout, const CScript &opret) {
+            CMutableTransaction mtx;
+            mtx.vin.push_back(CTxIn(prevout, CScript()));
+            mtx.vout.push_back(marker);
+            mtx.vout.push_back(CTxOut(0, opret));
+            return CTransaction(mtx);
+        };
+
+        // a deposit and a withdraw in one block, then the claim and the whole signing of the withdraw in the next
+        CBlock block1, block2;
+        const CTransaction txDeposit = makeTx(COutPoint(TxHash(3), 0), EncodeGatewaysDepositOpRet('D', bindtxid, "KMD", std::vector<CPubKey>(), std::vector<uint256>(), 10, TxHash(4), 0, "", std::vector<uint8_t>(), pk, 100));
+        const CTransaction txWithdraw = makeTx(COutPoint(TxHash(5), 0), EncodeGatewaysWithdrawOpRet('W', tokenid, bindtxid, "KMD", pk, 50));
+        block1.vtx.push_back(txDeposit);
+        block1.vtx.push_back(txWithdraw);
+        const CTransaction txClaim = makeTx(COutPoint(txDeposit.GetHash(), 0), EncodeGatewaysClaimOpRet('C', tokenid, bindtxid, "KMD", txDeposit.GetHash(), pk, 100));
+        const CTransaction txPartial = makeTx(COutPoint(txWithdraw.GetHash(), 0), EncodeGatewaysPartialOpRet('P', txWithdraw.GetHash(), "KMD", 1, pk, ""));
+        const CTransaction txComplete = makeTx(COutPoint(txPartial.GetHash(), 0), EncodeGatewaysCompleteSigningOpRet('S', txWithdraw.GetHash(), "KMD", 2, ""));
+        const CTransaction txMarkDone = makeTx(COutPoint(txComplete.GetHash(), 0), EncodeGatewaysMarkDoneOpRet('M', txWithdraw.GetHash(), "KMD", txComplete.GetHash()));
+        // a second claim of the same deposit does not spend its marker
+        const CTransaction txClaimAgain = makeTx(COutPoint(TxHash(6), 0), EncodeGatewaysClaimOpRet('C', tokenid, bindtxid, "KMD", txDeposit.GetHash(), pk, 100));
+        block2.vtx.push_back(txClaim);
+        block2.vtx.push_back(txClaimAgain);
+        block2.vtx.push_back(txPartial);
+        block2.vtx.push_back(txComplete);
+        block2.vtx.push_back(txMarkDone);
+
+        auto connect = [&](const CBlock &block, bool fConnect) {
+            std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > states;
+            std::vector<std::pair<uint256, uint256> > withdraws;
+            GetGatewaysIndexEntries(block, fConnect, states, withdraws);
+            return pblocktree->UpdateGatewaysIndex(states, withdraws);
+        };
+        auto count = [&](uint8_t stage) {
+            std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > vRead;
+            EXPECT_TRUE(pblocktree->ReadGatewaysStates(bindtxid, stage, vRead));
+            return vRead.size();
+        };
+
+        ASSERT_TRUE(connect(block1, true));
+        EXPECT_EQ(count('D'), 1);
+        EXPECT_EQ(count('W'), 1);
+        uint256 tmpbindtxid;
+        ASSERT_TRUE(pblocktree->ReadGatewaysWithdrawBind(txWithdraw.GetHash(), tmpbindtxid));
+        EXPECT_EQ(tmpbindtxid, bindtxid);
+
+        ASSERT_TRUE(connect(block2, true));
+        EXPECT_EQ(count('D'), 0);
+        EXPECT_EQ(count('C'), 1);
+        EXPECT_EQ(count('W'), 0);
+        EXPECT_EQ(count('S'), 0);
+        ASSERT_EQ(count('M'), 1);
+        CGatewaysStateValue value;
+        ASSERT_TRUE(pblocktree->ReadGatewaysState(CGatewaysStateKey(bindtxid, 'C', txDeposit.GetHash()), value));
+        EXPECT_EQ(value.vtxid, std::vector<uint256>({ txDeposit.GetHash(), txClaim.GetHash() }));
+        ASSERT_TRUE(pblocktree->ReadGatewaysState(CGatewaysStateKey(bindtxid, 'M', txWithdraw.GetHash()), value));
+        EXPECT_EQ(value.vtxid, std::vector<uint256>({ txWithdraw.GetHash(), txPartial.GetHash(), txComplete.GetHash(), txMarkDone.GetHash() }));
+
+        // disconnecting the blocks walks the records back
+        ASSERT_TRUE(connect(block2, false));
+        EXPECT_EQ(count('C'), 0);
+        EXPECT_EQ(count('M'), 0);
+        ASSERT_TRUE(pblocktree->ReadGatewaysState(CGatewaysStateKey(bindtxid, 'D', txDeposit.GetHash()), value));
+        EXPECT_EQ(value.vtxid, std::vector<uint256>(1, txDeposit.GetHash()));
+        ASSERT_TRUE(pblocktree->ReadGatewaysState(CGatewaysStateKey(bindtxid, 'W', txWithdraw.GetHash()), value));
+        EXPECT_EQ(value.vtxid, std::vector<uint256>(1, txWithdraw.GetHash()));
+
+        ASSERT_TRUE(connect(block1, false));
+        EXPECT_EQ(count('D'), 0);
+        EXPECT_EQ(count('W'), 0);
+        EXPECT_FALSE(pblocktree->ReadGatewaysWithdrawBind(txWithdraw.GetHash(), tmpbindtxid));
+
+        pblocktree = pblocktreeSaved;
+    }
+
+    TEST(TestAddressIndex, address_unspent_pages) {
+        std::unique_ptr<CBlockTreeDB> db(new CBlockTreeDB(1 << 20, true));
+        uint160 hashAddress;
+        hashAddress.begin()[0] = 1;
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vWrite;
+        for (int i = 0; i < 12; i++)
+            vWrite.push_back(std::make_pair(CAddressUnspentKey(1, hashAddress, TxHash(i), i % 3), CAddressUnspentValue(i + 1, CScript(), 100 + i)));
+        ASSERT_TRUE(db->UpdateAddressUnspentIndex(vWrite));
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vFull, vPaged;
+        ASSERT_TRUE(db->ReadAddressUnspentIndex(hashAddress, 1, vFull));
+        ASSERT_EQ(vFull.size(), 12);
+
+        CAddressUnspentKey keyAfter;
+        bool fMore = true;
+        const CAddressUnspentKey *pkeyAfter = NULL;
+        while (fMore) {
+            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vPage;
+            ASSERT_TRUE(db->ReadAddressUnspentIndexPage(hashAddress, 1, pkeyAfter, 5, vPage, fMore));
+            EXPECT_EQ(vPage.size(), vPaged.size() < 10 ? 5 : 2);
+            vPaged.insert(vPaged.end(), vPage.begin(), vPage.end());
+            keyAfter = vPage.back().first;
+            pkeyAfter = &keyAfter;
+        }
+        // the same records in the same order as the full read
+        ASSERT_EQ(vPaged.size(), vFull.size());
+        for (size_t i = 0; i < vFull.size(); i++) {
+            EXPECT_EQ(vPaged[i].first.txhash, vFull[i].first.txhash);
+            EXPECT_EQ(vPaged[i].first.index, vFull[i].first.index);
+            EXPECT_EQ(vPaged[i].second.satoshis, vFull[i].second.satoshis);
+        }
+    }
+}
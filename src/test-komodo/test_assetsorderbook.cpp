@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include "cc/CCassetsorderbook.h"
+
+namespace TestAssetsOrderBook {
+
+    static uint256 Hash(uint8_t n)
+    {
+        uint256 hash;
+        hash.begin()[0] = n;
+        return hash;
+    }
+
+    // a transaction creating an order on vout 0, its funcid and price in the locktime
+    static CTransaction OrderTx(uint8_t n, uint8_t funcid, int64_t price, const std::vector<COutPoint> &spent)
+    {
+        CMutableTransaction mtx;
+        for (size_t i = 0; i < spent.size(); i++)
+            mtx.vin.push_back(CTxIn(spent[i]));
+        mtx.vout.push_back(CTxOut(100, CScript() << n));
+        mtx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << funcid));
+        mtx.nLockTime = price;
+        return mtx;
+    }
+
+    static bool Decode(const CTransaction &tx, std::vector<CAssetOrder> &orders)
+    {
+        orders.clear();
+        if (tx.vout.size() != 2 || tx.vout[1].scriptPubKey[0] != OP_RETURN)
+            return false;
+        CAssetOrder order;
+        order.funcid = tx.vout[1].scriptPubKey[2];
+        order.outpoint = COutPoint(tx.GetHash(), 0);
+        order.amount = order.amount0 = tx.vout[0].nValue;
+        order.assetid = Hash(1);
+        order.price = tx.nLockTime;
+        orders.push_back(order);
+        return true;
+    }
+
+    static CBlock Block(const std::vector<CTransaction> &vtx)
+    {
+        CBlock block;
+        CMutableTransaction coinbase;
+        coinbase.vin.push_back(CTxIn());
+        block.vtx.push_back(coinbase);
+        block.vtx.insert(block.vtx.end(), vtx.begin(), vtx.end());
+        return block;
+    }
+
+    TEST(TestAssetsOrderBook, blocks_and_mempool) {
+        std::set<uint256> mempool;
+        CAssetsOrderBook book(Decode, [&mempool](const uint256 &txid) { return mempool.count(txid) != 0; }, 1);
+        std::vector<CAssetOrder> bids, asks;
+
+        // nothing is kept for the blocks before the load
+        const CTransaction ask1 = OrderTx(1, 's', 300, std::vector<COutPoint>());
+        book.ConnectBlock(Block({ask1}), Hash(10), Hash(11));
+        EXPECT_FALSE(book.IsLoaded(Hash(11), 0));
+
+        std::vector<CAssetOrder> orders;
+        ASSERT_TRUE(Decode(ask1, orders));
+        book.Load(Hash(11), 0, orders);
+        EXPECT_TRUE(book.IsLoaded(Hash(11), 0));
+        EXPECT_FALSE(book.IsLoaded(Hash(11), 0xf2));
+
+        const CTransaction ask2 = OrderTx(2, 's', 200, std::vector<COutPoint>());
+        const CTransaction bid1 = OrderTx(3, 'b', 50, std::vector<COutPoint>());
+        const CTransaction bid2 = OrderTx(4, 'b', 20, std::vector<COutPoint>());
+        book.ConnectBlock(Block({ask2, bid1, bid2}), Hash(11), Hash(12));
+        EXPECT_TRUE(book.IsLoaded(Hash(12), 0));
+        book.GetOrders(Hash(1), bids, asks);
+        ASSERT_EQ(bids.size(), 2);
+        ASSERT_EQ(asks.size(), 2);
+        // the highest bid and the lowest ask first
+        EXPECT_EQ(bids[0].outpoint.hash, bid2.GetHash());
+        EXPECT_EQ(asks[0].outpoint.hash, ask2.GetHash());
+        book.GetOrders(Hash(2), bids, asks);
+        EXPECT_TRUE(bids.empty() && asks.empty());
+
+        // a fill in the mempool spends ask2 and creates its remainder
+        const CTransaction fill = OrderTx(5, 'S', 100, {COutPoint(ask2.GetHash(), 0)});
+        mempool.insert(fill.GetHash());
+        book.AddMempoolTx(fill);
+        book.GetOrders(Hash(1), bids, asks);
+        ASSERT_EQ(asks.size(), 2);
+        EXPECT_EQ(asks[0].outpoint.hash, fill.GetHash());
+        EXPECT_EQ(asks[1].outpoint.hash, ask1.GetHash());
+
+        // dropped from the mempool
+        mempool.clear();
+        book.GetOrders(Hash(1), bids, asks);
+        ASSERT_EQ(asks.size(), 2);
+        EXPECT_EQ(asks[0].outpoint.hash, ask2.GetHash());
+
+        // then mined, and disconnected
+        book.ConnectBlock(Block({fill}), Hash(12), Hash(13));
+        book.GetOrders(Hash(1), bids, asks);
+        ASSERT_EQ(asks.size(), 2);
+        EXPECT_EQ(asks[0].outpoint.hash, fill.GetHash());
+        book.DisconnectBlock(Block({fill}), Hash(13), Hash(12));
+        EXPECT_TRUE(book.IsLoaded(Hash(12), 0));
+        book.GetOrders(Hash(1), bids, asks);
+        ASSERT_EQ(asks.size(), 2);
+        EXPECT_EQ(asks[0].outpoint.hash, ask2.GetHash());
+
+        // past the undo kept the book must be loaded again
+        book.DisconnectBlock(Block({ask2, bid1, bid2}), Hash(12), Hash(11));
+        EXPECT_FALSE(book.IsLoaded(Hash(11), 0));
+        book.GetOrders(Hash(1), bids, asks);
+        EXPECT_TRUE(bids.empty() && asks.empty());
+    }
+}
@@ -4,8 +4,13 @@
 #include "consensus/validation.h"
 #include "coincontrol.h"
 #include "miner.h"
+#include "txmempool.h"
+#include "blockencodings.h"
+#include "blockreader.h"
+#include "mappedfile.h"
 
 #include <thread>
+#include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 
 // NB! first generateBlock call changes IsInitialBlockDownload() to false globally (!), affects other tests
@@ -21,6 +26,219 @@ TEST(test_block, header_size_is_expected) {
     EXPECT_EQ(ss.size(), stream_size);
 }
 
+TEST(test_block, disk_tx_pos_block_hash) {
+    CDiskBlockPos blockPos(3, 1000);
+    uint256 hashBlock = uint256S("0x027e3758c3a65b12aa1046462b486d0a63bfa1beae327897f56c5cfb7daaae71");
+
+    // entries written before the block hash was stored
+    CDiskTxPos oldPos(blockPos, 81);
+    CDataStream ssOld(SER_DISK, CLIENT_VERSION);
+    ssOld << oldPos;
+    CDiskTxPos readOld;
+    ssOld >> readOld;
+    EXPECT_EQ(readOld.nFile, 3);
+    EXPECT_EQ(readOld.nPos, 1000);
+    EXPECT_EQ(readOld.nTxOffset, 81);
+    EXPECT_TRUE(readOld.hashBlock.IsNull());
+
+    CDiskTxPos newPos(blockPos, 81, hashBlock);
+    CDataStream ssNew(SER_DISK, CLIENT_VERSION);
+    ssNew << newPos;
+    EXPECT_EQ(ssNew.size(), ::GetSerializeSize(oldPos, SER_DISK, CLIENT_VERSION) + 32);
+    CDiskTxPos readNew;
+    ssNew >> readNew;
+    EXPECT_EQ(readNew.nTxOffset, 81);
+    EXPECT_EQ(readNew.hashBlock, hashBlock);
+}
+
+static CBlock MakeTestBlock(int nTx)
+{
+    CBlock block;
+    for (int i = 0; i < nTx; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout.n = i;
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = i;
+        block.vtx.push_back(CTransaction(mtx));
+    }
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+TEST(test_block, merkle_root_cache) {
+    CBlock block = MakeTestBlock(5);
+    CBlock copy = block;
+    bool mutated = true;
+    EXPECT_EQ(copy.GetMerkleRoot(&mutated), block.hashMerkleRoot);
+    EXPECT_FALSE(mutated);
+
+    // A tree built for other transactions is not used
+    copy.vtx.pop_back();
+    EXPECT_NE(copy.GetMerkleRoot(), block.hashMerkleRoot);
+    EXPECT_EQ(copy.GetMerkleRoot(), copy.BuildMerkleTree());
+
+    // Mutation is remembered with the tree
+    copy.vtx[3] = copy.vtx[2];
+    copy.BuildMerkleTree();
+    EXPECT_EQ(copy.GetMerkleRoot(&mutated), copy.vMerkleTree.back());
+    EXPECT_TRUE(mutated);
+}
+
+TEST(test_block, block_file_reader) {
+    // Two blocks with garbage in between, as in a block file
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL);
+    std::vector<CBlock> blocks = { MakeTestBlock(3), MakeTestBlock(7) };
+    {
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        for (const CBlock &block : blocks) {
+            fileout << FLATDATA(Params().MessageStart()) << (unsigned int)GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+            fileout << block;
+            fileout << (uint32_t)0xdeadbeef;
+        }
+        fflush(file);
+        rewind(file);
+        fileout.release();
+    }
+
+    CBlockFileReader reader(file, 1);
+    std::shared_ptr<CBlock> pblock;
+    uint64_t nBlockPos;
+    for (const CBlock &block : blocks) {
+        ASSERT_TRUE(reader.Next(pblock, nBlockPos));
+        EXPECT_EQ(pblock->GetHash(), block.GetHash());
+        EXPECT_EQ(pblock->vtx.size(), block.vtx.size());
+        // the merkle tree is ready
+        EXPECT_FALSE(pblock->vMerkleTree.empty());
+        EXPECT_EQ(pblock->GetMerkleRoot(), block.hashMerkleRoot);
+    }
+    EXPECT_FALSE(reader.Next(pblock, nBlockPos));
+}
+
+TEST(test_block, raw_block_cache) {
+    CRawBlockCache cache(250);
+    uint256 hash1 = uint256S("01"), hash2 = uint256S("02"), hash3 = uint256S("03");
+    CRawBlockRef raw1 = std::make_shared<std::vector<unsigned char> >(100, 1);
+    CRawBlockRef raw2 = std::make_shared<std::vector<unsigned char> >(100, 2);
+    CRawBlockRef raw3 = std::make_shared<std::vector<unsigned char> >(100, 3);
+    cache.Insert(hash1, raw1);
+    cache.Insert(hash2, raw2);
+    EXPECT_EQ(cache.Bytes(), 200);
+    // using the first block makes the second one the oldest
+    EXPECT_EQ(cache.Get(hash1), raw1);
+    cache.Insert(hash3, raw3);
+    EXPECT_EQ(cache.Bytes(), 200);
+    EXPECT_EQ(cache.Get(hash1), raw1);
+    EXPECT_TRUE(cache.Get(hash2) == nullptr);
+    EXPECT_EQ(cache.Get(hash3), raw3);
+    // too large to be cached
+    cache.Insert(hash2, std::make_shared<std::vector<unsigned char> >(300, 2));
+    EXPECT_TRUE(cache.Get(hash2) == nullptr);
+    cache.Clear();
+    EXPECT_EQ(cache.Bytes(), 0);
+}
+
+TEST(test_block, compact_block) {
+    CBlock block = MakeTestBlock(4);
+    CBlockHeaderAndShortTxIDs cmpctblock(block);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << cmpctblock;
+    CBlockHeaderAndShortTxIDs received;
+    ss >> received;
+    EXPECT_EQ(received.header.GetHash(), block.GetHash());
+    EXPECT_EQ(received.BlockTxCount(), block.vtx.size());
+    EXPECT_EQ(received.GetShortID(block.vtx[2].GetHash()), cmpctblock.GetShortID(block.vtx[2].GetHash()));
+
+    // Nothing in the mempool, only the prefilled coinbase is available
+    CTxMemPool pool(CFeeRate(0));
+    PartiallyDownloadedBlock partialBlock(&pool);
+    ASSERT_EQ(partialBlock.InitData(received), READ_STATUS_OK);
+    EXPECT_TRUE(partialBlock.IsTxAvailable(0));
+    BlockTransactionsRequest req;
+    for (size_t i = 0; i < received.BlockTxCount(); i++)
+        if (!partialBlock.IsTxAvailable(i))
+            req.indexes.push_back(i);
+    ASSERT_EQ(req.indexes.size(), 3);
+
+    // The request survives the differential encoding of its indexes
+    req.blockhash = block.GetHash();
+    CDataStream ssReq(SER_NETWORK, PROTOCOL_VERSION);
+    ssReq << req;
+    BlockTransactionsRequest receivedReq;
+    ssReq >> receivedReq;
+    EXPECT_EQ(receivedReq.indexes, req.indexes);
+
+    BlockTransactions resp(receivedReq);
+    for (size_t i = 0; i < receivedReq.indexes.size(); i++)
+        resp.txn[i] = block.vtx[receivedReq.indexes[i]];
+
+    // Missing transactions are an invalid answer, and a block can only be filled once
+    PartiallyDownloadedBlock partialCopy = partialBlock;
+    CBlock rebuilt;
+    EXPECT_EQ(partialCopy.FillBlock(rebuilt, std::vector<CTransaction>(resp.txn.begin(), resp.txn.end() - 1)), READ_STATUS_INVALID);
+    ASSERT_EQ(partialBlock.FillBlock(rebuilt, resp.txn), READ_STATUS_OK);
+    EXPECT_EQ(rebuilt.GetHash(), block.GetHash());
+    EXPECT_EQ(rebuilt.BuildMerkleTree(), block.hashMerkleRoot);
+
+    // Wrong transactions don't match the merkle root
+    PartiallyDownloadedBlock partialWrong(&pool);
+    ASSERT_EQ(partialWrong.InitData(received), READ_STATUS_OK);
+    std::vector<CTransaction> vWrong(resp.txn);
+    std::swap(vWrong[0], vWrong[1]);
+    EXPECT_EQ(partialWrong.FillBlock(rebuilt, vWrong), READ_STATUS_FAILED);
+}
+
+TEST(test_block, mapped_block_file) {
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    CBlock block = MakeTestBlock(3);
+    {
+        CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        ASSERT_FALSE(fileout.IsNull());
+        fileout << block;
+    }
+    uint64_t nSize = boost::filesystem::file_size(path);
+
+    CMappedFileCache cache;
+    EXPECT_TRUE(cache.Get(1, path, 0) == nullptr); // disabled
+    cache.SetMaxFiles(1);
+    std::shared_ptr<const CMappedFile> mapped = cache.Get(1, path, 0);
+    ASSERT_TRUE(mapped != nullptr);
+    EXPECT_EQ(mapped->size(), nSize);
+    EXPECT_EQ(cache.Get(1, path, nSize - 1), mapped);
+
+    // reading from the mapping and from the file give the same block
+    CBlock fromMapping, fromFile;
+    CDiskFileStream mappedIn(mapped, 0, fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    EXPECT_TRUE(mappedIn.IsMapped());
+    mappedIn >> fromMapping;
+    EXPECT_EQ(fromMapping.GetHash(), block.GetHash());
+    EXPECT_EQ(fromMapping.vtx.size(), block.vtx.size());
+    EXPECT_THROW(mappedIn >> fromMapping, std::ios_base::failure);
+    CDiskFileStream fileIn(nullptr, 0, fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    EXPECT_FALSE(fileIn.IsMapped());
+    fileIn >> fromFile;
+    EXPECT_EQ(fromFile.GetHash(), block.GetHash());
+
+    // appended data is mapped again
+    {
+        CAutoFile fileout(fopen(path.string().c_str(), "ab"), SER_DISK, CLIENT_VERSION);
+        fileout << block;
+    }
+    std::shared_ptr<const CMappedFile> remapped = cache.Get(1, path, nSize);
+    ASSERT_TRUE(remapped != nullptr);
+    EXPECT_EQ(remapped->size(), 2 * nSize);
+    CDiskFileStream remappedIn(remapped, 0, NULL, SER_DISK, CLIENT_VERSION);
+    remappedIn.Seek(nSize);
+    remappedIn >> fromMapping;
+    EXPECT_EQ(fromMapping.GetHash(), block.GetHash());
+
+    // older mappings stay valid for their readers
+    EXPECT_EQ(mapped->size(), nSize);
+    cache.Erase(1);
+    boost::filesystem::remove(path);
+}
+
 TEST(test_block, TestStopAt)
 {
     TestChain chain;
@@ -36,6 +254,28 @@ TEST(test_block, TestStopAt)
     KOMODO_STOPAT = 0; // to not stop other tests
 }
 
+TEST(test_block, TestReadRawBlock)
+{
+    TestChain chain;
+    auto notary = std::make_shared<TestWallet>(chain.getNotaryKey(), "notary");
+    std::shared_ptr<CBlock> lastBlock = chain.generateBlock(notary);
+    CBlockIndex *pindex = chain.GetIndex();
+    ASSERT_EQ(pindex->GetBlockHash(), lastBlock->GetHash());
+
+    // the stored bytes are the network serialization
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << *lastBlock;
+    std::vector<unsigned char> raw;
+    ASSERT_TRUE(ReadRawBlockFromDisk(raw, pindex));
+    EXPECT_EQ(std::vector<unsigned char>(ss.begin(), ss.end()), raw);
+
+    // served again from the cache
+    CRawBlockRef cached = GetRawBlock(pindex);
+    ASSERT_TRUE(cached != nullptr);
+    EXPECT_EQ(*cached, raw);
+    EXPECT_EQ(GetRawBlock(pindex), cached);
+}
+
 TEST(test_block, TestConnectWithoutChecks)
 {
     TestChain chain;
@@ -70,6 +310,73 @@ TEST(test_block, TestConnectWithoutChecks)
         FAIL() << state.GetRejectReason();
 }
 
+TEST(test_block, TestConnectAssumedNotarized)
+{
+    TestChain chain;
+    auto notary = std::make_shared<TestWallet>(chain.getNotaryKey(), "notary");
+    auto alice = std::make_shared<TestWallet>("alice");
+    std::shared_ptr<CBlock> lastBlock = chain.generateBlock(notary); // genesis block
+    ASSERT_GT( chain.GetIndex()->nHeight, 0 );
+    int32_t newHeight = chain.GetIndex()->nHeight + 1;
+    TransactionInProcess fundAlice = notary->CreateSpendTransaction(alice, 100000);
+    // break the signature, only the script checks can see it
+    CMutableTransaction badSpend(fundAlice.transaction);
+    std::vector<unsigned char> scriptSig(badSpend.vin[0].scriptSig.begin(), badSpend.vin[0].scriptSig.end());
+    ASSERT_GT(scriptSig.size(), 10);
+    scriptSig[10] ^= 1;
+    badSpend.vin[0].scriptSig = CScript(scriptSig.begin(), scriptSig.end());
+    CBlock block;
+    auto consensusParams = Params().GetConsensus();
+    CMutableTransaction txNew = CreateNewContextualCMutableTransaction(consensusParams, newHeight);
+    txNew.vin.resize(1);
+    txNew.vin[0].prevout.SetNull();
+    txNew.vin[0].scriptSig = (CScript() << newHeight << CScriptNum(1)) + COINBASE_FLAGS;
+    txNew.vout.resize(1);
+    txNew.vout[0].nValue = GetBlockSubsidy(newHeight,consensusParams);
+    txNew.nExpiryHeight = 0;
+    block.vtx.push_back(CTransaction(txNew));
+    block.vtx.push_back(CTransaction(badSpend));
+    uint256 hashBlock = block.GetHash();
+    CBlockIndex newIndex;
+    newIndex.phashBlock = &hashBlock;
+    newIndex.pprev = chain.GetIndex();
+    newIndex.nHeight = newHeight;
+    newIndex.BuildSkip();
+
+    // fully checked without -assumenotarized
+    CValidationState state;
+    EXPECT_FALSE( chain.ConnectBlock(block, state, &newIndex, true, false) );
+
+    // the block is assumed notarized, headers are piled above it
+    CBlockIndex* pindexBestHeaderOld = pindexBestHeader;
+    mapBlockIndex[hashBlock] = &newIndex;
+    hashAssumeNotarized = hashBlock;
+    std::vector<CBlockIndex> headers(ASSUMENOTARIZED_MIN_DEPTH);
+    CBlockIndex* pprev = &newIndex;
+    for (CBlockIndex& header : headers) {
+        header.pprev = pprev;
+        header.nHeight = pprev->nHeight + 1;
+        header.BuildSkip();
+        pprev = &header;
+    }
+
+    // not deep enough yet
+    pindexBestHeader = &headers[ASSUMENOTARIZED_MIN_DEPTH - 2];
+    CValidationState stateShallow;
+    EXPECT_FALSE( chain.ConnectBlock(block, stateShallow, &newIndex, true, false) );
+
+    // the script checks are skipped, the bad signature goes through
+    pindexBestHeader = &headers.back();
+    CValidationState stateAssumed;
+    EXPECT_TRUE( chain.ConnectBlock(block, stateAssumed, &newIndex, true, false) );
+    if (!stateAssumed.IsValid() )
+        FAIL() << stateAssumed.GetRejectReason();
+
+    hashAssumeNotarized.SetNull();
+    pindexBestHeader = pindexBestHeaderOld;
+    mapBlockIndex.erase(hashBlock);
+}
+
 TEST(test_block, TestSpendInSameBlock)
 {
     //setConsoleDebugging(true);
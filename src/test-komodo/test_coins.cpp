@@ -10,6 +10,7 @@
 #include "test/test_bitcoin.h"
 #include "consensus/validation.h"
 #include "main.h"
+#include "txdb.h"
 #include "undo.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
@@ -202,16 +203,33 @@ public:
     {
         // Manually recompute the dynamic usage of the whole data, and compare it.
         size_t ret = memusage::DynamicUsage(cacheCoins) +
+                     memusage::DynamicUsage(cacheOutputs) +
                      memusage::DynamicUsage(cacheSproutAnchors) +
                      memusage::DynamicUsage(cacheSaplingAnchors) +
                      memusage::DynamicUsage(cacheSproutNullifiers) +
                      memusage::DynamicUsage(cacheSaplingNullifiers);
         for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
-            ret += it->second.coins.DynamicMemoryUsage();
+            ret += it->second.DynamicMemoryUsage();
+        }
+        for (CCoinsOutputMap::iterator it = cacheOutputs.begin(); it != cacheOutputs.end(); it++) {
+            // an output is only cached on its own while its transaction is not
+            EXPECT_EQ(cacheCoins.count(it->first.hash), 0);
+            ret += it->second.DynamicMemoryUsage();
         }
         EXPECT_EQ(DynamicMemoryUsage(), ret);
     }
 
+    bool HaveOutputInCache(const COutPoint &outpoint) const
+    {
+        return cacheOutputs.count(outpoint) != 0;
+    }
+
+    std::set<uint32_t> DirtyOutputs(const uint256 &txid) const
+    {
+        CCoinsMap::const_iterator it = cacheCoins.find(txid);
+        return it == cacheCoins.end() ? std::set<uint32_t>() : it->second.dirtyOutputs;
+    }
+
 };
 
 class TxWithNullifiers
@@ -971,4 +989,246 @@ TEST(TestCoins, ccoins_serialization)
     }
 }
 
+
+TEST(TestCoins, coins_db_raw_records)
+{
+    // Changes recorded as raw records take effect once written
+    CCoinsViewDB db(1 << 20, true);
+    uint256 txid = GetRandHash();
+    uint256 hashBlock = GetRandHash();
+    uint256 nullifier = GetRandHash();
+    {
+        CCoinsMap mapCoins;
+        CAnchorsSproutMap mapSproutAnchors;
+        CAnchorsSaplingMap mapSaplingAnchors;
+        CNullifiersMap mapSproutNullifiers, mapSaplingNullifiers;
+        CCoinsCacheEntry entry;
+        entry.coins.vout.resize(2);
+        entry.coins.vout[1].nValue = 12345;
+        entry.coins.nHeight = 7;
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        entry.dirtyOutputs.insert(1);
+        mapCoins[txid] = entry;
+        CNullifiersCacheEntry nf;
+        nf.entered = true;
+        nf.flags = CNullifiersCacheEntry::DIRTY;
+        mapSaplingNullifiers[nullifier] = nf;
+
+        CCoinsDBRecordMap records;
+        db.RecordBatch(records, mapCoins, hashBlock, uint256(), uint256(),
+                mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers);
+        EXPECT_EQ(records.size(), 4);
+        EXPECT_TRUE(db.GetBestBlock().IsNull());
+        EXPECT_TRUE(db.WriteRawRecords(records, true));
+    }
+
+    CCoins coins;
+    EXPECT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_EQ(coins.nHeight, 7);
+    EXPECT_EQ(coins.vout[1].nValue, 12345);
+    EXPECT_TRUE(db.GetNullifier(nullifier, SAPLING));
+    EXPECT_EQ(db.GetBestBlock(), hashBlock);
+
+    // The raw cursor sees every record
+    std::unique_ptr<CDBIterator> pcursor(db.RawCursor());
+    size_t nRecords = 0;
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next())
+        nRecords++;
+    EXPECT_EQ(nRecords, 4);
+}
+
+
+TEST(TestCoins, coins_db_per_output)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    for (int i = 0; i < 1000; i++)
+        mtx.vout.push_back(CTxOut(i + 1, CScript() << OP_TRUE));
+    CTransaction tx(mtx);
+    uint256 txid = tx.GetHash();
+
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->FromTx(tx, 10);
+        cache.SetBestBlock(GetRandHash());
+        EXPECT_TRUE(cache.Flush());
+    }
+    CCoins coins;
+    EXPECT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_EQ(coins, CCoins(tx, 10));
+
+    // Spending one output only touches that output
+    {
+        CCoinsViewCacheTest cache(&db);
+        CCoinsViewCacheTest child(&cache);
+        child.ModifyCoins(txid)->Spend(500);
+        EXPECT_EQ(child.DirtyOutputs(txid), std::set<uint32_t>({500}));
+        EXPECT_TRUE(child.Flush());
+        child.ModifyCoins(txid)->Spend(999);
+        EXPECT_TRUE(child.Flush());
+        EXPECT_EQ(cache.DirtyOutputs(txid), std::set<uint32_t>({500, 999}));
+        cache.SelfTest();
+        EXPECT_TRUE(cache.Flush());
+    }
+    EXPECT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_EQ(coins.vout.size(), 999);
+    EXPECT_FALSE(coins.IsAvailable(500));
+    EXPECT_TRUE(coins.IsAvailable(501));
+    EXPECT_EQ(coins.nHeight, 10);
+
+    // Restoring an output and spending everything
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->vout[500] = tx.vout[500];
+        EXPECT_TRUE(cache.Flush());
+    }
+    EXPECT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_TRUE(coins.IsAvailable(500));
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->Clear();
+        EXPECT_TRUE(cache.Flush());
+    }
+    EXPECT_FALSE(db.HaveCoins(txid));
+    EXPECT_FALSE(db.GetCoins(txid, coins));
+}
+
+TEST(TestCoins, coins_db_single_output)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    for (int i = 0; i < 10; i++)
+        mtx.vout.push_back(CTxOut(i + 1, CScript() << OP_TRUE));
+    CTransaction tx(mtx);
+    uint256 txid = tx.GetHash();
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->FromTx(tx, 10);
+        cache.SetBestBlock(GetRandHash());
+        EXPECT_TRUE(cache.Flush());
+    }
+
+    // The database reads a single output
+    CCoinsOutput coin;
+    EXPECT_TRUE(db.GetCoin(COutPoint(txid, 3), coin));
+    EXPECT_EQ(coin.out, tx.vout[3]);
+    EXPECT_EQ(coin.nHeight, 10);
+    EXPECT_FALSE(coin.fCoinBase);
+    EXPECT_FALSE(db.GetCoin(COutPoint(txid, 10), coin));
+    EXPECT_FALSE(db.GetCoin(COutPoint(GetRandHash(), 0), coin));
+
+    // The cache keeps single outputs until the transaction is loaded
+    CCoinsViewCacheTest cache(&db);
+    const CTxOut *out = cache.AccessOutput(COutPoint(txid, 3));
+    ASSERT_TRUE(out != NULL);
+    EXPECT_EQ(*out, tx.vout[3]);
+    EXPECT_TRUE(cache.HaveOutputInCache(COutPoint(txid, 3)));
+    EXPECT_FALSE(cache.HaveCoinsInCache(txid));
+    EXPECT_TRUE(cache.AccessOutput(COutPoint(txid, 10)) == NULL);
+    cache.SelfTest();
+
+    // Spending the output replaces it by the whole transaction
+    cache.ModifyCoins(txid)->Spend(3);
+    EXPECT_FALSE(cache.HaveOutputInCache(COutPoint(txid, 3)));
+    EXPECT_TRUE(cache.AccessOutput(COutPoint(txid, 3)) == NULL);
+    EXPECT_FALSE(cache.GetCoin(COutPoint(txid, 3), coin));
+    cache.SelfTest();
+
+    // Outputs spent in a child are not served from the parent afterwards
+    EXPECT_TRUE(cache.GetCoin(COutPoint(txid, 4), coin));
+    EXPECT_TRUE(cache.Flush());
+    EXPECT_TRUE(cache.AccessOutput(COutPoint(txid, 3)) == NULL);
+    CCoinsViewCacheTest child(&cache);
+    EXPECT_TRUE(child.GetCoin(COutPoint(txid, 4), coin));
+    EXPECT_TRUE(cache.HaveOutputInCache(COutPoint(txid, 4)));
+    child.ModifyCoins(txid)->Spend(4);
+    EXPECT_TRUE(child.Flush());
+    EXPECT_FALSE(cache.HaveOutputInCache(COutPoint(txid, 4)));
+    EXPECT_FALSE(cache.GetCoin(COutPoint(txid, 4), coin));
+    cache.SelfTest();
+    child.SelfTest();
+}
+
+TEST(TestCoins, coins_db_format)
+{
+    // The format has its own record, it reads as 0 until written
+    CBlockTreeDB blocktree(1 << 20, true);
+    int nFormat = -1;
+    EXPECT_TRUE(blocktree.ReadCoinsFormat(nFormat));
+    EXPECT_EQ(nFormat, 0);
+    EXPECT_TRUE(blocktree.WriteCoinsFormat(COINS_DB_FORMAT));
+    EXPECT_TRUE(blocktree.ReadCoinsFormat(nFormat));
+    EXPECT_EQ(nFormat, COINS_DB_FORMAT);
+}
+
+TEST(TestCoins, coins_db_upgrade)
+{
+    // Write a whole-transaction record the way older versions did
+    CCoinsViewDB db(1 << 20, true);
+    uint256 txid = GetRandHash();
+    CCoins coinsOld;
+    coinsOld.nVersion = 1;
+    coinsOld.nHeight = 42;
+    coinsOld.fCoinBase = true;
+    coinsOld.vout.resize(3);
+    coinsOld.vout[0] = CTxOut(5, CScript() << OP_TRUE);
+    coinsOld.vout[2] = CTxOut(7, CScript() << OP_FALSE);
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::make_pair('c', txid);
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << coinsOld;
+    CCoinsDBRecordMap records;
+    records[std::string(ssKey.begin(), ssKey.end())] = std::string(ssValue.begin(), ssValue.end());
+    EXPECT_TRUE(db.WriteRawRecords(records, true));
+    EXPECT_FALSE(db.HaveCoins(txid));
+
+    EXPECT_TRUE(db.Upgrade());
+    CCoins coins;
+    EXPECT_TRUE(db.GetCoins(txid, coins));
+    EXPECT_EQ(coins, coinsOld);
+
+    // Only the per-output records and the header are left
+    std::unique_ptr<CDBIterator> pcursor(db.RawCursor());
+    size_t nRecords = 0;
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next())
+        nRecords++;
+    EXPECT_EQ(nRecords, 3);
+}
+
+
+TEST(TestCoins, coins_add_fetched)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    uint256 txid = GetRandHash();
+
+    CCoins coins;
+    coins.nHeight = 3;
+    coins.vout.push_back(CTxOut(10, CScript() << OP_TRUE));
+    EXPECT_FALSE(cache.HaveCoinsInCache(txid));
+    cache.AddFetchedCoins(txid, coins);
+    EXPECT_TRUE(coins.IsPruned());
+    EXPECT_TRUE(cache.HaveCoinsInCache(txid));
+    cache.SelfTest();
+
+    // An existing entry is kept
+    CCoins other;
+    other.vout.push_back(CTxOut(20, CScript() << OP_TRUE));
+    cache.AddFetchedCoins(txid, other);
+    const CCoins *pcoins = cache.AccessCoins(txid);
+    ASSERT_TRUE(pcoins != NULL);
+    EXPECT_EQ(pcoins->nHeight, 3);
+    EXPECT_EQ(pcoins->vout[0].nValue, 10);
+
+    // Fetched entries are not dirty, flushing does not write them
+    EXPECT_TRUE(cache.Flush());
+    CCoins fromBase;
+    EXPECT_FALSE(base.GetCoins(txid, fromBase));
+}
+
 } // namespace TestCoins
@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include "crypto/blake2b_multi.h"
 #include "crypto/equihash.h"
 #include "uint256.h"
 
@@ -80,6 +81,34 @@ TEST(equihash_tests, is_probably_duplicate) {
     ASSERT_TRUE(IsProbablyDuplicate<4>(p3, 4));
 }
 
+TEST(equihash_tests, multi_lane_hashes_match_libsodium) {
+    Blake2bMultiAutoDetect();
+    Equihash<200,9> Eh200_9;
+    crypto_generichash_blake2b_state state;
+    Eh200_9.InitialiseState(state);
+    // Same length as the serialized I||V of a block header.
+    std::vector<unsigned char> header(140);
+    for (size_t i = 0; i < header.size(); i++)
+        header[i] = (unsigned char)(i * 31);
+    crypto_generichash_blake2b_update(&state, header.data(), header.size());
+
+    const size_t hLen = 50;
+    std::vector<eh_index> indices = {0, 1, 2, 3, 4, 1048575, 7, 0xfffffffe, 42};
+    for (size_t count = 1; count <= indices.size(); count++) {
+        SCOPED_TRACE(count);
+        std::vector<unsigned char> batch(count * hLen);
+        GenerateIndexHashes(state, indices.data(), count, batch.data(), hLen);
+        for (size_t i = 0; i < count; i++) {
+            crypto_generichash_blake2b_state single = state;
+            eh_index lei = htole32(indices[i]);
+            unsigned char expected[50];
+            crypto_generichash_blake2b_update(&single, (const unsigned char*) &lei, sizeof(eh_index));
+            crypto_generichash_blake2b_final(&single, expected, hLen);
+            EXPECT_EQ(0, memcmp(expected, batch.data() + i * hLen, hLen));
+        }
+    }
+}
+
 #ifdef ENABLE_MINING
 TEST(equihash_tests, check_basic_solver_cancelled) {
     Equihash<48,5> Eh48_5;
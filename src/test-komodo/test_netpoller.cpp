@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include "netpoller.h"
+#include "utiltime.h"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/resource.h>
+
+namespace TestNetPoller {
+
+    static std::vector<std::string> AvailableBackends()
+    {
+        std::vector<std::string> vNames;
+        const char *names[] = { "epoll", "poll", "select" };
+        for (const char *name : names) {
+            std::unique_ptr<CSocketPoller> poller(CSocketPoller::Create(name));
+            if (poller)
+                vNames.push_back(name);
+        }
+        return vNames;
+    }
+
+    static SOCKET ListenLoopback(struct sockaddr_in &addr)
+    {
+        SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (hListen == INVALID_SOCKET ||
+            bind(hListen, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+            listen(hListen, SOMAXCONN) != 0 ||
+            getsockname(hListen, (struct sockaddr*)&addr, &len) != 0) {
+            if (hListen != INVALID_SOCKET)
+                close(hListen);
+            return INVALID_SOCKET;
+        }
+        return hListen;
+    }
+
+    TEST(TestNetPoller, backends) {
+        std::unique_ptr<CSocketPoller> poller(CSocketPoller::Create(""));
+        ASSERT_TRUE(poller != nullptr);
+        EXPECT_EQ(poller->GetName(), CSocketPoller::GetDefaultName());
+        EXPECT_TRUE(CSocketPoller::Create("kqueue") == NULL);
+
+        std::unique_ptr<CSocketPoller> selectPoller(CSocketPoller::Create("select"));
+        ASSERT_TRUE(selectPoller != nullptr);
+        EXPECT_TRUE(selectPoller->LimitedToSelectable());
+        EXPECT_FALSE(selectPoller->Set(FD_SETSIZE, CSocketPoller::RECV, 0));
+    }
+
+    TEST(TestNetPoller, events) {
+        for (const std::string &strName : AvailableBackends()) {
+            SCOPED_TRACE(strName);
+            std::unique_ptr<CSocketPoller> poller(CSocketPoller::Create(strName));
+            int fds[2];
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+            // nothing to read yet
+            poller->Begin();
+            ASSERT_TRUE(poller->Set(fds[0], CSocketPoller::RECV, 1));
+            EXPECT_EQ(poller->Wait(0), 0);
+            EXPECT_EQ(poller->GetEvents(fds[0]), 0);
+
+            ASSERT_EQ(send(fds[1], "x", 1, 0), 1);
+            poller->Begin();
+            ASSERT_TRUE(poller->Set(fds[0], CSocketPoller::RECV, 1));
+            EXPECT_EQ(poller->Wait(1000), 1);
+            EXPECT_EQ(poller->GetEvents(fds[0]), CSocketPoller::RECV);
+
+            // only waiting for sending now
+            poller->Begin();
+            ASSERT_TRUE(poller->Set(fds[0], CSocketPoller::SEND, 1));
+            EXPECT_EQ(poller->Wait(1000), 1);
+            EXPECT_EQ(poller->GetEvents(fds[0]), CSocketPoller::SEND);
+
+            // the socket number is reused by another owner
+            close(fds[0]);
+            int fdsNew[2];
+            ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fdsNew), 0);
+            ASSERT_EQ(send(fdsNew[1], "y", 1, 0), 1);
+            poller->Begin();
+            ASSERT_TRUE(poller->Set(fdsNew[0], CSocketPoller::RECV, 2));
+            EXPECT_EQ(poller->Wait(1000), 1);
+            EXPECT_TRUE(poller->GetEvents(fdsNew[0]) & CSocketPoller::RECV);
+
+            // the peer went away
+            close(fdsNew[1]);
+            poller->Begin();
+            ASSERT_TRUE(poller->Set(fdsNew[0], CSocketPoller::RECV, 2));
+            EXPECT_EQ(poller->Wait(1000), 1);
+            EXPECT_TRUE(poller->GetEvents(fdsNew[0]) & CSocketPoller::RECV);
+
+            // sockets not declared again are forgotten
+            poller->Begin();
+            EXPECT_EQ(poller->Wait(0), 0);
+            EXPECT_EQ(poller->Size(), 0);
+
+            close(fds[1]);
+            close(fdsNew[0]);
+        }
+    }
+
+    // Thousands of loopback connections, as on a seed or nSPV server node
+    TEST(TestNetPoller, loopback_load) {
+        struct rlimit limit;
+        ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &limit), 0);
+        if (limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+            getrlimit(RLIMIT_NOFILE, &limit);
+        }
+        const size_t nConnections = std::min((size_t)4000, ((size_t)limit.rlim_cur - 64) / 2);
+        if (nConnections < 1000) {
+            std::cerr << "[          ] skipped, only " << limit.rlim_cur << " file descriptors" << std::endl;
+            return;
+        }
+
+        struct sockaddr_in addr;
+        SOCKET hListen = ListenLoopback(addr);
+        ASSERT_NE(hListen, INVALID_SOCKET);
+        std::vector<SOCKET> vClients, vServers;
+        for (size_t i = 0; i < nConnections; i++) {
+            SOCKET hClient = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            ASSERT_NE(hClient, INVALID_SOCKET);
+            ASSERT_EQ(connect(hClient, (struct sockaddr*)&addr, sizeof(addr)), 0);
+            vClients.push_back(hClient);
+            SOCKET hServer = accept(hListen, NULL, NULL);
+            ASSERT_NE(hServer, INVALID_SOCKET);
+            vServers.push_back(hServer);
+        }
+
+        for (const std::string &strName : AvailableBackends()) {
+            SCOPED_TRACE(strName);
+            std::unique_ptr<CSocketPoller> poller(CSocketPoller::Create(strName));
+            if (poller->LimitedToSelectable()) {
+                // the sockets past FD_SETSIZE are refused
+                poller->Begin();
+                EXPECT_FALSE(poller->Set(vServers.back(), CSocketPoller::RECV, 0));
+                continue;
+            }
+
+            // every 10th client sends something
+            std::set<SOCKET> setExpected;
+            for (size_t i = 0; i < nConnections; i += 10) {
+                ASSERT_EQ(send(vClients[i], "x", 1, 0), 1);
+                setExpected.insert(vServers[i]);
+            }
+
+            const int nRounds = 50;
+            int64_t nStart = GetTimeMicros();
+            for (int nRound = 0; nRound < nRounds; nRound++) {
+                poller->Begin();
+                for (size_t i = 0; i < nConnections; i++)
+                    ASSERT_TRUE(poller->Set(vServers[i], CSocketPoller::RECV, i));
+                int nReady = poller->Wait(1000);
+                ASSERT_EQ(nReady, (int)setExpected.size());
+                for (size_t i = 0; i < nConnections; i++)
+                    EXPECT_EQ(poller->GetEvents(vServers[i]) != 0, setExpected.count(vServers[i]) != 0);
+            }
+            std::cerr << "[          ] " << strName << ": " << nConnections << " connections, "
+                      << (GetTimeMicros() - nStart) / nRounds << "us per round" << std::endl;
+
+            // drain the sockets for the next backend
+            char ch;
+            for (SOCKET hServer : setExpected)
+                ASSERT_EQ(recv(hServer, &ch, 1, 0), 1);
+        }
+
+        for (size_t i = 0; i < nConnections; i++) {
+            close(vClients[i]);
+            close(vServers[i]);
+        }
+        close(hListen);
+    }
+}
+
+#endif // WIN32
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "nspvcache.h"
+
+#include <vector>
+
+namespace TestNSPVCache {
+
+    // a chain of nLength blocks, forked from base at nForkHeight if given
+    class FakeChain
+    {
+    public:
+        std::vector<uint256> vHashes;
+        std::vector<CBlockIndex> vIndex;
+
+        FakeChain(int nLength, uint8_t nSeed, const FakeChain *base = NULL, int nForkHeight = 0) : vHashes(nLength), vIndex(nLength)
+        {
+            for (int i = 0; i < nLength; i++) {
+                if (base != NULL && i < nForkHeight) {
+                    vHashes[i] = base->vHashes[i];
+                } else {
+                    vHashes[i].begin()[0] = nSeed;
+                    vHashes[i].begin()[1] = (uint8_t)i;
+                    vHashes[i].begin()[2] = (uint8_t)(i >> 8);
+                }
+                vIndex[i].nHeight = i;
+                vIndex[i].phashBlock = &vHashes[i];
+                vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : NULL;
+            }
+        }
+
+        const CBlockIndex *Tip() const { return &vIndex.back(); }
+        const CBlockIndex *At(int nHeight) const { return &vIndex[nHeight]; }
+    };
+
+    static std::vector<uint8_t> Bytes(uint8_t a, uint8_t b)
+    {
+        std::vector<uint8_t> v;
+        v.push_back(a);
+        v.push_back(b);
+        return v;
+    }
+
+    TEST(TestNSPVCache, tip_and_anchored) {
+        CNSPVResponseCache cache(1024 * 1024, 3600);
+        FakeChain chain(100, 1);
+        std::vector<uint8_t> response;
+
+        cache.Put(Bytes(1, 0), Bytes(2, 0), chain.At(98), -1, 1000);
+        cache.Put(Bytes(5, 0), Bytes(6, 0), chain.At(98), 50, 1000);
+        EXPECT_EQ(cache.Size(), 2);
+        EXPECT_FALSE(cache.Get(Bytes(1, 1), chain.At(98), 1000, response));
+        ASSERT_TRUE(cache.Get(Bytes(1, 0), chain.At(98), 1000, response));
+        EXPECT_EQ(response, Bytes(2, 0));
+
+        // a new tip: only the anchored response is still served
+        EXPECT_FALSE(cache.Get(Bytes(1, 0), chain.At(99), 1001, response));
+        ASSERT_TRUE(cache.Get(Bytes(5, 0), chain.At(99), 1001, response));
+        EXPECT_EQ(response, Bytes(6, 0));
+
+        // until it expires
+        EXPECT_FALSE(cache.Get(Bytes(5, 0), chain.At(99), 1000 + 3600, response));
+        EXPECT_EQ(cache.Size(), 0);
+        EXPECT_EQ(cache.GetHits(), 2);
+        EXPECT_EQ(cache.GetMisses(), 3);
+    }
+
+    TEST(TestNSPVCache, reorg) {
+        CNSPVResponseCache cache(1024 * 1024, 3600);
+        FakeChain chain(100, 1);
+        FakeChain fork(101, 2, &chain, 60);
+        std::vector<uint8_t> response;
+
+        cache.Put(Bytes(1, 0), Bytes(2, 0), chain.Tip(), 50, 1000);
+        cache.Put(Bytes(1, 1), Bytes(2, 1), chain.Tip(), 70, 1000);
+        EXPECT_TRUE(cache.Get(Bytes(1, 0), fork.Tip(), 1000, response));
+        EXPECT_FALSE(cache.Get(Bytes(1, 1), fork.Tip(), 1000, response));
+
+        // the responses for the old tip are dropped once a response for the new one is kept
+        cache.Put(Bytes(3, 0), Bytes(4, 0), chain.Tip(), -1, 1000);
+        cache.Put(Bytes(3, 1), Bytes(4, 1), fork.Tip(), -1, 1000);
+        EXPECT_EQ(cache.Size(), 2);
+        EXPECT_FALSE(cache.Get(Bytes(3, 0), chain.Tip(), 1000, response));
+        EXPECT_TRUE(cache.Get(Bytes(3, 1), fork.Tip(), 1000, response));
+    }
+
+    TEST(TestNSPVCache, eviction) {
+        FakeChain chain(10, 1);
+        std::vector<uint8_t> response;
+        CNSPVResponseCache probe(1024 * 1024, 3600);
+        probe.Put(Bytes(0, 0), std::vector<uint8_t>(100), chain.Tip(), -1, 1000);
+        const size_t nEntryBytes = probe.Bytes();
+
+        CNSPVResponseCache cache(nEntryBytes * 4, 3600);
+        for (uint8_t i = 0; i < 4; i++)
+            cache.Put(Bytes(0, i), std::vector<uint8_t>(100, i), chain.Tip(), -1, 1000);
+        EXPECT_EQ(cache.Size(), 4);
+        EXPECT_TRUE(cache.Get(Bytes(0, 0), chain.Tip(), 1000, response));
+
+        // the least recently used response goes first
+        cache.Put(Bytes(0, 4), std::vector<uint8_t>(100, 4), chain.Tip(), -1, 1000);
+        EXPECT_EQ(cache.Size(), 4);
+        EXPECT_TRUE(cache.Get(Bytes(0, 0), chain.Tip(), 1000, response));
+        EXPECT_FALSE(cache.Get(Bytes(0, 1), chain.Tip(), 1000, response));
+        EXPECT_LE(cache.Bytes(), nEntryBytes * 4);
+
+        // too large to be worth keeping
+        cache.Put(Bytes(0, 5), std::vector<uint8_t>(nEntryBytes * 2), chain.Tip(), -1, 1000);
+        EXPECT_FALSE(cache.Get(Bytes(0, 5), chain.Tip(), 1000, response));
+    }
+}
@@ -0,0 +1,368 @@
+#include <gtest/gtest.h>
+
+#include "core_io.h"
+#include "key.h"
+#include "main.h"
+#include "merkleblock.h"
+#include "script/cc.h"
+#include "util.h"
+#include "utilstrencodings.h"
+
+#include "komodo_nSPV_defs.h"
+#include "komodo_notary.h"
+
+#include <boost/filesystem.hpp>
+
+#include <set>
+#include <vector>
+
+extern std::map<std::string, std::string> mapArgs;
+
+// the nSPV superlite functions and caches are compiled into main.cpp
+extern struct NSPV_ntzsresp NSPV_ntzsresp_cache[NSPV_MAXVINS];
+extern struct NSPV_ntzsproofresp NSPV_ntzsproofresp_cache[NSPV_MAXVINS * 2];
+extern struct NSPV_txproof NSPV_txproof_cache[NSPV_MAXVINS * 4];
+extern uint32_t NSPV_logintime;
+extern CKey NSPV_key;
+uint256 NSPV_hdrhash(struct NSPV_equihdr *hdr);
+bool NSPV_SignTx(CMutableTransaction &mtx,int32_t vini,int64_t utxovalue,const CScript scriptPubKey,uint32_t nTime);
+void NSPV_ntzsresp_purge(struct NSPV_ntzsresp *ptr);
+void NSPV_ntzsproofresp_purge(struct NSPV_ntzsproofresp *ptr);
+void NSPV_txproof_purge(struct NSPV_txproof *ptr);
+int32_t NSPV_ntzsproof_verify(struct NSPV_ntzsproofresp *ptr);
+struct NSPV_ntzsresp *NSPV_ntzsresp_find(int32_t reqheight);
+struct NSPV_ntzsresp *NSPV_ntzsresp_add(struct NSPV_ntzsresp *ptr);
+struct NSPV_ntzsproofresp *NSPV_ntzsproof_find(uint256 prevtxid,uint256 nexttxid);
+struct NSPV_ntzsproofresp *NSPV_ntzsproof_add(struct NSPV_ntzsproofresp *ptr);
+struct NSPV_txproof *NSPV_txproof_find(uint256 txid);
+struct NSPV_txproof *NSPV_txproof_add(struct NSPV_txproof *ptr);
+void NSPV_cache_save();
+void NSPV_cache_load();
+
+namespace TestNSPVCacheFile {
+
+    class NSPVCacheFile : public ::testing::Test
+    {
+    protected:
+        boost::filesystem::path pathTemp;
+        std::vector<CKey> vNotaries;
+        CKey oldKey;
+        uint32_t oldLoginTime;
+
+        virtual void SetUp()
+        {
+            chainName = assetchain();
+            pathTemp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+            boost::filesystem::create_directories(pathTemp);
+            mapArgs["-datadir"] = pathTemp.string();
+            ClearDatadirCache();
+
+            // 13 notaries elected from genesis, their signatures are checked against these
+            uint8_t pubkeys[64][33];
+            for (int i = 0; i < 13; i++) {
+                CKey key;
+                key.MakeNewKey(true);
+                vNotaries.push_back(key);
+                CPubKey pk = key.GetPubKey();
+                memcpy(pubkeys[i], pk.begin(), 33);
+            }
+            komodo_notaries_uninit();
+            komodo_notarysinit(0, pubkeys, 13);
+
+            // NSPV_SignTx gives the signature hash the notary signatures are checked with
+            oldKey = NSPV_key;
+            oldLoginTime = NSPV_logintime;
+            NSPV_key = vNotaries[0];
+            NSPV_logintime = (uint32_t)time(NULL);
+            ClearCaches();
+        }
+
+        virtual void TearDown()
+        {
+            ClearCaches();
+            NSPV_key = oldKey;
+            NSPV_logintime = oldLoginTime;
+            komodo_notaries_uninit();
+            mapArgs.erase("-datadir");
+            ClearDatadirCache();
+            boost::filesystem::remove_all(pathTemp);
+        }
+
+        void ClearCaches()
+        {
+            for (int i = 0; i < sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
+                NSPV_ntzsresp_purge(&NSPV_ntzsresp_cache[i]);
+            for (int i = 0; i < sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
+                NSPV_ntzsproofresp_purge(&NSPV_ntzsproofresp_cache[i]);
+            for (int i = 0; i < sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
+                NSPV_txproof_purge(&NSPV_txproof_cache[i]);
+        }
+
+        int CountProofs()
+        {
+            int n = 0;
+            for (int i = 0; i < sizeof(NSPV_ntzsproofresp_cache)/sizeof(*NSPV_ntzsproofresp_cache); i++)
+                n += NSPV_ntzsproofresp_cache[i].common.hdrs != 0;
+            return n;
+        }
+
+        int CountNtzs()
+        {
+            int n = 0;
+            for (int i = 0; i < sizeof(NSPV_ntzsresp_cache)/sizeof(*NSPV_ntzsresp_cache); i++)
+                n += NSPV_ntzsresp_cache[i].reqheight != 0;
+            return n;
+        }
+
+        int CountTxProofs()
+        {
+            int n = 0;
+            for (int i = 0; i < sizeof(NSPV_txproof_cache)/sizeof(*NSPV_txproof_cache); i++)
+                n += NSPV_txproof_cache[i].txlen != 0;
+            return n;
+        }
+
+        static std::vector<uint8_t> Serialize(const CTransaction &tx)
+        {
+            return ParseHex(EncodeHexTx(tx));
+        }
+
+        // a notarization of blockhash at height, signed by the first numsigs notaries
+        CTransaction MakeNotarization(int32_t height, uint256 blockhash, uint32_t nTime, int numsigs)
+        {
+            CMutableTransaction mtx;
+            for (int i = 0; i < numsigs; i++)
+                mtx.vin.push_back(CTxIn(COutPoint(blockhash, i), CScript()));
+            CPubKey pk = vNotaries[0].GetPubKey();
+            mtx.vout.push_back(CTxOut(10000, CScript() << ParseHex(HexStr(pk)) << OP_CHECKSIG));
+            std::vector<uint8_t> opret(blockhash.begin(), blockhash.end());
+            for (int i = 0; i < 4; i++)
+                opret.push_back((uint8_t)(height >> (i * 8)));
+            opret.resize(opret.size() + 32);
+            mtx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << opret));
+            for (int i = 0; i < numsigs; i++) {
+                CPubKey notary = vNotaries[i].GetPubKey();
+                CScript scriptPubKey = CScript() << ParseHex(HexStr(notary)) << OP_CHECKSIG;
+                NSPV_SignTx(mtx, i, 10000, scriptPubKey, nTime);
+                std::vector<unsigned char> sig;
+                EXPECT_TRUE(vNotaries[i].Sign(SIG_TXHASH, sig));
+                sig.push_back((unsigned char)SIGHASH_ALL);
+                mtx.vin[i].scriptSig = CScript() << sig;
+            }
+            return CTransaction(mtx);
+        }
+
+        // the headers prevht..prevht+4 notarized on both ends, the block at prevht+2 holding tx
+        void MakeProof(struct NSPV_ntzsproofresp *ptr, int32_t prevht, const CBlock &block, int numsigs)
+        {
+            const int numhdrs = 5;
+            memset(ptr, 0, sizeof(*ptr));
+            ptr->common.hdrs = (struct NSPV_equihdr *)calloc(numhdrs, sizeof(*ptr->common.hdrs));
+            ptr->common.numhdrs = numhdrs;
+            ptr->common.prevht = prevht;
+            ptr->common.nextht = prevht + numhdrs - 1;
+            for (int i = 0; i < numhdrs; i++) {
+                struct NSPV_equihdr *hdr = &ptr->common.hdrs[i];
+                hdr->nVersion = 4;
+                hdr->nTime = 1600000000 + prevht + i;
+                hdr->nBits = 0x200f0f0f;
+                if (i > 0)
+                    hdr->hashPrevBlock = NSPV_hdrhash(&ptr->common.hdrs[i - 1]);
+                if (i == 2)
+                    hdr->hashMerkleRoot = block.BuildMerkleTree();
+            }
+            CTransaction prevntz = MakeNotarization(prevht, NSPV_hdrhash(&ptr->common.hdrs[0]), ptr->common.hdrs[0].nTime, numsigs);
+            CTransaction nextntz = MakeNotarization(ptr->common.nextht, NSPV_hdrhash(&ptr->common.hdrs[numhdrs - 1]), ptr->common.hdrs[numhdrs - 1].nTime, numsigs);
+            std::vector<uint8_t> prevraw = Serialize(prevntz), nextraw = Serialize(nextntz);
+            ptr->prevtxid = prevntz.GetHash();
+            ptr->nexttxid = nextntz.GetHash();
+            ptr->prevtxidht = ptr->common.prevht + 1;
+            ptr->nexttxidht = ptr->common.nextht + 1;
+            ptr->prevtxlen = (int32_t)prevraw.size();
+            ptr->nexttxlen = (int32_t)nextraw.size();
+            ptr->prevntz = (uint8_t *)malloc(ptr->prevtxlen);
+            ptr->nextntz = (uint8_t *)malloc(ptr->nexttxlen);
+            memcpy(ptr->prevntz, &prevraw[0], ptr->prevtxlen);
+            memcpy(ptr->nextntz, &nextraw[0], ptr->nexttxlen);
+        }
+
+        void MakeNtzs(struct NSPV_ntzsresp *ptr, const struct NSPV_ntzsproofresp *proof, int32_t reqheight)
+        {
+            memset(ptr, 0, sizeof(*ptr));
+            ptr->prevntz.txid = proof->prevtxid;
+            ptr->prevntz.height = proof->common.prevht;
+            ptr->prevntz.txidheight = proof->prevtxidht;
+            ptr->nextntz.txid = proof->nexttxid;
+            ptr->nextntz.height = proof->common.nextht;
+            ptr->nextntz.txidheight = proof->nexttxidht;
+            ptr->reqheight = reqheight;
+        }
+
+        void MakeTxProof(struct NSPV_txproof *ptr, const CBlock &block, int32_t height)
+        {
+            const CTransaction &tx = block.vtx[1];
+            std::set<uint256> setTxids;
+            setTxids.insert(tx.GetHash());
+            CMerkleBlock mb(block, setTxids);
+            CDataStream ssMB(SER_NETWORK, PROTOCOL_VERSION);
+            ssMB << mb;
+            std::vector<uint8_t> raw = Serialize(tx), proof(ssMB.begin(), ssMB.end());
+            memset(ptr, 0, sizeof(*ptr));
+            ptr->txid = tx.GetHash();
+            ptr->height = height;
+            ptr->txlen = (int32_t)raw.size();
+            ptr->txprooflen = (int32_t)proof.size();
+            ptr->tx = (uint8_t *)malloc(ptr->txlen);
+            ptr->txproof = (uint8_t *)malloc(ptr->txprooflen);
+            memcpy(ptr->tx, &raw[0], ptr->txlen);
+            memcpy(ptr->txproof, &proof[0], ptr->txprooflen);
+            ptr->hashblock = block.GetHash();
+        }
+
+        static CBlock MakeBlock(uint8_t seed)
+        {
+            CBlock block;
+            for (int i = 0; i < 2; i++) {
+                CMutableTransaction mtx;
+                mtx.vin.push_back(CTxIn(COutPoint(uint256(), i), CScript() << seed));
+                mtx.vout.push_back(CTxOut(1000 * (i + 1), CScript() << OP_TRUE));
+                block.vtx.push_back(CTransaction(mtx));
+            }
+            return block;
+        }
+
+        std::vector<uint8_t> ReadCacheFile()
+        {
+            boost::filesystem::path path = GetDataDir() / "nspvcache.dat";
+            std::vector<uint8_t> data(boost::filesystem::file_size(path));
+            FILE *fp = fopen(path.string().c_str(), "rb");
+            EXPECT_EQ(fread(&data[0], 1, data.size(), fp), data.size());
+            fclose(fp);
+            return data;
+        }
+
+        void WriteCacheFile(const std::vector<uint8_t> &data)
+        {
+            boost::filesystem::path path = GetDataDir() / "nspvcache.dat";
+            FILE *fp = fopen(path.string().c_str(), "wb");
+            EXPECT_EQ(fwrite(&data[0], 1, data.size(), fp), data.size());
+            fclose(fp);
+        }
+    };
+
+    TEST_F(NSPVCacheFile, save_and_load) {
+        CBlock block = MakeBlock(1);
+        struct NSPV_ntzsproofresp P; struct NSPV_ntzsresp N; struct NSPV_txproof T;
+        MakeProof(&P, 10, block, 13);
+        MakeNtzs(&N, &P, 12);
+        MakeTxProof(&T, block, 12);
+        ASSERT_EQ(NSPV_ntzsproof_verify(&P), 0);
+        NSPV_ntzsproof_add(&P);
+        NSPV_ntzsresp_add(&N);
+        NSPV_txproof_add(&T);
+
+        NSPV_cache_save();
+        ClearCaches();
+        EXPECT_TRUE(NSPV_ntzsproof_find(P.prevtxid, P.nexttxid) == 0);
+        NSPV_cache_load();
+
+        struct NSPV_ntzsproofresp *proof = NSPV_ntzsproof_find(P.prevtxid, P.nexttxid);
+        ASSERT_TRUE(proof != 0);
+        EXPECT_EQ(proof->common.numhdrs, P.common.numhdrs);
+        EXPECT_EQ(memcmp(proof->common.hdrs, P.common.hdrs, P.common.numhdrs * sizeof(*P.common.hdrs)), 0);
+        ASSERT_EQ(proof->prevtxlen, P.prevtxlen);
+        EXPECT_EQ(memcmp(proof->prevntz, P.prevntz, P.prevtxlen), 0);
+        struct NSPV_ntzsresp *ntzs = NSPV_ntzsresp_find(12);
+        ASSERT_TRUE(ntzs != 0);
+        EXPECT_EQ(ntzs->prevntz.txid, P.prevtxid);
+        EXPECT_EQ(ntzs->nextntz.height, 14);
+        struct NSPV_txproof *txproof = NSPV_txproof_find(T.txid);
+        ASSERT_TRUE(txproof != 0);
+        ASSERT_EQ(txproof->txprooflen, T.txprooflen);
+        EXPECT_EQ(memcmp(txproof->txproof, T.txproof, T.txprooflen), 0);
+        EXPECT_EQ(txproof->hashblock, T.hashblock);
+
+        NSPV_ntzsproofresp_purge(&P);
+        NSPV_txproof_purge(&T);
+    }
+
+    TEST_F(NSPVCacheFile, corrupt_file) {
+        CBlock block = MakeBlock(1);
+        struct NSPV_ntzsproofresp P; struct NSPV_ntzsresp N; struct NSPV_txproof T;
+        MakeProof(&P, 10, block, 13);
+        MakeNtzs(&N, &P, 12);
+        MakeTxProof(&T, block, 12);
+        NSPV_ntzsproof_add(&P);
+        NSPV_ntzsresp_add(&N);
+        NSPV_txproof_add(&T);
+        NSPV_cache_save();
+        std::vector<uint8_t> data = ReadCacheFile();
+
+        // truncated
+        WriteCacheFile(std::vector<uint8_t>(data.begin(), data.end() - 100));
+        ClearCaches();
+        NSPV_cache_load();
+        EXPECT_EQ(CountProofs(), 0);
+        EXPECT_EQ(CountNtzs(), 0);
+        EXPECT_EQ(CountTxProofs(), 0);
+
+        // a byte flipped
+        std::vector<uint8_t> tampered(data);
+        tampered[data.size() / 2] ^= 1;
+        WriteCacheFile(tampered);
+        NSPV_cache_load();
+        EXPECT_EQ(CountProofs(), 0);
+        EXPECT_EQ(CountNtzs(), 0);
+        EXPECT_EQ(CountTxProofs(), 0);
+
+        // the file as saved still loads
+        WriteCacheFile(data);
+        NSPV_cache_load();
+        EXPECT_EQ(CountProofs(), 1);
+        EXPECT_EQ(CountNtzs(), 1);
+        EXPECT_EQ(CountTxProofs(), 1);
+
+        NSPV_ntzsproofresp_purge(&P);
+        NSPV_txproof_purge(&T);
+    }
+
+    TEST_F(NSPVCacheFile, unverified_entries) {
+        // entries with a valid checksum that fail verification are dropped, and what was checked against them too
+        CBlock block = MakeBlock(1), otherblock = MakeBlock(2);
+        struct NSPV_ntzsproofresp good, fewsigs, broken; struct NSPV_ntzsresp N, fewsigsN; struct NSPV_txproof T, otherT;
+        MakeProof(&good, 10, block, 13);
+        MakeProof(&fewsigs, 20, otherblock, 11);
+        MakeProof(&broken, 30, otherblock, 13);
+        broken.common.hdrs[2].nNonce.begin()[0] ^= 1;
+        EXPECT_EQ(NSPV_ntzsproof_verify(&good), 0);
+        EXPECT_EQ(NSPV_ntzsproof_verify(&fewsigs), -3);
+        EXPECT_EQ(NSPV_ntzsproof_verify(&broken), -2);
+        MakeNtzs(&N, &good, 12);
+        MakeNtzs(&fewsigsN, &fewsigs, 22);
+        MakeTxProof(&T, block, 12);
+        MakeTxProof(&otherT, otherblock, 22);
+        NSPV_ntzsproof_add(&good);
+        NSPV_ntzsproof_add(&fewsigs);
+        NSPV_ntzsproof_add(&broken);
+        NSPV_ntzsresp_add(&N);
+        NSPV_ntzsresp_add(&fewsigsN);
+        NSPV_txproof_add(&T);
+        NSPV_txproof_add(&otherT);
+
+        NSPV_cache_save();
+        ClearCaches();
+        NSPV_cache_load();
+        EXPECT_EQ(CountProofs(), 1);
+        EXPECT_TRUE(NSPV_ntzsproof_find(good.prevtxid, good.nexttxid) != 0);
+        EXPECT_EQ(CountNtzs(), 1);
+        EXPECT_TRUE(NSPV_ntzsresp_find(12) != 0);
+        EXPECT_EQ(CountTxProofs(), 1);
+        EXPECT_TRUE(NSPV_txproof_find(T.txid) != 0);
+
+        NSPV_ntzsproofresp_purge(&good);
+        NSPV_ntzsproofresp_purge(&fewsigs);
+        NSPV_ntzsproofresp_purge(&broken);
+        NSPV_txproof_purge(&T);
+        NSPV_txproof_purge(&otherT);
+    }
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "nspvqueue.h"
+#include "utiltime.h"
+
+#include <boost/thread.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace TestNSPVQueue {
+
+    class RecordingHandler
+    {
+    public:
+        boost::mutex mutex;
+        std::vector<std::pair<NodeId, uint8_t> > vCalls;
+
+        void operator()(CNode *pnode, const std::vector<uint8_t> &request)
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            vCalls.push_back(std::make_pair(pnode->GetId(), request[0]));
+        }
+
+        size_t Count()
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            return vCalls.size();
+        }
+    };
+
+    static bool WaitForCalls(RecordingHandler &recorder, size_t nCalls)
+    {
+        for (int i = 0; i < 500 && recorder.Count() < nCalls; i++)
+            MilliSleep(10);
+        return recorder.Count() == nCalls;
+    }
+
+    TEST(TestNSPVQueue, order_and_backpressure) {
+        RecordingHandler recorder;
+        CNSPVRequestQueue queue(std::ref(recorder), 3, 100);
+        CNode node1(INVALID_SOCKET, CAddress(), "", true);
+        CNode node2(INVALID_SOCKET, CAddress(), "", true);
+
+        // node1 sends two expensive requests and a cheap one, node2 an expensive and a cheap one
+        queue.Push(&node1, std::vector<uint8_t>(1, 1), false);
+        queue.Push(&node1, std::vector<uint8_t>(1, 2), false);
+        EXPECT_FALSE(queue.IsBusy(node1.GetId()));
+        queue.Push(&node1, std::vector<uint8_t>(1, 3), true);
+        queue.Push(&node2, std::vector<uint8_t>(1, 4), false);
+        queue.Push(&node2, std::vector<uint8_t>(1, 5), true);
+        EXPECT_EQ(queue.Size(), 5);
+
+        // node1 has reached its limit, node2 has not
+        EXPECT_TRUE(queue.IsBusy(node1.GetId()));
+        EXPECT_FALSE(queue.IsBusy(node2.GetId()));
+        EXPECT_EQ(node1.GetRefCount(), 3);
+
+        boost::thread worker(&CNSPVRequestQueue::Thread, &queue);
+        ASSERT_TRUE(WaitForCalls(recorder, 5));
+        worker.interrupt();
+        worker.join();
+
+        // the cheap requests first, then the peers take turns, each in order
+        std::vector<std::pair<NodeId, uint8_t> > vExpected;
+        vExpected.push_back(std::make_pair(node1.GetId(), 3));
+        vExpected.push_back(std::make_pair(node2.GetId(), 5));
+        vExpected.push_back(std::make_pair(node1.GetId(), 1));
+        vExpected.push_back(std::make_pair(node2.GetId(), 4));
+        vExpected.push_back(std::make_pair(node1.GetId(), 2));
+        EXPECT_EQ(recorder.vCalls, vExpected);
+
+        EXPECT_EQ(queue.Size(), 0);
+        EXPECT_FALSE(queue.IsBusy(node1.GetId()));
+        EXPECT_EQ(node1.GetRefCount(), 0);
+        EXPECT_EQ(node2.GetRefCount(), 0);
+    }
+
+    TEST(TestNSPVQueue, full_queue) {
+        RecordingHandler recorder;
+        CNSPVRequestQueue queue(std::ref(recorder), 8, 4);
+        CNode node1(INVALID_SOCKET, CAddress(), "", true);
+        CNode node2(INVALID_SOCKET, CAddress(), "", true);
+        CNode node3(INVALID_SOCKET, CAddress(), "", true);
+
+        for (int i = 0; i < 3; i++)
+            queue.Push(&node1, std::vector<uint8_t>(1, i), false);
+        queue.Push(&node2, std::vector<uint8_t>(1, 3), false);
+
+        // the queue is full: the peers with queued requests are paused, the others are still read
+        EXPECT_TRUE(queue.IsBusy(node1.GetId()));
+        EXPECT_TRUE(queue.IsBusy(node2.GetId()));
+        EXPECT_FALSE(queue.IsBusy(node3.GetId()));
+
+        // requests of disconnected peers are dropped
+        node1.fDisconnect = true;
+        boost::thread worker(&CNSPVRequestQueue::Thread, &queue);
+        ASSERT_TRUE(WaitForCalls(recorder, 1));
+        for (int i = 0; i < 500 && queue.Size() > 0; i++)
+            MilliSleep(10);
+        worker.interrupt();
+        worker.join();
+        EXPECT_EQ(recorder.vCalls.size(), 1);
+        EXPECT_EQ(recorder.vCalls[0].first, node2.GetId());
+        EXPECT_EQ(node1.GetRefCount(), 0);
+    }
+}
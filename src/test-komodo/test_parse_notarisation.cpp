@@ -91,7 +91,7 @@ class komodo_state_accessor : public komodo_state
 public:
     void clear_npoints()
     {
-        NPOINTS.clear();
+        clear_checkpoints();
     }
     const notarized_checkpoint *last_checkpoint()
     {
@@ -469,6 +469,44 @@ TEST(TestParseNotarisation, test_notarizeddata)
     EXPECT_EQ(txid, expected_txid);
  }
 
+TEST(TestParseNotarisation, test_notarizedhash)
+{
+    // get the komodo_state to play with
+    char src[KOMODO_ASSETCHAIN_MAXLEN];
+    char dest[KOMODO_ASSETCHAIN_MAXLEN];
+    komodo_state *sp = komodo_stateptr(src, dest);
+    EXPECT_NE(sp, nullptr);
+
+    // empty NPOINTS
+    clear_npoints(sp);
+    uint256 hash;
+    EXPECT_FALSE(komodo_notarizedhash(9, &hash));
+    EXPECT_TRUE(hash.IsNull());
+
+    uint256 first_hash;
+    first_hash.SetHex("0A");
+    uint256 second_hash;
+    second_hash.SetHex("0C");
+    komodo_notarized_update(sp, 10, 9, first_hash, uint256(), uint256(), 1);
+    komodo_notarized_update(sp, 12, 11, second_hash, uint256(), uint256(), 1);
+    EXPECT_TRUE(komodo_notarizedhash(9, &hash));
+    EXPECT_EQ(hash, first_hash);
+    EXPECT_TRUE(komodo_notarizedhash(11, &hash));
+    EXPECT_EQ(hash, second_hash);
+    EXPECT_FALSE(komodo_notarizedhash(10, &hash)); // not a notarized height
+    EXPECT_TRUE(hash.IsNull());
+    // a later notarization of the same height wins
+    uint256 third_hash;
+    third_hash.SetHex("0E");
+    komodo_notarized_update(sp, 14, 9, third_hash, uint256(), uint256(), 1);
+    EXPECT_TRUE(komodo_notarizedhash(9, &hash));
+    EXPECT_EQ(hash, third_hash);
+    EXPECT_TRUE(komodo_notarizedhash(11, &hash));
+    EXPECT_EQ(hash, second_hash);
+    clear_npoints(sp);
+    EXPECT_FALSE(komodo_notarizedhash(9, &hash));
+}
+
 TEST(TestParseNotarisation, DISABLED_OldVsNew)
 {
     /***
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "tokencache.h"
+
+namespace TestTokenCache {
+
+    static uint256 Hash(uint8_t n)
+    {
+        uint256 hash;
+        hash.begin()[0] = n;
+        return hash;
+    }
+
+    TEST(TestTokenCache, block_of_the_verdict) {
+        CTokenVoutCache cache(100);
+        const COutPoint outpoint(Hash(1), 0);
+        const uint256 tokenid = Hash(2), hashBlock = Hash(3);
+        int64_t amount;
+
+        // nothing is kept for a transaction in the mempool
+        cache.Put(outpoint, tokenid, uint256(), 10);
+        EXPECT_EQ(cache.Size(), 0);
+
+        cache.Put(outpoint, tokenid, hashBlock, 10);
+        cache.Put(COutPoint(Hash(1), 1), tokenid, hashBlock, 0);
+        ASSERT_TRUE(cache.Get(outpoint, tokenid, hashBlock, amount));
+        EXPECT_EQ(amount, 10);
+        ASSERT_TRUE(cache.Get(COutPoint(Hash(1), 1), tokenid, hashBlock, amount));
+        EXPECT_EQ(amount, 0);
+
+        // another token, or the transaction in another block after a reorg
+        EXPECT_FALSE(cache.Get(outpoint, Hash(4), hashBlock, amount));
+        EXPECT_FALSE(cache.Get(outpoint, tokenid, Hash(5), amount));
+        EXPECT_FALSE(cache.Get(outpoint, tokenid, uint256(), amount));
+        cache.Put(outpoint, tokenid, Hash(5), 10);
+        EXPECT_TRUE(cache.Get(outpoint, tokenid, Hash(5), amount));
+        EXPECT_FALSE(cache.Get(outpoint, tokenid, hashBlock, amount));
+        EXPECT_EQ(cache.Size(), 2);
+        EXPECT_EQ(cache.GetHits(), 3);
+        EXPECT_EQ(cache.GetMisses(), 4);
+    }
+
+    TEST(TestTokenCache, eviction) {
+        CTokenVoutCache cache(3);
+        const uint256 tokenid = Hash(1), hashBlock = Hash(2);
+        int64_t amount;
+
+        for (uint32_t i = 0; i < 3; i++)
+            cache.Put(COutPoint(Hash(3), i), tokenid, hashBlock, i + 1);
+        EXPECT_TRUE(cache.Get(COutPoint(Hash(3), 0), tokenid, hashBlock, amount));
+
+        // the least recently used verdict goes first
+        cache.Put(COutPoint(Hash(3), 3), tokenid, hashBlock, 4);
+        EXPECT_EQ(cache.Size(), 3);
+        EXPECT_TRUE(cache.Get(COutPoint(Hash(3), 0), tokenid, hashBlock, amount));
+        EXPECT_FALSE(cache.Get(COutPoint(Hash(3), 1), tokenid, hashBlock, amount));
+        EXPECT_TRUE(cache.Get(COutPoint(Hash(3), 3), tokenid, hashBlock, amount));
+        EXPECT_EQ(amount, 4);
+    }
+}
@@ -99,7 +99,7 @@ void setupChain()
     // Init blockchain
     ClearDatadirCache();
     pblocktree = new CBlockTreeDB(1 << 20, true);
-    CCoinsViewDB *pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
     pcoinsTip = new CCoinsViewCache(pcoinsdbview);
     pnotarisations = new NotarisationDB(1 << 20, true);
     InitBlockIndex();
@@ -0,0 +1,67 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "tokencache.h"
+
+bool CTokenVoutCache::Get(const COutPoint &outpoint, const uint256 &tokenid, const uint256 &hashBlock, int64_t &amount)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<Key, Entry>::iterator it = mapEntries.find(std::make_pair(outpoint, tokenid));
+    if (it == mapEntries.end() || hashBlock.IsNull() || it->second.hashBlock != hashBlock) {
+        nMisses++;
+        return false;
+    }
+    listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+    amount = it->second.amount;
+    nHits++;
+    return true;
+}
+
+void CTokenVoutCache::Put(const COutPoint &outpoint, const uint256 &tokenid, const uint256 &hashBlock, int64_t amount)
+{
+    if (hashBlock.IsNull() || nMaxEntries == 0)
+        return;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    const Key key = std::make_pair(outpoint, tokenid);
+    std::map<Key, Entry>::iterator it = mapEntries.find(key);
+    if (it != mapEntries.end()) {
+        listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+    } else {
+        while (mapEntries.size() >= nMaxEntries && !listLRU.empty()) {
+            mapEntries.erase(listLRU.back());
+            listLRU.pop_back();
+        }
+        listLRU.push_front(key);
+        it = mapEntries.insert(std::make_pair(key, Entry())).first;
+        it->second.itLRU = listLRU.begin();
+    }
+    it->second.amount = amount;
+    it->second.hashBlock = hashBlock;
+}
+
+void CTokenVoutCache::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    mapEntries.clear();
+    listLRU.clear();
+}
+
+size_t CTokenVoutCache::Size()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return mapEntries.size();
+}
+
+uint64_t CTokenVoutCache::GetHits()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nHits;
+}
+
+uint64_t CTokenVoutCache::GetMisses()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nMisses;
+}
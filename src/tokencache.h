@@ -0,0 +1,74 @@
+// Copyright (c) 2016-2023 The Komodo Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef KOMODO_TOKENCACHE_H
+#define KOMODO_TOKENCACHE_H
+
+#include "primitives/transaction.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <utility>
+
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Verdicts of the full (goDeeper) IsTokensvout check on the outputs of
+ * confirmed transactions: the token amount of the output for a tokenid, 0 if
+ * it is not a valid tokens output.
+ *
+ * The check of a confirmed output only depends on the block the transaction
+ * is in and its ancestors, so a verdict is kept with the hash of that block
+ * and only served for it. A transaction that is reorganized into another
+ * block, or back to the mempool, is checked again. The least recently used
+ * verdicts are evicted past nMaxEntries.
+ */
+class CTokenVoutCache
+{
+private:
+    typedef std::pair<COutPoint, uint256> Key;
+
+    struct Entry
+    {
+        int64_t amount;
+        uint256 hashBlock;
+        std::list<Key>::iterator itLRU;
+    };
+
+    const size_t nMaxEntries;
+
+    boost::mutex mutex;
+    std::map<Key, Entry> mapEntries;
+    //! Outputs, most recently used first
+    std::list<Key> listLRU;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+public:
+    CTokenVoutCache(size_t nMaxEntriesIn) : nMaxEntries(nMaxEntriesIn), nHits(0), nMisses(0) {}
+
+    /****
+     * Find the verdict for an output
+     * @param outpoint the output
+     * @param tokenid the token the output was checked for
+     * @param hashBlock the block the transaction of the output is in
+     * @param amount set to the token amount of the output, 0 if it is not a valid tokens output
+     * @returns false if there is no verdict for this block
+     */
+    bool Get(const COutPoint &outpoint, const uint256 &tokenid, const uint256 &hashBlock, int64_t &amount);
+
+    /****
+     * Keep the verdict for an output of a confirmed transaction, nothing is kept for a null hashBlock
+     */
+    void Put(const COutPoint &outpoint, const uint256 &tokenid, const uint256 &hashBlock, int64_t amount);
+
+    void Clear();
+    size_t Size();
+    uint64_t GetHits();
+    uint64_t GetMisses();
+};
+
+#endif // KOMODO_TOKENCACHE_H
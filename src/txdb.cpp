@@ -23,12 +23,16 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
 #include "core_io.h"
+#include "ui_interface.h"
 #include "komodo_bitcoind.h"
 
+#include <algorithm>
+#include <atomic>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -41,7 +45,9 @@ static const char DB_SPROUT_ANCHOR = 'A';
 static const char DB_SAPLING_ANCHOR = 'Z';
 static const char DB_NULLIFIER = 's';
 static const char DB_SAPLING_NULLIFIER = 'S';
-static const char DB_COINS = 'c';
+static const char DB_COINS = 'c'; // whole-transaction coins records, before the per-output upgrade
+static const char DB_COIN = 'C';
+static const char DB_COINS_HEADER = 'H'; // number of outputs of a transaction with per-output records
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'd';
@@ -50,6 +56,16 @@ static const char DB_TIMESTAMPINDEX = 'S';
 static const char DB_BLOCKHASHINDEX = 'z';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_ADDRESSBALANCE = 'v';
+static const char DB_ADDRESSBALANCE_BACKFILL = 'V';
+static const char DB_CCINDEX = 'e';
+static const char DB_TOKENOUTPUT = 'o';
+static const char DB_TOKENBALANCE = 'k';
+static const char DB_TOKENSUPPLY = 'K';
+static const char DB_TOKENBLOCK = 'T';
+static const char DB_ORACLESAMPLE = 'O';
+static const char DB_GATEWAYSSTATE = 'G';
+static const char DB_GATEWAYSWITHDRAW = 'g';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_BEST_SPROUT_ANCHOR = 'a';
@@ -57,6 +73,7 @@ static const char DB_BEST_SAPLING_ANCHOR = 'z';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_COINS_FORMAT = 'M';
 
 
 CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
@@ -107,12 +124,67 @@ bool CCoinsViewDB::GetNullifier(const uint256 &nf, ShieldedType type) const {
     return db.Read(make_pair(dbChar, nf), spent);
 }
 
+/** Key of a coins database record holding one unspent output */
+struct CCoinsOutputKey
+{
+    char key;
+    uint256 txid;
+    uint32_t n;
+
+    CCoinsOutputKey() : key(DB_COIN), n(0) {}
+    CCoinsOutputKey(const uint256 &txidIn, uint32_t nIn) : key(DB_COIN), txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(key);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    // The header is a point read, so the bloom filters answer for the missing transactions
+    uint32_t nOutputs;
+    if (!db.Read(make_pair(DB_COINS_HEADER, txid), nOutputs))
+        return false;
+
+    /* It seems that there are no "const iterators" for LevelDB.  Since we
+       only need read operations on it, use a const-cast to get around
+       that restriction.  */
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+    pcursor->Seek(make_pair(DB_COIN, txid));
+
+    // the unspent outputs are next to each other, one scan reads them whatever the number of spent ones
+    coins.Clear();
+    coins.vout.resize(nOutputs);
+    bool fFound = false;
+    while (pcursor->Valid()) {
+        CCoinsOutputKey key;
+        if (!pcursor->GetKey(key) || key.key != DB_COIN || key.txid != txid)
+            break;
+        CCoinsOutput coin;
+        if (!pcursor->GetValue(coin))
+            return error("%s: unable to read output %s:%u", __func__, txid.ToString(), key.n);
+        coins.fCoinBase = coin.fCoinBase;
+        coins.nHeight = coin.nHeight;
+        coins.nVersion = coin.nVersion;
+        if (coins.vout.size() <= key.n)
+            coins.vout.resize(key.n + 1);
+        coins.vout[key.n] = coin.out;
+        fFound = true;
+        pcursor->Next();
+    }
+    return fFound;
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    return db.Exists(make_pair(DB_COINS_HEADER, txid));
+}
+
+bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const {
+    return db.Read(CCoinsOutputKey(outpoint.hash, outpoint.n), coin);
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -141,7 +213,38 @@ uint256 CCoinsViewDB::GetBestAnchor(ShieldedType type) const {
     return hashBestAnchor;
 }
 
-void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char& dbChar)
+/** Collects serialized records instead of writing them to a database */
+class CDBRecordBatch
+{
+private:
+    CCoinsDBRecordMap &records;
+
+    template <typename K>
+    static std::string SerializeRecordPart(const K& obj)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << obj;
+        return std::string(ss.begin(), ss.end());
+    }
+
+public:
+    CDBRecordBatch(CCoinsDBRecordMap &recordsIn) : records(recordsIn) {}
+
+    template <typename K, typename V>
+    void Write(const K& key, const V& value)
+    {
+        records[SerializeRecordPart(key)] = SerializeRecordPart(value);
+    }
+
+    template <typename K>
+    void Erase(const K& key)
+    {
+        records[SerializeRecordPart(key)] = boost::none;
+    }
+};
+
+template<typename Batch>
+void BatchWriteNullifiers(Batch& batch, CNullifiersMap& mapToUse, const char& dbChar)
 {
     for (CNullifiersMap::iterator it = mapToUse.begin(); it != mapToUse.end();) {
         if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
@@ -156,8 +259,8 @@ void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char&
     }
 }
 
-template<typename Map, typename MapIterator, typename MapEntry, typename Tree>
-void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
+template<typename Batch, typename Map, typename MapIterator, typename MapEntry, typename Tree>
+void BatchWriteAnchors(Batch& batch, Map& mapToUse, const char& dbChar)
 {
     for (MapIterator it = mapToUse.begin(); it != mapToUse.end();) {
         if (it->second.flags & MapEntry::DIRTY) {
@@ -175,32 +278,41 @@ void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
     }
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
-                              const uint256 &hashBlock,
-                              const uint256 &hashSproutAnchor,
-                              const uint256 &hashSaplingAnchor,
-                              CAnchorsSproutMap &mapSproutAnchors,
-                              CAnchorsSaplingMap &mapSaplingAnchors,
-                              CNullifiersMap &mapSproutNullifiers,
-                              CNullifiersMap &mapSaplingNullifiers) {
-    CDBBatch batch(db);
-    size_t count = 0;
-    size_t changed = 0;
+template<typename Batch>
+void BatchWriteCoins(Batch& batch,
+                     size_t& count,
+                     size_t& changed,
+                     CCoinsMap &mapCoins,
+                     const uint256 &hashBlock,
+                     const uint256 &hashSproutAnchor,
+                     const uint256 &hashSaplingAnchor,
+                     CAnchorsSproutMap &mapSproutAnchors,
+                     CAnchorsSaplingMap &mapSaplingAnchors,
+                     CNullifiersMap &mapSproutNullifiers,
+                     CNullifiersMap &mapSaplingNullifiers)
+{
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
+            const CCoins &coins = it->second.coins;
+            for (uint32_t n : it->second.dirtyOutputs) {
+                if (coins.IsAvailable(n))
+                    batch.Write(CCoinsOutputKey(it->first, n), CCoinsOutput(coins, n));
+                else
+                    batch.Erase(CCoinsOutputKey(it->first, n));
+                changed++;
+            }
+            if (coins.IsPruned())
+                batch.Erase(make_pair(DB_COINS_HEADER, it->first));
             else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
-            changed++;
+                batch.Write(make_pair(DB_COINS_HEADER, it->first), (uint32_t)coins.vout.size());
         }
         count++;
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
 
-    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR);
-    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR);
+    ::BatchWriteAnchors<Batch, CAnchorsSproutMap, CAnchorsSproutMap::iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR);
+    ::BatchWriteAnchors<Batch, CAnchorsSaplingMap, CAnchorsSaplingMap::iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR);
 
     ::BatchWriteNullifiers(batch, mapSproutNullifiers, DB_NULLIFIER);
     ::BatchWriteNullifiers(batch, mapSaplingNullifiers, DB_SAPLING_NULLIFIER);
@@ -211,11 +323,111 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
         batch.Write(DB_BEST_SPROUT_ANCHOR, hashSproutAnchor);
     if (!hashSaplingAnchor.IsNull())
         batch.Write(DB_BEST_SAPLING_ANCHOR, hashSaplingAnchor);
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
+                              const uint256 &hashBlock,
+                              const uint256 &hashSproutAnchor,
+                              const uint256 &hashSaplingAnchor,
+                              CAnchorsSproutMap &mapSproutAnchors,
+                              CAnchorsSaplingMap &mapSaplingAnchors,
+                              CNullifiersMap &mapSproutNullifiers,
+                              CNullifiersMap &mapSaplingNullifiers) {
+    CDBBatch batch(db);
+    size_t count = 0;
+    size_t changed = 0;
+    ::BatchWriteCoins(batch, count, changed, mapCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor,
+            mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed outputs (of %u transactions) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return db.WriteBatch(batch);
 }
 
+void CCoinsViewDB::RecordBatch(CCoinsDBRecordMap &records,
+                               CCoinsMap &mapCoins,
+                               const uint256 &hashBlock,
+                               const uint256 &hashSproutAnchor,
+                               const uint256 &hashSaplingAnchor,
+                               CAnchorsSproutMap &mapSproutAnchors,
+                               CAnchorsSaplingMap &mapSaplingAnchors,
+                               CNullifiersMap &mapSproutNullifiers,
+                               CNullifiersMap &mapSaplingNullifiers) const {
+    CDBRecordBatch batch(records);
+    size_t count = 0;
+    size_t changed = 0;
+    ::BatchWriteCoins(batch, count, changed, mapCoins, hashBlock, hashSproutAnchor, hashSaplingAnchor,
+            mapSproutAnchors, mapSaplingAnchors, mapSproutNullifiers, mapSaplingNullifiers);
+}
+
+CDBIterator *CCoinsViewDB::RawCursor() const {
+    /* It seems that there are no "const iterators" for LevelDB.  Since we
+       only need read operations on it, use a const-cast to get around
+       that restriction.  */
+    return const_cast<CDBWrapper*>(&db)->NewIterator();
+}
+
+bool CCoinsViewDB::WriteRawRecords(const CCoinsDBRecordMap &records, bool fSync) {
+    CDBBatch batch(db);
+    for (const auto& record : records) {
+        if (record.second)
+            batch.WriteRaw(record.first, *record.second);
+        else
+            batch.EraseRaw(record.first);
+    }
+    return db.WriteBatch(batch, fSync);
+}
+
+bool CCoinsViewDB::Upgrade() {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    std::pair<char, uint256> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS)
+        return true;
+
+    LogPrintf("Upgrading the coins database to per-output records...\n");
+    uiInterface.ShowProgress(_("Upgrading UTXO database"), 0);
+    CDBBatch batch(db);
+    size_t nTransactions = 0, nBatched = 0;
+    int nReportDone = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        CCoins coins;
+        if (!pcursor->GetValue(coins))
+            return error("%s: unable to read coins of %s", __func__, key.second.ToString());
+        for (uint32_t n = 0; n < coins.vout.size(); n++) {
+            if (!coins.vout[n].IsNull()) {
+                batch.Write(CCoinsOutputKey(key.second, n), CCoinsOutput(coins, n));
+                nBatched++;
+            }
+        }
+        batch.Write(make_pair(DB_COINS_HEADER, key.second), (uint32_t)coins.vout.size());
+        batch.Erase(key);
+        nTransactions++;
+        // Each batch replaces whole transactions, so an interrupted upgrade resumes where it stopped
+        if (nBatched >= 100000) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            nBatched = 0;
+            int nPercentageDone = (int)(key.second.begin()[0] * 100.0 / 256);
+            if (nPercentageDone > nReportDone) {
+                uiInterface.ShowProgress(_("Upgrading UTXO database"), nPercentageDone);
+                nReportDone = nPercentageDone;
+            }
+        }
+        pcursor->Next();
+    }
+    if (!db.WriteBatch(batch, true))
+        return false;
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("Upgraded the coins of %u transactions%s\n", nTransactions, ShutdownRequested() ? ", interrupted" : "");
+    return !ShutdownRequested();
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, bool compression, int maxOpenFiles) 
         : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, compression, maxOpenFiles) {
 }
@@ -236,6 +448,17 @@ bool CBlockTreeDB::ReadReindexing(bool &fReindexing) const {
     return true;
 }
 
+bool CBlockTreeDB::WriteCoinsFormat(int nFormat) {
+    return Write(DB_COINS_FORMAT, nFormat, true);
+}
+
+bool CBlockTreeDB::ReadCoinsFormat(int &nFormat) const {
+    nFormat = 0;
+    if (!Exists(DB_COINS_FORMAT))
+        return true;
+    return Read(DB_COINS_FORMAT, nFormat);
+}
+
 bool CBlockTreeDB::ReadLastBlockFile(int &nFile) const {
     return Read(DB_LAST_BLOCK, nFile);
 }
@@ -245,30 +468,32 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
-    pcursor->Seek(DB_COINS);
+    pcursor->Seek(DB_COIN);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
+    uint256 prevTxid;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && key.first == DB_COINS) {
-            if (pcursor->GetValue(coins)) {
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
+        CCoinsOutputKey key;
+        CCoinsOutput value;
+        if (pcursor->GetKey(key) && key.key == DB_COIN) {
+            if (pcursor->GetValue(value)) {
+                // Records are ordered by txid, each transaction's outputs are hashed together
+                if (stats.nTransactions == 0 || key.txid != prevTxid) {
+                    if (stats.nTransactions != 0)
+                        ss << VARINT(0);
+                    ss << key.txid;
+                    stats.nTransactions++;
+                    prevTxid = key.txid;
                 }
-                stats.nSerializedSize += 32 + pcursor->GetValueSize();
-                ss << VARINT(0);
+                stats.nTransactionOutputs++;
+                ss << VARINT(key.n+1);
+                ss << value.out;
+                nTotalAmount += value.out.nValue;
+                stats.nSerializedSize += pcursor->GetKeySize() + pcursor->GetValueSize();
             } else {
                 return error("CCoinsViewDB::GetStats() : unable to read value");
             }
@@ -277,6 +502,8 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
         }
         pcursor->Next();
     }
+    if (stats.nTransactions != 0)
+        ss << VARINT(0);
     {
         LOCK(cs_main);
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
@@ -329,7 +556,10 @@ bool CBlockTreeDB::EraseBatchSync(const std::vector<const CBlockIndex*>& blockin
 }
 
 bool CBlockTreeDB::ReadDiskBlockIndex(const uint256 &blockhash, CDiskBlockIndex &dbindex) const {
-    return Read(make_pair(DB_BLOCK_INDEX, blockhash), dbindex);
+    if (!Read(make_pair(DB_BLOCK_INDEX, blockhash), dbindex))
+        return false;
+    dbindex.hashBlock = blockhash;
+    return true;
 }
 
 bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) const {
@@ -406,17 +636,420 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressUnspentIndexPage(uint160 addressHash, int type, const CAddressUnspentKey *pkeyAfter, size_t nMax,
+                                               std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, bool &fMore) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    fMore = false;
+    if (pkeyAfter != NULL) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, *pkeyAfter));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, CAddressUnspentKey> keyObj;
+            pcursor->GetKey(keyObj);
+            char chType = keyObj.first;
+            CAddressUnspentKey indexKey = keyObj.second;
+
+            if (chType == DB_ADDRESSUNSPENTINDEX && indexKey.hashBytes == addressHash) {
+                if (pkeyAfter != NULL && indexKey.txhash == pkeyAfter->txhash && indexKey.index == pkeyAfter->index) {
+                    pcursor->Next();
+                    continue;
+                }
+                if (unspentOutputs.size() >= nMax) {
+                    fMore = true;
+                    break;
+                }
+                try {
+                    CAddressUnspentValue nValue;
+                    pcursor->GetValue(nValue);
+                    unspentOutputs.push_back(make_pair(indexKey, nValue));
+                    pcursor->Next();
+                } catch (const std::exception& e) {
+                    return error("failed to get address unspent value");
+                }
+            } else {
+                break;
+            }
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+    return true;
+}
+
+void CBlockTreeDB::BatchAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) {
+    // a block has at most one record per output and input, the transactions are counted once per address
+    std::map<std::pair<unsigned int, uint160>, std::pair<CAddressBalanceValue, std::set<uint256> > > mapDeltas;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        std::pair<CAddressBalanceValue, std::set<uint256> > &delta = mapDeltas[std::make_pair(it->first.type, it->first.hashBytes)];
+        if (it->second > 0)
+            delta.first.received += it->second;
+        else
+            delta.first.sent -= it->second;
+        if (delta.second.insert(it->first.txhash).second)
+            delta.first.txcount++;
+    }
+
+    for (std::map<std::pair<unsigned int, uint160>, std::pair<CAddressBalanceValue, std::set<uint256> > >::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+        const CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        const CAddressBalanceValue &delta = it->second.first;
+        CAddressBalanceValue balance;
+        if (!Read(make_pair(DB_ADDRESSBALANCE, key), balance))
+            balance.SetNull();
+        if (fErase) {
+            balance.received -= delta.received;
+            balance.sent -= delta.sent;
+            balance.txcount -= delta.txcount;
+        } else {
+            balance.received += delta.received;
+            balance.sent += delta.sent;
+            balance.txcount += delta.txcount;
+        }
+        if (balance.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSBALANCE, key));
+        else
+            batch.Write(make_pair(DB_ADDRESSBALANCE, key), balance);
+    }
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+    // the records of a block are written in one batch with its balance deltas, so any of them marks the block
+    // applied: a block replayed after an unclean shutdown, the block index being ahead of the chainstate, is not counted twice
+    const bool fApplied = !vect.empty() && Exists(make_pair(DB_ADDRESSINDEX, vect.front().first));
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    if (!fApplied)
+        BatchAddressBalances(batch, vect, false);
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+    const bool fApplied = !vect.empty() && Exists(make_pair(DB_ADDRESSINDEX, vect.front().first));
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    if (fApplied)
+        BatchAddressBalances(batch, vect, true);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WriteContractIndex(const std::vector<std::pair<CContractIndexKey, int32_t> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CContractIndexKey, int32_t> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(make_pair(DB_CCINDEX, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseContractIndex(const std::vector<std::pair<CContractIndexKey, int32_t> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CContractIndexKey, int32_t> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Erase(make_pair(DB_CCINDEX, it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadContractIndex(uint8_t evalcode, uint8_t funcid, std::vector<std::pair<CContractIndexKey, int32_t> > &vect) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_CCINDEX, CContractIndexIteratorKey(evalcode, funcid)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        pair<char, CContractIndexKey> keyObj;
+        if (!pcursor->GetKey(keyObj) || keyObj.first != DB_CCINDEX || keyObj.second.evalcode != evalcode || keyObj.second.funcid != funcid)
+            break;
+        int32_t vout;
+        if (!pcursor->GetValue(vout))
+            return error("failed to get cc index value");
+        vect.push_back(make_pair(keyObj.second, vout));
+        pcursor->Next();
+    }
+    return true;
+}
+
+void CBlockTreeDB::BatchTokenBalances(CDBBatch &batch, const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                                      const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent, bool fErase) {
+    std::map<std::pair<uint256, uint160>, CAmount> mapDeltas;
+    std::map<uint256, CAmount> mapSupplyDeltas;
+    for (std::vector<std::pair<COutPoint, CTokenOutputValue> >::const_iterator it=vCreated.begin(); it!=vCreated.end(); it++) {
+        mapDeltas[std::make_pair(it->second.tokenid, it->second.addressHash)] += it->second.satoshis;
+        // the outputs of the creation transaction are the supply
+        if (it->first.hash == it->second.tokenid)
+            mapSupplyDeltas[it->second.tokenid] += it->second.satoshis;
+    }
+    for (std::vector<std::pair<COutPoint, CTokenOutputValue> >::const_iterator it=vSpent.begin(); it!=vSpent.end(); it++)
+        mapDeltas[std::make_pair(it->second.tokenid, it->second.addressHash)] -= it->second.satoshis;
+
+    std::map<uint256, CTokenSupplyValue> mapSupplies;
+    for (std::map<std::pair<uint256, uint160>, CAmount>::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+        const uint256 &tokenid = it->first.first;
+        if (!mapSupplies.count(tokenid) && !Read(make_pair(DB_TOKENSUPPLY, tokenid), mapSupplies[tokenid]))
+            mapSupplies[tokenid].SetNull();
+        CAmount balance = 0;
+        if (!Read(make_pair(DB_TOKENBALANCE, it->first), balance))
+            balance = 0;
+        const CAmount balanceNew = fErase ? balance - it->second : balance + it->second;
+        // the holders are the addresses going from no balance to some, or back
+        if (balance == 0 && balanceNew != 0)
+            mapSupplies[tokenid].holders++;
+        else if (balance != 0 && balanceNew == 0)
+            mapSupplies[tokenid].holders--;
+        if (balanceNew == 0)
+            batch.Erase(make_pair(DB_TOKENBALANCE, it->first));
+        else
+            batch.Write(make_pair(DB_TOKENBALANCE, it->first), balanceNew);
+    }
+    for (std::map<uint256, CAmount>::const_iterator it=mapSupplyDeltas.begin(); it!=mapSupplyDeltas.end(); it++) {
+        if (!mapSupplies.count(it->first) && !Read(make_pair(DB_TOKENSUPPLY, it->first), mapSupplies[it->first]))
+            mapSupplies[it->first].SetNull();
+        mapSupplies[it->first].supply += fErase ? -it->second : it->second;
+    }
+
+    for (std::map<uint256, CTokenSupplyValue>::const_iterator it=mapSupplies.begin(); it!=mapSupplies.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair(DB_TOKENSUPPLY, it->first));
+        else
+            batch.Write(make_pair(DB_TOKENSUPPLY, it->first), it->second);
+    }
+}
+
+bool CBlockTreeDB::WriteTokenIndex(const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                                   const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent, const uint256 &hashBlock) {
+    // the block index is written ahead of the chainstate, a block replayed after an unclean shutdown was already applied
+    if ((vCreated.empty() && vSpent.empty()) || Exists(make_pair(DB_TOKENBLOCK, hashBlock)))
+        return true;
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<COutPoint, CTokenOutputValue> >::const_iterator it=vCreated.begin(); it!=vCreated.end(); it++)
+        batch.Write(make_pair(DB_TOKENOUTPUT, it->first), it->second);
+    BatchTokenBalances(batch, vCreated, vSpent, false);
+    batch.Write(make_pair(DB_TOKENBLOCK, hashBlock), '1');
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseTokenIndex(const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                                   const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent, const uint256 &hashBlock) {
+    if (!Exists(make_pair(DB_TOKENBLOCK, hashBlock)))
+        return true;
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<COutPoint, CTokenOutputValue> >::const_iterator it=vCreated.begin(); it!=vCreated.end(); it++)
+        batch.Erase(make_pair(DB_TOKENOUTPUT, it->first));
+    BatchTokenBalances(batch, vCreated, vSpent, true);
+    batch.Erase(make_pair(DB_TOKENBLOCK, hashBlock));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadTokenOutput(const COutPoint &outpoint, CTokenOutputValue &value) {
+    return Read(make_pair(DB_TOKENOUTPUT, outpoint), value);
+}
+
+bool CBlockTreeDB::ReadTokenBalance(const uint256 &tokenid, const uint160 &addressHash, CAmount &balance) {
+    if (!Read(make_pair(DB_TOKENBALANCE, make_pair(tokenid, addressHash)), balance))
+        balance = 0;
+    return true;
+}
+
+bool CBlockTreeDB::ReadTokenSupply(const uint256 &tokenid, CTokenSupplyValue &supply) {
+    if (!Read(make_pair(DB_TOKENSUPPLY, tokenid), supply))
+        supply.SetNull();
+    return true;
+}
+
+bool CBlockTreeDB::WriteOracleSampleIndex(const std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<COracleSampleKey, COracleSampleValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(make_pair(DB_ORACLESAMPLE, it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseOracleSampleIndex(const std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<COracleSampleKey, COracleSampleValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Erase(make_pair(DB_ORACLESAMPLE, it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadOracleSamples(const uint256 &oracletxid, const uint160 &publisherHash, int maxHeight, int num,
+                                     std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // from the first key above maxHeight, backwards
+    const int seekHeight = maxHeight < std::numeric_limits<int>::max() ? maxHeight + 1 : maxHeight;
+    pcursor->Seek(make_pair(DB_ORACLESAMPLE, COracleSampleIteratorKey(oracletxid, publisherHash, seekHeight)));
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
+
+    while (pcursor->Valid() && (num == 0 || (int)vect.size() < num)) {
+        boost::this_thread::interruption_point();
+        pair<char, COracleSampleKey> keyObj;
+        if (!pcursor->GetKey(keyObj) || keyObj.first != DB_ORACLESAMPLE || keyObj.second.oracletxid != oracletxid || keyObj.second.publisherHash != publisherHash)
+            break;
+        COracleSampleValue value;
+        if (!pcursor->GetValue(value))
+            return error("failed to get oracle sample value");
+        vect.push_back(make_pair(keyObj.second, value));
+        pcursor->Prev();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadOracleLatestSamples(const uint256 &oracletxid, std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_ORACLESAMPLE, COracleSampleIteratorKey(oracletxid, uint160(), 0)));
+
+    // jump from publisher to publisher, the last sample of one is just before the first of the next
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        pair<char, COracleSampleKey> keyObj;
+        if (!pcursor->GetKey(keyObj) || keyObj.first != DB_ORACLESAMPLE || keyObj.second.oracletxid != oracletxid)
+            break;
+        const uint160 publisherHash = keyObj.second.publisherHash;
+        pcursor->Seek(make_pair(DB_ORACLESAMPLE, COracleSampleIteratorKey(oracletxid, publisherHash, std::numeric_limits<int>::max())));
+        if (pcursor->Valid())
+            pcursor->Prev();
+        else
+            pcursor->SeekToLast();
+        COracleSampleValue value;
+        if (!pcursor->Valid() || !pcursor->GetKey(keyObj) || !pcursor->GetValue(value))
+            return error("failed to get oracle sample value");
+        vect.push_back(make_pair(keyObj.second, value));
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateGatewaysIndex(const std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &vect,
+                                       const std::vector<std::pair<uint256, uint256> > &withdraws) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair(DB_GATEWAYSSTATE, it->first));
+        else
+            batch.Write(make_pair(DB_GATEWAYSSTATE, it->first), it->second);
+    }
+    for (std::vector<std::pair<uint256, uint256> >::const_iterator it=withdraws.begin(); it!=withdraws.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair(DB_GATEWAYSWITHDRAW, it->first));
+        else
+            batch.Write(make_pair(DB_GATEWAYSWITHDRAW, it->first), it->second);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadGatewaysState(const CGatewaysStateKey &key, CGatewaysStateValue &value) {
+    return Read(make_pair(DB_GATEWAYSSTATE, key), value);
+}
+
+bool CBlockTreeDB::ReadGatewaysWithdrawBind(const uint256 &withdrawtxid, uint256 &bindtxid) {
+    return Read(make_pair(DB_GATEWAYSWITHDRAW, withdrawtxid), bindtxid);
+}
+
+bool CBlockTreeDB::ReadGatewaysStates(const uint256 &bindtxid, uint8_t stage, std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &vect) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_GATEWAYSSTATE, CGatewaysStateIteratorKey(bindtxid, stage)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        pair<char, CGatewaysStateKey> keyObj;
+        if (!pcursor->GetKey(keyObj) || keyObj.first != DB_GATEWAYSSTATE || keyObj.second.bindtxid != bindtxid || keyObj.second.stage != stage)
+            break;
+        CGatewaysStateValue value;
+        if (!pcursor->GetValue(value))
+            return error("failed to get gateways state value");
+        vect.push_back(make_pair(keyObj.second, value));
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance) {
+    if (!Read(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), balance))
+        balance.SetNull();
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalanceBackfill(CAddressIndexIteratorKey &keyLast) {
+    return Read(DB_ADDRESSBALANCE_BACKFILL, keyLast);
+}
+
+bool CBlockTreeDB::BackfillAddressBalances(const CAddressIndexIteratorKey *pkeyAfter, size_t nMaxRecords,
+                                           CAddressIndexIteratorKey &keyLast, bool &fDone) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+
+    // the records are ordered by address, then height: the highest height key of an address comes before its next one
+    if (pkeyAfter != NULL) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(pkeyAfter->type, pkeyAfter->hashBytes, -1)));
+    } else {
+        pcursor->Seek(DB_ADDRESSINDEX);
+    }
+
+    fDone = true;
+    size_t nRecords = 0;
+    bool fAddress = false;
+    CAddressIndexIteratorKey key;
+    CAddressBalanceValue balance;
+    int lastHeight = -1;
+    uint256 lastTxHash;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        pair<char, CAddressIndexKey> keyObj;
+        if (!pcursor->GetKey(keyObj) || keyObj.first != DB_ADDRESSINDEX)
+            break;
+        const CAddressIndexKey &indexKey = keyObj.second;
+
+        if (!fAddress || indexKey.type != key.type || indexKey.hashBytes != key.hashBytes) {
+            if (fAddress) {
+                batch.Write(make_pair(DB_ADDRESSBALANCE, key), balance);
+                keyLast = key;
+                if (nRecords >= nMaxRecords) {
+                    fDone = false;
+                    break;
+                }
+            }
+            fAddress = true;
+            key = CAddressIndexIteratorKey(indexKey.type, indexKey.hashBytes);
+            balance.SetNull();
+            lastHeight = -1;
+        }
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+        if (nValue > 0)
+            balance.received += nValue;
+        else
+            balance.sent -= nValue;
+        // the records of a transaction are next to each other
+        if (indexKey.blockHeight != lastHeight || indexKey.txhash != lastTxHash) {
+            balance.txcount++;
+            lastHeight = indexKey.blockHeight;
+            lastTxHash = indexKey.txhash;
+        }
+        nRecords++;
+        pcursor->Next();
+    }
+    if (fDone && fAddress) {
+        batch.Write(make_pair(DB_ADDRESSBALANCE, key), balance);
+        keyLast = key;
+    }
+    if (fAddress)
+        batch.Write(DB_ADDRESSBALANCE_BACKFILL, keyLast);
     return WriteBatch(batch);
 }
 
@@ -464,6 +1097,64 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressIndexPage(uint160 addressHash, int type, const CAddressIndexKey *pkeyAfter, size_t nMax,
+                                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore,
+                                        int start, int end) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // as in ReadAddressIndex, the height range only applies with both ends
+    if (start <= 0 || end <= 0)
+        start = end = 0;
+    fMore = false;
+    if (pkeyAfter != NULL) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pkeyAfter));
+    } else if (start > 0) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            pair<char, CAddressIndexKey> keyObj;
+            pcursor->GetKey(keyObj);
+            char chType = keyObj.first;
+            CAddressIndexKey indexKey = keyObj.second;
+
+            if (chType == DB_ADDRESSINDEX && indexKey.hashBytes == addressHash) {
+                if (pkeyAfter != NULL && indexKey.blockHeight == pkeyAfter->blockHeight && indexKey.txindex == pkeyAfter->txindex &&
+                    indexKey.txhash == pkeyAfter->txhash && indexKey.index == pkeyAfter->index && indexKey.spending == pkeyAfter->spending) {
+                    pcursor->Next();
+                    continue;
+                }
+                if (end > 0 && indexKey.blockHeight > end) {
+                    break;
+                }
+                if (addressIndex.size() >= nMax) {
+                    fMore = true;
+                    break;
+                }
+                try {
+                    CAmount nValue;
+                    pcursor->GetValue(nValue);
+                    addressIndex.push_back(make_pair(indexKey, nValue));
+                    pcursor->Next();
+                } catch (const std::exception& e) {
+                    return error("failed to get address index value");
+                }
+            } else {
+                break;
+            }
+        } catch (const std::exception& e) {
+            break;
+        }
+    }
+
+    return true;
+}
+
 bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &address);
 
 #define DECLARE_IGNORELIST std::map <std::string,int> ignoredMap = { \
@@ -707,73 +1398,168 @@ bool CBlockTreeDB::blockOnchainActive(const uint256 &hash) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts()
+/** Number of key ranges the block index is split into while loading. */
+static const int BLOCK_INDEX_LOAD_SHARDS = 16;
+
+/** A block index entry read from disk, not yet linked into mapBlockIndex */
+struct CLoadedBlockIndex
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    uint256 hash;
+    uint256 hashPrev;
+    CBlockIndex* pindex;
+};
+
+/****
+ * Read and deserialize the block index entries whose hash starts with a byte
+ * in [nBegin, nEnd). Entries are returned in key order.
+ * @returns false if an entry could not be read
+ */
+static bool LoadBlockIndexShard(CBlockTreeDB& db, int nBegin, int nEnd, std::vector<CLoadedBlockIndex>& vLoaded)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
 
-    pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
+    uint256 hashStart;
+    *hashStart.begin() = nBegin;
+    pcursor->Seek(make_pair(DB_BLOCK_INDEX, hashStart));
 
-    // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->hashSproutAnchor     = diskindex.hashSproutAnchor;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->hashFinalSaplingRoot   = diskindex.hashFinalSaplingRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                // the Equihash solution will be loaded lazily from the dbindex entry
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nCachedBranchId = diskindex.nCachedBranchId;
-                pindexNew->nTx            = diskindex.nTx;
-                pindexNew->nChainSupplyDelta  = diskindex.nChainSupplyDelta;
-                pindexNew->nTransparentValue = diskindex.nTransparentValue;
-                pindexNew->nBurnedAmountDelta = diskindex.nBurnedAmountDelta;
-                pindexNew->nSproutValue   = diskindex.nSproutValue;
-                pindexNew->nSaplingValue  = diskindex.nSaplingValue;
-                pindexNew->segid          = diskindex.segid;
-                pindexNew->nNotaryPay     = diskindex.nNotaryPay;
-
-                if ( 0 ) // POW will be checked before any block is connected
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= nEnd)
+            break;
+        CDiskBlockIndex diskindex;
+        if (!pcursor->GetValue(diskindex))
+            return error("LoadBlockIndex() : failed to read value");
+
+        CBlockIndex* pindexNew = new CBlockIndex();
+        pindexNew->nHeight        = diskindex.nHeight;
+        pindexNew->nFile          = diskindex.nFile;
+        pindexNew->nDataPos       = diskindex.nDataPos;
+        pindexNew->nUndoPos       = diskindex.nUndoPos;
+        pindexNew->hashSproutAnchor     = diskindex.hashSproutAnchor;
+        pindexNew->nVersion       = diskindex.nVersion;
+        pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+        pindexNew->hashFinalSaplingRoot   = diskindex.hashFinalSaplingRoot;
+        pindexNew->nTime          = diskindex.nTime;
+        pindexNew->nBits          = diskindex.nBits;
+        pindexNew->nNonce         = diskindex.nNonce;
+        // the Equihash solution will be loaded lazily from the dbindex entry
+        pindexNew->nStatus        = diskindex.nStatus;
+        pindexNew->nCachedBranchId = diskindex.nCachedBranchId;
+        pindexNew->nTx            = diskindex.nTx;
+        pindexNew->nChainSupplyDelta  = diskindex.nChainSupplyDelta;
+        pindexNew->nTransparentValue = diskindex.nTransparentValue;
+        pindexNew->nBurnedAmountDelta = diskindex.nBurnedAmountDelta;
+        pindexNew->nSproutValue   = diskindex.nSproutValue;
+        pindexNew->nSaplingValue  = diskindex.nSaplingValue;
+        pindexNew->segid          = diskindex.segid;
+        pindexNew->nNotaryPay     = diskindex.nNotaryPay;
+
+        // the key is the block hash, no need to rehash the header and solution
+        vLoaded.push_back(CLoadedBlockIndex{key.second, diskindex.hashPrev, pindexNew});
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts()
+{
+    // Reading and deserializing the entries is done on a pool, one key range
+    // at a time. Linking them into mapBlockIndex happens afterwards on this
+    // thread, in key order, so the result does not depend on thread scheduling.
+    std::vector<std::vector<CLoadedBlockIndex> > vShards(BLOCK_INDEX_LOAD_SHARDS);
+    std::vector<char> vShardOk(BLOCK_INDEX_LOAD_SHARDS, 0);
+    std::atomic<int> nNextShard(0);
+    int nThreads = std::max(1, std::min(GetNumCores(), BLOCK_INDEX_LOAD_SHARDS));
+
+    auto worker = [&]() {
+        int nShard;
+        while ((nShard = nNextShard++) < BLOCK_INDEX_LOAD_SHARDS) {
+            int nBegin = nShard * 256 / BLOCK_INDEX_LOAD_SHARDS;
+            int nEnd = (nShard + 1) * 256 / BLOCK_INDEX_LOAD_SHARDS;
+            try {
+                vShardOk[nShard] = LoadBlockIndexShard(*this, nBegin, nEnd, vShards[nShard]);
+            } catch (const boost::thread_interrupted&) {
+                return;
+            } catch (const std::exception& e) {
+                LogPrintf("LoadBlockIndex(): %s\n", e.what());
+                return;
+            }
+        }
+    };
+    boost::thread_group loaders;
+    for (int i = 0; i < nThreads; i++)
+        loaders.create_thread(worker);
+    try {
+        loaders.join_all();
+    } catch (const boost::thread_interrupted&) {
+        loaders.interrupt_all();
+        loaders.join_all();
+        for (auto& shard : vShards)
+            for (const auto& loaded : shard)
+                delete loaded.pindex;
+        throw;
+    }
+
+    bool fOk = std::all_of(vShardOk.begin(), vShardOk.end(), [](char ok) { return ok != 0; });
+    if (!fOk) {
+        for (auto& shard : vShards)
+            for (const auto& loaded : shard)
+                delete loaded.pindex;
+        return error("LoadBlockIndex() : failed to load block index");
+    }
+    boost::this_thread::interruption_point();
+
+    size_t nEntries = 0;
+    for (const auto& shard : vShards)
+        nEntries += shard.size();
+    mapBlockIndex.reserve(mapBlockIndex.size() + nEntries);
+
+    // Load mapBlockIndex
+    for (auto& shard : vShards) {
+        for (auto& loaded : shard) {
+            BlockMap::iterator mi = mapBlockIndex.find(loaded.hash);
+            if (mi != mapBlockIndex.end() && mi->second != NULL) {
+                // already referenced as a parent, keep that object
+                CBlockIndex* pindexExisting = mi->second;
+                *pindexExisting = *loaded.pindex;
+                pindexExisting->phashBlock = &mi->first;
+                delete loaded.pindex;
+                loaded.pindex = pindexExisting;
+            } else {
+                mi = mapBlockIndex.insert(make_pair(loaded.hash, loaded.pindex)).first;
+                mi->second = loaded.pindex;
+                loaded.pindex->phashBlock = &mi->first;
+            }
+        }
+    }
+    for (const auto& shard : vShards) {
+        for (const auto& loaded : shard) {
+            CBlockIndex* pindexNew = loaded.pindex;
+            pindexNew->pprev = InsertBlockIndex(loaded.hashPrev);
+
+            if ( 0 ) // POW will be checked before any block is connected
+            {
+                // Consistency checks
+                CBlockHeader header;
                 {
-                    // Consistency checks
-                    CBlockHeader header;
-                    {
-                        LOCK(cs_main);
-                        try {
-                            header = pindexNew->GetBlockHeader();
-                        } catch (const runtime_error&) {
-                            return error("LoadBlockIndex(): failed to read index entry: diskindex hash = %s",
-                                diskindex.GetBlockHash().ToString());
-                        }
+                    LOCK(cs_main);
+                    try {
+                        header = pindexNew->GetBlockHeader();
+                    } catch (const runtime_error&) {
+                        return error("LoadBlockIndex(): failed to read index entry: diskindex hash = %s",
+                            loaded.hash.ToString());
                     }
-                    if (header.GetHash() != pindexNew->GetBlockHash())
-                        return error("LoadBlockIndex(): block header inconsistency detected: on-disk = %s, in-memory = %s",
-                                    diskindex.ToString(),  pindexNew->ToString());
-
-                    uint8_t pubkey33[33];
-                    komodo_index2pubkey33(pubkey33,pindexNew,pindexNew->nHeight);
-                    if (!CheckProofOfWork(header,pubkey33,pindexNew->nHeight,Params().GetConsensus()))
-                        return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindexNew->ToString());
                 }
-                pcursor->Next();
-            } else {
-                return error("LoadBlockIndex() : failed to read value");
+                if (header.GetHash() != pindexNew->GetBlockHash())
+                    return error("LoadBlockIndex(): block header inconsistency detected: on-disk = %s, in-memory = %s",
+                                loaded.hash.ToString(),  pindexNew->ToString());
+
+                uint8_t pubkey33[33];
+                komodo_index2pubkey33(pubkey33,pindexNew,pindexNew->nHeight);
+                if (!CheckProofOfWork(header,pubkey33,pindexNew->nHeight,Params().GetConsensus()))
+                    return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindexNew->ToString());
             }
-        } else {
-            break;
         }
     }
 
@@ -29,6 +29,8 @@
 #include <string>
 #include <utility>
 #include <vector>
+
+#include <boost/optional.hpp>
 #include <univalue.h>
 
 class CBlockFileInfo;
@@ -39,6 +41,14 @@ struct CAddressUnspentValue;
 struct CAddressIndexKey;
 struct CAddressIndexIteratorKey;
 struct CAddressIndexIteratorHeightKey;
+struct CAddressBalanceValue;
+struct CContractIndexKey;
+struct CTokenOutputValue;
+struct CTokenSupplyValue;
+struct COracleSampleKey;
+struct COracleSampleValue;
+struct CGatewaysStateKey;
+struct CGatewaysStateValue;
 struct CTimestampIndexKey;
 struct CTimestampIndexIteratorKey;
 struct CTimestampBlockIndexKey;
@@ -54,10 +64,15 @@ static const int64_t nDefaultDbCache = 450;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! Format of the coins database: a record per unspent output and a header per transaction
+static const int COINS_DB_FORMAT = 2;
 
 /** 
  * CCoinsView backed by the coin database (chainstate/) 
 */
+/** Serialized coins database records, keyed by serialized key. An empty value marks an erased record. */
+typedef std::map<std::string, boost::optional<std::string> > CCoinsDBRecordMap;
+
 class CCoinsViewDB : public CCoinsView
 {
 protected:
@@ -81,6 +96,13 @@ public:
      * @returns true if the txid exists in the database
      */
     bool HaveCoins(const uint256 &txid) const;
+    /****
+     * Read a single output, with a point lookup
+     * @param outpoint the output
+     * @param coin the output and the metadata of its transaction
+     * @returns true if the output is unspent
+     */
+    bool GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const;
     uint256 GetBestBlock() const;
     uint256 GetBestAnchor(ShieldedType type) const;
     bool BatchWrite(CCoinsMap &mapCoins,
@@ -92,6 +114,37 @@ public:
                     CNullifiersMap &mapSproutNullifiers,
                     CNullifiersMap &mapSaplingNullifiers);
     bool GetStats(CCoinsStats &stats) const;
+    /****
+     * Serialize the changes a BatchWrite would apply, without applying them
+     * @param[in,out] records the resulting records, later changes override earlier ones
+     */
+    void RecordBatch(CCoinsDBRecordMap &records,
+                    CCoinsMap &mapCoins,
+                    const uint256 &hashBlock,
+                    const uint256 &hashSproutAnchor,
+                    const uint256 &hashSaplingAnchor,
+                    CAnchorsSproutMap &mapSproutAnchors,
+                    CAnchorsSaplingMap &mapSaplingAnchors,
+                    CNullifiersMap &mapSproutNullifiers,
+                    CNullifiersMap &mapSaplingNullifiers) const;
+    /***
+     * Get an iterator over the serialized records of the database
+     * NOTE: you are responsible for deletion of the returned iterator
+     * @returns an iterator
+     */
+    CDBIterator *RawCursor() const;
+    /****
+     * Write serialized records
+     * @param records the records, erased records are deleted
+     * @param fSync true to sync to disk
+     * @returns true on success
+     */
+    bool WriteRawRecords(const CCoinsDBRecordMap &records, bool fSync);
+    /****
+     * Convert whole-transaction coins records of older versions to per-output records
+     * @returns true on success, false on error or if interrupted by a shutdown
+     */
+    bool Upgrade();
 };
 
 /** 
@@ -163,6 +216,18 @@ public:
      * @returns true on success
      */
     bool ReadReindexing(bool &fReindex) const;
+    /****
+     * Record the format of the coins database, a version reading a format newer than its own refuses to start
+     * @param nFormat the format, see COINS_DB_FORMAT
+     * @returns true on success
+     */
+    bool WriteCoinsFormat(int nFormat);
+    /****
+     * Retrieve the format of the coins database
+     * @param nFormat the format, 0 if it was never recorded
+     * @returns true on success
+     */
+    bool ReadCoinsFormat(int &nFormat) const;
 
     bool ReadDiskBlockIndex(const uint256 &blockhash, CDiskBlockIndex &dbindex) const;
     /***
@@ -206,6 +271,18 @@ public:
      */
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    /****
+     * Read a page of the unspent key/value pairs for a particular address
+     * @param addressHash the address
+     * @param type the address type
+     * @param pkeyAfter the last key of the previous page, NULL for the first page
+     * @param nMax the most records to read
+     * @param vect the results
+     * @param fMore set to true if there are records after this page
+     * @returns true on success
+     */
+    bool ReadAddressUnspentIndexPage(uint160 addressHash, int type, const CAddressUnspentKey *pkeyAfter, size_t nMax,
+                                     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect, bool &fMore);
     /*****
      * Write a batch of address index / amount records
      * @param vect a collection of address index/amount records
@@ -218,6 +295,151 @@ public:
      * @returns true on success
      */
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    /****
+     * Write a batch of CC opreturn records
+     * @param vect the records, with the vout of the opreturn
+     * @returns true on success
+     */
+    bool WriteContractIndex(const std::vector<std::pair<CContractIndexKey, int32_t> > &vect);
+    /****
+     * Remove a batch of CC opreturn records
+     * @param vect the records to erase
+     * @returns true on success
+     */
+    bool EraseContractIndex(const std::vector<std::pair<CContractIndexKey, int32_t> > &vect);
+    /****
+     * Read the CC opreturn records of an evalcode and funcid
+     * @param evalcode the evalcode
+     * @param funcid the funcid
+     * @param vect the records found, in height order
+     * @returns true on success
+     */
+    bool ReadContractIndex(uint8_t evalcode, uint8_t funcid, std::vector<std::pair<CContractIndexKey, int32_t> > &vect);
+    /****
+     * Write the tokens outputs created and spent by a block, and update the balances and supplies of their tokens
+     * @param vCreated the tokens outputs of the block
+     * @param vSpent the tokens outputs spent by the block
+     * @param hashBlock the block, a block already applied is skipped
+     * @returns true on success
+     */
+    bool WriteTokenIndex(const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                         const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent, const uint256 &hashBlock);
+    /****
+     * Undo WriteTokenIndex for a disconnected block
+     * @param vCreated the tokens outputs of the block, their records are removed
+     * @param vSpent the tokens outputs spent by the block
+     * @param hashBlock the block, a block not applied is skipped
+     * @returns true on success
+     */
+    bool EraseTokenIndex(const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                         const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent, const uint256 &hashBlock);
+    /****
+     * Read a tokens output, spent or not
+     * @param outpoint the output
+     * @param value the token, address and amount of the output
+     * @returns false if it is not a tokens output
+     */
+    bool ReadTokenOutput(const COutPoint &outpoint, CTokenOutputValue &value);
+    /****
+     * Read the balance of a token on an address
+     * @param tokenid the token
+     * @param addressHash the CC address
+     * @param balance the balance, 0 if the address holds none
+     * @returns true on success
+     */
+    bool ReadTokenBalance(const uint256 &tokenid, const uint160 &addressHash, CAmount &balance);
+    /****
+     * Read the supply and holder count of a token
+     * @param tokenid the token
+     * @param supply the totals, null if the token is not known
+     * @returns true on success
+     */
+    bool ReadTokenSupply(const uint256 &tokenid, CTokenSupplyValue &supply);
+    /****
+     * Write the oracle data samples of a block
+     * @param vect the samples
+     * @returns true on success
+     */
+    bool WriteOracleSampleIndex(const std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect);
+    /****
+     * Erase the oracle data samples of a disconnected block
+     * @param vect the samples
+     * @returns true on success
+     */
+    bool EraseOracleSampleIndex(const std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect);
+    /****
+     * Read the last data samples of a publisher of an oracle
+     * @param oracletxid the oracle
+     * @param publisherHash the baton CC address of the publisher
+     * @param maxHeight the samples above this height are skipped
+     * @param num the number of samples to read, 0 for all
+     * @param vect the samples, newest first
+     * @returns true on success
+     */
+    bool ReadOracleSamples(const uint256 &oracletxid, const uint160 &publisherHash, int maxHeight, int num,
+                           std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect);
+    /****
+     * Read the last data sample of each publisher of an oracle
+     * @param oracletxid the oracle
+     * @param vect the samples, one per publisher
+     * @returns true on success
+     */
+    bool ReadOracleLatestSamples(const uint256 &oracletxid, std::vector<std::pair<COracleSampleKey, COracleSampleValue> > &vect);
+    /****
+     * Update the gateways lifecycle records of a block
+     * @param vect the records, a null value erases the record
+     * @param withdraws the bind of each withdraw, a null bindtxid erases it
+     * @returns true on success
+     */
+    bool UpdateGatewaysIndex(const std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &vect,
+                             const std::vector<std::pair<uint256, uint256> > &withdraws);
+    /****
+     * Read the lifecycle record of a deposit or a withdraw
+     * @param key the bind, the stage and the deposit or withdraw
+     * @param value the record
+     * @returns false if it is not at this stage
+     */
+    bool ReadGatewaysState(const CGatewaysStateKey &key, CGatewaysStateValue &value);
+    /****
+     * Read the bind of a withdraw
+     * @param withdrawtxid the withdraw
+     * @param bindtxid the bind
+     * @returns false if the withdraw is not indexed
+     */
+    bool ReadGatewaysWithdrawBind(const uint256 &withdrawtxid, uint256 &bindtxid);
+    /****
+     * Read the deposits or withdraws of a bind at a stage of their lifecycle
+     * @param bindtxid the bind
+     * @param stage the stage
+     * @param vect the records
+     * @returns true on success
+     */
+    bool ReadGatewaysStates(const uint256 &bindtxid, uint8_t stage, std::vector<std::pair<CGatewaysStateKey, CGatewaysStateValue> > &vect);
+    /****
+     * Read the running totals of an address
+     * @param addressHash the address
+     * @param type the address type
+     * @param balance the totals, null if the address has no records
+     * @returns true on success
+     */
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &balance);
+    /****
+     * Compute the running totals of the next addresses of the address index, for
+     * an address index written before they were kept
+     * @param pkeyAfter the last address done, NULL to start with the first one
+     * @param nMaxRecords stop at the first address after reading this many records
+     * @param keyLast set to the last address done
+     * @param fDone set to true once all the addresses are done
+     * @returns true on success
+     */
+    bool BackfillAddressBalances(const CAddressIndexIteratorKey *pkeyAfter, size_t nMaxRecords,
+                                 CAddressIndexIteratorKey &keyLast, bool &fDone);
+    /****
+     * Read where BackfillAddressBalances stopped
+     * @param keyLast the last address done
+     * @returns false if it has not started
+     */
+    bool ReadAddressBalanceBackfill(CAddressIndexIteratorKey &keyLast);
     /****
      * Read a range of address index / amount records for a particular address
      * @param addressHash the address to look for
@@ -230,6 +452,21 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /****
+     * Read a page of the address index / amount records for a particular address, by height
+     * @param addressHash the address to look for
+     * @param type the address type
+     * @param pkeyAfter the last key of the previous page, NULL for the first page
+     * @param nMax the most records to read
+     * @param addressIndex the address index / amount records found
+     * @param fMore set to true if there are records after this page
+     * @param start the first block height, used for the first page
+     * @param end the last block height, the range applies when start and end are both above 0
+     * @returns true on success
+     */
+    bool ReadAddressIndexPage(uint160 addressHash, int type, const CAddressIndexKey *pkeyAfter, size_t nMax,
+                              std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore,
+                              int start = 0, int end = 0);
     /****
      * Write a timestamp entry to the db
      * @param timestampIndex the record to write
@@ -274,6 +511,24 @@ public:
      * @returns true on success
      */
     bool ReadFlag(const std::string &name, bool &fValue) const;
+private:
+    /****
+     * Add (or remove) the address index records of a block to the running totals of their addresses
+     * @param batch where to write the updated totals
+     * @param vect the address index records of a block
+     * @param fErase true if the block is disconnected
+     */
+    void BatchAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase);
+    /****
+     * Add (or remove) the tokens outputs created and spent by a block to the balances and supplies of their tokens
+     * @param batch where to write the updated balances
+     * @param vCreated the tokens outputs of the block
+     * @param vSpent the tokens outputs spent by the block
+     * @param fErase true if the block is disconnected
+     */
+    void BatchTokenBalances(CDBBatch &batch, const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vCreated,
+                            const std::vector<std::pair<COutPoint, CTokenOutputValue> > &vSpent, bool fErase);
+public:
     /****
      * Load the block headers from disk
      * NOTE: this does no consistency check beyond verifying records exist
@@ -905,6 +905,13 @@ bool CCoinsViewMemPool::HaveCoins(const uint256 &txid) const {
     return mempool.exists(txid) || base->HaveCoins(txid);
 }
 
+bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const {
+    // Outputs of mempool transactions come from the whole transaction, as in GetCoins
+    if (mempool.exists(outpoint.hash))
+        return CCoinsView::GetCoin(outpoint, coin);
+    return base->GetCoin(outpoint, coin);
+}
+
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 6 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
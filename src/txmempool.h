@@ -293,6 +293,7 @@ public:
     bool GetNullifier(const uint256 &txid, ShieldedType type) const;
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
     bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, CCoinsOutput &coin) const;
 };
 
 #endif // BITCOIN_TXMEMPOOL_H
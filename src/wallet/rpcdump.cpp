@@ -1013,6 +1013,7 @@ UniValue NSPV_login(char *wifstr);
 UniValue NSPV_logout();
 UniValue NSPV_addresstxids(char *coinaddr,int32_t CCflag,int32_t skipcount,int32_t filter);
 UniValue NSPV_addressutxos(char *coinaddr,int32_t CCflag,int32_t skipcount,int32_t filter);
+UniValue NSPV_addresspage(uint8_t reqtype,char *coinaddr,int32_t CCflag,std::string cursorhex,int32_t maxcount);
 UniValue NSPV_mempooltxids(char *coinaddr,int32_t CCflag,uint8_t funcid,uint256 txid,int32_t vout);
 UniValue NSPV_broadcast(char *hex);
 UniValue NSPV_spend(char *srcaddr,char *destaddr,int64_t satoshis);
@@ -1125,6 +1126,37 @@ UniValue nspv_listtransactions(const UniValue& params, bool fHelp, const CPubKey
     else throw runtime_error("nspv_listtransactions [address [isCC [skipcount]]]\n");
 }
 
+static UniValue nspv_addresspage(uint8_t reqtype,const char *method,const UniValue& params, bool fHelp)
+{
+    int32_t CCflag = 0,maxcount = 0; std::string cursor;
+    if ( fHelp || params.size() < 1 || params.size() > 4 )
+        throw runtime_error(strprintf("%s address [isCC [cursor [count]]]\n"
+            "\nReturns a page of at most count (default and max %d) results, oldest first for transactions, and the cursor to pass to get the next page, empty after the last page.\n",method,NSPV_MAXPAGE));
+    if ( KOMODO_NSPV_FULLNODE )
+        throw runtime_error("-nSPV=1 must be set to use nspv\n");
+    if ( params.size() >= 2 )
+        CCflag = atoi((char *)params[1].get_str().c_str());
+    if ( params.size() >= 3 )
+    {
+        cursor = params[2].get_str();
+        if ( !IsHex(cursor) && cursor.size() != 0 )
+            throw runtime_error("cursor must be hex\n");
+    }
+    if ( params.size() == 4 )
+        maxcount = atoi((char *)params[3].get_str().c_str());
+    return(NSPV_addresspage(reqtype,(char *)params[0].get_str().c_str(),CCflag,cursor,maxcount));
+}
+
+UniValue nspv_listunspentpage(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    return(nspv_addresspage(NSPV_UTXOSPAGE,"nspv_listunspentpage",params,fHelp));
+}
+
+UniValue nspv_listtransactionspage(const UniValue& params, bool fHelp, const CPubKey& mypk)
+{
+    return(nspv_addresspage(NSPV_TXIDSPAGE,"nspv_listtransactionspage",params,fHelp));
+}
+
 UniValue nspv_spentinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     uint256 txid; int32_t vout;
@@ -3309,6 +3309,21 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             sample_times.push_back(benchmark_loadwallet());
         } else if (benchmarktype == "listunspent") {
             sample_times.push_back(benchmark_listunspent());
+        } else if (benchmarktype == "gettransaction") {
+            // Random transaction lookups through the transaction index, optionally with
+            // a number of memory-mapped block files (0 = read with fread) to compare
+            int nTxs = 1000;
+            int nMappedFiles = -1;
+            if (params.size() >= 3) {
+                nTxs = params[2].get_int();
+                if (nTxs <= 0) {
+                    throw JSONRPCError(RPC_TYPE_ERROR, "Invalid number of transactions");
+                }
+            }
+            if (params.size() >= 4) {
+                nMappedFiles = params[3].get_int();
+            }
+            sample_times.push_back(benchmark_gettransaction(nTxs, nMappedFiles));
         } else if (benchmarktype == "createsaplingspend") {
             sample_times.push_back(benchmark_create_sapling_spend());
         } else if (benchmarktype == "createsaplingoutput") {
@@ -7166,21 +7181,30 @@ UniValue tokeninfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
 UniValue tokenorders(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     uint256 tokenid;
-    if ( fHelp || params.size() > 1 )
-        throw runtime_error("tokenorders [tokenid]\n"
-                            "returns token orders for the tokenid or all available token orders if tokenid is not set\n"
+    int32_t limit = 0, offset = 0;
+    if ( fHelp || params.size() > 3 )
+        throw runtime_error("tokenorders [tokenid] [limit] [offset]\n"
+                            "returns token orders for the tokenid or all available token orders if tokenid is not set or 0\n"
+                            "the bids come first, the highest price first, then the asks, the lowest price first\n"
+                            "if limit is set then returns at most limit orders, after skipping offset orders\n"
                             "(this rpc supports only fungible tokens)\n" "\n");
     if (ensure_CCrequirements(EVAL_ASSETS) < 0 || ensure_CCrequirements(EVAL_TOKENS) < 0)
         throw runtime_error(CC_REQUIREMENTS_MSG);
-	if (params.size() == 1) {
+    if (params.size() > 1)
+        limit = atoi(params[1].get_str().c_str());
+    if (params.size() > 2)
+        offset = atoi(params[2].get_str().c_str());
+    if (limit < 0 || offset < 0)
+        throw runtime_error("incorrect limit or offset\n");
+	if (params.size() > 0 && params[0].get_str() != "0") {
 		tokenid = Parseuint256((char *)params[0].get_str().c_str());
 		if (tokenid == zeroid) 
 			throw runtime_error("incorrect tokenid\n");
-        return AssetOrders(tokenid, CPubKey(), 0);
+        return AssetOrders(tokenid, CPubKey(), 0, offset, limit);
 	}
     else {
         // throw runtime_error("no tokenid\n");
-        return AssetOrders(zeroid, CPubKey(), 0);
+        return AssetOrders(zeroid, CPubKey(), 0, offset, limit);
     }
 }
 
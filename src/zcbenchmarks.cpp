@@ -221,7 +221,7 @@ double benchmark_verify_equihash()
     CBlockHeader genesis_header = genesis.GetBlockHeader();
     struct timeval tv_start;
     timer_start(tv_start);
-    CheckEquihashSolution(&genesis_header, params);
+    CheckEquihashSolution(&genesis_header, params, false);
     return timer_stop(tv_start);
 }
 
@@ -475,6 +475,38 @@ double benchmark_listunspent()
     return timer_stop(tv_start);
 }
 
+double benchmark_gettransaction(size_t nTxs, int nMappedFiles)
+{
+    if (!fTxIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Benchmark needs -txindex");
+    if (chainActive.Height() < 1)
+        throw JSONRPCError(RPC_MISC_ERROR, "Benchmark needs a chain");
+
+    // Pick transactions from random blocks
+    std::vector<uint256> txids;
+    while (txids.size() < nTxs) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, chainActive[1 + GetRand(chainActive.Height())], 0))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to read block");
+        txids.push_back(block.vtx[GetRand(block.vtx.size())].GetHash());
+    }
+
+    if (nMappedFiles >= 0)
+        SetMappedBlockFiles(nMappedFiles);
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (const uint256 &txid : txids) {
+        CTransaction tx;
+        uint256 hashBlock;
+        if (!GetTransaction(txid, tx, hashBlock, false))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Transaction not found");
+    }
+    double duration = timer_stop(tv_start);
+    if (nMappedFiles >= 0)
+        SetMappedBlockFiles(GetArg("-mmapblockfiles", DEFAULT_MMAP_BLOCK_FILES));
+    return duration;
+}
+
 double benchmark_create_sapling_spend()
 {
     auto sk = libzcash::SaplingSpendingKey::random();